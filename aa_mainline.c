@@ -3,27 +3,42 @@
 #include <stdlib.h> /* for free() */
 #include <unistd.h> /* for getopt() */
 #include <ctype.h>  /* for isdigit() */
-#include <time.h>   /* for clock() */
 #include <errno.h>
 
 #include "aarray.h"
 #include "data-reader.h"
 #include "keyprint.h"
+#include "strarena.h"
+#include "latency.h"
+#include "perfcounters.h"
+#include "resultwriter.h"
+#include "querypipeline.h"
 
 #define	LINE_MAX	128
 
+/** copy a value, into the arena if there is one */
+static char *
+copyValue(StringArena *arena, const char *value)
+{
+	if (arena != NULL)
+		return arenaStrdup(arena, value);
+	return strdup(value);
+}
+
 /**
  * Load the assocArray of attribute value entries
  */
 static int
-loadAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKey)
+loadAssociativeArray(AssociativeArray *assocArray, char *filename,
+		int useIntKey, int copyValues, StringArena *arena,
+		LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	int nEntries = 0;
-	clock_t startTime, endTime;
+	int nEntries = 0, status;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int intkey;
+	long long intkey;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -33,33 +48,51 @@ loadAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKey
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readDataLine(fp, linebuffer, LINE_MAX, &strkey, &value) > 0) {
 		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
-			if (aaInsert(assocArray,
-						(AAKeyType) &intkey, sizeof(int),
-						strdup(value)) < 0) {
-				fprintf(stderr, "Failed to add key '%d' to assocArray\n", intkey);
+			value = copyValue(arena, value);
+			opStart = latencyStart(latency);
+			status = aaInsertI64(assocArray, intkey, value);
+			latencyStop(latency, opStart);
+			if (status < 0) {
+				fprintf(stderr, "Failed to add key '%lld' to assocArray\n", intkey);
+				return -1;
+			}
+		} else if (copyValues) {
+			opStart = latencyStart(latency);
+			status = aaInsertValue(assocArray,
+					(AAKeyType) strkey, strlen(strkey),
+					value, strlen(value));
+			latencyStop(latency, opStart);
+			if (status < 0) {
+				fprintf(stderr, "Failed to add key '%s' to assocArray\n", strkey);
 				return -1;
 			}
+
 		} else {
 
-			if (aaInsert(assocArray,
-						(AAKeyType) strkey, strlen(strkey),
-						strdup(value)) < 0) {
+			value = copyValue(arena, value);
+			opStart = latencyStart(latency);
+			status = aaInsert(assocArray,
+					(AAKeyType) strkey, strlen(strkey), value);
+			latencyStop(latency, opStart);
+			if (status < 0) {
 				fprintf(stderr, "Failed to add key '%s' to assocArray\n", strkey);
 				return -1;
 			}
 		}
 		nEntries++;
 	}
-	endTime = clock();
+	perfCountersStop(perf, nEntries);
+	endTime = latencyNow();
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Inserts took %lf seconds\n", timeTaken);
 
 	fclose(fp);
@@ -70,54 +103,240 @@ loadAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKey
  * Query the array with all the values in the given file
  */
 static int
-queryAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKey)
+queryAssociativeArray(AssociativeArray *assocArray, char *filename,
+		int useIntKey, int copyValues, ResultWriter *results,
+		LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	int intkey;
-	clock_t startTime, endTime;
+	AAValueView view;
+	long long intkey;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
+	int found, nQueries = 0;
 	FILE *fp = NULL;
 
-	fp = fopen(filename, "r");
+	fp = openInputFile(filename);
 	if (fp == NULL) {
 		fprintf(stderr, "Error: Failed to open query input file '%s' : %s\n",
 				filename, strerror(errno));
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
+		nQueries++;
 		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
 
-			value = aaLookup(assocArray, (AAKeyType) &intkey, sizeof(int));
+			opStart = latencyStart(latency);
+			value = aaLookupI64(assocArray, intkey);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("LOOKUP: key (%d) produced no value\n", intkey);
+				resultWriterIntegerValue(results, "LOOKUP", intkey, NULL, 0);
+			} else {
+				resultWriterIntegerValue(results, "LOOKUP", intkey,
+						value, strlen(value));
+			}
+
+		} else if (copyValues) {
+			opStart = latencyStart(latency);
+			found = aaLookupView(assocArray,
+					(AAKeyType) strkey, strlen(strkey), &view);
+			latencyStop(latency, opStart);
+			if ( ! found) {
+				resultWriterValue(results, "LOOKUP", strkey, NULL, 0);
 			} else {
-				printf("LOOKUP: key (%d) produced value '%s'\n", intkey, value);
+				resultWriterValue(results, "LOOKUP", strkey,
+						(const char *) view.data, view.length);
 			}
 
 		} else {
+			opStart = latencyStart(latency);
 			value = aaLookup(assocArray, (AAKeyType) strkey, strlen(strkey));
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("LOOKUP: key '%s' produced no value\n", strkey);
+				resultWriterValue(results, "LOOKUP", strkey, NULL, 0);
 			} else {
-				printf("LOOKUP: key '%s' produced value '%s'\n", strkey, value);
+				resultWriterValue(results, "LOOKUP", strkey, value, strlen(value));
 			}
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Queries took %lf seconds\n", timeTaken);
 
 	/** cleanup list */
 
-	fclose(fp);
+	closeInputFile(fp);
+	return 1;
+}
+
+/** what the lookup workers of a pipelined query need to know */
+typedef struct AAQueryContext {
+	AssociativeArray *assocArray;
+	int useIntKey;
+	int copyValues;
+} AAQueryContext;
+
+/** look up one key on a pipeline worker, as queryAssociativeArray() does */
+static int
+pipelineLookup(void *userdata, const char *strkey, QueryResult *result)
+{
+	AAQueryContext *context = (AAQueryContext *) userdata;
+	AAValueView view;
+	long long intkey;
+
+	result->value = NULL;
+	result->length = 0;
+	if (context->useIntKey && isdigit(strkey[0])) {
+		if (sscanf(strkey, "%lld", &intkey) == 1)
+			result->value = aaLookupI64(context->assocArray, intkey);
+	} else if (context->copyValues) {
+		if (aaLookupView(context->assocArray,
+					(AAKeyType) strkey, strlen(strkey), &view)) {
+			result->value = (void *) view.data;
+			result->length = view.length;
+		}
+		return 0;
+	} else {
+		result->value = aaLookup(context->assocArray,
+				(AAKeyType) strkey, strlen(strkey));
+	}
+	if (result->value != NULL)
+		result->length = strlen((char *) result->value);
+	return 0;
+}
+
+/** write out the result of one key, in the order of the query file */
+static void
+pipelineReport(void *userdata, ResultWriter *results,
+		const char *strkey, QueryResult *result)
+{
+	AAQueryContext *context = (AAQueryContext *) userdata;
+	long long intkey;
+
+	if (context->useIntKey && isdigit(strkey[0])
+			&& sscanf(strkey, "%lld", &intkey) == 1) {
+		resultWriterIntegerValue(results, "LOOKUP", intkey,
+				(const char *) result->value, result->length);
+	} else {
+		resultWriterValue(results, "LOOKUP", strkey,
+				(const char *) result->value, result->length);
+	}
+}
+
+/**
+ * Query the array with all the keys in the given file, looking them
+ * up on nWorkers threads at once
+ */
+static int
+pipelineQueryAssociativeArray(AssociativeArray *assocArray, char *filename,
+		int useIntKey, int copyValues, int nWorkers, ResultWriter *results,
+		LatencyHistogram *latency, PerfCounters *perf)
+{
+	AAQueryContext context;
+	QueryPipelineStats stats;
+	uint64_t startTime, endTime;
+	double timeTaken;
+	int status;
+	FILE *fp = NULL;
+
+	fp = openInputFile(filename);
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Failed to open query input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	context.assocArray = assocArray;
+	context.useIntKey = useIntKey;
+	context.copyValues = copyValues;
+
+	startTime = latencyNow();
+	perfCountersStart(perf);
+	status = queryPipelineRun(fp, nWorkers, pipelineLookup, pipelineReport,
+			&context, results, latency, &stats);
+	perfCountersStop(perf, stats.nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
+	closeInputFile(fp);
+
+	if (status < 0) {
+		fprintf(stderr, "Error: cannot start %d query threads\n", nWorkers);
+		return -1;
+	}
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Queries took %lf seconds on %d threads\n", timeTaken, nWorkers);
+	return 1;
+}
+
+/**
+ * Query with all the (string) keys in the given file, handing them
+ * to aaLookupBatch() AA_LOOKUP_BATCH_MAX at a time
+ */
+static int
+batchQueryAssociativeArray(AssociativeArray *assocArray, char *filename,
+		ResultWriter *results, LatencyHistogram *latency, PerfCounters *perf)
+{
+	char linebuffers[AA_LOOKUP_BATCH_MAX][LINE_MAX];
+	AAKeyType keys[AA_LOOKUP_BATCH_MAX];
+	size_t keylengths[AA_LOOKUP_BATCH_MAX];
+	void *values[AA_LOOKUP_BATCH_MAX];
+	char *strkey = NULL;
+	uint64_t startTime, endTime, opStart;
+	double timeTaken;
+	int i, n, more = 1, nQueries = 0;
+	FILE *fp = NULL;
+
+	fp = openInputFile(filename);
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Failed to open query input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	startTime = latencyNow();
+	perfCountersStart(perf);
+	while (more) {
+		for (n = 0; n < AA_LOOKUP_BATCH_MAX; n++) {
+			if ( ! readPlainLine(fp, linebuffers[n], LINE_MAX, &strkey)) {
+				more = 0;
+				break;
+			}
+			keys[n] = (AAKeyType) strkey;
+			keylengths[n] = strlen(strkey);
+		}
+
+		nQueries += n;
+		opStart = latencyStart(latency);
+		aaLookupBatch(assocArray, keys, keylengths, values, n);
+		latencyStop(latency, opStart);
+		for (i = 0; i < n; i++) {
+			resultWriterValue(results, "LOOKUP", (char *) keys[i],
+					(char *) values[i],
+					(values[i] == NULL) ? 0 : strlen((char *) values[i]));
+		}
+	}
+	perfCountersStop(perf, nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Queries took %lf seconds\n", timeTaken);
+
+	closeInputFile(fp);
 	return 1;
 }
 
@@ -127,13 +346,17 @@ queryAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKe
  * these values outside of the library
  */
 static int
-deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename, int useIntKey)
+deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename,
+		int useIntKey, int copyValues, StringArena *arena,
+		ResultWriter *results, LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	clock_t startTime, endTime;
+	size_t valuelength;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int intkey;
+	long long intkey;
+	int nDeletions = 0, deleted;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -143,35 +366,60 @@ deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename, int use
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
+		nDeletions++;
 		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
 
-			value = aaDelete(assocArray, (AAKeyType) &intkey, sizeof(int));
+			opStart = latencyStart(latency);
+			value = aaDeleteI64(assocArray, intkey);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("DELETE: key (%d) produced no value\n", intkey);
+				resultWriterIntegerValue(results, "DELETE", intkey, NULL, 0);
 			} else {
-				printf("DELETE: key (%d) produced value '%s'\n", intkey, value);
+				resultWriterIntegerValue(results, "DELETE", intkey,
+						value, strlen(value));
+				if (arena == NULL)
+					free(value);
+			}
+
+		} else if (copyValues) {
+			/** the array hands its copy of the value back to be freed */
+			opStart = latencyStart(latency);
+			deleted = aaDeleteValue(assocArray, (AAKeyType) strkey,
+					strlen(strkey), (void **) &value, &valuelength);
+			latencyStop(latency, opStart);
+			if (deleted <= 0) {
+				resultWriterValue(results, "DELETE", strkey, NULL, 0);
+			} else {
+				resultWriterValue(results, "DELETE", strkey, value, valuelength);
 				free(value);
 			}
 
 		} else {
+			opStart = latencyStart(latency);
 			value = aaDelete(assocArray, (AAKeyType) strkey, strlen(strkey));
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("DELETE: key '%s' produced no value\n", strkey);
+				resultWriterValue(results, "DELETE", strkey, NULL, 0);
 			} else {
-				printf("DELETE: key '%s' produced value '%s'\n", strkey, value);
-				free(value);
+				resultWriterValue(results, "DELETE", strkey, value, strlen(value));
+				if (arena == NULL)
+					free(value);
 			}
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nDeletions);
+	endTime = latencyNow();
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	resultWriterFlush(results);
+
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Deletions took %lf seconds\n", timeTaken);
 
 	fclose(fp);
@@ -215,7 +463,52 @@ void usage(char *progname)
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options: \n");
 	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
-	fprintf(stderr, "%-*s: If a key is made of digits, store it as an int.\n", OPTIONLEN, "-i");
+	fprintf(stderr, "%-*s: If a key is made of digits, store it as a 64-bit integer key;\n", OPTIONLEN, "-i");
+	fprintf(stderr, "%-*s: these are iterated in numeric order.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Have the array keep its own copy of each value, storing\n",
+			OPTIONLEN, "-v <N>");
+	fprintf(stderr, "%-*s: values of up to <N> bytes inside the trie node itself.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Cannot be combined with -i unless -s or -S is given.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Copy values into a string arena that is freed in one go\n",
+			OPTIONLEN, "-s");
+	fprintf(stderr, "%-*s: at exit, rather than with strdup(3).\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -s, also storing repeated values only once.\n",
+			OPTIONLEN, "-S");
+	fprintf(stderr, "%-*s: Check string keys against a Bloom filter with false\n",
+			OPTIONLEN, "-f <RATE>");
+	fprintf(stderr, "%-*s: positive rate <RATE> (e.g. 0.01) before the trie.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Answer queries %d keys at a time with aaLookupBatch().\n",
+			OPTIONLEN, "-b", AA_LOOKUP_BATCH_MAX);
+	fprintf(stderr, "%-*s: Cannot be combined with -i or -v.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Scan each trie node's children most used first, reordering\n",
+			OPTIONLEN, "-r");
+	fprintf(stderr, "%-*s: them as lookups go.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Cache up to <N> recently found keys in front of the trie.\n",
+			OPTIONLEN, "-c <N>");
+	fprintf(stderr, "%-*s: Answer queries on <N> lookup threads, with a reader\n",
+			OPTIONLEN, "-Q <N>");
+	fprintf(stderr, "%-*s: thread feeding them and results in query file order.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Cannot be combined with -b, -c, -f or -r.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Print the summary statistics as JSON.\n", OPTIONLEN, "-j");
+	fprintf(stderr, "%-*s: Time each insert, lookup and delete, and report\n",
+			OPTIONLEN, "-l");
+	fprintf(stderr, "%-*s: percentiles of their latencies.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -l, also writing every latency (in ns) to <FILE>.\n",
+			OPTIONLEN, "-L <FILE>");
+	fprintf(stderr, "%-*s: Count cycles, instructions, LLC, branch and dTLB misses\n",
+			OPTIONLEN, "-C");
+	fprintf(stderr, "%-*s: over the insert, delete and query phases, per operation.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Write query and delete results as tab separated\n",
+			OPTIONLEN, "-T");
+	fprintf(stderr, "%-*s: \"OPERATION KEY VALUE\" lines, leaving out the value\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: (and its tab) for keys not found.\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
 			OPTIONLEN, "-o <FILE>");
 	fprintf(stderr, "%-*s: Size of table used internally, default %d.\n",
@@ -229,6 +522,7 @@ void usage(char *progname)
 	fprintf(stderr, "%-*s: or \"doublehash\".\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Perform queries on all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-q <FILE>");
+	fprintf(stderr, "%-*s: or, if <FILE> is \"-\", read from stdin.\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Delete all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-d <FILE>");
 	fprintf(stderr, "\n");
@@ -248,10 +542,27 @@ main(int argc, char **argv)
 	char *programname = NULL;
 	FILE *ofp = stdout;
 	int arraySize = DEFAULT_ARRAY_SIZE;
+	int cacheSize = 0;
+	int adaptiveOrder = 0;
+	int summaryJSON = 0;
+	int measureLatency = 0;
+	FILE *latencyfp = NULL;
+	LatencyHistogram *insertLatency = NULL, *lookupLatency = NULL;
+	LatencyHistogram *deleteLatency = NULL;
+	int countEvents = 0;
+	PerfCounters *insertPerf = NULL, *lookupPerf = NULL, *deletePerf = NULL;
 	int useIntKey = 0;
+	int copyValues = 0, maxInline = 0;
+	int useArena = 0, internValues = 0;
+	StringArena *arena = NULL;
 	int iterateContents = 0;
+	int batchQueries = 0;
+	int nQueryThreads = 0;
+	double filterRate = 0;
 	int printContents = 0;
 	char *queryfile = NULL, *deletefile = NULL;
+	ResultFormat resultFormat = RESULT_TEXT;
+	ResultWriter *results;
 	int i, c;
 
 	AssociativeArray *assocArray;
@@ -261,13 +572,75 @@ main(int argc, char **argv)
 	programname = argv[0];
 
 	/** use getopt(3) to parse command line */
-	while ((c = getopt(argc, argv, "hpiIn:H:P:2:o:q:d:")) != -1) {
+	while ((c = getopt(argc, argv, "hpjlCiIsSbrTn:H:P:2:o:q:d:v:f:c:L:Q:")) != -1) {
 		if (c == 'i') {
 			useIntKey = 1;
+		} else if (c == 'T') {
+			resultFormat = RESULT_TSV;
 		} else if (c == 'I') {
 			iterateContents = 1;
 		} else if (c == 'p') {
 			printContents = 1;
+
+		} else if (c == 's') {
+			useArena = 1;
+
+		} else if (c == 'S') {
+			useArena = 1;
+			internValues = 1;
+
+		} else if (c == 'b') {
+			batchQueries = 1;
+
+		} else if (c == 'f') {
+			if (sscanf(optarg, "%lf", &filterRate) != 1
+					|| filterRate <= 0 || filterRate >= 1) {
+				fprintf(stderr,
+						"Error: cannot parse filter false positive"
+						" rate (between 0 and 1) from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+		} else if (c == 'C') {
+			countEvents = 1;
+
+		} else if (c == 'l') {
+			measureLatency = 1;
+
+		} else if (c == 'L') {
+			measureLatency = 1;
+			latencyfp = fopen(optarg, "w");
+			if (latencyfp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested latency file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
+		} else if (c == 'j') {
+			summaryJSON = 1;
+
+		} else if (c == 'r') {
+			adaptiveOrder = 1;
+
+		} else if (c == 'Q') {
+			if (sscanf(optarg, "%d", &nQueryThreads) != 1 || nQueryThreads < 1) {
+				fprintf(stderr,
+						"Error: cannot parse number of query"
+						" threads requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
+		} else if (c == 'c') {
+			if (sscanf(optarg, "%d", &cacheSize) != 1 || cacheSize < 0) {
+				fprintf(stderr,
+						"Error: cannot parse cache"
+						" size requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
 		} else if (c == 'n') {
 			if (sscanf(optarg, "%d", &arraySize) != 1) {
 				fprintf(stderr,
@@ -286,6 +659,16 @@ main(int argc, char **argv)
 		} else if (c == 'P') {
 			probe = optarg;
 
+		} else if (c == 'v') {
+			if (sscanf(optarg, "%d", &maxInline) != 1 || maxInline < 0) {
+				fprintf(stderr,
+						"Error: cannot parse inline value"
+						" size requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+			copyValues = 1;
+
 		} else if (c == 'q') {
 			queryfile = optarg;
 
@@ -315,6 +698,31 @@ main(int argc, char **argv)
 		usage(programname);
 	}
 
+	/**
+	 * integer keyed values are still ours to free at exit, which
+	 * the sweep below cannot do once some of the values belong to
+	 * the array (unless they all go when the arena does)
+	 */
+	if (copyValues && useIntKey && ! useArena) {
+		fprintf(stderr, "Error: -v and -i cannot be used together\n");
+		usage(programname);
+	}
+
+	if (batchQueries && (useIntKey || copyValues)) {
+		fprintf(stderr, "Error: -b cannot be used with -i or -v\n");
+		usage(programname);
+	}
+
+	/**
+	 * the cache, filter and adaptive ordering all update the trie
+	 * as it is read, which the query threads cannot share
+	 */
+	if (nQueryThreads > 0
+			&& (batchQueries || cacheSize > 0 || filterRate > 0 || adaptiveOrder)) {
+		fprintf(stderr, "Error: -Q cannot be used with -b, -c, -f or -r\n");
+		usage(programname);
+	}
+
 	/** allocate the array and fail out if we cannot */
 	assocArray = aaCreateAssociativeArray(arraySize, probe, hash1, hash2);
 	if (assocArray == NULL) {
@@ -322,10 +730,67 @@ main(int argc, char **argv)
 		return -1;
 	}
 
+	if (copyValues && aaSetValueBytes(assocArray, maxInline) < 0) {
+		fprintf(stderr, "Error: cannot set up value storage - exitting\n");
+		return -1;
+	}
+
+	if (filterRate > 0 && aaSetFilter(assocArray, filterRate) < 0) {
+		fprintf(stderr, "Error: cannot set up key filter - exitting\n");
+		return -1;
+	}
+
+	if (cacheSize > 0 && aaSetCache(assocArray, (size_t) cacheSize) < 0) {
+		fprintf(stderr, "Error: cannot set up key cache - exitting\n");
+		return -1;
+	}
+
+	if (adaptiveOrder && aaSetAdaptiveOrder(assocArray, 1) < 0) {
+		fprintf(stderr, "Error: cannot set up adaptive ordering - exitting\n");
+		return -1;
+	}
+
+
+	if (useArena) {
+		arena = arenaCreate(internValues);
+		if (arena == NULL) {
+			fprintf(stderr, "Error: cannot allocate string arena - exitting\n");
+			return -1;
+		}
+	}
+
+	/** batched lookups are timed a whole batch at a time */
+	if (measureLatency) {
+		insertLatency = latencyCreate("insert", latencyfp != NULL);
+		lookupLatency = latencyCreate(batchQueries ? "lookup-batch" : "lookup",
+				latencyfp != NULL);
+		deleteLatency = latencyCreate("delete", latencyfp != NULL);
+		if (insertLatency == NULL || lookupLatency == NULL || deleteLatency == NULL) {
+			fprintf(stderr, "Error: cannot allocate latency histograms - exitting\n");
+			return -1;
+		}
+	}
+
+	if (countEvents) {
+		insertPerf = perfCountersCreate("insert");
+		lookupPerf = perfCountersCreate("lookup");
+		deletePerf = perfCountersCreate("delete");
+		if (insertPerf == NULL || lookupPerf == NULL || deletePerf == NULL) {
+			fprintf(stderr, "Error: cannot allocate performance counters - exitting\n");
+			return -1;
+		}
+	}
+
+	results = resultWriterCreate(stdout, resultFormat);
+	if (results == NULL) {
+		fprintf(stderr, "Error: cannot allocate result writer - exitting\n");
+		return -1;
+	}
 
 	/** getopt leaves us only "file" arguments left in argv */
 	for (i = 0; i < argc; i++) {
-		if (loadAssociativeArray(assocArray, argv[i], useIntKey) < 0) {
+		if (loadAssociativeArray(assocArray, argv[i], useIntKey, copyValues,
+					arena, insertLatency, insertPerf) < 0) {
 			fprintf(stderr, "Error: failed loading from file '%s'\n", argv[i]);
 			return -1;
 		}
@@ -335,28 +800,58 @@ main(int argc, char **argv)
 
 	/** delete anything that we were asked to */
 	if (deletefile != NULL) {
-		deleteFromAssociativeArray(assocArray, deletefile, useIntKey);
+		deleteFromAssociativeArray(assocArray, deletefile, useIntKey, copyValues,
+				arena, results, deleteLatency, deletePerf);
 	}
 
 	/** perform any queries we were asked to */
 	if (queryfile != NULL) {
-		queryAssociativeArray(assocArray, queryfile, useIntKey);
+		if (batchQueries) {
+			batchQueryAssociativeArray(assocArray, queryfile,
+					results, lookupLatency, lookupPerf);
+		} else if (nQueryThreads > 0) {
+			pipelineQueryAssociativeArray(assocArray, queryfile,
+					useIntKey, copyValues, nQueryThreads,
+					results, lookupLatency, lookupPerf);
+		} else {
+			queryAssociativeArray(assocArray, queryfile, useIntKey, copyValues,
+					results, lookupLatency, lookupPerf);
+		}
 	}
 
+	resultWriterDelete(results);
+
 	/** iterate (printing each key) */
 	if (iterateContents) {
 		aaIterateAction(assocArray, printIteratorValue, stdout);
 	}
 
+	latencyFinish(stdout, latencyfp, insertLatency);
+	latencyFinish(stdout, latencyfp, deleteLatency);
+	latencyFinish(stdout, latencyfp, lookupLatency);
+	perfCountersFinish(stdout, insertPerf);
+	perfCountersFinish(stdout, deletePerf);
+	perfCountersFinish(stdout, lookupPerf);
+	if (latencyfp != NULL)
+		fclose(latencyfp);
+
 	/* print out what we loaded */
-	aaPrintSummary(ofp, assocArray);
+	if (summaryJSON) {
+		aaPrintSummaryJSON(ofp, assocArray);
+	} else {
+		aaPrintSummary(ofp, assocArray);
+	}
+	if (arena != NULL)
+		arenaPrintSummary(ofp, arena);
 	if (printContents) {
 		aaPrintContents(ofp, assocArray, "  ");
 	}
 
 	/* clean up before exit */
-	aaIterateAction(assocArray, deleteValue, NULL);
+	if ( ! copyValues && arena == NULL)
+		aaIterateAction(assocArray, deleteValue, NULL);
 	aaDeleteAssociativeArray(assocArray);
+	arenaDelete(arena);
 
 	/* exit with success if we get here */
 	return 0;
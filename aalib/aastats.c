@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "trie_defs.h"
+
+
+/** serial numbers for arrays; 0 marks an empty thread slot */
+static unsigned long aa_next_serial = 0;
+
+/** each thread's most recently used blocks, by array serial number */
+static __thread struct {
+	unsigned long serial;
+	AAThreadStats *stats;
+} aa_thread_slots[AA_STATS_THREAD_SLOTS];
+
+
+/** set up the statistics of a new array */
+void
+aa_stats_init(AssociativeArray *aarray)
+{
+	aarray->serial = __sync_add_and_fetch(&aa_next_serial, 1);
+	pthread_mutex_init(&aarray->statsLock, NULL);
+	aarray->threadStats = NULL;
+}
+
+void
+aa_stats_free(AssociativeArray *aarray)
+{
+	AAThreadStats *block, *next;
+
+	for (block = aarray->threadStats; block != NULL; block = next) {
+		next = block->next;
+		free(block);
+	}
+	pthread_mutex_destroy(&aarray->statsLock);
+}
+
+/**
+ * Find this thread's block for the array, creating it the first time.
+ * Only this path takes the lock; afterwards the thread local slot
+ * answers.  Returns NULL if a block cannot be allocated.
+ */
+static AAThreadStats *
+aa_stats_thread_block(AssociativeArray *aarray)
+{
+	int slot = (int) (aarray->serial % AA_STATS_THREAD_SLOTS);
+	pthread_t self = pthread_self();
+	AAThreadStats *block;
+
+	if (aa_thread_slots[slot].serial == aarray->serial)
+		return aa_thread_slots[slot].stats;
+
+	pthread_mutex_lock(&aarray->statsLock);
+	for (block = aarray->threadStats; block != NULL; block = block->next) {
+		if (pthread_equal(block->owner, self))
+			break;
+	}
+	if (block == NULL) {
+		block = (AAThreadStats *) malloc(sizeof(AAThreadStats));
+		if (block != NULL) {
+			memset(block, 0, sizeof(AAThreadStats));
+			block->owner = self;
+			block->next = aarray->threadStats;
+			aarray->threadStats = block;
+		}
+	}
+	pthread_mutex_unlock(&aarray->statsLock);
+
+	if (block != NULL) {
+		aa_thread_slots[slot].serial = aarray->serial;
+		aa_thread_slots[slot].stats = block;
+	}
+	return block;
+}
+
+/** count one operation, and the trie nodes it visited */
+void
+aa_stats_count(AssociativeArray *aarray, AAOperation operation, int visits)
+{
+	AAThreadStats *block = aa_stats_thread_block(aarray);
+	AAOperationStats *op;
+
+	if (block == NULL)
+		return;
+	op = &block->operations[operation];
+	op->count++;
+	op->nodeVisits += visits;
+	op->visitHistogram[(visits < AA_STATS_VISIT_BUCKETS)
+			? visits : AA_STATS_VISIT_BUCKETS - 1]++;
+}
+
+const char *
+aaOperationName(AAOperation operation)
+{
+	static const char *names[AA_N_OPERATIONS] = {
+			"insert", "lookup", "delete", "pattern"
+		};
+
+	if (operation < 0 || operation >= AA_N_OPERATIONS)
+		return "unknown";
+	return names[operation];
+}
+
+/**
+ * Gather the statistics of the array.  The per thread counts are
+ * added up without stopping the threads that own them, so counts
+ * taken while other threads are working are approximate.
+ */
+int
+aaGetStats(AssociativeArray *aarray, AAStats *stats)
+{
+	AAThreadStats *block;
+	int i, j;
+
+	memset(stats, 0, sizeof(AAStats));
+
+	pthread_mutex_lock(&aarray->statsLock);
+	for (block = aarray->threadStats; block != NULL; block = block->next) {
+		for (i = 0; i < AA_N_OPERATIONS; i++) {
+			stats->operations[i].count += block->operations[i].count;
+			stats->operations[i].nodeVisits += block->operations[i].nodeVisits;
+			for (j = 0; j < AA_STATS_VISIT_BUCKETS; j++) {
+				stats->operations[i].visitHistogram[j]
+						+= block->operations[i].visitHistogram[j];
+			}
+		}
+		stats->bytesAllocated += sizeof(AAThreadStats);
+	}
+	pthread_mutex_unlock(&aarray->statsLock);
+
+	stats->bytesAllocated += sizeof(AssociativeArray);
+	stats->nStringKeys = aarray->trie->nKeys;
+	trieGetStats(aarray->trie, stats);
+	if (aarray->intTrie != NULL) {
+		stats->nIntegerKeys = aarray->intTrie->nEntries;
+		trieU64GetStats(aarray->intTrie, stats);
+	}
+	if (aarray->filter != NULL) {
+		stats->bytesAllocated += sizeof(TrieFilter)
+				+ aarray->filter->nBlocks * TRIE_FILTER_BLOCK_WORDS * sizeof(uint64_t);
+	}
+	if (aarray->cache != NULL) {
+		stats->bytesAllocated += sizeof(TrieCache)
+				+ aarray->cache->nBuckets
+						* (TRIE_CACHE_WAYS * sizeof(TrieCacheEntry) + 1);
+	}
+
+	stats->nEntries = stats->nStringKeys + stats->nIntegerKeys;
+	if (stats->nEntries > 0)
+		stats->bytesPerKey = (double) stats->bytesAllocated / stats->nEntries;
+	return 0;
+}
+
+/** print the non-empty buckets of a histogram as "value:count" pairs */
+static void
+aa_print_histogram(FILE *fp, const char *label, const uint64_t *histogram,
+		int nBuckets)
+{
+	int i;
+
+	fprintf(fp, "  %-10s:", label);
+	for (i = 0; i < nBuckets; i++) {
+		if (histogram[i] != 0) {
+			fprintf(fp, " %d%s:%llu", i, (i == nBuckets - 1) ? "+" : "",
+					(unsigned long long) histogram[i]);
+		}
+	}
+	fprintf(fp, "\n");
+}
+
+/**
+ * Print out a short summary
+ */
+void aaPrintSummary(FILE *fp, AssociativeArray *aarray)
+{
+	AAStats stats;
+	int i;
+
+	aaGetStats(aarray, &stats);
+
+	fprintf(fp, "Associative array contains %llu entries\n",
+			(unsigned long long) stats.nEntries);
+	fprintf(fp, "Costs accrued while processing keys:\n");
+	fprintf(fp, "  Insertion : %llu\n",
+			(unsigned long long) stats.operations[AA_OP_INSERT].nodeVisits);
+	fprintf(fp, "  Search    : %llu\n",
+			(unsigned long long) (stats.operations[AA_OP_LOOKUP].nodeVisits
+					+ stats.operations[AA_OP_PATTERN].nodeVisits));
+	fprintf(fp, "  Deletion  : %llu\n",
+			(unsigned long long) stats.operations[AA_OP_DELETE].nodeVisits);
+	fprintf(fp, "Trie nodes visited per operation:\n");
+	for (i = 0; i < AA_N_OPERATIONS; i++) {
+		if (stats.operations[i].count == 0)
+			continue;
+		fprintf(fp, "  %-10s: %llu operations, %.2f nodes each\n",
+				aaOperationName(i),
+				(unsigned long long) stats.operations[i].count,
+				(double) stats.operations[i].nodeVisits / stats.operations[i].count);
+		aa_print_histogram(fp, "visits", stats.operations[i].visitHistogram,
+				AA_STATS_VISIT_BUCKETS);
+	}
+	fprintf(fp, "Trie shape: %llu nodes, %llu bytes, %.1f bytes per key\n",
+			(unsigned long long) stats.nNodes,
+			(unsigned long long) stats.bytesAllocated, stats.bytesPerKey);
+	aa_print_histogram(fp, "key depth", stats.depthHistogram, AA_STATS_DEPTH_BUCKETS);
+	aa_print_histogram(fp, "fanout", stats.fanoutHistogram, AA_STATS_FANOUT_BUCKETS);
+
+	if (aarray->trie->adaptiveOrder) {
+		fprintf(fp, "Adaptive ordering: %.2f letters compared per node scanned\n",
+				trieAverageScanLength(aarray->trie));
+	}
+	if (aarray->filter != NULL) {
+		fprintf(fp, "Filter ruled out %lu of %lu keys checked (%d hashes, %lu rebuilds)\n",
+				(unsigned long) aarray->filter->nRejected,
+				(unsigned long) aarray->filter->nChecked,
+				aarray->filter->nHashes,
+				(unsigned long) aarray->filter->nRebuilds);
+	}
+	if (aarray->cache != NULL) {
+		fprintf(fp, "Cache hit %lu of %lu lookups (%lu admitted, %lu evicted, %lu invalidated)\n",
+				(unsigned long) aarray->cache->nHits,
+				(unsigned long) (aarray->cache->nHits + aarray->cache->nMisses),
+				(unsigned long) aarray->cache->nAdmitted,
+				(unsigned long) aarray->cache->nEvicted,
+				(unsigned long) aarray->cache->nInvalidated);
+	}
+}
+
+/** a histogram as a JSON object from value to count, empty buckets left out */
+static void
+aa_print_histogram_json(FILE *fp, const uint64_t *histogram, int nBuckets)
+{
+	const char *separator = "";
+	int i;
+
+	fprintf(fp, "{");
+	for (i = 0; i < nBuckets; i++) {
+		if (histogram[i] != 0) {
+			fprintf(fp, "%s\"%d\": %llu", separator, i,
+					(unsigned long long) histogram[i]);
+			separator = ", ";
+		}
+	}
+	fprintf(fp, "}");
+}
+
+/**
+ * The same statistics as a single JSON object, for tools to read.
+ * Histogram keys are the bucket values; the last bucket of each
+ * counts everything at or beyond it.
+ */
+void aaPrintSummaryJSON(FILE *fp, AssociativeArray *aarray)
+{
+	AAStats stats;
+	int i;
+
+	aaGetStats(aarray, &stats);
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"entries\": %llu,\n", (unsigned long long) stats.nEntries);
+	fprintf(fp, "  \"stringKeys\": %llu,\n", (unsigned long long) stats.nStringKeys);
+	fprintf(fp, "  \"integerKeys\": %llu,\n", (unsigned long long) stats.nIntegerKeys);
+	fprintf(fp, "  \"operations\": {\n");
+	for (i = 0; i < AA_N_OPERATIONS; i++) {
+		fprintf(fp, "    \"%s\": {\"count\": %llu, \"nodeVisits\": %llu, \"visitHistogram\": ",
+				aaOperationName(i),
+				(unsigned long long) stats.operations[i].count,
+				(unsigned long long) stats.operations[i].nodeVisits);
+		aa_print_histogram_json(fp, stats.operations[i].visitHistogram,
+				AA_STATS_VISIT_BUCKETS);
+		fprintf(fp, "}%s\n", (i < AA_N_OPERATIONS - 1) ? "," : "");
+	}
+	fprintf(fp, "  },\n");
+	fprintf(fp, "  \"nodes\": %llu,\n", (unsigned long long) stats.nNodes);
+	fprintf(fp, "  \"bytesAllocated\": %llu,\n", (unsigned long long) stats.bytesAllocated);
+	fprintf(fp, "  \"bytesPerKey\": %.2f,\n", stats.bytesPerKey);
+	fprintf(fp, "  \"depthHistogram\": ");
+	aa_print_histogram_json(fp, stats.depthHistogram, AA_STATS_DEPTH_BUCKETS);
+	fprintf(fp, ",\n  \"fanoutHistogram\": ");
+	aa_print_histogram_json(fp, stats.fanoutHistogram, AA_STATS_FANOUT_BUCKETS);
+
+	if (aarray->trie->adaptiveOrder) {
+		fprintf(fp, ",\n  \"adaptiveOrder\": {\"lettersPerScan\": %.2f}",
+				trieAverageScanLength(aarray->trie));
+	}
+	if (aarray->filter != NULL) {
+		fprintf(fp, ",\n  \"filter\": {\"checked\": %lu, \"rejected\": %lu, \"hashes\": %d, \"rebuilds\": %lu}",
+				(unsigned long) aarray->filter->nChecked,
+				(unsigned long) aarray->filter->nRejected,
+				aarray->filter->nHashes,
+				(unsigned long) aarray->filter->nRebuilds);
+	}
+	if (aarray->cache != NULL) {
+		fprintf(fp, ",\n  \"cache\": {\"hits\": %lu, \"misses\": %lu, \"admitted\": %lu, \"evicted\": %lu, \"invalidated\": %lu}",
+				(unsigned long) aarray->cache->nHits,
+				(unsigned long) aarray->cache->nMisses,
+				(unsigned long) aarray->cache->nAdmitted,
+				(unsigned long) aarray->cache->nEvicted,
+				(unsigned long) aarray->cache->nInvalidated);
+	}
+	fprintf(fp, "\n}\n");
+}
@@ -25,9 +25,21 @@ aaCreateAssociativeArray(
 	memset(newAA, 0, sizeof(AssociativeArray));
 
 	newAA->trie = trieCreateTrie();
+	aa_stats_init(newAA);
 	return newAA;
 }
 
+/**
+ * Give the string keys a dense alphabet (see trieSetAlphabet()).
+ * A NULL letter list means the alphabet is learned from the keys.
+ */
+int
+aaSetAlphabet(AssociativeArray *aarray, const char *letters)
+{
+	return trieSetAlphabet(aarray->trie, (const unsigned char *) letters,
+			(letters == NULL) ? 0 : strlen(letters));
+}
+
 /**
  * deallocate all the memory in the store -- the keys (which we allocated),
  * and the store itself.
@@ -36,10 +48,129 @@ aaCreateAssociativeArray(
 void
 aaDeleteAssociativeArray(AssociativeArray *aarray)
 {
+	trieDeleteFilter(aarray->filter);
+	trieDeleteCache(aarray->cache);
 	trieDeleteTrie(aarray->trie);
+	if (aarray->intTrie != NULL)
+		trieDeleteU64Trie(aarray->intTrie);
+	aa_stats_free(aarray);
 	free(aarray);
 }
 
+/**
+ * Have lookups of string keys scan trie nodes' children most used
+ * first (see trieSetAdaptiveOrder())
+ */
+int
+aaSetAdaptiveOrder(AssociativeArray *aarray, int enable)
+{
+	return trieSetAdaptiveOrder(aarray->trie, enable);
+}
+
+/**
+ * Put an approximate membership filter in front of the string keys,
+ * with the given false positive rate, so that most lookups of absent
+ * keys are answered without walking the trie.  A rate of 0 removes
+ * the filter.
+ */
+int
+aaSetFilter(AssociativeArray *aarray, double falsePositiveRate)
+{
+	TrieFilter *filter;
+
+	if (falsePositiveRate <= 0) {
+		trieDeleteFilter(aarray->filter);
+		aarray->filter = NULL;
+		return 0;
+	}
+
+	filter = trieCreateFilter(0, falsePositiveRate);
+	if (filter == NULL || trieFilterRebuild(filter, aarray->trie) < 0) {
+		trieDeleteFilter(filter);
+		return -1;
+	}
+	filter->nRebuilds = 0;	/* the initial fill is not a rebuild */
+	trieDeleteFilter(aarray->filter);
+	aarray->filter = filter;
+	return 0;
+}
+
+/**
+ * Keep the most recently found string keys in a front cache of (at
+ * least) the given number of entries, so that repeated lookups of the
+ * same keys skip the trie.  A size of 0 removes the cache.
+ */
+int
+aaSetCache(AssociativeArray *aarray, size_t nEntries)
+{
+	TrieCache *cache = NULL;
+
+	if (nEntries > 0) {
+		cache = trieCreateCache(nEntries);
+		if (cache == NULL)
+			return -1;
+	}
+	trieDeleteCache(aarray->cache);
+	aarray->cache = cache;
+	return 0;
+}
+
+/** find the key in the trie, remembering it in the cache if there is one */
+static void *
+aa_lookup_trie(AssociativeArray *aarray, AAKeyType key, size_t keylen,
+		size_t *valuelength, int *cost)
+{
+	void *value;
+	size_t length = 0;
+
+	value = (void *) trieLookupValue(aarray->trie, key, keylen, &length, cost);
+	if (value != NULL && aarray->cache != NULL)
+		trieCacheAdmit(aarray->cache, key, keylen, value, length);
+	if (valuelength != NULL)
+		*valuelength = length;
+	return value;
+}
+
+/**
+ * A string key lookup: the cache, then the filter, then the trie.
+ * The lookup is counted in the statistics with the nodes it visited.
+ */
+static void *
+aa_lookup_string(AssociativeArray *aarray, AAKeyType key, size_t keylen,
+		size_t *valuelength)
+{
+	void *value = NULL;
+	int cost = 0;
+
+	if (aarray->cache != NULL
+			&& trieCacheLookup(aarray->cache, key, keylen, &value, valuelength)) {
+		/** found without visiting the trie */
+	} else if (aarray->filter == NULL || trieFilterCheck(aarray->filter, key, keylen)) {
+		value = aa_lookup_trie(aarray, key, keylen, valuelength, &cost);
+	}
+	aa_stats_count(aarray, AA_OP_LOOKUP, cost);
+	return value;
+}
+
+/** keep the filter in step with a key just added */
+static int
+aa_filter_added(AssociativeArray *aarray, AAKeyType key, size_t keylen)
+{
+	trieFilterAdd(aarray->filter, key, keylen);
+	if (trieFilterNeedsRebuild(aarray->filter))
+		return trieFilterRebuild(aarray->filter, aarray->trie);
+	return 0;
+}
+
+/** deleted keys stay in the filter until enough build up to rebuild it */
+static void
+aa_filter_deleted(AssociativeArray *aarray)
+{
+	trieFilterNoteDelete(aarray->filter);
+	if (trieFilterNeedsRebuild(aarray->filter))
+		trieFilterRebuild(aarray->filter, aarray->trie);
+}
+
 /**
  * Add another key and data value to the table, provided there is room.
  *
@@ -54,9 +185,19 @@ aaInsert(AssociativeArray *aarray,
 		void *value
 	)
 {
-	return trieInsertKey(aarray->trie,
+	size_t nKeys;
+	int status, cost = 0;
+
+	if (aarray->cache != NULL)
+		trieCacheInvalidate(aarray->cache, key, keylen);
+	nKeys = aarray->trie->nKeys;
+	status = trieInsertKey(aarray->trie,
 			key, keylen,
-			value, &aarray->insertCost);
+			value, &cost);
+	aa_stats_count(aarray, AA_OP_INSERT, cost);
+	if (status >= 0 && aarray->filter != NULL && aarray->trie->nKeys > nKeys)
+		return aa_filter_added(aarray, key, keylen);
+	return status;
 }
 
 
@@ -71,7 +212,48 @@ aaInsert(AssociativeArray *aarray,
  */
 void *aaLookup(AssociativeArray *aarray, AAKeyType key, size_t keylen)
 {
-	return trieLookupKey(aarray->trie, key, keylen, &aarray->searchCost);
+	return aa_lookup_string(aarray, key, keylen, NULL);
+}
+
+/**
+ * Look up a batch of keys, filling in values[i] for keys[i] (NULL if
+ * absent), and return how many were found.  With a filter, every key
+ * is checked against it first, its cache lines fetched together, and
+ * only the keys it lets through go on to the front cache and the trie.
+ */
+int aaLookupBatch(AssociativeArray *aarray, AAKeyType *keys, size_t *keylens,
+		void **values, int nKeys)
+{
+	unsigned char maybe[AA_LOOKUP_BATCH_MAX];
+	int i, base, n, cost, nFound = 0;
+
+	for (base = 0; base < nKeys; base += AA_LOOKUP_BATCH_MAX) {
+		n = nKeys - base;
+		if (n > AA_LOOKUP_BATCH_MAX)
+			n = AA_LOOKUP_BATCH_MAX;
+
+		if (aarray->filter != NULL) {
+			trieFilterCheckBatch(aarray->filter, &keys[base], &keylens[base],
+					n, maybe);
+		} else {
+			memset(maybe, 1, n);
+		}
+
+		for (i = 0; i < n; i++) {
+			values[base + i] = NULL;
+			cost = 0;
+			if (maybe[i] && (aarray->cache == NULL
+					|| ! trieCacheLookup(aarray->cache, keys[base + i],
+							keylens[base + i], &values[base + i], NULL))) {
+				values[base + i] = aa_lookup_trie(aarray, keys[base + i],
+						keylens[base + i], NULL, &cost);
+			}
+			aa_stats_count(aarray, AA_OP_LOOKUP, cost);
+			if (values[base + i] != NULL)
+				nFound++;
+		}
+	}
+	return nFound;
 }
 
 
@@ -87,7 +269,142 @@ void *aaLookup(AssociativeArray *aarray, AAKeyType key, size_t keylen)
  */
 void *aaDelete(AssociativeArray *aarray, AAKeyType key, size_t keylen)
 {
-	return trieDeleteKey(aarray->trie, key, keylen, &aarray->deleteCost);
+	void *value = NULL;
+	size_t nKeys;
+	int cost = 0;
+
+	if (aarray->cache != NULL)
+		trieCacheInvalidate(aarray->cache, key, keylen);
+	if (aarray->filter == NULL) {
+		value = trieDeleteKey(aarray->trie, key, keylen, &cost);
+	} else if (trieFilterCheck(aarray->filter, key, keylen)) {
+		nKeys = aarray->trie->nKeys;
+		value = trieDeleteKey(aarray->trie, key, keylen, &cost);
+		if (aarray->trie->nKeys < nKeys)
+			aa_filter_deleted(aarray);
+	}
+	aa_stats_count(aarray, AA_OP_DELETE, cost);
+	return value;
+}
+
+/** copy values into the array, inlining those up to maxInline bytes */
+int
+aaSetValueBytes(AssociativeArray *aarray, size_t maxInline)
+{
+	return trieSetValueBytes(aarray->trie, maxInline);
+}
+
+int
+aaInsertValue(AssociativeArray *aarray, AAKeyType key, size_t keylen,
+		const void *value, size_t valuelen)
+{
+	size_t nKeys;
+	int status, cost = 0;
+
+	if (aarray->cache != NULL)
+		trieCacheInvalidate(aarray->cache, key, keylen);
+	nKeys = aarray->trie->nKeys;
+	status = trieInsertValue(aarray->trie, key, keylen,
+			value, valuelen, &cost);
+	aa_stats_count(aarray, AA_OP_INSERT, cost);
+	if (status >= 0 && aarray->filter != NULL && aarray->trie->nKeys > nKeys)
+		return aa_filter_added(aarray, key, keylen);
+	return status;
+}
+
+/** fill in the view and return 1 if the key is present, else return 0 */
+int
+aaLookupView(AssociativeArray *aarray, AAKeyType key, size_t keylen,
+		AAValueView *view)
+{
+	view->data = aa_lookup_string(aarray, key, keylen, &view->length);
+	if (view->data == NULL) {
+		view->length = 0;
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Remove the key, returning 1 if it was present.  The array's copy of
+ * the value is handed over to the caller to free() if value is given,
+ * and freed here if not.
+ */
+int
+aaDeleteValue(AssociativeArray *aarray, AAKeyType key, size_t keylen,
+		void **value, size_t *valuelength)
+{
+	int deleted = 0, cost = 0;
+
+	if (aarray->cache != NULL)
+		trieCacheInvalidate(aarray->cache, key, keylen);
+	if (aarray->filter == NULL || trieFilterCheck(aarray->filter, key, keylen)) {
+		deleted = trieDeleteValue(aarray->trie, key, keylen,
+				value, valuelength, &cost);
+		if (deleted > 0 && aarray->filter != NULL)
+			aa_filter_deleted(aarray);
+	}
+	aa_stats_count(aarray, AA_OP_DELETE, cost);
+	return deleted;
+}
+
+/**
+ * Add an integer key.  The integer trie is only created once the
+ * first integer key arrives.
+ */
+int
+aaInsertU64(AssociativeArray *aarray, uint64_t key, void *value)
+{
+	int status, cost = 0;
+
+	if (aarray->intTrie == NULL) {
+		aarray->intTrie = trieCreateU64Trie();
+		if (aarray->intTrie == NULL)
+			return -1;
+	}
+	status = trieInsertU64(aarray->intTrie, key, value, &cost);
+	aa_stats_count(aarray, AA_OP_INSERT, cost);
+	return status;
+}
+
+/** find the value for an integer key, or NULL */
+void *aaLookupU64(AssociativeArray *aarray, uint64_t key)
+{
+	void *value = NULL;
+	int cost = 0;
+
+	if (aarray->intTrie != NULL)
+		value = trieLookupU64(aarray->intTrie, key, &cost);
+	aa_stats_count(aarray, AA_OP_LOOKUP, cost);
+	return value;
+}
+
+/** remove an integer key, returning its value (or NULL) */
+void *aaDeleteU64(AssociativeArray *aarray, uint64_t key)
+{
+	void *value = NULL;
+	int cost = 0;
+
+	if (aarray->intTrie != NULL)
+		value = trieDeleteU64(aarray->intTrie, key, &cost);
+	aa_stats_count(aarray, AA_OP_DELETE, cost);
+	return value;
+}
+
+/** signed keys, flipped so that they sort in numeric order */
+int aaInsertI64(AssociativeArray *aarray, int64_t key, void *value)
+{
+	return aaInsertU64(aarray, AA_I64_KEY(key), value);
+}
+
+void *aaLookupI64(AssociativeArray *aarray, int64_t key)
+{
+	return aaLookupU64(aarray, AA_I64_KEY(key));
+}
+
+void *aaDeleteI64(AssociativeArray *aarray, int64_t key)
+{
+	return aaDeleteU64(aarray, AA_I64_KEY(key));
 }
 
 /** iterate over the array, calling the user function on each valid value */
@@ -97,27 +414,65 @@ int aaIterateAction(
 		void *userdata
 	)
 {
-	return trieIterateAction(aarray->trie, userfunction, userdata);
+	int nKeys, nIntKeys;
+
+	nKeys = trieIterateAction(aarray->trie, userfunction, userdata);
+	if (nKeys < 0 || aarray->intTrie == NULL)
+		return nKeys;
+
+	nIntKeys = trieIterateU64Action(aarray->intTrie, userfunction, userdata);
+	if (nIntKeys < 0)
+		return -1;
+	return nKeys + nIntKeys;
 }
 
 /**
- * Print out the entire aarray contents
+ * Call the user function on each key matching the glob pattern,
+ * visiting only the parts of the trie the pattern can reach
  */
-void aaPrintContents(FILE *fp, AssociativeArray *aarray, char * tag)
+int aaPatternSearch(
+		AssociativeArray *aarray,
+		const char *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata
+	)
 {
-	triePrint(fp, aarray->trie);
+	int nMatches, cost = 0;
+
+	nMatches = triePatternSearch(aarray->trie, pattern,
+			userfunction, userdata, &cost);
+	aa_stats_count(aarray, AA_OP_PATTERN, cost);
+	return nMatches;
 }
 
+/** compile a glob pattern for checking keys held elsewhere */
+AAPattern *aaCompilePattern(const char *pattern)
+{
+	return trieCompilePattern(pattern);
+}
+
+void aaDeletePattern(AAPattern *pattern)
+{
+	trieDeletePattern(pattern);
+}
+
+/** check one key, held elsewhere, against a compiled glob pattern */
+int aaPatternMatch(AAPattern *pattern, AAKeyType key, size_t keylen)
+{
+	return triePatternMatch(pattern, key, keylen);
+}
+
+size_t aaPatternPrefix(AAPattern *pattern, AAKeyType buffer, size_t maxLength)
+{
+	return triePatternPrefix(pattern, buffer, maxLength);
+}
 
 /**
- * Print out a short summary
+ * Print out the entire aarray contents
  */
-void aaPrintSummary(FILE *fp, AssociativeArray *aarray)
-{
-	fprintf(fp, "Associative array contains %d entries\n",
-			aarray->nEntries);
-	fprintf(fp, "Costs accrued while processing keys:\n");
-	fprintf(fp, "  Insertion : %d\n", aarray->insertCost);
-	fprintf(fp, "  Search    : %d\n", aarray->searchCost);
-	fprintf(fp, "  Deletion  : %d\n", aarray->deleteCost);
+void aaPrintContents(FILE *fp, AssociativeArray *aarray, char * tag)
+{
+	triePrint(fp, aarray->trie);
+	if (aarray->intTrie != NULL)
+		trieU64Print(fp, aarray->intTrie);
 }
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trie_defs.h"
+
+
+/** turn adaptive ordering on or off; scan orders are built lazily */
+int
+trieSetAdaptiveOrder(KeyValueTrie *trie, int enable)
+{
+	trie->adaptiveOrder = (enable != 0);
+	return 0;
+}
+
+/** the average number of letters compared per subtrie scan by lookups */
+double
+trieAverageScanLength(KeyValueTrie *trie)
+{
+	if (trie->nScans == 0)
+		return 0;
+	return (double) trie->nCompares / (double) trie->nScans;
+}
+
+void
+trie_adaptive_delete(TrieAdaptiveOrder *order)
+{
+	if (order == NULL)	return;
+	free(order->scan);
+	free(order->hits);
+	free(order);
+}
+
+/** bring the scan order up to date with subtries added since it was built */
+static int
+trie_adaptive_sync(TrieAdaptiveOrder **orderp, TrieNode **subtries, int nSubtries)
+{
+	TrieAdaptiveOrder *order = *orderp;
+	TrieNode **scan;
+	unsigned *hits;
+
+	if (order == NULL) {
+		order = (TrieAdaptiveOrder *) malloc(sizeof(TrieAdaptiveOrder));
+		if (order == NULL)
+			return -1;
+		memset(order, 0, sizeof(TrieAdaptiveOrder));
+		*orderp = order;
+	}
+
+	if (nSubtries > order->maxChildren) {
+		scan = (TrieNode **) realloc(order->scan, nSubtries * sizeof(TrieNode *));
+		if (scan == NULL)
+			return -1;
+		order->scan = scan;
+		hits = (unsigned *) realloc(order->hits, nSubtries * sizeof(unsigned));
+		if (hits == NULL)
+			return -1;
+		order->hits = hits;
+		order->maxChildren = nSubtries;
+	}
+
+	while (order->nChildren < nSubtries) {
+		order->scan[order->nChildren] = subtries[order->nChildren];
+		order->hits[order->nChildren] = 0;
+		order->nChildren++;
+	}
+	return 0;
+}
+
+/**
+ * Sort the scan order by hits, most first.  An insertion sort is
+ * stable, so ties keep their place, and it is quick on a list that
+ * is mostly in order already from the last time.  The counts are
+ * then halved, so older lookups count for less.
+ */
+static void
+trie_adaptive_reorder(TrieAdaptiveOrder *order)
+{
+	TrieNode *node;
+	unsigned hits;
+	int i, j;
+
+	for (i = 1; i < order->nChildren; i++) {
+		node = order->scan[i];
+		hits = order->hits[i];
+		for (j = i; j > 0 && order->hits[j - 1] < hits; j--) {
+			order->scan[j] = order->scan[j - 1];
+			order->hits[j] = order->hits[j - 1];
+		}
+		order->scan[j] = node;
+		order->hits[j] = hits;
+	}
+
+	for (i = 0; i < order->nChildren; i++)
+		order->hits[i] /= 2;
+	order->nLookups = 0;
+}
+
+/**
+ * Find the subtrie for the letter, scanning in frequency order, and
+ * count the lookup towards the next reordering.  If the scan order
+ * cannot be allocated the subtries are scanned as they are.
+ */
+TrieNode *
+trie_adaptive_subtrie(KeyValueTrie *trie, TrieAdaptiveOrder **orderp,
+		TrieNode **subtries, int nSubtries, TrieLetter letter)
+{
+	TrieAdaptiveOrder *order;
+	TrieNode **scan = subtries, *found;
+	int i;
+
+	if (trie_adaptive_sync(orderp, subtries, nSubtries) == 0)
+		scan = (*orderp)->scan;
+	order = (scan == subtries) ? NULL : *orderp;
+
+	trie->nScans++;
+	for (i = 0; i < nSubtries; i++) {
+		if (scan[i]->letter == letter)
+			break;
+	}
+	trie->nCompares += (i < nSubtries) ? i + 1 : nSubtries;
+	found = (i < nSubtries) ? scan[i] : NULL;
+
+	if (order != NULL) {
+		if (found != NULL)
+			order->hits[i]++;
+		if (++order->nLookups >= TRIE_ADAPTIVE_PERIOD)
+			trie_adaptive_reorder(order);
+	}
+	return found;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trie_defs.h"
+
+#define	TRIE_CACHE_MIN_ENTRIES	64
+
+
+/** create an empty cache of (at least) the given number of entries */
+TrieCache *
+trieCreateCache(size_t nEntries)
+{
+	TrieCache *cache;
+	size_t nBuckets = TRIE_CACHE_MIN_ENTRIES / TRIE_CACHE_WAYS;
+
+	while (nBuckets * TRIE_CACHE_WAYS < nEntries)
+		nBuckets *= 2;
+
+	cache = (TrieCache *) malloc(sizeof(TrieCache));
+	if (cache == NULL)
+		return NULL;
+	memset(cache, 0, sizeof(TrieCache));
+
+	cache->entries = (TrieCacheEntry *) calloc(nBuckets * TRIE_CACHE_WAYS,
+			sizeof(TrieCacheEntry));
+	cache->hands = (unsigned char *) calloc(nBuckets, sizeof(unsigned char));
+	if (cache->entries == NULL || cache->hands == NULL) {
+		trieDeleteCache(cache);
+		return NULL;
+	}
+	cache->nBuckets = nBuckets;
+	return cache;
+}
+
+void
+trieDeleteCache(TrieCache *cache)
+{
+	if (cache == NULL)	return;
+	free(cache->entries);
+	free(cache->hands);
+	free(cache);
+}
+
+/** the entry holding the key, or NULL */
+static TrieCacheEntry *
+trie_cache_find(TrieCache *cache, uint64_t hash,
+		AAKeyType key, size_t keylength)
+{
+	TrieCacheEntry *bucket;
+	int i;
+
+	bucket = &cache->entries[(hash & (cache->nBuckets - 1)) * TRIE_CACHE_WAYS];
+	for (i = 0; i < TRIE_CACHE_WAYS; i++) {
+		if (bucket[i].inUse && bucket[i].hash == hash
+				&& bucket[i].keylength == keylength
+				&& memcmp(bucket[i].key, key, keylength) == 0)
+			return &bucket[i];
+	}
+	return NULL;
+}
+
+/** fill in the value and return 1 if the key is cached, else return 0 */
+int
+trieCacheLookup(TrieCache *cache, AAKeyType key, size_t keylength,
+		void **value, size_t *valuelength)
+{
+	TrieCacheEntry *entry;
+
+	if (keylength > TRIE_CACHE_KEY_MAX) {
+		cache->nMisses++;
+		return 0;
+	}
+
+	entry = trie_cache_find(cache, trie_key_hash(key, keylength), key, keylength);
+	if (entry == NULL) {
+		cache->nMisses++;
+		return 0;
+	}
+
+	entry->referenced = 1;
+	*value = entry->value;
+	if (valuelength != NULL)
+		*valuelength = entry->valueLength;
+	cache->nHits++;
+	return 1;
+}
+
+/**
+ * Add a key just found in the trie.  The hand sweeps the bucket from
+ * where it last stopped, giving each marked entry a second chance,
+ * and the first empty or unmarked entry is replaced.
+ */
+void
+trieCacheAdmit(TrieCache *cache, AAKeyType key, size_t keylength,
+		void *value, size_t valuelength)
+{
+	TrieCacheEntry *bucket, *entry;
+	uint64_t hash;
+	size_t b;
+
+	if (keylength > TRIE_CACHE_KEY_MAX)
+		return;
+
+	hash = trie_key_hash(key, keylength);
+	entry = trie_cache_find(cache, hash, key, keylength);
+	if (entry == NULL) {
+		b = hash & (cache->nBuckets - 1);
+		bucket = &cache->entries[b * TRIE_CACHE_WAYS];
+		for (;;) {
+			entry = &bucket[cache->hands[b]];
+			cache->hands[b] = (cache->hands[b] + 1) % TRIE_CACHE_WAYS;
+			if ( ! entry->inUse || ! entry->referenced)
+				break;
+			entry->referenced = 0;
+		}
+		if (entry->inUse)
+			cache->nEvicted++;
+
+		entry->hash = hash;
+		memcpy(entry->key, key, keylength);
+		entry->keylength = (unsigned char) keylength;
+		entry->inUse = 1;
+		entry->referenced = 0;
+		cache->nAdmitted++;
+	}
+	entry->value = value;
+	entry->valueLength = valuelength;
+}
+
+/** forget the key, if it is cached */
+void
+trieCacheInvalidate(TrieCache *cache, AAKeyType key, size_t keylength)
+{
+	TrieCacheEntry *entry;
+
+	if (keylength > TRIE_CACHE_KEY_MAX)
+		return;
+
+	entry = trie_cache_find(cache, trie_key_hash(key, keylength), key, keylength);
+	if (entry != NULL) {
+		entry->inUse = 0;
+		cache->nInvalidated++;
+	}
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+#include "trie_defs.h"
+
+
+/** create a cursor positioned before the first key */
+TrieCursor *
+trieCreateCursor(KeyValueTrie *trie)
+{
+	TrieCursor *cursor;
+
+	cursor = (TrieCursor *) malloc(sizeof(TrieCursor));
+	if (cursor == NULL)
+		return NULL;
+
+	cursor->trie = trie;
+	cursor->maxDepth = trie->maxKeyLength;
+	cursor->path = (TrieNode **) malloc((cursor->maxDepth + 1) * sizeof(TrieNode *));
+	cursor->next = (int *) malloc((cursor->maxDepth + 1) * sizeof(int));
+	cursor->keybuffer = (AAKeyType) malloc(cursor->maxDepth + 1);
+	if (cursor->path == NULL || cursor->next == NULL || cursor->keybuffer == NULL) {
+		trieDeleteCursor(cursor);
+		return NULL;
+	}
+
+	trieCursorRewind(cursor);
+	return cursor;
+}
+
+void
+trieDeleteCursor(TrieCursor *cursor)
+{
+	if (cursor == NULL)	return;
+	free(cursor->path);
+	free(cursor->next);
+	free(cursor->keybuffer);
+	free(cursor);
+}
+
+/** go back to before the first key */
+void
+trieCursorRewind(TrieCursor *cursor)
+{
+	cursor->depth = 0;
+	cursor->next[0] = 0;
+}
+
+/**
+ * Move on to the next key.  Returns 1 and fills in the key (which
+ * stays valid until the next call) and the slot holding its value,
+ * or returns 0 once every key has been seen.
+ */
+int
+trieCursorNext(TrieCursor *cursor, AAKeyType *key, size_t *keylength, void ***slot)
+{
+	TrieNode *child;
+	int depth;
+
+	for (;;) {
+		depth = cursor->depth;
+
+		/** find the next subtrie to visit at this depth */
+		if (depth == 0) {
+			if (cursor->next[0] >= cursor->trie->nSubtries)
+				return 0;
+			child = cursor->trie->subtries[cursor->next[0]++];
+		} else if (cursor->next[depth] < cursor->path[depth - 1]->nSubtries) {
+			child = cursor->path[depth - 1]->subtries[cursor->next[depth]++];
+		} else {
+			cursor->depth--;
+			continue;
+		}
+
+		/** step down into it, visiting keys before longer keys */
+		assert(depth < cursor->maxDepth);
+		cursor->path[depth] = child;
+		cursor->keybuffer[depth] = child->letter;
+		cursor->depth = depth + 1;
+		cursor->next[depth + 1] = 0;
+
+		if (child->isKeySoHasValue) {
+			cursor->keybuffer[depth + 1] = '\0';
+			if (key != NULL)		*key = cursor->keybuffer;
+			if (keylength != NULL)	*keylength = depth + 1;
+			if (slot != NULL)		*slot = &child->value;
+			return 1;
+		}
+	}
+}
+
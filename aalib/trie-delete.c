@@ -8,7 +8,7 @@
 
 
 /** recursively roll up the chain */
-static int walk_chain_to_delete(void **value, TrieNode *curSearchNode, AAKeyType key, size_t keylength, int *cost)
+static int walk_chain_to_delete(KeyValueTrie *root, void **value, TrieNode *curSearchNode, AAKeyType key, size_t keylength, int *cost)
 {
 	// TO DO: remove nodes for deleted key
   
@@ -23,16 +23,15 @@ static int walk_chain_to_delete(void **value, TrieNode *curSearchNode, AAKeyType
         if (curSearchNode->subtries[i]->letter == key[0]) {
             if (keylength == 1 && curSearchNode->subtries[i]->isKeySoHasValue) {
                 *value = curSearchNode->subtries[i]->value;
-                //curSearchNode->subtries[i]->isKeySoHasValue = 0;
-                //curSearchNode->subtries[i]->value = NULL;
-               
-               
+                curSearchNode->subtries[i]->isKeySoHasValue = 0;
+                curSearchNode->subtries[i]->value = NULL;
+                root->nKeys--;
                return 1;
             }
             (*cost)++;
 
             // Recurse for the next character in the key.
-            return walk_chain_to_delete(value, curSearchNode->subtries[i], key + 1, keylength - 1, cost);
+            return walk_chain_to_delete(root, value, curSearchNode->subtries[i], key + 1, keylength - 1, cost);
         }
     }
 
@@ -46,8 +45,10 @@ void *trieDeleteKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *co
 {
 	void *valueFromDeletedKey = NULL;
 
+	TRIE_TRACE2(delete_entry, key, keylength);
 
 	if (root->nSubtries == 0) {
+		TRIE_TRACE3(delete_return, key, keylength, NULL);
 		return NULL;
 	}
 
@@ -59,12 +60,23 @@ void *trieDeleteKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *co
     // Iterate over the top-level nodes to find the starting node that matches the key's first character.
     for (int i = 0; i < root->nSubtries; i++) {
         if (root->subtries[i]->letter == key[0]) {
-            if (walk_chain_to_delete(&valueFromDeletedKey, root->subtries[i], key + 1, keylength - 1, cost)) {
+            // A single letter key ends at the top-level node itself.
+            if (keylength == 1) {
+                if (root->subtries[i]->isKeySoHasValue) {
+                    valueFromDeletedKey = root->subtries[i]->value;
+                    root->subtries[i]->isKeySoHasValue = 0;
+                    root->subtries[i]->value = NULL;
+                    root->nKeys--;
+                }
+                break;
+            }
+            if (walk_chain_to_delete(root, &valueFromDeletedKey, root->subtries[i], key + 1, keylength - 1, cost)) {
                 break;  // If the key is found and deleted, break out of the loop.
             }
         }
     }
 
+    TRIE_TRACE3(delete_return, key, keylength, valueFromDeletedKey);
     return valueFromDeletedKey;
 }
 
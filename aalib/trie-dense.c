@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h> // for memset()
+#include <stdlib.h> // for malloc()
+#include <assert.h>
+
+#include "trie_defs.h"
+
+
+/** the code for a letter, adding it to the alphabet if it is new */
+static int
+trie_dense_code(KeyValueTrie *trie, TrieLetter letter)
+{
+	if (trie->letterCode[letter] == 0)
+		trie->letterCode[letter] = ++trie->alphabetSize;
+	return trie->letterCode[letter];
+}
+
+/**
+ * Bring the index of a node (or of the root) up to date after a
+ * subtrie has been added to the end of its list.  The index is
+ * built from the whole list when it is first needed, and grown
+ * whenever the alphabet has outgrown it.
+ */
+int
+trie_dense_update(KeyValueTrie *trie, TrieNode ***index, int *nIndex,
+		TrieNode **subtries, int nSubtries)
+{
+	TrieNode **grown;
+	int i, first;
+
+	if (trie->letterCode == NULL || nSubtries < TRIE_DENSE_MIN_FANOUT)
+		return 0;
+
+	first = (*index == NULL) ? 0 : nSubtries - 1;
+	for (i = first; i < nSubtries; i++)
+		trie_dense_code(trie, subtries[i]->letter);
+
+	if (*nIndex < trie->alphabetSize + 1) {
+		grown = (TrieNode **) realloc(*index,
+				(trie->alphabetSize + 1) * sizeof(TrieNode *));
+		if (grown == NULL)
+			return -1;
+		memset(&grown[*nIndex], 0,
+				(trie->alphabetSize + 1 - *nIndex) * sizeof(TrieNode *));
+		*index = grown;
+		*nIndex = trie->alphabetSize + 1;
+		TRIE_TRACE2(index_grow, *index, *nIndex);
+	}
+
+	for (i = first; i < nSubtries; i++)
+		(*index)[trie->letterCode[subtries[i]->letter]] = subtries[i];
+	return 0;
+}
+
+/**
+ * Find the subtrie for the letter.  Slot 0 of every index is left
+ * empty, so letters outside the alphabet need no special test; a
+ * code past the end of the index is a letter that was added to the
+ * alphabet after this node was last changed.
+ */
+TrieNode *
+trie_dense_subtrie(KeyValueTrie *trie, TrieNode **index, int nIndex,
+		TrieNode **subtries, int nSubtries, TrieLetter letter)
+{
+	int code = trie->letterCode[letter];
+
+	if (code < nIndex)
+		return index[code];
+	if (nSubtries == 1 && subtries[0]->letter == letter)
+		return subtries[0];
+	return NULL;
+}
+
+/** bring the index of a node up to date, giving it one if it is due */
+int
+trie_dense_update_node(KeyValueTrie *trie, TrieNode *node)
+{
+	TrieNodeExtras *extras;
+
+	if (trie->letterCode == NULL || node->nSubtries < TRIE_DENSE_MIN_FANOUT)
+		return 0;
+
+	extras = trie_node_extras(node);
+	if (extras == NULL)
+		return -1;
+	return trie_dense_update(trie, &extras->index, &extras->nIndex,
+			node->subtries, node->nSubtries);
+}
+
+/** find the subtrie of a node for the letter */
+TrieNode *
+trie_dense_node_subtrie(KeyValueTrie *trie, TrieNode *node, TrieLetter letter)
+{
+	TrieNodeExtras *extras;
+
+	if ( ! (node->flags & TRIE_NODE_EXTRAS))
+		return trie_dense_subtrie(trie, NULL, 0,
+				node->subtries, node->nSubtries, letter);
+	extras = TRIE_EXTRAS(node);
+	return trie_dense_subtrie(trie, extras->index, extras->nIndex,
+			node->subtries, node->nSubtries, letter);
+}
+
+/** find the node for a key in a dense trie: one indexed load per letter */
+TrieNode *
+trie_dense_find(KeyValueTrie *trie, AAKeyType key, size_t keylength, int *cost)
+{
+	TrieNode *current;
+	size_t i;
+
+	if (keylength == 0)
+		return NULL;
+
+	current = trie_dense_subtrie(trie, trie->index, trie->nIndex,
+			trie->subtries, trie->nSubtries, key[0]);
+
+	for (i = 1; current != NULL && i < keylength; i++) {
+		current = trie_dense_node_subtrie(trie, current, key[i]);
+		if (current != NULL && cost != NULL)
+			(*cost)++;
+	}
+
+	return current;
+}
+
+/** recursive helper to index every node already in the trie */
+static int
+trie_dense_index_helper(KeyValueTrie *trie, TrieNode *node)
+{
+	int i;
+
+	if (trie_dense_update_node(trie, node) < 0)
+		return -1;
+
+	for (i = 0; i < node->nSubtries; i++) {
+		if (trie_dense_index_helper(trie, node->subtries[i]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * Turn on dense indexing.  This may be done before or after keys
+ * have been added; existing nodes are indexed here, and after this
+ * the insertion code keeps the indices current.
+ */
+int
+trieSetAlphabet(KeyValueTrie *trie, const unsigned char *letters, size_t nLetters)
+{
+	size_t i;
+
+	/** the alphabet can only be set once */
+	if (trie->letterCode != NULL)
+		return -1;
+
+	trie->letterCode = (unsigned short *) calloc(256, sizeof(unsigned short));
+	if (trie->letterCode == NULL)
+		return -1;
+	trie->alphabetSize = 0;
+
+	for (i = 0; letters != NULL && i < nLetters; i++)
+		trie_dense_code(trie, letters[i]);
+
+	if (trie_dense_update(trie, &trie->index, &trie->nIndex,
+			trie->subtries, trie->nSubtries) < 0)
+		return -1;
+
+	for (i = 0; i < (size_t) trie->nSubtries; i++) {
+		if (trie_dense_index_helper(trie, trie->subtries[i]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
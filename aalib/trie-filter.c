@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hashmix.h"
+#include "trie_defs.h"
+
+#define	TRIE_FILTER_BLOCK_BITS	(TRIE_FILTER_BLOCK_WORDS * 64)
+#define	TRIE_FILTER_MIN_KEYS	1024
+#define	TRIE_FILTER_MAX_HASHES	16
+
+/** rebuild once this fraction of the keys added have been deleted */
+#define	TRIE_FILTER_DELETE_DIVISOR	4
+
+
+/**
+ * FNV-1a over the key, then the splitmix64 finalizer to spread it;
+ * the front cache hashes its keys with this as well
+ */
+uint64_t
+trie_key_hash(AAKeyType key, size_t keylength)
+{
+	return hashMix64(hashFnv1a(key, keylength));
+}
+
+/** the block for a hash: the high half scaled down to nBlocks */
+static uint64_t *
+trie_filter_block(TrieFilter *filter, uint64_t hash)
+{
+	size_t block = (size_t) (((hash >> 32) * (uint64_t) filter->nBlocks) >> 32);
+
+	return &filter->blocks[block * TRIE_FILTER_BLOCK_WORDS];
+}
+
+/**
+ * Size the filter for the number of keys: the usual Bloom filter
+ * bits per key for the false positive rate, and hashes to match
+ */
+static int
+trie_filter_plan(TrieFilter *filter, size_t expectedKeys)
+{
+	double bitsPerKey;
+	uint64_t *blocks;
+	size_t nBlocks;
+	int nHashes;
+
+	if (expectedKeys < TRIE_FILTER_MIN_KEYS)
+		expectedKeys = TRIE_FILTER_MIN_KEYS;
+
+	bitsPerKey = -log(filter->falsePositiveRate) / (M_LN2 * M_LN2);
+	nBlocks = (size_t) ceil(expectedKeys * bitsPerKey / TRIE_FILTER_BLOCK_BITS);
+	nHashes = (int) (bitsPerKey * M_LN2 + 0.5);
+	if (nHashes < 1)
+		nHashes = 1;
+	if (nHashes > TRIE_FILTER_MAX_HASHES)
+		nHashes = TRIE_FILTER_MAX_HASHES;
+
+	blocks = (uint64_t *) calloc(nBlocks * TRIE_FILTER_BLOCK_WORDS, sizeof(uint64_t));
+	if (blocks == NULL)
+		return -1;
+
+	free(filter->blocks);
+	filter->blocks = blocks;
+	filter->nBlocks = nBlocks;
+	filter->nHashes = nHashes;
+	filter->plannedKeys = expectedKeys;
+	filter->nKeys = 0;
+	filter->nDeleted = 0;
+	return 0;
+}
+
+/** create an empty filter sized for the given number of keys */
+TrieFilter *
+trieCreateFilter(size_t expectedKeys, double falsePositiveRate)
+{
+	TrieFilter *filter;
+
+	if (falsePositiveRate <= 0 || falsePositiveRate >= 1)
+		return NULL;
+
+	filter = (TrieFilter *) malloc(sizeof(TrieFilter));
+	if (filter == NULL)
+		return NULL;
+	memset(filter, 0, sizeof(TrieFilter));
+	filter->falsePositiveRate = falsePositiveRate;
+
+	if (trie_filter_plan(filter, expectedKeys) < 0) {
+		free(filter);
+		return NULL;
+	}
+	return filter;
+}
+
+void
+trieDeleteFilter(TrieFilter *filter)
+{
+	if (filter == NULL)	return;
+	free(filter->blocks);
+	free(filter);
+}
+
+/**
+ * The bits for a key within its block are found by double hashing
+ * on the low half of the hash
+ */
+void
+trieFilterAdd(TrieFilter *filter, AAKeyType key, size_t keylength)
+{
+	uint64_t hash = trie_key_hash(key, keylength);
+	uint64_t *block = trie_filter_block(filter, hash);
+	unsigned bit = (unsigned) hash, step = ((unsigned) (hash >> 9)) | 1;
+	int i;
+
+	for (i = 0; i < filter->nHashes; i++, bit += step) {
+		block[(bit / 64) % TRIE_FILTER_BLOCK_WORDS] |= 1ULL << (bit % 64);
+	}
+	filter->nKeys++;
+}
+
+/** return 0 if the key is certainly not present, 1 if it may be */
+int
+trieFilterCheck(TrieFilter *filter, AAKeyType key, size_t keylength)
+{
+	uint64_t hash = trie_key_hash(key, keylength);
+	uint64_t *block = trie_filter_block(filter, hash);
+	unsigned bit = (unsigned) hash, step = ((unsigned) (hash >> 9)) | 1;
+	int i;
+
+	filter->nChecked++;
+	for (i = 0; i < filter->nHashes; i++, bit += step) {
+		if ((block[(bit / 64) % TRIE_FILTER_BLOCK_WORDS] & (1ULL << (bit % 64))) == 0) {
+			filter->nRejected++;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Check a batch of keys, writing 0 (certainly absent) or 1 (maybe
+ * present) to maybe[] for each.  The keys are taken AA_LOOKUP_BATCH_MAX
+ * at a time, and all the blocks of a group are fetched before any is
+ * examined, so their cache misses overlap rather than following one
+ * another.  Returns the number that may be present.
+ */
+int
+trieFilterCheckBatch(TrieFilter *filter, AAKeyType *keys, size_t *keylengths,
+		int nKeys, unsigned char *maybe)
+{
+	uint64_t hashes[AA_LOOKUP_BATCH_MAX];
+	uint64_t *block;
+	unsigned bit, step;
+	int base, n, i, j, nMaybe = 0;
+
+	for (base = 0; base < nKeys; base += AA_LOOKUP_BATCH_MAX) {
+		n = nKeys - base;
+		if (n > AA_LOOKUP_BATCH_MAX)
+			n = AA_LOOKUP_BATCH_MAX;
+
+		for (i = 0; i < n; i++) {
+			hashes[i] = trie_key_hash(keys[base + i], keylengths[base + i]);
+#ifdef	__GNUC__
+			__builtin_prefetch(trie_filter_block(filter, hashes[i]));
+#endif
+		}
+
+		for (i = 0; i < n; i++) {
+			block = trie_filter_block(filter, hashes[i]);
+			bit = (unsigned) hashes[i];
+			step = ((unsigned) (hashes[i] >> 9)) | 1;
+			maybe[base + i] = 1;
+			for (j = 0; j < filter->nHashes; j++, bit += step) {
+				if ((block[(bit / 64) % TRIE_FILTER_BLOCK_WORDS] & (1ULL << (bit % 64))) == 0) {
+					maybe[base + i] = 0;
+					filter->nRejected++;
+					break;
+				}
+			}
+			nMaybe += maybe[base + i];
+		}
+	}
+	filter->nChecked += nKeys;
+	return nMaybe;
+}
+
+/** a key was deleted; its bits stay set until the next rebuild */
+void
+trieFilterNoteDelete(TrieFilter *filter)
+{
+	filter->nDeleted++;
+}
+
+/**
+ * The filter still never rules out a key that is present, but too
+ * many deletes, or more keys than it was planned for, push its false
+ * positive rate up
+ */
+int
+trieFilterNeedsRebuild(TrieFilter *filter)
+{
+	return filter->nDeleted * TRIE_FILTER_DELETE_DIVISOR > filter->nKeys
+			|| filter->nKeys > filter->plannedKeys;
+}
+
+/** clear the filter and add the keys now in the trie, resizing to fit */
+int
+trieFilterRebuild(TrieFilter *filter, KeyValueTrie *trie)
+{
+	TrieCursor *cursor;
+	AAKeyType key;
+	size_t keylength, nKeys = 0;
+
+	cursor = trieCreateCursor(trie);
+	if (cursor == NULL)
+		return -1;
+	while (trieCursorNext(cursor, NULL, NULL, NULL))
+		nKeys++;
+
+	/** leave room to grow before the next rebuild */
+	if (trie_filter_plan(filter, 2 * nKeys) < 0) {
+		trieDeleteCursor(cursor);
+		return -1;
+	}
+
+	trieCursorRewind(cursor);
+	while (trieCursorNext(cursor, &key, &keylength, NULL))
+		trieFilterAdd(filter, key, keylength);
+
+	trieDeleteCursor(cursor);
+	filter->nRebuilds++;
+	return 0;
+}
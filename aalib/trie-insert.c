@@ -18,8 +18,25 @@ int trie_subtreeSearchComparator(const void *keyValue, const void *nodePtr)
 }
 
 
-/** create a whole chain for the rest of the key */
-static TrieNode * trie_create_chain(AAKeyType key, size_t keylength, void *value, int *cost)
+/** free a chain that could not be finished or linked in */
+static void trie_free_chain(TrieNode *chain)
+{
+    TrieNode *next;
+
+    while (chain != NULL) {
+        next = (chain->nSubtries > 0) ? chain->subtries[0] : NULL;
+        trie_free_subtries(chain);
+        free(chain);
+        chain = next;
+    }
+}
+
+/**
+ * create a whole chain for the rest of the key; returns NULL, having
+ * freed whatever part of it was made, if there is no memory.  The
+ * caller counts the key once the chain is linked in.
+ */
+static TrieNode * trie_create_chain(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value, int *cost)
 {
 	TrieNode *current = NULL;
 
@@ -29,7 +46,19 @@ static TrieNode * trie_create_chain(AAKeyType key, size_t keylength, void *value
 
     //creating new node and initializing it's contents to zero
     for (size_t i = 0; i < keylength; i++) {
-        TrieNode *newNode = trieCreateNode();
+        TrieNode *newNode;
+
+        // the node ending the key gets room for its value, if the trie owns them
+        if (root->ownsValues) {
+            newNode = trie_create_value_node(
+                    (i == keylength - 1) ? root->inlineValueMax + 1 : 0);
+        } else {
+            newNode = trieCreateNode();
+        }
+        if (newNode == NULL) {
+            trie_free_chain(current);
+            return NULL;
+        }
         newNode->letter = key[i];
         
         // when last letter in the key is reached
@@ -41,8 +70,14 @@ static TrieNode * trie_create_chain(AAKeyType key, size_t keylength, void *value
         //initializing the previous node
         if (prevNode != NULL) {
             prevNode->subtries = malloc(sizeof(TrieNode*));
+            if (prevNode->subtries == NULL) {
+                free(newNode);
+                trie_free_chain(current);
+                return NULL;
+            }
             prevNode->subtries[0] = newNode;
             prevNode->nSubtries = 1;
+            TRIE_TRACE2(children_grow, prevNode->subtries, 1);
         } else {
             current = newNode; // Pointing to first node in the chain
         }
@@ -67,16 +102,18 @@ static int trie_add_chain(TrieNode ***subtreeList, int *nSubtries, AAKeyType key
 	// subtries you add this
 	
     //resizing pointer to take more subtries
-    *subtreeList = realloc(*subtreeList, sizeof(TrieNode*) * (*nSubtries + 1));
+    TrieNode **grown = realloc(*subtreeList, sizeof(TrieNode*) * (*nSubtries + 1));
     
-    // Checking memory allocation failure
-    if (*subtreeList == NULL) {
+    // Checking memory allocation failure; the old list is still good
+    if (grown == NULL) {
         return -1; 
     }
+    *subtreeList = grown;
 
     //adding chain
     (*subtreeList)[*nSubtries] = newChain;
     (*nSubtries)++;
+    TRIE_TRACE2(children_grow, *subtreeList, *nSubtries);
 
    
 
@@ -89,7 +126,7 @@ static int trie_add_chain(TrieNode ***subtreeList, int *nSubtries, AAKeyType key
 
 
 /** link the provided key into the current chain */
-static int trie_link_to_chain(TrieNode *current, AAKeyType key, size_t keylength, void *value, int *cost)
+static int trie_link_to_chain(KeyValueTrie *root, TrieNode *current, AAKeyType key, size_t keylength, void *value, int *cost)
 {
 	// TO DO: add the remaining portions of the key
 	// into this chain, forming a new branch if and when
@@ -98,13 +135,23 @@ static int trie_link_to_chain(TrieNode *current, AAKeyType key, size_t keylength
     //checking if current key matches or not
 	 while (keylength > 0 && current->nSubtries > 0) {
         int found = 0;
-        for (int i = 0; i < current->nSubtries; i++) {
-            if (current->subtries[i]->letter == key[0]) {
-                current = current->subtries[i];
+        if (root->letterCode != NULL) {
+            TrieNode *next = trie_dense_node_subtrie(root, current, key[0]);
+            if (next != NULL) {
+                current = next;
                 key++;
                 keylength--;
                 found = 1;
-                break;
+            }
+        } else {
+            for (int i = 0; i < current->nSubtries; i++) {
+                if (current->subtries[i]->letter == key[0]) {
+                    current = current->subtries[i];
+                    key++;
+                    keylength--;
+                    found = 1;
+                    break;
+                }
             }
         }
         if (!found) {
@@ -115,11 +162,25 @@ static int trie_link_to_chain(TrieNode *current, AAKeyType key, size_t keylength
  
     // creating a new chain for the remaining key
     if (keylength > 0) {
-        TrieNode *newChain = trie_create_chain(key, keylength, value, cost);
-        current->subtries = realloc(current->subtries, sizeof(TrieNode*) * (current->nSubtries + 1));
+        TrieNode *newChain = trie_create_chain(root, key, keylength, value, cost);
+        if (newChain == NULL) {
+            return -1;
+        }
+        if (trie_grow_subtries(current, current->nSubtries + 1) < 0) {
+            trie_free_chain(newChain);
+            return -1;
+        }
         current->subtries[current->nSubtries] = newChain;
         current->nSubtries = current->nSubtries + 1;
+        root->nKeys++;
+        TRIE_TRACE2(children_grow, current->subtries, current->nSubtries);
+        if (trie_dense_update_node(root, current) < 0) {
+            return -1;
+        }
     } else {
+        if (!current->isKeySoHasValue) {
+            root->nKeys++;
+        }
         current->isKeySoHasValue = 1;
         current->value = value;
     }
@@ -132,16 +193,23 @@ static int trie_link_to_chain(TrieNode *current, AAKeyType key, size_t keylength
 }
 
 
-int
-trieInsertKey(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value, int *cost)
+static int
+trie_insert_key(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value, int *cost)
 { 
+	/** a trie that owns its values only takes them from trieInsertValue() */
+	if (root->ownsValues && value != NULL)
+		return -1;
+
 	/** keep the max key length in order to keep a buffer for interation */
 	if (root->maxKeyLength < keylength)
 		root->maxKeyLength = keylength;
 
 	if (root->nSubtries == 0) {
-		root->subtries[root->nSubtries++] = trie_create_chain(
-				key, keylength, value, cost);
+		root->subtries[0] = trie_create_chain(root, key, keylength, value, cost);
+		if (root->subtries[0] == NULL)
+			return -1;
+		root->nSubtries = 1;
+		root->nKeys++;
 		return 0;
 	}
 
@@ -150,14 +218,33 @@ trieInsertKey(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value,
 	// key, and insert the new key into the correct subtrie
 	// chain based on that letter
 
-	for (int i = 0; i < root->nSubtries; i++) {
-        if (root->subtries[i]->letter == key[0]) {
-            return trie_link_to_chain(root->subtries[i], key + 1, keylength - 1, value, cost);
+	if (root->letterCode != NULL) {
+        TrieNode *first = trie_dense_subtrie(root, root->index, root->nIndex,
+                root->subtries, root->nSubtries, key[0]);
+        if (first != NULL) {
+            return trie_link_to_chain(root, first, key + 1, keylength - 1, value, cost);
+        }
+    } else {
+        for (int i = 0; i < root->nSubtries; i++) {
+            if (root->subtries[i]->letter == key[0]) {
+                return trie_link_to_chain(root, root->subtries[i], key + 1, keylength - 1, value, cost);
+            }
         }
     }
      // If first letter not found, create a new chain
-    TrieNode *newChain = trie_create_chain(key, keylength, value, cost);
-    trie_add_chain(&(root->subtries), &(root->nSubtries), key, newChain);
+    TrieNode *newChain = trie_create_chain(root, key, keylength, value, cost);
+    if (newChain == NULL) {
+        return -1;
+    }
+    if (trie_add_chain(&(root->subtries), &(root->nSubtries), key, newChain) < 0) {
+        trie_free_chain(newChain);
+        return -1;
+    }
+    root->nKeys++;
+    if (trie_dense_update(root, &root->index, &root->nIndex,
+            root->subtries, root->nSubtries) < 0) {
+        return -1;
+    }
 
 
 	// TO DO: you probably want to replace this return statement
@@ -167,5 +254,14 @@ trieInsertKey(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value,
 
 }
 
+/** the traced entry point; see trie_trace.h */
+int
+trieInsertKey(KeyValueTrie *root, AAKeyType key, size_t keylength, void *value, int *cost)
+{
+	int status;
 
-
+	TRIE_TRACE2(insert_entry, key, keylength);
+	status = trie_insert_key(root, key, keylength, value, cost);
+	TRIE_TRACE3(insert_return, key, keylength, status);
+	return status;
+}
@@ -24,6 +24,7 @@ trie_iterate_chain(TrieNode *curnode, AAKeyType keybuffer, int keybufferpos,
 	if (curnode->isKeySoHasValue) {
 		nTotalKeys++;
 		keybuffer[keybufferpos+1] = '\0';
+		TRIE_TRACE3(iterate_key, keybuffer, keybufferpos+1, curnode->value);
 		if ((*userfunction)(keybuffer, keybufferpos+1,
 				curnode->value, userdata) < 0) {
 			return -1;
@@ -58,6 +59,8 @@ int trieIterateAction(
 	AAKeyType buffer;
 	int i, nKeys = 0, thisNkeys;
 
+	TRIE_TRACE1(iterate_entry, trie);
+
 	/** buffer large enough for key and termination */
 	buffer = (AAKeyType) malloc(trie->maxKeyLength + 1);
 
@@ -66,12 +69,14 @@ int trieIterateAction(
 				buffer, 0, userfunction, userdata);
 		if (thisNkeys < 0) {
 			free(buffer);
+			TRIE_TRACE2(iterate_return, trie, -1);
 			return -1;
 		}
 		nKeys += thisNkeys;
 	}
 
 	free(buffer);
+	TRIE_TRACE2(iterate_return, trie, nKeys);
 	return nKeys;
 }
 
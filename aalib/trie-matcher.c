@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h> // for memset()
+#include <stdlib.h> // for malloc()
+#include <assert.h>
+
+#include "trie_defs.h"
+
+
+/** count the nodes below (and including) this one */
+static int
+trie_matcher_count_nodes(TrieNode *node)
+{
+	int i, nNodes = 1;
+
+	for (i = 0; i < node->nSubtries; i++)
+		nNodes += trie_matcher_count_nodes(node->subtries[i]);
+
+	return nNodes;
+}
+
+/** follow the letter from the given state, or -1 if there is no edge */
+static int
+trie_matcher_goto(TrieMatcher *matcher, int state, unsigned char letter)
+{
+	TrieMatcherState *s = &matcher->states[state];
+	int i;
+
+	if (state == 0)
+		return matcher->rootNext[letter];
+
+	for (i = s->firstChild; i < s->firstChild + s->nChildren; i++) {
+		if (matcher->letters[i] == letter)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Build an Aho-Corasick automaton over every key currently in the
+ * trie.  The automaton is a snapshot: keys added to or deleted from
+ * the trie afterwards are not seen by it, and the values it reports
+ * are those held at the time it was built.
+ */
+TrieMatcher *
+trieCreateMatcher(KeyValueTrie *trie)
+{
+	TrieMatcher *matcher;
+	TrieNode **nodes;
+	TrieMatcherState *s, *t;
+	int i, j, f, next, nStates = 1;
+
+	for (i = 0; i < trie->nSubtries; i++)
+		nStates += trie_matcher_count_nodes(trie->subtries[i]);
+
+	matcher = (TrieMatcher *) malloc(sizeof(TrieMatcher));
+	if (matcher == NULL)
+		return NULL;
+	matcher->nStates = nStates;
+	matcher->states = (TrieMatcherState *) calloc(nStates, sizeof(TrieMatcherState));
+	matcher->letters = (unsigned char *) calloc(nStates, 1);
+	nodes = (TrieNode **) calloc(nStates, sizeof(TrieNode *));
+	if (matcher->states == NULL || matcher->letters == NULL || nodes == NULL) {
+		free(nodes);
+		trieDeleteMatcher(matcher);
+		return NULL;
+	}
+
+	/**
+	 * Number the states breadth first.  The states array doubles
+	 * as the queue, since a state's children are always numbered
+	 * after it.
+	 */
+	matcher->states[0].firstChild = 1;
+	matcher->states[0].nChildren = trie->nSubtries;
+	next = 1;
+	for (i = 0; i < trie->nSubtries; i++) {
+		nodes[next] = trie->subtries[i];
+		matcher->letters[next] = (unsigned char) trie->subtries[i]->letter;
+		matcher->states[next].depth = 1;
+		next++;
+	}
+	for (i = 1; i < nStates; i++) {
+		s = &matcher->states[i];
+		s->isKeySoHasValue = nodes[i]->isKeySoHasValue;
+		s->value = nodes[i]->value;
+		s->firstChild = next;
+		s->nChildren = nodes[i]->nSubtries;
+		for (j = 0; j < nodes[i]->nSubtries; j++) {
+			nodes[next] = nodes[i]->subtries[j];
+			matcher->letters[next] = (unsigned char) nodes[next]->letter;
+			matcher->states[next].depth = s->depth + 1;
+			next++;
+		}
+	}
+	free(nodes);
+
+	/** the root gets a full table, as every mismatch comes back here */
+	for (i = 0; i < 256; i++)
+		matcher->rootNext[i] = -1;
+	for (i = 1; i <= trie->nSubtries; i++)
+		matcher->rootNext[matcher->letters[i]] = i;
+
+	/**
+	 * Failure links, again in breadth first order so that the
+	 * links of all shallower states are ready when we need them.
+	 * The output link points at the nearest state along the failure
+	 * chain that ends a key, so reporting skips the states that don't.
+	 */
+	for (i = 0; i < nStates; i++) {
+		s = &matcher->states[i];
+		for (j = s->firstChild; j < s->firstChild + s->nChildren; j++) {
+			t = &matcher->states[j];
+			if (i == 0) {
+				t->fail = 0;
+			} else {
+				f = s->fail;
+				while (f != 0 && trie_matcher_goto(matcher, f, matcher->letters[j]) < 0)
+					f = matcher->states[f].fail;
+				f = trie_matcher_goto(matcher, f, matcher->letters[j]);
+				t->fail = (f < 0) ? 0 : f;
+			}
+			f = t->fail;
+			t->output = matcher->states[f].isKeySoHasValue
+					? f : matcher->states[f].output;
+		}
+	}
+
+	return matcher;
+}
+
+/** release the automaton; the trie it was built from is untouched */
+void
+trieDeleteMatcher(TrieMatcher *matcher)
+{
+	if (matcher == NULL)	return;
+	free(matcher->states);
+	free(matcher->letters);
+	free(matcher);
+}
+
+/**
+ * Stream the text through the automaton, calling the user function
+ * for every occurrence of every key.  The key handed to the user
+ * function points into the text at the start of the occurrence, so
+ * (key - text) is the offset of the hit.
+ *
+ * Returns the number of hits, or -1 if the user function asked us
+ * to stop.
+ */
+long
+trieMatcherScan(TrieMatcher *matcher,
+		const unsigned char *text, size_t textlength,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	TrieMatcherState *hit;
+	long nHits = 0;
+	size_t i;
+	int state = 0, next, out;
+
+	for (i = 0; i < textlength; i++) {
+		while ((next = trie_matcher_goto(matcher, state, text[i])) < 0 && state != 0)
+			state = matcher->states[state].fail;
+		state = (next < 0) ? 0 : next;
+
+		out = matcher->states[state].isKeySoHasValue
+				? state : matcher->states[state].output;
+		while (out != 0) {
+			hit = &matcher->states[out];
+			nHits++;
+			if ((*userfunction)((AAKeyType) &text[i + 1 - hit->depth],
+					hit->depth, hit->value, userdata) < 0) {
+				return -1;
+			}
+			out = hit->output;
+		}
+	}
+
+	return nHits;
+}
+
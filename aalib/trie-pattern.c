@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <string.h> // for memset()
+#include <stdlib.h> // for malloc()
+#include <assert.h>
+
+#include "trie_defs.h"
+
+
+/**
+ * One position within a compiled pattern.  Every token accepts
+ * a set of letters (a literal accepts one, '?' accepts all of them
+ * and a class accepts whatever was listed); a '*' token also accepts
+ * all letters but may match any number of them.
+ */
+typedef struct TriePatternToken {
+	unsigned char accept[32];
+	int isStar;
+} TriePatternToken;
+
+/** a pattern compiled for matching keys one at a time */
+struct TriePattern {
+	TriePatternToken *tokens;
+	int nTokens;
+	unsigned char *states;		/* two sets of live pattern positions */
+};
+
+/** everything the recursive walk needs, gathered in one place */
+typedef struct TriePatternSearch {
+	TriePatternToken *tokens;
+	int nTokens;
+	unsigned char *states;
+	AAKeyType keybuffer;
+	int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata);
+	void *userdata;
+	int *cost;
+} TriePatternSearch;
+
+#define	PATTERN_ACCEPTS(tok, c)	((tok)->accept[(c) >> 3] & (1 << ((c) & 7)))
+#define	PATTERN_SET(tok, c)		((tok)->accept[(c) >> 3] |= (1 << ((c) & 7)))
+
+
+/**
+ * Parse a "[...]" character class starting just after the '['.
+ * Returns the number of pattern characters consumed (including
+ * the closing ']'), or -1 if the class is not terminated.
+ */
+static int
+trie_pattern_class(TriePatternToken *tok, const unsigned char *p)
+{
+	const unsigned char *start = p;
+	int negate = 0, i, lo, hi;
+
+	if (*p == '!' || *p == '^') {
+		negate = 1;
+		p++;
+	}
+
+	/** a ']' in the first position is taken literally */
+	if (*p == ']') {
+		PATTERN_SET(tok, ']');
+		p++;
+	}
+
+	while (*p != '\0' && *p != ']') {
+		if (*p == '\\' && p[1] != '\0')
+			p++;
+		lo = *p++;
+		hi = lo;
+		if (*p == '-' && p[1] != ']' && p[1] != '\0') {
+			p++;
+			if (*p == '\\' && p[1] != '\0')
+				p++;
+			hi = *p++;
+		}
+		for (i = lo; i <= hi; i++)
+			PATTERN_SET(tok, i);
+	}
+
+	if (*p != ']')
+		return -1;
+
+	if (negate) {
+		for (i = 0; i < 32; i++)
+			tok->accept[i] = ~tok->accept[i];
+	}
+
+	return (p + 1) - start;
+}
+
+/**
+ * Turn the pattern text into an array of tokens.  Returns the
+ * number of tokens, or -1 if the pattern cannot be parsed.
+ */
+static int
+trie_pattern_compile(const char *pattern, TriePatternToken **tokenList)
+{
+	const unsigned char *p = (const unsigned char *) pattern;
+	TriePatternToken *tokens, *tok;
+	int nTokens = 0, used;
+
+	/** never more tokens than pattern characters */
+	tokens = (TriePatternToken *) malloc(
+			(strlen(pattern) + 1) * sizeof(TriePatternToken));
+	if (tokens == NULL)
+		return -1;
+
+	while (*p != '\0') {
+		tok = &tokens[nTokens];
+		memset(tok, 0, sizeof(TriePatternToken));
+
+		if (*p == '*') {
+			/** runs of stars are the same as a single star */
+			while (*p == '*')
+				p++;
+			tok->isStar = 1;
+			memset(tok->accept, 0xff, sizeof(tok->accept));
+
+		} else if (*p == '?') {
+			memset(tok->accept, 0xff, sizeof(tok->accept));
+			p++;
+
+		} else if (*p == '[') {
+			used = trie_pattern_class(tok, p + 1);
+			if (used < 0) {
+				free(tokens);
+				return -1;
+			}
+			p += 1 + used;
+
+		} else {
+			if (*p == '\\' && p[1] != '\0')
+				p++;
+			PATTERN_SET(tok, *p);
+			p++;
+		}
+		nTokens++;
+	}
+
+	*tokenList = tokens;
+	return nTokens;
+}
+
+/**
+ * A star may match nothing, so being in front of a star also
+ * means being just past it
+ */
+static void
+trie_pattern_closure(TriePatternToken *tokens, int nTokens, unsigned char *states)
+{
+	int p;
+
+	for (p = 0; p < nTokens; p++) {
+		if (states[p] && tokens[p].isStar)
+			states[p + 1] = 1;
+	}
+}
+
+/**
+ * Advance the set of live pattern positions over one letter.
+ * Returns zero if no position survives, which means nothing below
+ * this point in the trie can match.
+ */
+static int
+trie_pattern_step(TriePatternToken *tokens, int nTokens,
+		const unsigned char *from, unsigned char *to, unsigned char letter)
+{
+	int p, alive = 0;
+
+	memset(to, 0, nTokens + 1);
+	for (p = 0; p < nTokens; p++) {
+		if (from[p] && PATTERN_ACCEPTS(&tokens[p], letter)) {
+			if (tokens[p].isStar)
+				to[p] = 1;
+			else
+				to[p + 1] = 1;
+			alive = 1;
+		}
+	}
+
+	if (alive)
+		trie_pattern_closure(tokens, nTokens, to);
+
+	return alive;
+}
+
+/**
+ * Recursive helper -- only descends into children whose letters
+ * keep at least one pattern position alive
+ */
+static int
+trie_pattern_walk(TrieNode *node, TriePatternSearch *search, int depth)
+{
+	unsigned char *from, *to;
+	int i, nFound = 0, nBelow;
+
+	from = &search->states[depth * (search->nTokens + 1)];
+	to = &search->states[(depth + 1) * (search->nTokens + 1)];
+
+	if ( ! trie_pattern_step(search->tokens, search->nTokens,
+				from, to, (unsigned char) node->letter))
+		return 0;
+
+	if (search->cost != NULL)
+		(*search->cost)++;
+
+	search->keybuffer[depth] = node->letter;
+
+	if (node->isKeySoHasValue && to[search->nTokens]) {
+		search->keybuffer[depth + 1] = '\0';
+		if ((*search->userfunction)(search->keybuffer, depth + 1,
+				node->value, search->userdata) < 0) {
+			return -1;
+		}
+		nFound++;
+	}
+
+	for (i = 0; i < node->nSubtries; i++) {
+		nBelow = trie_pattern_walk(node->subtries[i], search, depth + 1);
+		if (nBelow < 0)	return -1;
+		nFound += nBelow;
+	}
+
+	return nFound;
+}
+
+/**
+ * Call the user function on every key matching the glob pattern.
+ *
+ * The pattern understands '?' (any one letter), '*' (any run of
+ * letters, including none), "[...]" classes with ranges and '!' or
+ * '^' negation, and '\' to quote the next character.  Subtries are
+ * only entered while some part of the pattern can still match, so
+ * a pattern with a literal prefix only visits that part of the trie.
+ *
+ * Returns the number of matching keys, or -1 on a bad pattern or if
+ * the user function asked us to stop.
+ */
+int
+triePatternSearch(KeyValueTrie *trie, const char *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata, int *cost)
+{
+	TriePatternSearch search;
+	int i, nFound = 0, nBelow;
+
+	search.nTokens = trie_pattern_compile(pattern, &search.tokens);
+	if (search.nTokens < 0)
+		return -1;
+
+	/** one set of live pattern positions for each depth in the trie */
+	search.states = (unsigned char *) calloc(
+			(trie->maxKeyLength + 1) * (search.nTokens + 1), 1);
+	search.keybuffer = (AAKeyType) malloc(trie->maxKeyLength + 1);
+	search.userfunction = userfunction;
+	search.userdata = userdata;
+	search.cost = cost;
+
+	if (search.states == NULL || search.keybuffer == NULL) {
+		nFound = -1;
+		goto cleanup;
+	}
+
+	search.states[0] = 1;
+	trie_pattern_closure(search.tokens, search.nTokens, search.states);
+
+	for (i = 0; i < trie->nSubtries; i++) {
+		nBelow = trie_pattern_walk(trie->subtries[i], &search, 0);
+		if (nBelow < 0) {
+			nFound = -1;
+			break;
+		}
+		nFound += nBelow;
+	}
+
+cleanup:
+	free(search.states);
+	free(search.keybuffer);
+	free(search.tokens);
+	return nFound;
+}
+
+/**
+ * Compile the glob pattern once, for checking many keys that are not
+ * held in a trie.  Returns NULL if the pattern cannot be parsed or
+ * memory runs out.  The pattern keeps its own working state, so it
+ * must not be shared between threads.
+ */
+TriePattern *
+trieCompilePattern(const char *pattern)
+{
+	TriePattern *compiled;
+
+	compiled = (TriePattern *) malloc(sizeof(TriePattern));
+	if (compiled == NULL)
+		return NULL;
+
+	compiled->nTokens = trie_pattern_compile(pattern, &compiled->tokens);
+	if (compiled->nTokens < 0) {
+		free(compiled);
+		return NULL;
+	}
+
+	compiled->states = (unsigned char *) calloc(2 * (compiled->nTokens + 1), 1);
+	if (compiled->states == NULL) {
+		free(compiled->tokens);
+		free(compiled);
+		return NULL;
+	}
+	return compiled;
+}
+
+void
+trieDeletePattern(TriePattern *pattern)
+{
+	if (pattern == NULL)	return;
+	free(pattern->states);
+	free(pattern->tokens);
+	free(pattern);
+}
+
+/** check a single key against a compiled pattern; returns 1 on a match */
+int
+triePatternMatch(TriePattern *pattern, AAKeyType key, size_t keylength)
+{
+	unsigned char *from, *to, *swap;
+	int nTokens = pattern->nTokens;
+	size_t i;
+
+	from = pattern->states;
+	to = &pattern->states[nTokens + 1];
+
+	memset(from, 0, nTokens + 1);
+	from[0] = 1;
+	trie_pattern_closure(pattern->tokens, nTokens, from);
+	for (i = 0; i < keylength; i++) {
+		if ( ! trie_pattern_step(pattern->tokens, nTokens, from, to, key[i]))
+			return 0;
+		swap = from;
+		from = to;
+		to = swap;
+	}
+	return from[nTokens];
+}
+
+/**
+ * Copy the literal prefix of the pattern (the leading positions that
+ * each accept exactly one letter) into the buffer, up to maxLength
+ * letters.  Every key the pattern matches starts with this prefix.
+ * Returns the prefix length.
+ */
+size_t
+triePatternPrefix(TriePattern *pattern, AAKeyType buffer, size_t maxLength)
+{
+	TriePatternToken *tok;
+	size_t length = 0;
+	int c, letter, nAccepted;
+
+	while (length < maxLength && length < (size_t) pattern->nTokens) {
+		tok = &pattern->tokens[length];
+		if (tok->isStar)
+			break;
+		nAccepted = 0;
+		letter = 0;
+		for (c = 0; c < 256 && nAccepted < 2; c++) {
+			if (PATTERN_ACCEPTS(tok, c)) {
+				letter = c;
+				nAccepted++;
+			}
+		}
+		if (nAccepted != 1)
+			break;
+		buffer[length++] = (unsigned char) letter;
+	}
+	return length;
+}
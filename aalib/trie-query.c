@@ -7,8 +7,42 @@
 #include "trie_defs.h"
 
 
-/** find a key within the trie */
-void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost)
+/**
+ * Find the subtrie for the letter with a linear scan, in frequency
+ * order if the trie is adaptive and the node (or the top level, if
+ * node is NULL) has enough subtries.  Scans are only counted in
+ * adaptive tries, which change as they are read anyway; plain
+ * lookups leave the trie untouched, so that threads may share it.
+ */
+static TrieNode *trie_scan_subtries(KeyValueTrie *root, TrieNode *node,
+		TrieNode **subtries, int nSubtries, TrieLetter letter)
+{
+	TrieNodeExtras *extras;
+	int i;
+
+	if (root->adaptiveOrder) {
+		if (nSubtries >= TRIE_ADAPTIVE_MIN_FANOUT) {
+			if (node == NULL)
+				return trie_adaptive_subtrie(root, &root->adaptive,
+						subtries, nSubtries, letter);
+			if ((extras = trie_node_extras(node)) != NULL)
+				return trie_adaptive_subtrie(root, &extras->adaptive,
+						node->subtries, nSubtries, letter);
+		}
+		root->nScans++;
+	}
+
+	for (i = 0; i < nSubtries; i++) {
+		if (subtries[i]->letter == letter)
+			break;
+	}
+	if (root->adaptiveOrder)
+		root->nCompares += (i < nSubtries) ? i + 1 : nSubtries;
+	return (i < nSubtries) ? subtries[i] : NULL;
+}
+
+/** find the node at which a key ends, whether or not it holds a value */
+static TrieNode *trie_find_node(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost)
 {
 	// TO DO: walk the trie to find the key, returning
 	// a value if there is one after we have finished
@@ -16,14 +50,18 @@ void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *co
 
 	TrieNode *current = NULL;
 
-    // Start from the root of the trie
-    for (int i = 0; i < root->nSubtries; i++) {
-        if (root->subtries[i]->letter == key[0]) {
-            current = root->subtries[i];
-            break;
-        }
+    if (keylength == 0) {
+        return NULL;
+    }
+
+    if (root->letterCode != NULL) {
+        return trie_dense_find(root, key, keylength, cost);
     }
 
+    // Start from the root of the trie
+    current = trie_scan_subtries(root, NULL,
+            root->subtries, root->nSubtries, key[0]);
+
     // If the first letter is not found, the key does not exist in the trie
     if (!current){
         return NULL;
@@ -31,23 +69,30 @@ void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *co
 
     // Traverse the trie following the key
     for (size_t i = 1; i < keylength; i++) {
-        int found = 0;
-        for (int j = 0; j < current->nSubtries; j++) {
-            if (current->subtries[j]->letter == key[i]) {
-                current = current->subtries[j];
-                found = 1;
-                if (cost) (*cost)++;
-                break;
-            }
-        }
+        current = trie_scan_subtries(root, current,
+                current->subtries, current->nSubtries, key[i]);
         // If the next letter is not found, the key does not exist in the trie
-        if (!found){
+        if (!current){
             return NULL;
-        } 
+        }
+        if (cost) (*cost)++;
     }
 
+    return current;
+}
+
+/** find a key within the trie */
+void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost)
+{
+	TrieNode *current;
+
+	TRIE_TRACE2(lookup_entry, key, keylength);
+	current = trie_find_node(root, key, keylength, cost);
+	TRIE_TRACE3(lookup_return, key, keylength,
+			current != NULL && current->isKeySoHasValue);
+
     // If the end of the key is reached and the current node is marked as a key node, return its value
-    if (current->isKeySoHasValue) {
+    if (current != NULL && current->isKeySoHasValue) {
         return current->value;
     }
 
@@ -56,4 +101,47 @@ void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *co
 	return NULL;
 }
 
+/**
+ * Find the place the value for a key is kept, or NULL if the key
+ * is not present.  Unlike trieLookupKey() this tells a key stored
+ * with a NULL value apart from a missing one.
+ */
+void **trieLookupSlot(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost)
+{
+	TrieNode *current;
+
+	TRIE_TRACE2(lookup_entry, key, keylength);
+	current = trie_find_node(root, key, keylength, cost);
+	TRIE_TRACE3(lookup_return, key, keylength,
+			current != NULL && current->isKeySoHasValue);
+
+	if (current == NULL || ! current->isKeySoHasValue)
+		return NULL;
+	return &current->value;
+}
+
+/**
+ * Find the value slot for a key, adding the key (with a NULL value)
+ * if it is not already present.  isNew, if given, is set to show
+ * which happened.  Returns NULL only if the key could not be added.
+ */
+void **trieInsertSlot(KeyValueTrie *root, AAKeyType key, size_t keylength,
+		int *isNew, int *cost)
+{
+	void **slot;
+
+	if (isNew != NULL)
+		*isNew = 0;
+
+	slot = trieLookupSlot(root, key, keylength, cost);
+	if (slot != NULL || keylength == 0)
+		return slot;
+
+	if (trieInsertKey(root, key, keylength, NULL, cost) < 0)
+		return NULL;
+	if (isNew != NULL)
+		*isNew = 1;
+	return trieLookupSlot(root, key, keylength, cost);
+}
+
 
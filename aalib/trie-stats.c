@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trie_defs.h"
+
+
+/** count a value into a histogram, the last bucket taking any overflow */
+static void
+trie_stats_bucket(uint64_t *histogram, int nBuckets, size_t value, uint64_t count)
+{
+	if (value >= (size_t) nBuckets)
+		value = nBuckets - 1;
+	histogram[value] += count;
+}
+
+/** the bytes held by a scan order of adaptive ordering */
+static size_t
+trie_stats_adaptive_bytes(TrieAdaptiveOrder *order)
+{
+	if (order == NULL)
+		return 0;
+	return sizeof(TrieAdaptiveOrder)
+			+ order->maxChildren * (sizeof(TrieNode *) + sizeof(unsigned));
+}
+
+/** recursive helper: the node at the given depth and all below it */
+static void
+trie_stats_node(KeyValueTrie *trie, TrieNode *node, size_t depth, AAStats *stats)
+{
+	int i;
+
+	stats->nNodes++;
+	stats->bytesAllocated += node->nSubtries * sizeof(TrieNode *);
+	if (trie->ownsValues) {
+		stats->bytesAllocated += sizeof(TrieValueNode)
+				+ TRIE_VALUE_NODE(node)->inlineSize;
+	} else {
+		stats->bytesAllocated += sizeof(TrieNode);
+	}
+	if (node->flags & TRIE_NODE_EXTRAS) {
+		stats->bytesAllocated += sizeof(TrieNodeExtras)
+				+ TRIE_EXTRAS(node)->nIndex * sizeof(TrieNode *)
+				+ trie_stats_adaptive_bytes(TRIE_EXTRAS(node)->adaptive);
+	}
+	trie_stats_bucket(stats->fanoutHistogram, AA_STATS_FANOUT_BUCKETS,
+			node->nSubtries, 1);
+
+	if (node->isKeySoHasValue) {
+		trie_stats_bucket(stats->depthHistogram, AA_STATS_DEPTH_BUCKETS, depth, 1);
+
+		/** values too long for the node have a buffer of their own */
+		if (trie->ownsValues && node->value != NULL
+				&& node->value != (void *) TRIE_VALUE_NODE(node)->inlineValue)
+			stats->bytesAllocated += TRIE_VALUE_NODE(node)->valueLength + 1;
+	}
+
+	for (i = 0; i < node->nSubtries; i++)
+		trie_stats_node(trie, node->subtries[i], depth + 1, stats);
+}
+
+void
+trieGetStats(KeyValueTrie *trie, AAStats *stats)
+{
+	int i;
+
+	/** the top level list starts at 256 entries and keeps them for its first key */
+	stats->bytesAllocated += sizeof(KeyValueTrie)
+			+ ((trie->nSubtries <= 1) ? 256 : trie->nSubtries) * sizeof(TrieNode *)
+			+ trie->nIndex * sizeof(TrieNode *)
+			+ trie_stats_adaptive_bytes(trie->adaptive);
+	if (trie->letterCode != NULL)
+		stats->bytesAllocated += 256 * sizeof(unsigned short);
+
+	for (i = 0; i < trie->nSubtries; i++)
+		trie_stats_node(trie, trie->subtries[i], 1, stats);
+}
+
+/** recursive helper for the integer trie; a key's depth counts its leaf */
+static void
+trie_stats_u64_node(void *slot, size_t depth, AAStats *stats)
+{
+	U64TrieNode *node;
+	void *child;
+	int i;
+
+	stats->nNodes++;
+	if (U64TRIE_IS_LEAF(slot)) {
+		stats->bytesAllocated += sizeof(U64TrieLeaf);
+		trie_stats_bucket(stats->fanoutHistogram, AA_STATS_FANOUT_BUCKETS, 0, 1);
+		trie_stats_bucket(stats->depthHistogram, AA_STATS_DEPTH_BUCKETS, depth, 1);
+		return;
+	}
+
+	node = (U64TrieNode *) slot;
+	if (node->kind == U64TRIE_NODE4) {
+		stats->bytesAllocated += sizeof(U64TrieNode4);
+	} else if (node->kind == U64TRIE_NODE16) {
+		stats->bytesAllocated += sizeof(U64TrieNode16);
+	} else {
+		stats->bytesAllocated += sizeof(U64TrieNode256);
+	}
+	trie_stats_bucket(stats->fanoutHistogram, AA_STATS_FANOUT_BUCKETS,
+			node->nChildren, 1);
+
+	for (i = 0; i < U64TRIE_FANOUT; i++) {
+		if (node->kind == U64TRIE_NODE256) {
+			child = ((U64TrieNode256 *) node)->children[i];
+		} else if (i < node->nChildren) {
+			child = (node->kind == U64TRIE_NODE4)
+					? ((U64TrieNode4 *) node)->children[i]
+					: ((U64TrieNode16 *) node)->children[i];
+		} else {
+			break;
+		}
+		if (child != NULL)
+			trie_stats_u64_node(child, depth + 1, stats);
+	}
+}
+
+void
+trieU64GetStats(U64Trie *trie, AAStats *stats)
+{
+	stats->bytesAllocated += sizeof(U64Trie);
+	if (trie->root != NULL)
+		trie_stats_u64_node(trie->root, 1, stats);
+}
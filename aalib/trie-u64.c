@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <string.h> // for memset()
+#include <stdlib.h> // for malloc()
+#include <stdint.h>
+#include <assert.h>
+
+#include "trie_defs.h"
+
+
+#define	U64TRIE_BYTE(key, level) \
+		((unsigned int) ((key) >> (8 * (U64TRIE_LEVELS - 1 - (level)))) & 0xff)
+
+/** the bytes of the key above the given level, with the rest cleared */
+#define	U64TRIE_PREFIX(key, level) \
+		(((level) == 0) ? 0 : (key) & (~(uint64_t) 0 << (8 * (U64TRIE_LEVELS - (level)))))
+
+/** a small node shrinks once it has this few children left */
+#define	U64TRIE_NODE16_SHRINK	3
+#define	U64TRIE_NODE256_SHRINK	12
+
+
+/** the first level at which two different keys have different bytes */
+static int
+trie_u64_first_difference(uint64_t a, uint64_t b)
+{
+	return __builtin_clzll(a ^ b) / 8;
+}
+
+/** the bytes and children arrays of a node with up to 4 or 16 children */
+static unsigned char *
+trie_u64_bytes(U64TrieNode *node)
+{
+	if (node->kind == U64TRIE_NODE4)
+		return ((U64TrieNode4 *) node)->bytes;
+	return ((U64TrieNode16 *) node)->bytes;
+}
+
+static void **
+trie_u64_children(U64TrieNode *node)
+{
+	if (node->kind == U64TRIE_NODE4)
+		return ((U64TrieNode4 *) node)->children;
+	return ((U64TrieNode16 *) node)->children;
+}
+
+/** create an empty node of the given kind, branching at the given level */
+static U64TrieNode *
+trie_u64_create_node(int kind, int level, uint64_t key)
+{
+	U64TrieNode *node;
+	size_t size;
+
+	if (kind == U64TRIE_NODE4) {
+		size = sizeof(U64TrieNode4);
+	} else if (kind == U64TRIE_NODE16) {
+		size = sizeof(U64TrieNode16);
+	} else {
+		size = sizeof(U64TrieNode256);
+	}
+
+	node = (U64TrieNode *) malloc(size);
+	if (node == NULL)
+		return NULL;
+	memset(node, 0, size);
+	node->kind = kind;
+	node->level = level;
+	node->prefix = U64TRIE_PREFIX(key, level);
+	return node;
+}
+
+static U64TrieLeaf *
+trie_u64_create_leaf(uint64_t key, void *value)
+{
+	U64TrieLeaf *leaf = (U64TrieLeaf *) malloc(sizeof(U64TrieLeaf));
+
+	if (leaf == NULL)
+		return NULL;
+	leaf->key = key;
+	leaf->value = value;
+	return leaf;
+}
+
+/** the slot of the child for the byte, or NULL if there is none */
+static void **
+trie_u64_find_child(U64TrieNode *node, unsigned int byte)
+{
+	unsigned char *bytes;
+	int i;
+
+	if (node->kind == U64TRIE_NODE256) {
+		if (((U64TrieNode256 *) node)->children[byte] == NULL)
+			return NULL;
+		return &((U64TrieNode256 *) node)->children[byte];
+	}
+
+	bytes = trie_u64_bytes(node);
+	for (i = 0; i < node->nChildren; i++) {
+		if (bytes[i] == byte)
+			return &trie_u64_children(node)[i];
+	}
+	return NULL;
+}
+
+/**
+ * Copy the children of a node into an empty node of another kind,
+ * keeping them in byte order
+ */
+static void
+trie_u64_copy_children(U64TrieNode *to, U64TrieNode *from)
+{
+	void **children;
+	unsigned char *bytes;
+	int i, n = 0;
+
+	if (from->kind == U64TRIE_NODE256) {
+		for (i = 0; i < U64TRIE_FANOUT; i++) {
+			if (((U64TrieNode256 *) from)->children[i] == NULL)
+				continue;
+			trie_u64_bytes(to)[n] = (unsigned char) i;
+			trie_u64_children(to)[n] = ((U64TrieNode256 *) from)->children[i];
+			n++;
+		}
+	} else {
+		bytes = trie_u64_bytes(from);
+		children = trie_u64_children(from);
+		for (i = 0; i < from->nChildren; i++) {
+			if (to->kind == U64TRIE_NODE256) {
+				((U64TrieNode256 *) to)->children[bytes[i]] = children[i];
+			} else {
+				trie_u64_bytes(to)[i] = bytes[i];
+				trie_u64_children(to)[i] = children[i];
+			}
+		}
+	}
+	to->nChildren = from->nChildren;
+}
+
+/**
+ * Move the node in the slot into a node of another kind.  Returns -1,
+ * leaving the node as it was, if there is no memory.
+ */
+static int
+trie_u64_resize(void **slot, int kind)
+{
+	U64TrieNode *node = (U64TrieNode *) *slot, *resized;
+
+	resized = trie_u64_create_node(kind, node->level, node->prefix);
+	if (resized == NULL)
+		return -1;
+	trie_u64_copy_children(resized, node);
+	free(node);
+	*slot = resized;
+	return 0;
+}
+
+/**
+ * Add a child for a byte the node does not have yet, growing the
+ * node first if it is full.  Returns -1 if there is no memory.
+ */
+static int
+trie_u64_add_child(void **slot, unsigned int byte, void *child)
+{
+	U64TrieNode *node = (U64TrieNode *) *slot;
+	unsigned char *bytes;
+	void **children;
+	int i;
+
+	if ((node->kind == U64TRIE_NODE4 && node->nChildren == 4)
+			|| (node->kind == U64TRIE_NODE16 && node->nChildren == 16)) {
+		if (trie_u64_resize(slot, node->kind + 1) < 0)
+			return -1;
+		node = (U64TrieNode *) *slot;
+	}
+
+	if (node->kind == U64TRIE_NODE256) {
+		((U64TrieNode256 *) node)->children[byte] = child;
+	} else {
+		bytes = trie_u64_bytes(node);
+		children = trie_u64_children(node);
+		for (i = node->nChildren; i > 0 && bytes[i - 1] > byte; i--) {
+			bytes[i] = bytes[i - 1];
+			children[i] = children[i - 1];
+		}
+		bytes[i] = (unsigned char) byte;
+		children[i] = child;
+	}
+	node->nChildren++;
+	return 0;
+}
+
+/**
+ * Take the child for the byte out of the node.  A node left with a
+ * single child is replaced in its slot by that child, and one left
+ * with few is moved into a smaller kind if there is memory for it.
+ */
+static void
+trie_u64_remove_child(void **slot, unsigned int byte)
+{
+	U64TrieNode *node = (U64TrieNode *) *slot;
+	unsigned char *bytes;
+	void **children, *only = NULL;
+	int i;
+
+	if (node->kind == U64TRIE_NODE256) {
+		((U64TrieNode256 *) node)->children[byte] = NULL;
+	} else {
+		bytes = trie_u64_bytes(node);
+		children = trie_u64_children(node);
+		for (i = 0; i < node->nChildren && bytes[i] != byte; i++)
+			;
+		for (; i < node->nChildren - 1; i++) {
+			bytes[i] = bytes[i + 1];
+			children[i] = children[i + 1];
+		}
+	}
+	node->nChildren--;
+
+	if (node->nChildren == 1) {
+		if (node->kind == U64TRIE_NODE256) {
+			for (i = 0; only == NULL && i < U64TRIE_FANOUT; i++)
+				only = ((U64TrieNode256 *) node)->children[i];
+		} else {
+			only = trie_u64_children(node)[0];
+		}
+		free(node);
+		*slot = only;
+	} else if (node->kind == U64TRIE_NODE256
+			&& node->nChildren <= U64TRIE_NODE256_SHRINK) {
+		trie_u64_resize(slot, U64TRIE_NODE16);
+	} else if (node->kind == U64TRIE_NODE16
+			&& node->nChildren <= U64TRIE_NODE16_SHRINK) {
+		trie_u64_resize(slot, U64TRIE_NODE4);
+	}
+}
+
+/** create an empty integer keyed trie */
+U64Trie *
+trieCreateU64Trie()
+{
+	U64Trie *trie;
+
+	trie = (U64Trie *) malloc(sizeof(U64Trie));
+	if (trie == NULL)
+		return NULL;
+	trie->root = NULL;
+	trie->nEntries = 0;
+	return trie;
+}
+
+/** recursive helper for deletion */
+static void
+trie_u64_delete_helper(void *slot)
+{
+	U64TrieNode *node;
+	int i;
+
+	if (slot == NULL)	return;
+
+	if (U64TRIE_IS_LEAF(slot)) {
+		free(U64TRIE_LEAF(slot));
+		return;
+	}
+
+	node = (U64TrieNode *) slot;
+	if (node->kind == U64TRIE_NODE256) {
+		for (i = 0; i < U64TRIE_FANOUT; i++)
+			trie_u64_delete_helper(((U64TrieNode256 *) node)->children[i]);
+	} else {
+		for (i = 0; i < node->nChildren; i++)
+			trie_u64_delete_helper(trie_u64_children(node)[i]);
+	}
+	free(node);
+}
+
+/**
+ * delete the trie; as with the string trie, the values belong to
+ * the user code
+ */
+void
+trieDeleteU64Trie(U64Trie *trie)
+{
+	if (trie == NULL)	return;
+	trie_u64_delete_helper(trie->root);
+	free(trie);
+}
+
+/**
+ * Put a new node in the slot, branching at the given level between
+ * what the slot held and a new leaf for the key.  Returns -1, leaving
+ * the slot as it was, if there is no memory.
+ */
+static int
+trie_u64_split(void **slot, uint64_t existingKey, int level,
+		uint64_t key, void *value)
+{
+	U64TrieNode *node;
+	U64TrieLeaf *leaf;
+
+	node = trie_u64_create_node(U64TRIE_NODE4, level, key);
+	leaf = trie_u64_create_leaf(key, value);
+	if (node == NULL || leaf == NULL) {
+		free(node);
+		free(leaf);
+		return -1;
+	}
+
+	trie_u64_add_child((void **) &node,
+			U64TRIE_BYTE(existingKey, level), *slot);
+	trie_u64_add_child((void **) &node,
+			U64TRIE_BYTE(key, level), U64TRIE_TAG_LEAF(leaf));
+	*slot = node;
+	return 0;
+}
+
+/**
+ * Add or replace the value stored for the key.  Returns 0, or -1
+ * if a node could not be allocated, in which case the trie is left
+ * as it was.
+ */
+int
+trieInsertU64(U64Trie *trie, uint64_t key, void *value, int *cost)
+{
+	void **slot = &trie->root, **child;
+	U64TrieNode *node;
+	U64TrieLeaf *leaf;
+
+	for (;;) {
+		if (cost != NULL)
+			(*cost)++;
+
+		if (*slot == NULL) {
+			leaf = trie_u64_create_leaf(key, value);
+			if (leaf == NULL)
+				return -1;
+			*slot = U64TRIE_TAG_LEAF(leaf);
+			break;
+		}
+
+		if (U64TRIE_IS_LEAF(*slot)) {
+			leaf = U64TRIE_LEAF(*slot);
+			if (leaf->key == key) {
+				leaf->value = value;
+				return 0;
+			}
+			if (trie_u64_split(slot, leaf->key,
+					trie_u64_first_difference(leaf->key, key), key, value) < 0)
+				return -1;
+			break;
+		}
+
+		/** a key that leaves the shared prefix branches off above the node */
+		node = (U64TrieNode *) *slot;
+		if (U64TRIE_PREFIX(key, node->level) != node->prefix) {
+			if (trie_u64_split(slot, node->prefix,
+					trie_u64_first_difference(node->prefix, key), key, value) < 0)
+				return -1;
+			break;
+		}
+
+		child = trie_u64_find_child(node, U64TRIE_BYTE(key, node->level));
+		if (child == NULL) {
+			leaf = trie_u64_create_leaf(key, value);
+			if (leaf == NULL)
+				return -1;
+			if (trie_u64_add_child(slot, U64TRIE_BYTE(key, node->level),
+					U64TRIE_TAG_LEAF(leaf)) < 0) {
+				free(leaf);
+				return -1;
+			}
+			break;
+		}
+		slot = child;
+	}
+
+	trie->nEntries++;
+	return 0;
+}
+
+/** find the value for the key, or NULL if the key is not present */
+void *
+trieLookupU64(U64Trie *trie, uint64_t key, int *cost)
+{
+	void *slot = trie->root;
+	U64TrieNode *node;
+	unsigned char *bytes;
+	unsigned int byte;
+	int i, visits = 1;
+
+	while (slot != NULL && ! U64TRIE_IS_LEAF(slot)) {
+		node = (U64TrieNode *) slot;
+		byte = U64TRIE_BYTE(key, node->level);
+		visits++;
+
+		/** the dense levels are a single indexed load */
+		if (node->kind == U64TRIE_NODE256) {
+			slot = ((U64TrieNode256 *) node)->children[byte];
+			continue;
+		}
+
+		bytes = trie_u64_bytes(node);
+		for (i = 0; i < node->nChildren && bytes[i] != byte; i++)
+			;
+		slot = (i < node->nChildren) ? trie_u64_children(node)[i] : NULL;
+	}
+
+	if (cost != NULL)
+		(*cost) += visits;
+
+	if (slot == NULL || U64TRIE_LEAF(slot)->key != key)
+		return NULL;
+	return U64TRIE_LEAF(slot)->value;
+}
+
+/**
+ * Remove the key, collapsing or shrinking the node it was in, and
+ * return its value (or NULL if it was not present)
+ */
+void *
+trieDeleteU64(U64Trie *trie, uint64_t key, int *cost)
+{
+	void **slot = &trie->root, **parent = NULL;
+	U64TrieNode *node;
+	U64TrieLeaf *leaf;
+	void *value;
+
+	while (*slot != NULL && ! U64TRIE_IS_LEAF(*slot)) {
+		if (cost != NULL)
+			(*cost)++;
+		node = (U64TrieNode *) *slot;
+		parent = slot;
+		slot = trie_u64_find_child(node, U64TRIE_BYTE(key, node->level));
+		if (slot == NULL)
+			return NULL;
+	}
+	if (cost != NULL)
+		(*cost)++;
+
+	if (*slot == NULL || U64TRIE_LEAF(*slot)->key != key)
+		return NULL;
+
+	leaf = U64TRIE_LEAF(*slot);
+	value = leaf->value;
+	free(leaf);
+	trie->nEntries--;
+
+	if (parent == NULL) {
+		*slot = NULL;
+	} else {
+		node = (U64TrieNode *) *parent;
+		trie_u64_remove_child(parent, U64TRIE_BYTE(key, node->level));
+	}
+	return value;
+}
+
+/** recursive helper for iteration, in key order */
+static int
+trie_u64_iterate(void *slot, unsigned char *keybuffer,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	U64TrieNode *node;
+	U64TrieLeaf *leaf;
+	void *child;
+	int i, nKeys = 0, nBelow;
+
+	if (U64TRIE_IS_LEAF(slot)) {
+		leaf = U64TRIE_LEAF(slot);
+		for (i = 0; i < U64TRIE_LEVELS; i++)
+			keybuffer[i] = (unsigned char) U64TRIE_BYTE(leaf->key, i);
+		if ((*userfunction)(keybuffer, U64TRIE_LEVELS, leaf->value, userdata) < 0)
+			return -1;
+		return 1;
+	}
+
+	node = (U64TrieNode *) slot;
+	for (i = 0; i < U64TRIE_FANOUT; i++) {
+		if (node->kind == U64TRIE_NODE256) {
+			child = ((U64TrieNode256 *) node)->children[i];
+		} else if (i < node->nChildren) {
+			child = trie_u64_children(node)[i];
+		} else {
+			break;
+		}
+		if (child == NULL)
+			continue;
+		nBelow = trie_u64_iterate(child, keybuffer, userfunction, userdata);
+		if (nBelow < 0)	return -1;
+		nKeys += nBelow;
+	}
+	return nKeys;
+}
+
+/**
+ * Call the user function on every key in increasing numeric order.
+ * The key is handed over as its 8 bytes, most significant first.
+ */
+int trieIterateU64Action(
+		U64Trie *trie,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata
+	)
+{
+	unsigned char keybuffer[U64TRIE_LEVELS + 1];
+
+	if (trie->root == NULL)
+		return 0;
+
+	keybuffer[U64TRIE_LEVELS] = '\0';
+	return trie_u64_iterate(trie->root, keybuffer, userfunction, userdata);
+}
+
+/** print helper: one line per key */
+static int
+trie_u64_print_key(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	uint64_t intkey = 0;
+	size_t i;
+
+	for (i = 0; i < keylen; i++)
+		intkey = (intkey << 8) | key[i];
+
+	fprintf((FILE *) userdata, "    [0x%016llx] %p\n",
+			(unsigned long long) intkey, value);
+	return 0;
+}
+
+/* print out the keys in order, along with the memory in use */
+void
+trieU64Print(FILE *fp, U64Trie *trie)
+{
+	if (trie->nEntries == 0) {
+		fprintf(fp, "This integer trie is empty!\n");
+		return;
+	}
+	fprintf(fp, "Integer trie holds %lu keys:\n", (unsigned long) trie->nEntries);
+	trieIterateU64Action(trie, trie_u64_print_key, fp);
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h> // for memcpy()
+#include <stdlib.h> // for malloc()
+#include <stddef.h> // for offsetof()
+#include <assert.h>
+
+#include "trie_defs.h"
+
+
+/** the node that a value slot belongs to */
+#define	TRIE_SLOT_NODE(slot)	\
+		((TrieNode *) ((char *) (slot) - offsetof(TrieNode, value)))
+
+
+/**
+ * Make the trie own its values: from now on they are copied in by
+ * trieInsertValue(), and values of up to maxInline bytes are kept
+ * inside the node ending their key.  Must be done while the trie is
+ * still empty.
+ */
+int
+trieSetValueBytes(KeyValueTrie *trie, size_t maxInline)
+{
+	if (trie->nSubtries != 0)
+		return -1;
+
+	trie->ownsValues = 1;
+	trie->inlineValueMax = maxInline;
+	return 0;
+}
+
+/** free the buffer holding a value, if it is not held in the node */
+void
+trie_release_value(TrieNode *node)
+{
+	TrieValueNode *valueNode = TRIE_VALUE_NODE(node);
+
+	if (node->value != NULL && node->value != (void *) valueNode->inlineValue)
+		free(node->value);
+	node->value = NULL;
+	valueNode->valueLength = 0;
+}
+
+/**
+ * Copy the value in for the key, replacing any value it had.  The
+ * stored copy is always followed by a '\0', so string values can be
+ * used directly from trieLookupKey().
+ */
+int
+trieInsertValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		const void *value, size_t valuelength, int *cost)
+{
+	TrieValueNode *node;
+	void **slot;
+	unsigned char *buffer;
+
+	if ( ! trie->ownsValues)
+		return -1;
+
+	slot = trieInsertSlot(trie, key, keylength, NULL, cost);
+	if (slot == NULL)
+		return -1;
+	node = TRIE_VALUE_NODE(TRIE_SLOT_NODE(slot));
+
+	if (valuelength < node->inlineSize) {
+		trie_release_value(&node->node);
+		buffer = node->inlineValue;
+	} else {
+		buffer = (unsigned char *) malloc(valuelength + 1);
+		if (buffer == NULL)
+			return -1;
+		trie_release_value(&node->node);
+	}
+
+	memcpy(buffer, value, valuelength);
+	buffer[valuelength] = '\0';
+	node->node.value = buffer;
+	node->valueLength = valuelength;
+	return 0;
+}
+
+/**
+ * Find the value for the key, returning a pointer to the stored
+ * bytes (good until the key is next changed) and their length, or
+ * NULL if the key is not present.
+ */
+const void *
+trieLookupValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		size_t *valuelength, int *cost)
+{
+	void **slot = trieLookupSlot(trie, key, keylength, cost);
+
+	if (slot == NULL)
+		return NULL;
+	if (valuelength != NULL)
+		*valuelength = ( ! trie->ownsValues) ? 0
+				: TRIE_VALUE_NODE(TRIE_SLOT_NODE(slot))->valueLength;
+	return *slot;
+}
+
+/**
+ * Remove the key and return 1, 0 if it was not present, or -1 if the
+ * value could not be handed over (or the trie does not own values).  If value
+ * is given, the stored value (still followed by its '\0') is handed
+ * over to the caller to free(), with its length in valuelength;
+ * otherwise it is freed here.  The key's node is found with a single
+ * walk and simply stops being a key, as trieDeleteKey() would leave it.
+ */
+int
+trieDeleteValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		void **value, size_t *valuelength, int *cost)
+{
+	TrieValueNode *node;
+	void **slot;
+
+	if ( ! trie->ownsValues)
+		return -1;
+	slot = trieLookupSlot(trie, key, keylength, cost);
+	if (slot == NULL)
+		return 0;
+	node = TRIE_VALUE_NODE(TRIE_SLOT_NODE(slot));
+
+	if (value != NULL) {
+		if (node->node.value == (void *) node->inlineValue) {
+			*value = malloc(node->valueLength + 1);
+			if (*value == NULL)
+				return -1;
+			memcpy(*value, node->inlineValue, node->valueLength + 1);
+		} else {
+			*value = node->node.value;
+			node->node.value = NULL;
+		}
+		if (valuelength != NULL)
+			*valuelength = node->valueLength;
+	}
+	trie_release_value(&node->node);
+
+	node->node.isKeySoHasValue = 0;
+	trie->nKeys--;
+	return 1;
+}
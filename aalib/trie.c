@@ -33,20 +33,34 @@ trieCreateTrie()
     }
     root->nSubtries = 0;
     root->maxKeyLength = 0;
+    root->index = NULL;
+    root->nIndex = 0;
+    root->letterCode = NULL;
+    root->alphabetSize = 0;
+    root->ownsValues = 0;
+    root->inlineValueMax = 0;
+    root->nKeys = 0;
+    root->adaptiveOrder = 0;
+    root->adaptive = NULL;
+    root->nScans = 0;
+    root->nCompares = 0;
     return root;
 }
 
 /** recursive iterator helper function for deletion */
 static void
-trie_delete_helper(TrieNode *node)
+trie_delete_helper(TrieNode *node, int ownsValues)
 {
 	int i;
 
 	if (node == NULL)	return;
 
 	for (i = 0 ; i < node->nSubtries; i++) {
-		trie_delete_helper(node->subtries[i]);
+		trie_delete_helper(node->subtries[i], ownsValues);
 	}
+	if (ownsValues)
+		trie_release_value(node);
+	trie_free_subtries(node);
 	free(node);
 }
 
@@ -57,8 +71,12 @@ trieDeleteTrie(KeyValueTrie *trie)
 	int i;
 
 	for (i = 0 ; i < trie->nSubtries; i++) {
-		trie_delete_helper(trie->subtries[i]);
+		trie_delete_helper(trie->subtries[i], trie->ownsValues);
 	}
+	free(trie->subtries);
+	free(trie->index);
+	trie_adaptive_delete(trie->adaptive);
+	free(trie->letterCode);
 	free(trie);
 }
 
@@ -67,10 +85,32 @@ TrieNode *
 trieCreateNode()
 {
 	TrieNode *newNode = (TrieNode *) malloc(sizeof(TrieNode));
+	if (newNode == NULL)
+		return NULL;
 	memset(newNode, 0, sizeof(TrieNode));
+	TRIE_TRACE2(node_alloc, newNode, sizeof(TrieNode));
 	return newNode;
 }
 
+/**
+ * Create a value node, for a trie that owns its values, with room
+ * inside it for inlineSize bytes (counting the '\0'); keys that only
+ * pass through the node have no need of any.
+ */
+TrieNode *
+trie_create_value_node(size_t inlineSize)
+{
+	TrieValueNode *newNode;
+
+	newNode = (TrieValueNode *) malloc(sizeof(TrieValueNode) + inlineSize);
+	if (newNode == NULL)
+		return NULL;
+	memset(newNode, 0, sizeof(TrieValueNode));
+	newNode->inlineSize = inlineSize;
+	TRIE_TRACE2(node_alloc, newNode, sizeof(TrieValueNode) + inlineSize);
+	return &newNode->node;
+}
+
 /** clean up a single node */
 void
 trieDeleteNode(TrieNode *node)
@@ -78,7 +118,75 @@ trieDeleteNode(TrieNode *node)
 	free(node);
 }
 
-
+/** the start of the allocation holding a node's list of subtries */
+static void *
+trie_subtries_block(TrieNode *node)
+{
+	if (node->flags & TRIE_NODE_EXTRAS)
+		return TRIE_EXTRAS(node);
+	return node->subtries;
+}
+
+/**
+ * Make room for nSubtries in the list of subtries of a node, keeping
+ * any header of extras in front of it.  Returns -1, leaving the list
+ * as it was, if there is no memory.
+ */
+int
+trie_grow_subtries(TrieNode *node, int nSubtries)
+{
+	size_t header = (node->flags & TRIE_NODE_EXTRAS) ? sizeof(TrieNodeExtras) : 0;
+	char *block;
+
+	block = (char *) realloc(node->subtries == NULL ? NULL : trie_subtries_block(node),
+			header + nSubtries * sizeof(TrieNode *));
+	if (block == NULL)
+		return -1;
+	node->subtries = (TrieNode **) (block + header);
+	return 0;
+}
+
+/**
+ * The extras of a node with subtries, putting a header in front of
+ * its list if it does not have one yet.  Returns NULL if there is no
+ * memory for it.
+ */
+TrieNodeExtras *
+trie_node_extras(TrieNode *node)
+{
+	TrieNodeExtras *extras;
+
+	if (node->flags & TRIE_NODE_EXTRAS)
+		return TRIE_EXTRAS(node);
+
+	extras = (TrieNodeExtras *) malloc(sizeof(TrieNodeExtras)
+			+ node->nSubtries * sizeof(TrieNode *));
+	if (extras == NULL)
+		return NULL;
+	memset(extras, 0, sizeof(TrieNodeExtras));
+	if (node->nSubtries > 0)
+		memcpy(extras + 1, node->subtries, node->nSubtries * sizeof(TrieNode *));
+	free(node->subtries);
+	node->subtries = (TrieNode **) (extras + 1);
+	node->flags |= TRIE_NODE_EXTRAS;
+	return extras;
+}
+
+/** free the list of subtries of a node, along with its extras */
+void
+trie_free_subtries(TrieNode *node)
+{
+	if (node->flags & TRIE_NODE_EXTRAS) {
+		free(TRIE_EXTRAS(node)->index);
+		trie_adaptive_delete(TRIE_EXTRAS(node)->adaptive);
+	}
+	if (node->subtries != NULL)
+		free(trie_subtries_block(node));
+	node->subtries = NULL;
+	node->flags &= ~TRIE_NODE_EXTRAS;
+}
+
+
 
 #define	INDENT	4
 
@@ -2,31 +2,292 @@
 #define	__TRIE_TOOLS_HEADER__
 
 #include <stdio.h>
+#include <pthread.h>
 
 #include <trie.h>
+#include "trie_trace.h"
 
-typedef char TrieLetter;
+typedef unsigned char TrieLetter;
+
+/**
+ * With adaptive ordering on, a node with at least
+ * TRIE_ADAPTIVE_MIN_FANOUT subtries is also given a second list of
+ * them, in the order lookups scan them, with a count of the lookups
+ * that went down each.  Every TRIE_ADAPTIVE_PERIOD lookups through the
+ * node the scan list is sorted, most used first, and the counts are
+ * halved so that the order follows a workload that shifts.  The
+ * subtries list itself is never reordered, so iteration (and
+ * everything built on it) still sees the keys in the order they were
+ * added.  Subtries are only ever appended, so a scan list that is
+ * short of the node's subtries just takes on the newer ones at its end.
+ */
+#define	TRIE_ADAPTIVE_MIN_FANOUT	4
+#define	TRIE_ADAPTIVE_PERIOD		64
+
+typedef struct TrieAdaptiveOrder {
+	struct TrieNode **scan;
+	unsigned *hits;			/* lookups down each of scan[] */
+	int nChildren;
+	int maxChildren;
+	unsigned nLookups;		/* since the last reordering */
+} TrieAdaptiveOrder;
 
 typedef struct TrieNode {
 	struct TrieNode **subtries;
 	TrieLetter letter;
+	unsigned char flags;		/* TRIE_NODE_EXTRAS */
 	int nSubtries;
 	int isKeySoHasValue;
 	void *value;
 } TrieNode;
 
+/**
+ * The dense index and adaptive scan order of a node, when it has
+ * either, are kept in a header just before its list of subtries, so
+ * that a node in a plain trie is no bigger than it ever was.  Only
+ * nodes with subtries ever need them, and TRIE_NODE_EXTRAS in the
+ * flags of the node says that the header is there.
+ */
+#define	TRIE_NODE_EXTRAS	0x01
+
+typedef struct TrieNodeExtras {
+	struct TrieNode **index;	/* subtries by letter code, dense tries only */
+	TrieAdaptiveOrder *adaptive;	/* scan order, adaptive tries only */
+	int nIndex;
+} TrieNodeExtras;
+
+#define	TRIE_EXTRAS(node)	(((TrieNodeExtras *) (node)->subtries) - 1)
+
 typedef struct KeyValueTrie {
 	struct TrieNode **subtries;
 	int nSubtries;
 	int maxKeyLength;
+	struct TrieNode **index;
+	int nIndex;
+	unsigned short *letterCode;	/* byte to dense code (0 if unused), or NULL */
+	int alphabetSize;
+	int ownsValues;			/* values are copied in by trieInsertValue() */
+	size_t inlineValueMax;
+	size_t nKeys;
+	int adaptiveOrder;		/* keep scan orders by lookup frequency */
+	TrieAdaptiveOrder *adaptive;	/* scan order of the top level subtries */
+
+	/** with adaptive ordering, the scans done by lookups and letters compared */
+	size_t nScans;
+	size_t nCompares;
 } KeyValueTrie;
 
+/**
+ * A trie that owns its values is made of value nodes, which add the
+ * length of the value to the node.  Each node that ends a key, as it
+ * is created, is also given room for inlineValueMax value bytes (plus
+ * a '\0') right after it.  A value that fits is copied there, so it
+ * shares the node's allocation and usually its cache line; anything
+ * longer, or a value for a node created before its key (a prefix of
+ * an earlier key), goes in a buffer of its own.
+ */
+typedef struct TrieValueNode {
+	TrieNode node;
+	size_t valueLength;
+	size_t inlineSize;		/* room in inlineValue, counting the '\0' */
+	unsigned char inlineValue[];
+} TrieValueNode;
+
+#define	TRIE_VALUE_NODE(node)	((TrieValueNode *) (node))
+
+/**
+ * In a dense trie every letter seen is given a small code, 1 up to
+ * alphabetSize, and a node with at least TRIE_DENSE_MIN_FANOUT
+ * subtries also keeps them in an index array with one slot per code.
+ * Stepping down a level is then a single indexed load rather than a
+ * scan of the subtrie list; nodes on a plain chain just compare their
+ * only letter.  The subtrie lists are kept as well, so iteration and
+ * everything built on it is unchanged.
+ */
+#define	TRIE_DENSE_MIN_FANOUT	2
+
+/**
+ * Aho-Corasick automaton built from the keys of a trie.  States are
+ * numbered breadth first, so the children of a state occupy the run
+ * [firstChild, firstChild + nChildren) and their letters are kept in
+ * the parallel letters array.  State 0 is the root.
+ */
+typedef struct TrieMatcherState {
+	int firstChild;
+	int nChildren;
+	int fail;
+	int output;
+	int depth;
+	int isKeySoHasValue;
+	void *value;
+} TrieMatcherState;
+
+struct TrieMatcher {
+	TrieMatcherState *states;
+	unsigned char *letters;
+	int nStates;
+	int rootNext[256];
+};
+
+/**
+ * Radix trie for 8-byte integer keys, one level per byte, most
+ * significant byte first.  A key that is alone below a slot is kept
+ * there as a leaf holding the whole key, so inner nodes exist only
+ * where keys branch, and each records the level of the byte it
+ * branches on (and the bytes above it that all its keys share), so
+ * chains of nodes with a single child are never built.  Inner nodes
+ * come in three sizes: up to 4 or up to 16 children, kept in byte
+ * order and scanned, and 256 directly indexed slots for the dense
+ * levels.  Nodes grow a size as they fill and shrink as keys go.
+ *
+ * A slot holds NULL, an inner node, or a leaf with its lowest
+ * pointer bit set.
+ */
+#define	U64TRIE_LEVELS	8
+#define	U64TRIE_FANOUT	256
+
+#define	U64TRIE_NODE4	0
+#define	U64TRIE_NODE16	1
+#define	U64TRIE_NODE256	2
+
+typedef struct U64TrieLeaf {
+	uint64_t key;
+	void *value;
+} U64TrieLeaf;
+
+typedef struct U64TrieNode {
+	unsigned char kind;
+	unsigned char level;	/* the key byte this node branches on */
+	unsigned short nChildren;
+	uint64_t prefix;		/* the key bytes above level; the rest are 0 */
+} U64TrieNode;
+
+typedef struct U64TrieNode4 {
+	U64TrieNode header;
+	unsigned char bytes[4];
+	void *children[4];
+} U64TrieNode4;
+
+typedef struct U64TrieNode16 {
+	U64TrieNode header;
+	unsigned char bytes[16];
+	void *children[16];
+} U64TrieNode16;
+
+typedef struct U64TrieNode256 {
+	U64TrieNode header;
+	void *children[U64TRIE_FANOUT];
+} U64TrieNode256;
+
+#define	U64TRIE_IS_LEAF(slot)	(((uintptr_t) (slot)) & 1)
+#define	U64TRIE_LEAF(slot)		((U64TrieLeaf *) (((uintptr_t) (slot)) & ~(uintptr_t) 1))
+#define	U64TRIE_TAG_LEAF(leaf)	((void *) (((uintptr_t) (leaf)) | 1))
+
+struct U64Trie {
+	void *root;
+	size_t nEntries;
+};
+
+/**
+ * Resumable walk over the keys of a trie, in the same order as
+ * trieIterateAction().  The path from the root to the current node
+ * is kept, along with the index of the next subtrie to visit at
+ * each depth (next[0] is for the root itself).
+ */
+struct TrieCursor {
+	KeyValueTrie *trie;
+	TrieNode **path;
+	int *next;
+	AAKeyType keybuffer;
+	int depth;
+	int maxDepth;
+};
+
+/**
+ * Blocked Bloom filter over the keys of a trie.  Each key hashes to
+ * one 64 byte block (a single cache line) and sets nHashes bits within
+ * it, so ruling a key out touches one line however long the key is.
+ * Deleting keys cannot clear bits, so deletes are only counted; once
+ * they (or inserts beyond the planned size) have worn the filter down
+ * it is rebuilt from the keys left in the trie.
+ */
+#define	TRIE_FILTER_BLOCK_WORDS	8	/* 512 bits */
+
+struct TrieFilter {
+	uint64_t *blocks;
+	size_t nBlocks;
+	int nHashes;
+	double falsePositiveRate;
+	size_t plannedKeys;
+	size_t nKeys;			/* added since the last rebuild */
+	size_t nDeleted;		/* deleted since the last rebuild */
+
+	/** statistics */
+	size_t nChecked;
+	size_t nRejected;
+	size_t nRebuilds;
+};
+
+/**
+ * Front cache of recently found string keys and their values, so
+ * that a hot key costs one hash and a look at one bucket rather than
+ * a walk down the trie.  Each key hashes to a bucket of
+ * TRIE_CACHE_WAYS entries, which are replaced in CLOCK order: an
+ * entry is marked when it is hit, and the hand passes over (and
+ * unmarks) marked entries in search of an unmarked one to evict.  A
+ * newly admitted key starts unmarked, so a key seen only once is the
+ * first to go rather than pushing out one that is in steady use.
+ * Keys longer than TRIE_CACHE_KEY_MAX bytes are never cached.
+ */
+#define	TRIE_CACHE_WAYS		4
+#define	TRIE_CACHE_KEY_MAX	32
+
+typedef struct TrieCacheEntry {
+	uint64_t hash;
+	void *value;
+	size_t valueLength;
+	unsigned char key[TRIE_CACHE_KEY_MAX];
+	unsigned char keylength;
+	unsigned char inUse;
+	unsigned char referenced;
+} TrieCacheEntry;
+
+struct TrieCache {
+	TrieCacheEntry *entries;	/* nBuckets * TRIE_CACHE_WAYS */
+	unsigned char *hands;		/* the CLOCK hand of each bucket */
+	size_t nBuckets;			/* a power of two */
+
+	/** statistics */
+	size_t nHits;
+	size_t nMisses;
+	size_t nAdmitted;
+	size_t nEvicted;
+	size_t nInvalidated;
+};
+
+/**
+ * Operation counts for one thread's use of one array.  Each thread
+ * finds its own block through a small thread local table keyed by the
+ * array's serial number (serials are never reused, so a freed array
+ * cannot be mistaken for a new one at the same address), and only
+ * takes the array's lock the first time it is seen.
+ */
+#define	AA_STATS_THREAD_SLOTS	4
+
+typedef struct AAThreadStats {
+	AAOperationStats operations[AA_N_OPERATIONS];
+	pthread_t owner;
+	struct AAThreadStats *next;
+} AAThreadStats;
+
 struct AssociativeArray {
 	KeyValueTrie *trie;
-	int nEntries;
-	int searchCost;
-	int insertCost;
-	int deleteCost;
+	U64Trie *intTrie;
+	TrieFilter *filter;		/* string keys only, or NULL */
+	TrieCache *cache;		/* string keys only, or NULL */
+	unsigned long serial;
+	pthread_mutex_t statsLock;
+	AAThreadStats *threadStats;
 };
 
 
@@ -36,9 +297,39 @@ struct AssociativeArray {
 
 /** creation and deletion */
 TrieNode * trieCreateNode();
+TrieNode * trie_create_value_node(size_t inlineSize);
 void trieDeleteNode(TrieNode *node);
+void trie_release_value(TrieNode *node);
+
+/** lists of subtries, and the header of extras in front of them */
+int trie_grow_subtries(TrieNode *node, int nSubtries);
+TrieNodeExtras *trie_node_extras(TrieNode *node);
+void trie_free_subtries(TrieNode *node);
 
 /** utilities */
 int trie_subtreeSearchComparator(const void *keyValue, const void *nodePtr);
 
+/** statistics */
+void aa_stats_init(AssociativeArray *aarray);
+void aa_stats_free(AssociativeArray *aarray);
+void aa_stats_count(AssociativeArray *aarray, AAOperation operation, int visits);
+
+/** adaptive child ordering */
+TrieNode *trie_adaptive_subtrie(KeyValueTrie *trie, TrieAdaptiveOrder **order,
+		TrieNode **subtries, int nSubtries, TrieLetter letter);
+void trie_adaptive_delete(TrieAdaptiveOrder *order);
+
+/** key hashing, shared by the filter and the cache */
+uint64_t trie_key_hash(AAKeyType key, size_t keylength);
+
+/** dense alphabet support */
+int trie_dense_update(KeyValueTrie *trie, TrieNode ***index, int *nIndex,
+		TrieNode **subtries, int nSubtries);
+int trie_dense_update_node(KeyValueTrie *trie, TrieNode *node);
+TrieNode *trie_dense_subtrie(KeyValueTrie *trie, TrieNode **index, int nIndex,
+		TrieNode **subtries, int nSubtries, TrieLetter letter);
+TrieNode *trie_dense_node_subtrie(KeyValueTrie *trie, TrieNode *node,
+		TrieLetter letter);
+TrieNode *trie_dense_find(KeyValueTrie *trie, AAKeyType key, size_t keylength, int *cost);
+
 #endif
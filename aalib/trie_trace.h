@@ -0,0 +1,49 @@
+#ifndef	__TRIE_TRACE_HEADER__
+#define	__TRIE_TRACE_HEADER__
+
+/**
+ * Tracepoints on the hot paths of the (string keyed) trie, so that a
+ * tracer can be attached to a running program to find the keys that
+ * make it slow.  Keys are passed as a pointer and a length, as they
+ * need not be terminated.
+ *
+ *   node_alloc      (node, bytes)          a node was allocated
+ *   children_grow   (list, nChildren)      a subtrie list was grown
+ *   index_grow      (index, nIndex)        a dense letter index was grown
+ *   insert_entry    (key, keylength)
+ *   insert_return   (key, keylength, status)
+ *   lookup_entry    (key, keylength)
+ *   lookup_return   (key, keylength, found)
+ *   delete_entry    (key, keylength)
+ *   delete_return   (key, keylength, value)
+ *   iterate_entry   (trie)
+ *   iterate_key     (key, keylength, value)
+ *   iterate_return  (trie, nKeys)
+ *
+ * Compiled with TRIE_TRACE defined (see the makefile) these become
+ * USDT probes of the provider "aatrie", from <sys/sdt.h>; each is a
+ * single nop until a tracer enables it, for example
+ *
+ *   bpftrace -e 'usdt:./a4trie:aatrie:lookup_return /arg2 == 0/
+ *           { printf("%s\n", str(arg0, arg1)); }'
+ *
+ * Otherwise they compile to nothing, and their arguments are never
+ * evaluated.
+ */
+#ifdef	TRIE_TRACE
+
+#include <sys/sdt.h>
+
+#define	TRIE_TRACE1(probe, a)		DTRACE_PROBE1(aatrie, probe, a)
+#define	TRIE_TRACE2(probe, a, b)	DTRACE_PROBE2(aatrie, probe, a, b)
+#define	TRIE_TRACE3(probe, a, b, c)	DTRACE_PROBE3(aatrie, probe, a, b, c)
+
+#else	/* TRIE_TRACE */
+
+#define	TRIE_TRACE1(probe, a)		do { } while (0)
+#define	TRIE_TRACE2(probe, a, b)	do { } while (0)
+#define	TRIE_TRACE3(probe, a, b, c)	do { } while (0)
+
+#endif	/* TRIE_TRACE */
+
+#endif	/* __TRIE_TRACE_HEADER__ */
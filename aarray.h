@@ -2,6 +2,11 @@
 #define	__ASSOCIATIVE_ARRAY_TOOLS_HEADER__
 
 #include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef unsigned char *AAKeyType;
 typedef size_t AAIndexType;
@@ -22,13 +27,148 @@ void aaDeleteAssociativeArray(AssociativeArray *array);
 
 int aaIterateAction(AssociativeArray *array, int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata), void *userdata);
 
+/**
+ * Index the children of each trie node by letter code rather than
+ * scanning them.  Letters not given (or all of them, if letters is
+ * NULL) are learned as keys are added.
+ */
+int aaSetAlphabet(AssociativeArray *array, const char *letters);
+
+/**
+ * Have the array keep its own copy of each (string keyed) value,
+ * with values of up to maxInline bytes stored inside the trie node
+ * rather than in an allocation of their own.  This must be set
+ * before any keys are added, after which values are given to
+ * aaInsertValue() and aaDeleteValue() frees them (or hands them
+ * back to be freed by the caller); aaInsert() is refused.  Lookups
+ * return a view onto the stored bytes, which are always followed by
+ * a '\0'.
+ */
+typedef struct AAValueView {
+	const void *data;
+	size_t length;
+} AAValueView;
+
+int aaSetValueBytes(AssociativeArray *array, size_t maxInline);
+int aaInsertValue(AssociativeArray *array, AAKeyType key, size_t keylength,
+		const void *value, size_t valuelength);
+int aaLookupView(AssociativeArray *array, AAKeyType key, size_t keylength,
+		AAValueView *view);
+int aaDeleteValue(AssociativeArray *array, AAKeyType key, size_t keylength,
+		void **value, size_t *valuelength);
+
 /** the interface to do the critical work: insert, delete and lookup */
 int aaInsert(AssociativeArray *array, AAKeyType key, size_t keylength,void *value);
 void *aaLookup(AssociativeArray *array, AAKeyType key, size_t keylength);
 void *aaDelete(AssociativeArray *array, AAKeyType key, size_t keylength);
 
+/**
+ * Have string key lookups scan the children of each trie node in
+ * order of how often they are taken, reordering as they go, so that
+ * a skewed workload finds its hot keys sooner.  The order in which
+ * keys are iterated is unchanged.
+ */
+int aaSetAdaptiveOrder(AssociativeArray *array, int enable);
+
+/**
+ * Keep an approximate membership filter (a blocked Bloom filter) of
+ * the string keys, with the given false positive rate (0 for none).
+ * Lookups and deletes of keys it rules out never reach the trie.
+ */
+int aaSetFilter(AssociativeArray *array, double falsePositiveRate);
+
+/**
+ * Keep a fixed size cache (of at least nEntries) of the string keys
+ * most recently found, in front of the trie, so that looking up the
+ * same keys again and again costs one hash probe each.  Inserts and
+ * deletes keep it current.  A size of 0 removes the cache.
+ */
+int aaSetCache(AssociativeArray *array, size_t nEntries);
+
+/** look up many keys at once; values[i] is NULL for absent keys */
+#define	AA_LOOKUP_BATCH_MAX	64
+int aaLookupBatch(AssociativeArray *array, AAKeyType *keys, size_t *keylengths,
+		void **values, int nKeys);
+
+/**
+ * Fixed width integer keys.  These live apart from the byte string
+ * keys and are iterated (after them) in numeric order, each handed
+ * to the iterator as 8 bytes, most significant first.  Signed keys
+ * have their sign bit flipped so that negative numbers sort first.
+ */
+#define	AA_I64_KEY(v)	((uint64_t) (v) ^ 0x8000000000000000ULL)
+
+int aaInsertU64(AssociativeArray *array, uint64_t key, void *value);
+void *aaLookupU64(AssociativeArray *array, uint64_t key);
+void *aaDeleteU64(AssociativeArray *array, uint64_t key);
+int aaInsertI64(AssociativeArray *array, int64_t key, void *value);
+void *aaLookupI64(AssociativeArray *array, int64_t key);
+void *aaDeleteI64(AssociativeArray *array, int64_t key);
+
+/** call the user function on each key matching a glob pattern */
+int aaPatternSearch(AssociativeArray *array, const char *pattern, int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata), void *userdata);
+
+/**
+ * A glob pattern compiled once, to check many keys held outside the
+ * array.  aaCompilePattern() returns NULL if the pattern cannot be
+ * parsed, and aaPatternMatch() returns 1 on a match.  aaPatternPrefix()
+ * gives the literal letters every match must start with.
+ */
+typedef struct TriePattern AAPattern;
+
+AAPattern *aaCompilePattern(const char *pattern);
+void aaDeletePattern(AAPattern *pattern);
+int aaPatternMatch(AAPattern *pattern, AAKeyType key, size_t keylength);
+size_t aaPatternPrefix(AAPattern *pattern, AAKeyType buffer, size_t maxLength);
+
+/**
+ * Statistics on the array.  The operation counts are kept per thread
+ * and added up by aaGetStats(); the shape of the tries (depths,
+ * fanouts, nodes and bytes) is measured by walking them when asked.
+ * A histogram's last bucket also counts everything beyond it.
+ */
+#define	AA_STATS_VISIT_BUCKETS	64	/* nodes visited by one operation */
+#define	AA_STATS_DEPTH_BUCKETS	64	/* depth at which a key ends */
+#define	AA_STATS_FANOUT_BUCKETS	257	/* children of a node, 0 to 256 */
+
+typedef enum AAOperation {
+	AA_OP_INSERT = 0,
+	AA_OP_LOOKUP,
+	AA_OP_DELETE,
+	AA_OP_PATTERN,
+	AA_N_OPERATIONS
+} AAOperation;
+
+typedef struct AAOperationStats {
+	uint64_t count;
+	uint64_t nodeVisits;
+	uint64_t visitHistogram[AA_STATS_VISIT_BUCKETS];
+} AAOperationStats;
+
+typedef struct AAStats {
+	uint64_t nEntries;
+	uint64_t nStringKeys;
+	uint64_t nIntegerKeys;
+	AAOperationStats operations[AA_N_OPERATIONS];
+	uint64_t nNodes;
+	uint64_t depthHistogram[AA_STATS_DEPTH_BUCKETS];
+	uint64_t fanoutHistogram[AA_STATS_FANOUT_BUCKETS];
+	uint64_t bytesAllocated;
+	double bytesPerKey;
+} AAStats;
+
+int aaGetStats(AssociativeArray *array, AAStats *stats);
+const char *aaOperationName(AAOperation operation);
+
 /** print out the data, prefixing each line with the lineLeader */
 void aaPrintContents(FILE *fp, AssociativeArray *array, char *lineLeader);
+
+/** print the statistics, as text or as a single JSON object */
 void aaPrintSummary(FILE *fp, AssociativeArray *array);
+void aaPrintSummaryJSON(FILE *fp, AssociativeArray *array);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,558 @@
+#ifndef	__AA_TRIE_CPP_HEADER__
+#define	__AA_TRIE_CPP_HEADER__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "trie.h"
+
+/**
+ * Header only, typed C++ (17) interface over the trie library.
+ *
+ * aa::Trie<V> takes std::string_view keys and owns its values.  A
+ * value no bigger than a pointer is built directly in the void *
+ * slot that the trie node already has, so storing it costs nothing
+ * beyond the nodes themselves; larger values are built in chunks
+ * taken from a pool owned by the Trie, so there is no heap allocation
+ * per entry either way.  Values are moved in and destroyed when they
+ * are erased or when the Trie goes away.
+ *
+ * aa::Map<K, V> adds typed keys on top, through aa::KeyCodec<K>.
+ *
+ * Const member functions do not write to the Trie, so a const Trie
+ * may be read from several threads at once.  The nodes visited are
+ * added up in cost() by the non-const operations only; a const
+ * lookup hands its cost back through an explicit argument instead.
+ */
+namespace aa {
+
+namespace detail {
+
+/** values that can live in the trie node's own value slot */
+template <typename V>
+inline constexpr bool fitsInSlot = sizeof(V) <= sizeof(void *)
+		&& alignof(V) <= alignof(void *);
+
+/**
+ * Chunked storage for values too big for a slot.  Chunks double in
+ * size up to a limit and are never moved, so a value keeps its
+ * address for as long as it is stored; freed places are reused.
+ */
+template <typename V>
+class ValuePool {
+public:
+	ValuePool() = default;
+	ValuePool(ValuePool &&other) noexcept { *this = std::move(other); }
+	ValuePool &operator=(ValuePool &&other) noexcept
+	{
+		chunks_ = std::move(other.chunks_);
+		free_ = std::move(other.free_);
+		chunkSize_ = std::exchange(other.chunkSize_, 0);
+		used_ = std::exchange(other.used_, 0);
+		other.chunks_.clear();
+		other.free_.clear();
+		return *this;
+	}
+	ValuePool(const ValuePool &) = delete;
+	ValuePool &operator=(const ValuePool &) = delete;
+
+	void *allocate()
+	{
+		if ( ! free_.empty()) {
+			void *place = free_.back();
+			free_.pop_back();
+			return place;
+		}
+		if (used_ == chunkSize_) {
+			size_t size = chunks_.empty() ? FIRST_CHUNK
+					: std::min(chunkSize_ * 2, LAST_CHUNK);
+			chunks_.emplace_back(new Storage[size]);
+			chunkSize_ = size;
+			used_ = 0;
+		}
+		return &chunks_.back()[used_++];
+	}
+
+	void release(void *place) { free_.push_back(place); }
+
+private:
+	static constexpr size_t FIRST_CHUNK = 16;
+	static constexpr size_t LAST_CHUNK = 4096;
+
+	struct alignas(V) Storage {
+		unsigned char bytes[sizeof(V)];
+	};
+
+	std::vector<std::unique_ptr<Storage[]>> chunks_;
+	std::vector<void *> free_;
+	size_t chunkSize_ = 0;
+	size_t used_ = 0;
+};
+
+inline AAKeyType keyBytes(std::string_view key)
+{
+	return (AAKeyType) const_cast<char *>(key.data());
+}
+
+} // namespace detail
+
+
+/** what an iterator hands back: the key and a reference to the value */
+template <typename K, typename Ref>
+struct Entry {
+	K key;
+	Ref &value;
+};
+
+
+template <typename V>
+class Trie {
+	static constexpr bool inSlot = detail::fitsInSlot<V>;
+
+	template <bool Const>
+	class Iterator {
+		using Ref = std::conditional_t<Const, const V, V>;
+		using Owner = std::conditional_t<Const, const Trie, Trie>;
+
+	public:
+		/**
+		 * A single pass over the trie: copies of an iterator share
+		 * one cursor, so only one of them may be advanced.
+		 */
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Entry<std::string_view, Ref>;
+		using difference_type = std::ptrdiff_t;
+		using reference = value_type;
+
+		struct pointer {
+			value_type entry;
+			const value_type *operator->() const { return &entry; }
+		};
+
+		Iterator() = default;
+
+		/** the key view is only good until the iterator moves on */
+		reference operator*() const
+		{
+			return { std::string_view((const char *) key_, keylength_),
+					*Trie::valueAt(slot_) };
+		}
+		pointer operator->() const { return { **this }; }
+
+		Iterator &operator++() { advance(); return *this; }
+		void operator++(int) { advance(); }
+
+		bool operator==(const Iterator &other) const { return slot_ == other.slot_; }
+		bool operator!=(const Iterator &other) const { return slot_ != other.slot_; }
+
+	private:
+		friend class Trie;
+
+		explicit Iterator(Owner *owner)
+		{
+			if (owner->trie_ == nullptr || owner->size_ == 0)
+				return;
+			TrieCursor *cursor = trieCreateCursor(owner->trie_);
+			if (cursor == nullptr)
+				throw std::bad_alloc();
+			cursor_.reset(cursor, trieDeleteCursor);
+			advance();
+		}
+
+		void advance()
+		{
+			if ( ! trieCursorNext(cursor_.get(), &key_, &keylength_, &slot_)) {
+				slot_ = nullptr;
+				cursor_.reset();
+			}
+		}
+
+		std::shared_ptr<TrieCursor> cursor_;
+		AAKeyType key_ = nullptr;
+		size_t keylength_ = 0;
+		void **slot_ = nullptr;
+	};
+
+public:
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	Trie() = default;
+	~Trie() { reset(); }
+
+	Trie(Trie &&other) noexcept
+		: trie_(std::exchange(other.trie_, nullptr)),
+		  pool_(std::move(other.pool_)),
+		  size_(std::exchange(other.size_, 0)) {}
+
+	Trie &operator=(Trie &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			trie_ = std::exchange(other.trie_, nullptr);
+			pool_ = std::move(other.pool_);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+	Trie(const Trie &) = delete;
+	Trie &operator=(const Trie &) = delete;
+
+	/**
+	 * Index children by letter (see trieSetAlphabet()); letters not
+	 * listed are learned from the keys.  Returns false if the
+	 * alphabet was already set.
+	 */
+	bool setAlphabet(std::string_view letters = {})
+	{
+		return trieSetAlphabet(handle(),
+				(const unsigned char *) letters.data(), letters.size()) == 0;
+	}
+
+	/**
+	 * Build a value for the key from the arguments, unless the key is
+	 * already present.  Returns the stored value and whether it is new.
+	 */
+	template <typename... Args>
+	std::pair<V *, bool> try_emplace(std::string_view key, Args &&... args)
+	{
+		int isNew, cost = 0;
+		void **slot;
+
+		if (key.empty())
+			throw std::invalid_argument("aa::Trie keys must not be empty");
+
+		slot = trieInsertSlot(handle(), detail::keyBytes(key), key.size(),
+				&isNew, &cost);
+		cost_ += (uint64_t) cost;
+		if (slot == nullptr)
+			throw std::bad_alloc();
+		if ( ! isNew)
+			return { valueAt(slot), false };
+
+		try {
+			construct(slot, std::forward<Args>(args)...);
+		} catch (...) {
+			trieDeleteKey(trie_, detail::keyBytes(key), key.size(), &cost);
+			throw;
+		}
+		size_++;
+		return { valueAt(slot), true };
+	}
+
+	/** store the value, replacing (by move assignment) any already there */
+	template <typename M>
+	std::pair<V *, bool> insert_or_assign(std::string_view key, M &&value)
+	{
+		std::pair<V *, bool> result = try_emplace(key, std::forward<M>(value));
+
+		if ( ! result.second)
+			*result.first = std::forward<M>(value);
+		return result;
+	}
+
+	V &operator[](std::string_view key) { return *try_emplace(key).first; }
+
+	V *find(std::string_view key) { return valueAt(countedLookup(key)); }
+	const V *find(std::string_view key) const { return valueAt(lookup(key, nullptr)); }
+	bool contains(std::string_view key) const { return lookup(key, nullptr) != nullptr; }
+
+	/** a const lookup that adds the nodes it visits to cost */
+	const V *find(std::string_view key, uint64_t &cost) const
+	{
+		int visits = 0;
+		const V *value = valueAt(lookup(key, &visits));
+
+		cost += (uint64_t) visits;
+		return value;
+	}
+
+	V &at(std::string_view key) { return checked(find(key)); }
+	const V &at(std::string_view key) const { return checked(find(key)); }
+
+	/** remove the key, destroying its value; false if it was not there */
+	bool erase(std::string_view key)
+	{
+		void **slot = countedLookup(key);
+		int cost = 0;
+
+		if (slot == nullptr)
+			return false;
+		destroy(slot);
+		trieDeleteKey(trie_, detail::keyBytes(key), key.size(), &cost);
+		cost_ += (uint64_t) cost;
+		size_--;
+		return true;
+	}
+
+	void clear() { reset(); }
+
+	size_t size() const noexcept { return size_; }
+	bool empty() const noexcept { return size_ == 0; }
+
+	/** the cost counted by the trie library over the non-const operations */
+	uint64_t cost() const noexcept { return cost_; }
+
+	iterator begin() { return iterator(this); }
+	iterator end() { return iterator(); }
+	const_iterator begin() const { return const_iterator(this); }
+	const_iterator end() const { return const_iterator(); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+private:
+	KeyValueTrie *handle()
+	{
+		if (trie_ == nullptr) {
+			trie_ = trieCreateTrie();
+			if (trie_ == nullptr)
+				throw std::bad_alloc();
+		}
+		return trie_;
+	}
+
+	void **lookup(std::string_view key, int *cost) const
+	{
+		if (trie_ == nullptr || key.empty())
+			return nullptr;
+		return trieLookupSlot(trie_, detail::keyBytes(key), key.size(), cost);
+	}
+
+	/** a lookup on behalf of a non-const operation, counted in cost_ */
+	void **countedLookup(std::string_view key)
+	{
+		int cost = 0;
+		void **slot = lookup(key, &cost);
+
+		cost_ += (uint64_t) cost;
+		return slot;
+	}
+
+	static V *valueAt(void **slot)
+	{
+		if (slot == nullptr)
+			return nullptr;
+		if constexpr (inSlot)
+			return std::launder(reinterpret_cast<V *>(slot));
+		else
+			return static_cast<V *>(*slot);
+	}
+
+	template <typename T>
+	static T &checked(T *value)
+	{
+		if (value == nullptr)
+			throw std::out_of_range("aa::Trie key not found");
+		return *value;
+	}
+
+	template <typename... Args>
+	void construct(void **slot, Args &&... args)
+	{
+		if constexpr (inSlot) {
+			::new ((void *) slot) V(std::forward<Args>(args)...);
+		} else {
+			void *place = pool_.allocate();
+			try {
+				::new (place) V(std::forward<Args>(args)...);
+			} catch (...) {
+				pool_.release(place);
+				throw;
+			}
+			*slot = place;
+		}
+	}
+
+	void destroy(void **slot)
+	{
+		V *value = valueAt(slot);
+
+		value->~V();
+		if constexpr ( ! inSlot)
+			pool_.release(value);
+		*slot = nullptr;
+	}
+
+	/** destroy every value, then the trie itself */
+	void reset()
+	{
+		if (trie_ == nullptr)
+			return;
+
+		if constexpr ( ! std::is_trivially_destructible<V>::value) {
+			TrieCursor *cursor = trieCreateCursor(trie_);
+			void **slot;
+
+			while (cursor != nullptr && trieCursorNext(cursor, nullptr, nullptr, &slot))
+				valueAt(slot)->~V();
+			trieDeleteCursor(cursor);
+		}
+
+		trieDeleteTrie(trie_);
+		trie_ = nullptr;
+		pool_ = detail::ValuePool<V>();
+		size_ = 0;
+	}
+
+	KeyValueTrie *trie_ = nullptr;
+	detail::ValuePool<V> pool_;
+	size_t size_ = 0;
+	uint64_t cost_ = 0;
+};
+
+
+/**
+ * How a Map turns its keys into trie keys and back.  Integers are
+ * stored as their bytes, most significant first, with the sign bit of
+ * signed types flipped (as AA_I64_KEY() does) so that equal width keys
+ * compare in numeric order byte by byte.
+ */
+template <typename K, typename Enable = void>
+struct KeyCodec;
+
+template <>
+struct KeyCodec<std::string_view> {
+	static std::string_view encode(std::string_view key, char *) { return key; }
+	static std::string_view decode(std::string_view bytes) { return bytes; }
+};
+
+template <>
+struct KeyCodec<std::string> {
+	static std::string_view encode(const std::string &key, char *) { return key; }
+	static std::string decode(std::string_view bytes) { return std::string(bytes); }
+};
+
+template <typename K>
+struct KeyCodec<K, std::enable_if_t<std::is_integral<K>::value>> {
+	using Bits = std::make_unsigned_t<K>;
+	static constexpr Bits FLIP = std::is_signed<K>::value
+			? (Bits) ((Bits) 1 << (8 * sizeof(K) - 1)) : 0;
+
+	static std::string_view encode(K key, char *scratch)
+	{
+		Bits bits = (Bits) key ^ FLIP;
+
+		for (size_t i = sizeof(K); i > 0; i--) {
+			scratch[i - 1] = (char) (bits & 0xff);
+			bits = (Bits) (bits >> 8);
+		}
+		return std::string_view(scratch, sizeof(K));
+	}
+
+	static K decode(std::string_view bytes)
+	{
+		Bits bits = 0;
+
+		for (size_t i = 0; i < sizeof(K); i++)
+			bits = (Bits) ((bits << 8) | (unsigned char) bytes[i]);
+		return (K) (Bits) (bits ^ FLIP);
+	}
+};
+
+
+template <typename K, typename V, typename Codec = KeyCodec<K>>
+class Map {
+	template <typename BaseIterator, typename Ref>
+	class Iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Entry<K, Ref>;
+		using difference_type = std::ptrdiff_t;
+		using reference = value_type;
+
+		struct pointer {
+			value_type entry;
+			const value_type *operator->() const { return &entry; }
+		};
+
+		Iterator() = default;
+		explicit Iterator(BaseIterator base) : base_(std::move(base)) {}
+
+		reference operator*() const
+		{
+			auto entry = *base_;
+			return { Codec::decode(entry.key), entry.value };
+		}
+		pointer operator->() const { return { **this }; }
+
+		Iterator &operator++() { ++base_; return *this; }
+		void operator++(int) { ++base_; }
+
+		bool operator==(const Iterator &other) const { return base_ == other.base_; }
+		bool operator!=(const Iterator &other) const { return base_ != other.base_; }
+
+	private:
+		BaseIterator base_;
+	};
+
+	/** room for the encoded form of any fixed width key */
+	struct Scratch {
+		char bytes[16];
+	};
+
+public:
+	using key_type = K;
+	using mapped_type = V;
+	using iterator = Iterator<typename Trie<V>::iterator, V>;
+	using const_iterator = Iterator<typename Trie<V>::const_iterator, const V>;
+
+	bool setAlphabet(std::string_view letters = {}) { return trie_.setAlphabet(letters); }
+
+	template <typename... Args>
+	std::pair<V *, bool> try_emplace(const K &key, Args &&... args)
+	{
+		Scratch scratch;
+		return trie_.try_emplace(Codec::encode(key, scratch.bytes),
+				std::forward<Args>(args)...);
+	}
+
+	template <typename M>
+	std::pair<V *, bool> insert_or_assign(const K &key, M &&value)
+	{
+		Scratch scratch;
+		return trie_.insert_or_assign(Codec::encode(key, scratch.bytes),
+				std::forward<M>(value));
+	}
+
+	V &operator[](const K &key) { return *try_emplace(key).first; }
+
+	V *find(const K &key) { Scratch s; return trie_.find(Codec::encode(key, s.bytes)); }
+	const V *find(const K &key) const { Scratch s; return trie_.find(Codec::encode(key, s.bytes)); }
+	const V *find(const K &key, uint64_t &cost) const
+	{
+		Scratch s;
+		return trie_.find(Codec::encode(key, s.bytes), cost);
+	}
+	bool contains(const K &key) const { return find(key) != nullptr; }
+	V &at(const K &key) { Scratch s; return trie_.at(Codec::encode(key, s.bytes)); }
+	const V &at(const K &key) const { Scratch s; return trie_.at(Codec::encode(key, s.bytes)); }
+	bool erase(const K &key) { Scratch s; return trie_.erase(Codec::encode(key, s.bytes)); }
+
+	void clear() { trie_.clear(); }
+	size_t size() const noexcept { return trie_.size(); }
+	uint64_t cost() const noexcept { return trie_.cost(); }
+	bool empty() const noexcept { return trie_.empty(); }
+
+	iterator begin() { return iterator(trie_.begin()); }
+	iterator end() { return iterator(trie_.end()); }
+	const_iterator begin() const { return const_iterator(trie_.begin()); }
+	const_iterator end() const { return const_iterator(trie_.end()); }
+
+private:
+	Trie<V> trie_;
+};
+
+} // namespace aa
+
+#endif /* __AA_TRIE_CPP_HEADER__ */
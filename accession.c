@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "aarray.h"
+#include "u64table.h"
+#include "accession.h"
+
+/**
+ * Sizes of each part of the grammar.  A letter from [A-Z0-9] is
+ * coded with digits before letters, as in ASCII, so within a form
+ * codes sort in the same order as the accessions.
+ */
+#define	N_ALNUM		36
+#define	N_ALPHA		26
+#define	N_DIGIT		10
+#define	N_OPQ		3
+#define	N_FIRST		23	/* [A-NR-Z] */
+
+#define	N_FORM_OPQ	((uint64_t) N_OPQ * N_DIGIT * N_ALNUM * N_ALNUM * N_ALNUM * N_DIGIT)
+#define	N_BLOCK		((uint64_t) N_ALPHA * N_ALNUM * N_ALNUM * N_DIGIT)
+#define	N_FORM_SHORT	((uint64_t) N_FIRST * N_DIGIT * N_BLOCK)
+
+/** where the codes of each form begin */
+#define	BASE_OPQ	((uint64_t) 0)
+#define	BASE_SHORT	(BASE_OPQ + N_FORM_OPQ)
+#define	BASE_LONG	(BASE_SHORT + N_FORM_SHORT)
+#define	BASE_END	(BASE_LONG + N_FORM_SHORT * N_BLOCK)
+
+
+static int
+codeDigit(char c)
+{
+	return (c >= '0' && c <= '9') ? c - '0' : -1;
+}
+
+static int
+codeAlpha(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' : -1;
+}
+
+static int
+codeAlnum(char c)
+{
+	if (c >= '0' && c <= '9')	return c - '0';
+	if (c >= 'A' && c <= 'Z')	return N_DIGIT + c - 'A';
+	return -1;
+}
+
+static int
+codeFirst(char c)
+{
+	if (c >= 'A' && c <= 'N')	return c - 'A';
+	if (c >= 'R' && c <= 'Z')	return 14 + c - 'R';
+	return -1;
+}
+
+/** code one [A-Z][A-Z0-9]{2}[0-9] block, or -1 */
+static int64_t
+encodeBlock(const char *s)
+{
+	int a = codeAlpha(s[0]), b = codeAlnum(s[1]);
+	int c = codeAlnum(s[2]), d = codeDigit(s[3]);
+
+	if (a < 0 || b < 0 || c < 0 || d < 0)
+		return -1;
+	return ((a * N_ALNUM + b) * N_ALNUM + c) * N_DIGIT + d;
+}
+
+/**
+ * Return the code for a valid accession, or -1 if the string does
+ * not follow the accession grammar
+ */
+int64_t
+accessionEncode(const char *accession)
+{
+	size_t length = strlen(accession);
+	int first, digit, a, b, c, d;
+	int64_t block, second;
+
+	if (length != 6 && length != 10)
+		return -1;
+
+	if (length == 6 && (first = (accession[0] == 'O') ? 0
+				: (accession[0] == 'P') ? 1
+				: (accession[0] == 'Q') ? 2 : -1) >= 0) {
+		digit = codeDigit(accession[1]);
+		a = codeAlnum(accession[2]);
+		b = codeAlnum(accession[3]);
+		c = codeAlnum(accession[4]);
+		d = codeDigit(accession[5]);
+		if (digit < 0 || a < 0 || b < 0 || c < 0 || d < 0)
+			return -1;
+		return BASE_OPQ + ((((((uint64_t) first * N_DIGIT + digit)
+				* N_ALNUM + a) * N_ALNUM + b) * N_ALNUM + c) * N_DIGIT + d);
+	}
+
+	first = codeFirst(accession[0]);
+	digit = codeDigit(accession[1]);
+	block = encodeBlock(&accession[2]);
+	if (first < 0 || digit < 0 || block < 0)
+		return -1;
+	block += ((uint64_t) first * N_DIGIT + digit) * N_BLOCK;
+
+	if (length == 6)
+		return BASE_SHORT + block;
+
+	second = encodeBlock(&accession[6]);
+	if (second < 0)
+		return -1;
+	return BASE_LONG + block * N_BLOCK + second;
+}
+
+static char
+decodeAlnum(int code)
+{
+	return (code < N_DIGIT) ? (char) ('0' + code) : (char) ('A' + code - N_DIGIT);
+}
+
+/** write a block back out from its code */
+static void
+decodeBlock(uint64_t code, char *s)
+{
+	s[3] = (char) ('0' + code % N_DIGIT);	code /= N_DIGIT;
+	s[2] = decodeAlnum(code % N_ALNUM);	code /= N_ALNUM;
+	s[1] = decodeAlnum(code % N_ALNUM);	code /= N_ALNUM;
+	s[0] = (char) ('A' + code);
+}
+
+/**
+ * Write the accession for the code into the buffer (which must hold
+ * ACCESSION_MAX_LEN + 1 bytes).  Returns its length, or -1 if the
+ * code is out of range.
+ */
+int
+accessionDecode(uint64_t code, char *buffer)
+{
+	uint64_t block;
+	int first;
+
+	if (code < BASE_SHORT) {
+		code -= BASE_OPQ;
+		buffer[5] = (char) ('0' + code % N_DIGIT);	code /= N_DIGIT;
+		buffer[4] = decodeAlnum(code % N_ALNUM);	code /= N_ALNUM;
+		buffer[3] = decodeAlnum(code % N_ALNUM);	code /= N_ALNUM;
+		buffer[2] = decodeAlnum(code % N_ALNUM);	code /= N_ALNUM;
+		buffer[1] = (char) ('0' + code % N_DIGIT);	code /= N_DIGIT;
+		buffer[0] = "OPQ"[code];
+		buffer[6] = '\0';
+		return 6;
+	}
+
+	if (code >= BASE_END)
+		return -1;
+
+	if (code < BASE_LONG) {
+		block = code - BASE_SHORT;
+	} else {
+		block = (code - BASE_LONG) / N_BLOCK;
+		decodeBlock((code - BASE_LONG) % N_BLOCK, &buffer[6]);
+	}
+
+	decodeBlock(block % N_BLOCK, &buffer[2]);
+	block /= N_BLOCK;
+	buffer[1] = (char) ('0' + block % N_DIGIT);
+	first = (int) (block / N_DIGIT);
+	buffer[0] = (first < 14) ? (char) ('A' + first) : (char) ('R' + first - 14);
+
+	if (code < BASE_LONG) {
+		buffer[6] = '\0';
+		return 6;
+	}
+	buffer[10] = '\0';
+	return 10;
+}
+
+
+/**
+ * Create a map over the given associative array.  If useCodes is
+ * set, IDs that are valid accessions are kept as integers instead.
+ */
+AccessionMap *
+accessionMapCreate(AssociativeArray *others, int useCodes)
+{
+	AccessionMap *map;
+
+	map = (AccessionMap *) malloc(sizeof(AccessionMap));
+	if (map == NULL)
+		return NULL;
+
+	map->others = others;
+	map->codes = NULL;
+	map->sortedCodes = NULL;
+	map->nSortedCodes = 0;
+	map->codesSorted = 0;
+	if (useCodes) {
+		map->codes = u64tableCreate(0);
+		if (map->codes == NULL) {
+			free(map);
+			return NULL;
+		}
+	}
+	return map;
+}
+
+/** delete the map and the associative array it was given */
+void
+accessionMapDelete(AccessionMap *map)
+{
+	if (map == NULL)	return;
+	u64tableDelete(map->codes);
+	free(map->sortedCodes);
+	aaDeleteAssociativeArray(map->others);
+	free(map);
+}
+
+/** the code to use for this ID, or -1 if it belongs in the trie */
+static int64_t
+accessionMapCode(AccessionMap *map, const char *id)
+{
+	if (map->codes == NULL)
+		return -1;
+	return accessionEncode(id);
+}
+
+int
+accessionMapInsert(AccessionMap *map, const char *id, void *value)
+{
+	int64_t code = accessionMapCode(map, id);
+	size_t nEntries;
+	uint64_t *slot;
+
+	if (code < 0)
+		return aaInsert(map->others, (AAKeyType) id, strlen(id), value);
+
+	nEntries = map->codes->nEntries;
+	slot = u64tableSlot(map->codes, (uint64_t) code);
+	if (slot == NULL)
+		return -1;
+	*slot = (uint64_t) (uintptr_t) value;
+	if (map->codes->nEntries != nEntries)
+		map->codesSorted = 0;
+	return 0;
+}
+
+void *
+accessionMapLookup(AccessionMap *map, const char *id)
+{
+	int64_t code = accessionMapCode(map, id);
+	uint64_t *slot;
+
+	if (code < 0)
+		return aaLookup(map->others, (AAKeyType) id, strlen(id));
+
+	slot = u64tableFind(map->codes, (uint64_t) code);
+	return (slot == NULL) ? NULL : (void *) (uintptr_t) *slot;
+}
+
+void *
+accessionMapRemove(AccessionMap *map, const char *id)
+{
+	int64_t code = accessionMapCode(map, id);
+	uint64_t *slot;
+	void *value;
+
+	if (code < 0)
+		return aaDelete(map->others, (AAKeyType) id, strlen(id));
+
+	slot = u64tableFind(map->codes, (uint64_t) code);
+	if (slot == NULL)
+		return NULL;
+	value = (void *) (uintptr_t) *slot;
+	u64tableRemove(map->codes, (uint64_t) code);
+	map->codesSorted = 0;
+	return value;
+}
+
+static int
+accessionCodeComparator(const void *a, const void *b)
+{
+	uint64_t codeA = *(const uint64_t *) a, codeB = *(const uint64_t *) b;
+
+	if (codeA < codeB)	return -1;
+	return codeA > codeB;
+}
+
+/** bring the sorted list of codes up to date, if it has been invalidated */
+static int
+accessionMapSortCodes(AccessionMap *map)
+{
+	uint64_t *codes;
+	size_t i, n = 0;
+
+	if (map->codesSorted)
+		return 0;
+
+	codes = (uint64_t *) realloc(map->sortedCodes,
+			(map->codes->nEntries + 1) * sizeof(uint64_t));
+	if (codes == NULL)
+		return -1;
+	map->sortedCodes = codes;
+
+	for (i = 0; i < map->codes->capacity; i++) {
+		if (map->codes->used[i])
+			codes[n++] = map->codes->keys[i];
+	}
+	qsort(codes, n, sizeof(uint64_t), accessionCodeComparator);
+	map->nSortedCodes = n;
+	map->codesSorted = 1;
+	return 0;
+}
+
+/**
+ * The three forms of accession, in code order, with the first and
+ * last accession of each written out letter by letter.  Padding a
+ * prefix with the letters of the first (or last) gives the lowest
+ * (or highest) accession of that form starting with it.
+ */
+static const struct AccessionForm {
+	uint64_t base, end;
+	const char *first, *last;
+} accessionForms[] = {
+	{ BASE_OPQ,   BASE_SHORT, "O00000",     "Q9ZZZ9" },
+	{ BASE_SHORT, BASE_LONG,  "A0A000",     "Z9ZZZ9" },
+	{ BASE_LONG,  BASE_END,   "A0A000A000", "Z9ZZZ9ZZZ9" },
+};
+#define	N_FORMS	(sizeof(accessionForms) / sizeof(accessionForms[0]))
+
+/**
+ * Find the range of codes of the form whose accessions start with
+ * the prefix.  Within a form codes sort as the accessions do, so
+ * these are all the codes from low to high.  Returns -1 if no
+ * accession of the form can start with the prefix.
+ */
+static int
+accessionFormRange(const struct AccessionForm *form,
+		const char *prefix, size_t prefixLength, uint64_t *low, uint64_t *high)
+{
+	char lowest[ACCESSION_MAX_LEN + 1], highest[ACCESSION_MAX_LEN + 1];
+	size_t length = strlen(form->first);
+	int64_t lowCode, highCode;
+
+	if (prefixLength > length)
+		return -1;
+	memcpy(lowest, prefix, prefixLength);
+	memcpy(highest, prefix, prefixLength);
+	strcpy(&lowest[prefixLength], &form->first[prefixLength]);
+	strcpy(&highest[prefixLength], &form->last[prefixLength]);
+
+	/** a first letter of another form encodes, but into that form */
+	lowCode = accessionEncode(lowest);
+	highCode = accessionEncode(highest);
+	if (lowCode < 0 || highCode < 0
+			|| (uint64_t) lowCode < form->base || (uint64_t) lowCode >= form->end)
+		return -1;
+	*low = (uint64_t) lowCode;
+	*high = (uint64_t) highCode;
+	return 0;
+}
+
+/** the index of the first sorted code not below the given one */
+static size_t
+accessionMapFindCode(AccessionMap *map, uint64_t code)
+{
+	size_t low = 0, high = map->nSortedCodes, middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (map->sortedCodes[middle] < code)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/**
+ * Call the user function on the sorted codes from low to high for
+ * which pattern (if given) matches.  Returns the number of keys
+ * visited, or -1 if the user function asked us to stop.
+ */
+static int
+accessionMapVisitCodes(AccessionMap *map, AAPattern *pattern,
+		uint64_t low, uint64_t high,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	char buffer[ACCESSION_MAX_LEN + 1];
+	uint64_t code, *slot;
+	size_t i, n;
+	int length, nKeys = 0, status = 0;
+
+	/** the user function may remove codes, which only marks the list stale */
+	n = map->nSortedCodes;
+	for (i = accessionMapFindCode(map, low); i < n && status >= 0; i++) {
+		code = map->sortedCodes[i];
+		if (code > high)
+			break;
+		length = accessionDecode(code, buffer);
+		if (pattern != NULL
+				&& ! aaPatternMatch(pattern, (AAKeyType) buffer, length))
+			continue;
+		slot = u64tableFind(map->codes, code);
+		if (slot == NULL)
+			continue;
+		status = (*userfunction)((AAKeyType) buffer, length,
+				(void *) (uintptr_t) *slot, userdata);
+		nKeys++;
+	}
+
+	return (status < 0) ? -1 : nKeys;
+}
+
+/**
+ * Call the user function on every valid accession held as a code
+ * for which pattern (if given) matches, in code order.  Only the
+ * codes starting with the pattern's literal prefix are decoded and
+ * checked, found by a binary search in each form.
+ */
+static int
+accessionMapIterateCodes(AccessionMap *map, AAPattern *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	char prefix[ACCESSION_MAX_LEN + 1];
+	size_t prefixLength, f;
+	uint64_t low, high;
+	int nKeys = 0, nVisited;
+
+	if (map->codes == NULL || map->codes->nEntries == 0)
+		return 0;
+	if (accessionMapSortCodes(map) < 0)
+		return -1;
+
+	if (pattern == NULL)
+		return accessionMapVisitCodes(map, NULL, 0, UINT64_MAX,
+				userfunction, userdata);
+
+	/** one letter past the longest form, so an overlong prefix finds nothing */
+	prefixLength = aaPatternPrefix(pattern, (AAKeyType) prefix, sizeof(prefix));
+	for (f = 0; f < N_FORMS; f++) {
+		if (accessionFormRange(&accessionForms[f],
+					prefix, prefixLength, &low, &high) < 0)
+			continue;
+		nVisited = accessionMapVisitCodes(map, pattern, low, high,
+				userfunction, userdata);
+		if (nVisited < 0)
+			return -1;
+		nKeys += nVisited;
+	}
+	return nKeys;
+}
+
+/**
+ * Iterate everything: the trie held IDs first, then the accessions
+ * held as codes
+ */
+int
+accessionMapIterateAction(AccessionMap *map,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	int nKeys, nCodes;
+
+	nKeys = aaIterateAction(map->others, userfunction, userdata);
+	if (nKeys < 0)
+		return -1;
+	nCodes = accessionMapIterateCodes(map, NULL, userfunction, userdata);
+	if (nCodes < 0)
+		return -1;
+	return nKeys + nCodes;
+}
+
+/**
+ * Pattern search over both halves.  The trie half prunes subtries;
+ * the coded accessions are narrowed to those with the pattern's
+ * literal prefix, which are then checked against the pattern,
+ * compiled once for the search.
+ */
+int
+accessionMapPatternSearch(AccessionMap *map, const char *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata)
+{
+	AAPattern *compiled;
+	int nKeys, nCodes;
+
+	nKeys = aaPatternSearch(map->others, pattern, userfunction, userdata);
+	if (nKeys < 0)
+		return -1;
+	if (map->codes == NULL || map->codes->nEntries == 0)
+		return nKeys;
+
+	compiled = aaCompilePattern(pattern);
+	if (compiled == NULL)
+		return -1;
+	nCodes = accessionMapIterateCodes(map, compiled, userfunction, userdata);
+	aaDeletePattern(compiled);
+	if (nCodes < 0)
+		return -1;
+	return nKeys + nCodes;
+}
+
+/** print helper for the coded accessions */
+static int
+accessionMapPrintCode(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	fprintf((FILE *) userdata, "    [%s] %p\n", (char *) key, value);
+	return 0;
+}
+
+void
+accessionMapPrint(FILE *fp, AccessionMap *map, char *lineLeader)
+{
+	aaPrintContents(fp, map->others, lineLeader);
+	if (map->codes != NULL) {
+		fprintf(fp, "%lu accessions held as integer codes:\n",
+				(unsigned long) map->codes->nEntries);
+		accessionMapIterateCodes(map, NULL, accessionMapPrintCode, fp);
+	}
+}
+
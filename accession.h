@@ -0,0 +1,55 @@
+#ifndef	__UNIPROT_ACCESSION_HEADER__
+#define	__UNIPROT_ACCESSION_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "aarray.h"
+#include "u64table.h"
+
+/**
+ * UniProt accessions follow a fixed grammar:
+ *
+ *     [OPQ][0-9][A-Z0-9]{3}[0-9]
+ *     [A-NR-Z][0-9]([A-Z][A-Z0-9]{2}[0-9]){1,2}
+ *
+ * so every valid accession maps to a distinct integer.  The six
+ * letter forms (by far the most common) all encode below 2^32; the
+ * ten letter form needs 45 bits.
+ */
+#define	ACCESSION_MAX_LEN	10
+
+int64_t accessionEncode(const char *accession);
+int accessionDecode(uint64_t code, char *buffer);
+
+/**
+ * Map from record ID to value which keeps IDs that are valid
+ * accessions as integers in a hash table, and everything else in
+ * an associative array.  With useCodes off it is simply the
+ * associative array.  The codes are sorted for iteration when first
+ * needed, and kept until a code is added or removed.
+ */
+typedef struct AccessionMap {
+	U64Table *codes;
+	AssociativeArray *others;
+	uint64_t *sortedCodes;
+	size_t nSortedCodes;
+	int codesSorted;
+} AccessionMap;
+
+AccessionMap *accessionMapCreate(AssociativeArray *others, int useCodes);
+void accessionMapDelete(AccessionMap *map);
+
+int accessionMapInsert(AccessionMap *map, const char *id, void *value);
+void *accessionMapLookup(AccessionMap *map, const char *id);
+void *accessionMapRemove(AccessionMap *map, const char *id);
+
+int accessionMapIterateAction(AccessionMap *map,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata);
+int accessionMapPatternSearch(AccessionMap *map, const char *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata);
+void accessionMapPrint(FILE *fp, AccessionMap *map, char *lineLeader);
+
+#endif /* __UNIPROT_ACCESSION_HEADER__ */
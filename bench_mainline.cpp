@@ -0,0 +1,829 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h> /* for getopt() */
+#include <errno.h>
+
+#include "aarray.h"
+#include "hashmix.h"
+
+#define	DEFAULT_KEY_COUNT	"100000"
+#define	DEFAULT_MIX		"90:5:5"
+#define	DEFAULT_ZIPF_EXPONENT	0.99
+#define OPTIONLEN	12
+
+/**
+ * Synthetic workloads for the associative array, run against the
+ * standard containers as baselines.  Everything is derived from the
+ * seed, so a run can be repeated exactly on another build.
+ */
+
+/** splitmix64 generator */
+class Random {
+public:
+	explicit Random(uint64_t seed) : state_(seed) {}
+
+	uint64_t next()
+	{
+		return hashSplitmixNext(&state_);
+	}
+
+	/** uniform in [0, 1) */
+	double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+	/** uniform in [0, n) */
+	uint64_t below(uint64_t n) { return (uint64_t) (uniform() * n); }
+
+private:
+	uint64_t state_;
+};
+
+/**
+ * Zipf distributed ranks in [1, n], by rejection-inversion (Hörmann
+ * and Derflinger), which needs no table, so it works for any n
+ */
+class Zipf {
+public:
+	Zipf(uint64_t n, double exponent) : n_(n), s_(exponent)
+	{
+		hIntegralX1_ = hIntegral(1.5) - 1.0;
+		hIntegralN_ = hIntegral(n + 0.5);
+		sLimit_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+	}
+
+	uint64_t sample(Random &random) const
+	{
+		double u, x;
+		uint64_t k;
+
+		for (;;) {
+			u = hIntegralN_ + random.uniform() * (hIntegralX1_ - hIntegralN_);
+			x = hIntegralInverse(u);
+			k = (x < 1.5) ? 1 : (uint64_t) (x + 0.5);
+			if (k > n_)
+				k = n_;
+			if (k - x <= sLimit_ || u >= hIntegral(k + 0.5) - h((double) k))
+				return k;
+		}
+	}
+
+private:
+	double h(double x) const { return std::exp(-s_ * std::log(x)); }
+
+	double hIntegral(double x) const
+	{
+		double logX = std::log(x);
+		return helper2((1.0 - s_) * logX) * logX;
+	}
+
+	double hIntegralInverse(double x) const
+	{
+		double t = x * (1.0 - s_);
+		if (t < -1.0)
+			t = -1.0;
+		return std::exp(helper1(t) * x);
+	}
+
+	/** log1p(x) / x, and (exp(x) - 1) / x, both safe near zero */
+	static double helper1(double x)
+	{
+		return (std::fabs(x) > 1e-8) ? std::log1p(x) / x
+				: 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+	}
+	static double helper2(double x)
+	{
+		return (std::fabs(x) > 1e-8) ? std::expm1(x) / x
+				: 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+	}
+
+	uint64_t n_;
+	double s_;
+	double hIntegralX1_, hIntegralN_, sLimit_;
+};
+
+
+/** the kinds of keys (and of access pattern) that can be generated */
+enum WorkloadKind {
+	WORKLOAD_UNIFORM,
+	WORKLOAD_ZIPF,
+	WORKLOAD_PREFIX,
+	WORKLOAD_INTEGER,
+	WORKLOAD_ACCESSION,
+	N_WORKLOADS
+};
+
+static const char *workloadNames[N_WORKLOADS] = {
+		"uniform", "zipf", "prefix", "integer", "accession"
+	};
+
+/** every key of the prefix workload starts with this */
+static const char sharedPrefix[] =
+		"sp|shared/prefix/common/to/every/key/in/the/set|";
+
+/** UniProt accessions: [A-NR-Z][0-9][A-Z][A-Z0-9][A-Z0-9][0-9], then optionally again */
+static const char accessionFirst[] = "ABCDEFGHIJKLMNRSTUVWXYZ";
+static const char accessionDigit[] = "0123456789";
+static const char accessionLetter[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char accessionAlnum[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static const char *accessionPositions[10] = {
+		accessionFirst, accessionDigit, accessionLetter,
+		accessionAlnum, accessionAlnum, accessionDigit,
+		accessionLetter, accessionAlnum, accessionAlnum, accessionDigit
+	};
+
+/** a prime sharing no factor with the sizes of the accession spaces */
+#define	ACCESSION_STRIDE	1000003ULL
+
+
+/**
+ * Keys 0 to n-1 are the ones loaded, and keys n to 2n-1 are distinct
+ * from them and used for misses and for inserts in the mixed phase.
+ * String keys are packed into one buffer.
+ */
+class StringKeys {
+public:
+	StringKeys(WorkloadKind kind, size_t n, uint64_t seed)
+	{
+		size_t i, nKeys = 2 * n;
+		std::string key;
+
+		accessionLength_ = 6;
+		accessionSpace_ = accessionSpace(6);
+		if (kind == WORKLOAD_ACCESSION && nKeys > accessionSpace_) {
+			accessionLength_ = 10;
+			accessionSpace_ = accessionSpace(10);
+		}
+
+		offsets_.reserve(nKeys + 1);
+		offsets_.push_back(0);
+		for (i = 0; i < nKeys; i++) {
+			makeKey(kind, i, seed, key);
+			bytes_ += key;
+			offsets_.push_back(bytes_.size());
+		}
+	}
+
+	std::string_view get(size_t i) const
+	{
+		return std::string_view(bytes_.data() + offsets_[i],
+				offsets_[i + 1] - offsets_[i]);
+	}
+
+private:
+	static uint64_t accessionSpace(int length)
+	{
+		uint64_t space = 1;
+		for (int i = 0; i < length; i++)
+			space *= strlen(accessionPositions[i]);
+		return space;
+	}
+
+	void makeKey(WorkloadKind kind, uint64_t i, uint64_t seed, std::string &key)
+	{
+		uint64_t v;
+		int p;
+
+		key.clear();
+		if (kind == WORKLOAD_ACCESSION) {
+			/** a stride through the space visits each accession once */
+			v = (i * ACCESSION_STRIDE + seed % accessionSpace_) % accessionSpace_;
+			key.resize(accessionLength_);
+			for (p = accessionLength_ - 1; p >= 0; p--) {
+				size_t radix = strlen(accessionPositions[p]);
+				key[p] = accessionPositions[p][v % radix];
+				v /= radix;
+			}
+			return;
+		}
+
+		if (kind == WORKLOAD_PREFIX)
+			key = sharedPrefix;
+		v = hashMix64(i + seed * HASH_SPLITMIX_GAMMA);
+		do {
+			key += (char) ('a' + v % 26);
+			v /= 26;
+		} while (v != 0);
+	}
+
+	std::string bytes_;
+	std::vector<size_t> offsets_;
+	int accessionLength_;
+	uint64_t accessionSpace_;
+};
+
+class IntegerKeys {
+public:
+	IntegerKeys(WorkloadKind, size_t n, uint64_t seed) : keys_(2 * n)
+	{
+		for (size_t i = 0; i < keys_.size(); i++)
+			keys_[i] = hashMix64(i + seed * HASH_SPLITMIX_GAMMA);
+	}
+
+	uint64_t get(size_t i) const { return keys_[i]; }
+
+private:
+	std::vector<uint64_t> keys_;
+};
+
+
+/** the operations of the mixed phase, in the top bits of each step */
+#define	MIXED_LOOKUP	0ULL
+#define	MIXED_INSERT	1ULL
+#define	MIXED_DELETE	2ULL
+#define	MIXED_SHIFT	62
+#define	MIXED_INDEX(step)	((step) & ((1ULL << MIXED_SHIFT) - 1))
+
+/**
+ * The keys each phase uses, worked out before any timing starts so
+ * that every backend sees exactly the same sequence
+ */
+struct AccessPlan {
+	std::vector<uint64_t> hits;
+	std::vector<uint64_t> mixed;
+	std::vector<uint64_t> deletes;
+};
+
+static void
+makePlan(AccessPlan &plan, WorkloadKind kind, size_t n, const int mix[3],
+		double zipfExponent, uint64_t seed)
+{
+	Random random(seed ^ 0x5bd1e995ULL);
+	Zipf zipf(n, zipfExponent);
+	uint64_t nextInsert = n, op;
+	int total = mix[0] + mix[1] + mix[2], pick;
+	size_t i;
+
+	/** only the zipf workload has popular keys */
+	auto draw = [&]() -> uint64_t {
+		return (kind == WORKLOAD_ZIPF) ? zipf.sample(random) - 1 : random.below(n);
+	};
+
+	plan.hits.resize(n);
+	for (i = 0; i < n; i++)
+		plan.hits[i] = draw();
+
+	plan.mixed.resize(n);
+	for (i = 0; i < n; i++) {
+		pick = (int) random.below(total);
+		if (pick < mix[0]) {
+			op = MIXED_LOOKUP;
+		} else if (pick < mix[0] + mix[1]) {
+			op = MIXED_INSERT;
+		} else {
+			op = MIXED_DELETE;
+		}
+		plan.mixed[i] = (op << MIXED_SHIFT)
+				| ((op == MIXED_INSERT) ? nextInsert++ : draw());
+	}
+
+	/** delete in a shuffled order */
+	plan.deletes.resize(n);
+	for (i = 0; i < n; i++)
+		plan.deletes[i] = i;
+	for (i = n; i > 1; i--)
+		std::swap(plan.deletes[i - 1], plan.deletes[random.below(i)]);
+}
+
+
+/** every backend stores the same (non-NULL) value for every key */
+static int benchValueTarget;
+static void *const benchValue = &benchValueTarget;
+
+static int
+countKey(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	*(size_t *) userdata += (value != NULL);
+	return 0;
+}
+
+/** the associative array, through aarray.h */
+class AABackend {
+public:
+	explicit AABackend(size_t n)
+	{
+		static char probe[] = "lin", hash1[] = "sum", hash2[] = "len";
+
+		array_ = aaCreateAssociativeArray(n, probe, hash1, hash2);
+		if (array_ == nullptr) {
+			fprintf(stderr, "Error: cannot allocate associative array - exitting\n");
+			exit(1);
+		}
+	}
+	~AABackend() { aaDeleteAssociativeArray(array_); }
+
+	bool insert(std::string_view key)
+	{
+		return aaInsert(array_, bytes(key), key.size(), benchValue) >= 0;
+	}
+	bool lookup(std::string_view key)
+	{
+		return aaLookup(array_, bytes(key), key.size()) != nullptr;
+	}
+	bool erase(std::string_view key)
+	{
+		return aaDelete(array_, bytes(key), key.size()) != nullptr;
+	}
+
+	bool insert(uint64_t key) { return aaInsertU64(array_, key, benchValue) >= 0; }
+	bool lookup(uint64_t key) { return aaLookupU64(array_, key) != nullptr; }
+	bool erase(uint64_t key) { return aaDeleteU64(array_, key) != nullptr; }
+
+	size_t iterate()
+	{
+		size_t nFound = 0;
+		aaIterateAction(array_, countKey, &nFound);
+		return nFound;
+	}
+
+private:
+	static AAKeyType bytes(std::string_view key)
+	{
+		return (AAKeyType) const_cast<char *>(key.data());
+	}
+
+	AssociativeArray *array_;
+};
+
+/**
+ * std::map, keyed by an owned std::string (or the integer); lookups
+ * compare against the view directly
+ */
+class MapBackend {
+public:
+	explicit MapBackend(size_t) {}
+
+	bool insert(std::string_view key)
+	{
+		strings_.insert_or_assign(std::string(key), benchValue);
+		return true;
+	}
+	bool lookup(std::string_view key) { return strings_.find(key) != strings_.end(); }
+	bool erase(std::string_view key)
+	{
+		auto found = strings_.find(key);
+		if (found == strings_.end())
+			return false;
+		strings_.erase(found);
+		return true;
+	}
+
+	bool insert(uint64_t key) { integers_[key] = benchValue; return true; }
+	bool lookup(uint64_t key) { return integers_.find(key) != integers_.end(); }
+	bool erase(uint64_t key) { return integers_.erase(key) > 0; }
+
+	size_t iterate()
+	{
+		size_t nFound = 0;
+		for (const auto &entry : strings_)
+			nFound += (entry.second != nullptr);
+		for (const auto &entry : integers_)
+			nFound += (entry.second != nullptr);
+		return nFound;
+	}
+
+private:
+	std::map<std::string, void *, std::less<>> strings_;
+	std::map<uint64_t, void *> integers_;
+};
+
+/**
+ * std::unordered_map, reserved for the keys to be loaded.  It cannot
+ * look up a view (before C++20), so the key is copied into a reused
+ * scratch string, which only allocates for keys longer than before.
+ */
+class UnorderedMapBackend {
+public:
+	explicit UnorderedMapBackend(size_t n)
+	{
+		strings_.reserve(n);
+		integers_.reserve(n);
+	}
+
+	bool insert(std::string_view key)
+	{
+		strings_.insert_or_assign(std::string(key), benchValue);
+		return true;
+	}
+	bool lookup(std::string_view key)
+	{
+		scratch_.assign(key);
+		return strings_.find(scratch_) != strings_.end();
+	}
+	bool erase(std::string_view key)
+	{
+		scratch_.assign(key);
+		return strings_.erase(scratch_) > 0;
+	}
+
+	bool insert(uint64_t key) { integers_[key] = benchValue; return true; }
+	bool lookup(uint64_t key) { return integers_.find(key) != integers_.end(); }
+	bool erase(uint64_t key) { return integers_.erase(key) > 0; }
+
+	size_t iterate()
+	{
+		size_t nFound = 0;
+		for (const auto &entry : strings_)
+			nFound += (entry.second != nullptr);
+		for (const auto &entry : integers_)
+			nFound += (entry.second != nullptr);
+		return nFound;
+	}
+
+private:
+	std::unordered_map<std::string, void *> strings_;
+	std::unordered_map<uint64_t, void *> integers_;
+	std::string scratch_;
+};
+
+enum BackendKind {
+	BACKEND_AA,
+	BACKEND_MAP,
+	BACKEND_UNORDERED_MAP,
+	N_BACKENDS
+};
+
+static const char *backendNames[N_BACKENDS] = { "aa", "map", "umap" };
+
+
+/** one timed phase */
+struct Result {
+	const char *workload;
+	const char *backend;
+	size_t nKeys;
+	int rep;
+	const char *operation;
+	size_t nOperations;
+	size_t nFound;
+	double seconds;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Run every phase against a fresh backend: load, hits, misses, a
+ * full iteration, the mixed steps and finally deleting the loaded
+ * keys.  The found counts show whether each backend agreed.
+ */
+template <typename Backend, typename Keys>
+static void
+runPhases(std::vector<Result> &results, Result row, const Keys &keys,
+		const AccessPlan &plan)
+{
+	Backend backend(row.nKeys);
+	size_t i, n = row.nKeys, nFound;
+	Clock::time_point start;
+	uint64_t step;
+
+	auto record = [&](const char *operation, size_t nOperations) {
+		row.operation = operation;
+		row.nOperations = nOperations;
+		row.nFound = nFound;
+		row.seconds = secondsSince(start);
+		results.push_back(row);
+	};
+
+	nFound = 0;
+	start = Clock::now();
+	for (i = 0; i < n; i++)
+		nFound += backend.insert(keys.get(i));
+	record("insert", n);
+
+	nFound = 0;
+	start = Clock::now();
+	for (i = 0; i < n; i++)
+		nFound += backend.lookup(keys.get(plan.hits[i]));
+	record("lookup-hit", n);
+
+	nFound = 0;
+	start = Clock::now();
+	for (i = 0; i < n; i++)
+		nFound += backend.lookup(keys.get(n + i));
+	record("lookup-miss", n);
+
+	start = Clock::now();
+	nFound = backend.iterate();
+	record("iterate", n);
+
+	nFound = 0;
+	start = Clock::now();
+	for (i = 0; i < n; i++) {
+		step = plan.mixed[i];
+		if ((step >> MIXED_SHIFT) == MIXED_LOOKUP) {
+			nFound += backend.lookup(keys.get(MIXED_INDEX(step)));
+		} else if ((step >> MIXED_SHIFT) == MIXED_INSERT) {
+			nFound += backend.insert(keys.get(MIXED_INDEX(step)));
+		} else {
+			nFound += backend.erase(keys.get(MIXED_INDEX(step)));
+		}
+	}
+	record("mixed", n);
+
+	nFound = 0;
+	start = Clock::now();
+	for (i = 0; i < n; i++)
+		nFound += backend.erase(keys.get(plan.deletes[i]));
+	record("delete", n);
+}
+
+template <typename Keys>
+static void
+runWorkload(std::vector<Result> &results, WorkloadKind kind, size_t n,
+		const int backends[N_BACKENDS], int nReps, const int mix[3],
+		double zipfExponent, uint64_t seed)
+{
+	Keys keys(kind, n, seed);
+	AccessPlan plan;
+	Result row = {};
+	int rep;
+
+	makePlan(plan, kind, n, mix, zipfExponent, seed);
+
+	row.workload = workloadNames[kind];
+	row.nKeys = n;
+	for (rep = 0; rep < nReps; rep++) {
+		row.rep = rep;
+		if (backends[BACKEND_AA]) {
+			row.backend = backendNames[BACKEND_AA];
+			runPhases<AABackend>(results, row, keys, plan);
+		}
+		if (backends[BACKEND_MAP]) {
+			row.backend = backendNames[BACKEND_MAP];
+			runPhases<MapBackend>(results, row, keys, plan);
+		}
+		if (backends[BACKEND_UNORDERED_MAP]) {
+			row.backend = backendNames[BACKEND_UNORDERED_MAP];
+			runPhases<UnorderedMapBackend>(results, row, keys, plan);
+		}
+	}
+}
+
+
+static void
+printCSV(FILE *fp, const std::vector<Result> &results)
+{
+	fprintf(fp, "workload,backend,keys,rep,operation,operations,found,seconds,ns_per_op\n");
+	for (const Result &r : results) {
+		fprintf(fp, "%s,%s,%zu,%d,%s,%zu,%zu,%.6f,%.1f\n",
+				r.workload, r.backend, r.nKeys, r.rep, r.operation,
+				r.nOperations, r.nFound, r.seconds,
+				r.seconds * 1e9 / r.nOperations);
+	}
+}
+
+static void
+printJSON(FILE *fp, const std::vector<Result> &results, uint64_t seed,
+		const char *mixSpec, double zipfExponent)
+{
+	size_t i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"seed\": %llu,\n", (unsigned long long) seed);
+	fprintf(fp, "  \"mix\": \"%s\",\n", mixSpec);
+	fprintf(fp, "  \"zipfExponent\": %g,\n", zipfExponent);
+#ifdef	__OPTIMIZE__
+	fprintf(fp, "  \"optimized\": true,\n");
+#else
+	fprintf(fp, "  \"optimized\": false,\n");
+#endif
+	fprintf(fp, "  \"results\": [\n");
+	for (i = 0; i < results.size(); i++) {
+		const Result &r = results[i];
+		fprintf(fp, "    {\"workload\": \"%s\", \"backend\": \"%s\", \"keys\": %zu, "
+				"\"rep\": %d, \"operation\": \"%s\", \"operations\": %zu, "
+				"\"found\": %zu, \"seconds\": %.6f, \"nsPerOp\": %.1f}%s\n",
+				r.workload, r.backend, r.nKeys, r.rep, r.operation,
+				r.nOperations, r.nFound, r.seconds,
+				r.seconds * 1e9 / r.nOperations,
+				(i < results.size() - 1) ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+}
+
+
+/** set flags[i] for each comma separated name found in names[] */
+static int
+parseNameList(char *list, const char **names, int nNames, int *flags)
+{
+	char *name, *save = NULL;
+	int i;
+
+	for (name = strtok_r(list, ",", &save); name != NULL;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "all") == 0) {
+			for (i = 0; i < nNames; i++)
+				flags[i] = 1;
+			continue;
+		}
+		for (i = 0; i < nNames; i++) {
+			if (strcmp(name, names[i]) == 0)
+				break;
+		}
+		if (i == nNames) {
+			fprintf(stderr, "Error: unknown name '%s'\n", name);
+			return -1;
+		}
+		flags[i] = 1;
+	}
+	return 0;
+}
+
+/** comma separated key counts, which may be written as 1e6 */
+static int
+parseSizeList(char *list, std::vector<size_t> &sizes)
+{
+	char *item, *end, *save = NULL;
+	double value;
+
+	for (item = strtok_r(list, ",", &save); item != NULL;
+			item = strtok_r(NULL, ",", &save)) {
+		value = strtod(item, &end);
+		if (*end != '\0' || ! (value >= 1 && value <= 1e12)) {
+			fprintf(stderr, "Error: bad key count '%s'\n", item);
+			return -1;
+		}
+		sizes.push_back((size_t) value);
+	}
+	return sizes.empty() ? -1 : 0;
+}
+
+/** print out the help */
+void usage(char *progname)
+{
+	fprintf(stderr, "%s [<OPTIONS>]\n", progname);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Generates synthetic keys and times the associative array, along\n");
+	fprintf(stderr, "with std::map and std::unordered_map, over the same operations:\n");
+	fprintf(stderr, "insert, lookup of present and absent keys, iterate, a mix of\n");
+	fprintf(stderr, "operations, and delete.  Results are written as CSV, one line\n");
+	fprintf(stderr, "per phase.  Time library changes with an optimized build, e.g.\n");
+	fprintf(stderr, "  make CFLAGS=\"-O2 -g -Wall -Iaalib -I.\" CXXFLAGS=\"-O2 -g -Wall -std=c++17 -Iaalib -I.\"\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options: \n");
+	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
+	fprintf(stderr, "%-*s: Comma separated workloads, default all of: uniform\n",
+			OPTIONLEN, "-w <LIST>");
+	fprintf(stderr, "%-*s: (random keys), zipf (the same keys, Zipf distributed\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: accesses), prefix (keys sharing a long prefix), integer\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: (64-bit keys) and accession (UniProt style accessions).\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Comma separated backends, default all of: aa, map, umap.\n",
+			OPTIONLEN, "-b <LIST>");
+	fprintf(stderr, "%-*s: Comma separated key counts, default %s; 1e3 to 1e8\n",
+			OPTIONLEN, "-n <LIST>", DEFAULT_KEY_COUNT);
+	fprintf(stderr, "%-*s: may be written so.  Allow about 100 bytes a key.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Lookup:insert:delete weights of the mixed phase,\n",
+			OPTIONLEN, "-m <L:I:D>");
+	fprintf(stderr, "%-*s: default %s.\n", OPTIONLEN, "", DEFAULT_MIX);
+	fprintf(stderr, "%-*s: Zipf exponent, default %g.\n",
+			OPTIONLEN, "-z <S>", DEFAULT_ZIPF_EXPONENT);
+	fprintf(stderr, "%-*s: Seed for the keys and accesses, default 1.\n",
+			OPTIONLEN, "-s <SEED>");
+	fprintf(stderr, "%-*s: Repeat each run <N> times, default 1.\n",
+			OPTIONLEN, "-r <N>");
+	fprintf(stderr, "%-*s: Write the results as JSON rather than CSV.\n",
+			OPTIONLEN, "-j");
+	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
+			OPTIONLEN, "-o <FILE>");
+	fprintf(stderr, "\n");
+	exit (1);
+}
+
+/**
+ * Program mainline -- runs each workload at each size against each
+ * backend.  Uses getopt(3) to parse arguments.
+ */
+int
+main(int argc, char **argv)
+{
+	char *programname = NULL;
+	FILE *ofp = stdout;
+	int workloads[N_WORKLOADS] = { 0 };
+	int backends[N_BACKENDS] = { 0 };
+	int anyWorkload = 0, anyBackend = 0;
+	char defaultSizes[] = DEFAULT_KEY_COUNT;
+	char *sizeList = defaultSizes;
+	std::vector<size_t> sizes;
+	const char *mixSpec = DEFAULT_MIX;
+	int mix[3];
+	double zipfExponent = DEFAULT_ZIPF_EXPONENT;
+	uint64_t seed = 1;
+	int nReps = 1;
+	int printJSONResults = 0;
+	std::vector<Result> results;
+	int i, c;
+
+	/* save program name before calling getopt() */
+	programname = argv[0];
+
+	/** use getopt(3) to parse command line */
+	while ((c = getopt(argc, argv, "hjw:b:n:m:z:s:r:o:")) != -1) {
+		if (c == 'w') {
+			if (parseNameList(optarg, workloadNames, N_WORKLOADS, workloads) < 0)
+				usage(programname);
+			anyWorkload = 1;
+
+		} else if (c == 'b') {
+			if (parseNameList(optarg, backendNames, N_BACKENDS, backends) < 0)
+				usage(programname);
+			anyBackend = 1;
+
+		} else if (c == 'n') {
+			sizeList = optarg;
+
+		} else if (c == 'm') {
+			mixSpec = optarg;
+
+		} else if (c == 'z') {
+			zipfExponent = strtod(optarg, NULL);
+			if ( ! (zipfExponent > 0)) {
+				fprintf(stderr, "Error: Zipf exponent must be positive\n");
+				usage(programname);
+			}
+
+		} else if (c == 's') {
+			seed = strtoull(optarg, NULL, 0);
+
+		} else if (c == 'r') {
+			nReps = atoi(optarg);
+			if (nReps < 1) {
+				fprintf(stderr, "Error: need at least one repetition\n");
+				usage(programname);
+			}
+
+		} else if (c == 'j') {
+			printJSONResults = 1;
+
+		} else if (c == 'o') {
+			ofp = fopen(optarg, "w");
+			if (ofp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested output file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
+		} else if (c == 'h') {
+			usage(programname);
+		}
+	}
+
+	if (parseSizeList(sizeList, sizes) < 0)
+		usage(programname);
+
+	if (sscanf(mixSpec, "%d:%d:%d", &mix[0], &mix[1], &mix[2]) != 3
+			|| mix[0] < 0 || mix[1] < 0 || mix[2] < 0
+			|| mix[0] + mix[1] + mix[2] == 0) {
+		fprintf(stderr, "Error: cannot parse mix '%s'\n", mixSpec);
+		usage(programname);
+	}
+
+	for (i = 0; i < N_WORKLOADS; i++)
+		workloads[i] |= ! anyWorkload;
+	for (i = 0; i < N_BACKENDS; i++)
+		backends[i] |= ! anyBackend;
+
+	for (size_t n : sizes) {
+		for (i = 0; i < N_WORKLOADS; i++) {
+			if ( ! workloads[i])
+				continue;
+			if (i == WORKLOAD_INTEGER) {
+				runWorkload<IntegerKeys>(results, (WorkloadKind) i, n,
+						backends, nReps, mix, zipfExponent, seed);
+			} else {
+				runWorkload<StringKeys>(results, (WorkloadKind) i, n,
+						backends, nReps, mix, zipfExponent, seed);
+			}
+		}
+	}
+
+	if (printJSONResults) {
+		printJSON(ofp, results, seed, mixSpec, zipfExponent);
+	} else {
+		printCSV(ofp, results);
+	}
+	if (ofp != stdout)
+		fclose(ofp);
+
+	/* exit with success if we get here */
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "densetrie.hpp"
+#include "aatrie.hpp"
+
+/**
+ * Builds and exercises the header only C++ interfaces, which nothing
+ * else in the tree compiles: insert, lookup, iteration order and
+ * delete on an aa::DenseTrie, an aa::Trie and an aa::Map.  Prints
+ * each check that fails and exits non-zero if any did.
+ */
+
+static int nChecks = 0, nFailed = 0;
+
+#define	CHECK(cond)	check((cond), #cond, __LINE__)
+
+static void
+check(bool passed, const char *what, int line)
+{
+	nChecks++;
+	if ( ! passed) {
+		fprintf(stderr, "FAILED: line %d: %s\n", line, what);
+		nFailed++;
+	}
+}
+
+static const unsigned char *
+bytes(const char *key)
+{
+	return (const unsigned char *) key;
+}
+
+static void
+checkDenseTrie()
+{
+	aa::DenseTrie<int, 4> trie("ACGT");
+	std::vector<std::string> keys;
+
+	CHECK(trie.alphabet().size() == 4);
+	CHECK(trie.insert(bytes("GATTACA"), 7, 1));
+	CHECK(trie.insert(bytes("GAT"), 3, 2));
+	CHECK(trie.insert(bytes("CAT"), 3, 3));
+	CHECK( ! trie.insert(bytes("GANT"), 4, 4));
+	CHECK(trie.size() == 3);
+
+	CHECK(trie.insert(bytes("GAT"), 3, 5));
+	CHECK(trie.size() == 3);
+	CHECK(trie.lookup(bytes("GAT"), 3) != nullptr && *trie.lookup(bytes("GAT"), 3) == 5);
+	CHECK(trie.lookup(bytes("GATT"), 4) == nullptr);
+	CHECK(trie.lookup(bytes("GANT"), 4) == nullptr);
+
+	/** keys come back in the order of the alphabet given */
+	trie.iterate([&](const unsigned char *key, size_t keylength, int) {
+		keys.emplace_back((const char *) key, keylength);
+		return 0;
+	});
+	CHECK(keys.size() == 3 && keys[0] == "CAT" && keys[1] == "GAT"
+			&& keys[2] == "GATTACA");
+
+	CHECK(trie.remove(bytes("GAT"), 3));
+	CHECK( ! trie.remove(bytes("GAT"), 3));
+	CHECK(trie.lookup(bytes("GAT"), 3) == nullptr);
+	CHECK(trie.lookup(bytes("GATTACA"), 7) != nullptr);
+	CHECK(trie.size() == 2);
+
+	/** the full byte alphabet needs no table */
+	aa::DenseTrie<long, 256> bytesTrie;
+	CHECK(bytesTrie.insert(bytes("\xff\x01"), 2, 7));
+	CHECK(bytesTrie.lookup(bytes("\xff\x01"), 2) != nullptr);
+}
+
+static void
+checkTrie()
+{
+	aa::Trie<std::string> trie;
+	const aa::Trie<std::string> &constTrie = trie;
+	uint64_t cost = 0, counted;
+	std::vector<std::string> keys;
+
+	CHECK(trie.try_emplace("apple", "red").second);
+	CHECK( ! trie.try_emplace("apple", "green").second);
+	CHECK(trie.insert_or_assign("banana", "yellow").second);
+	CHECK( ! trie.insert_or_assign("apple", "green").second);
+	trie["cherry"] = "dark";
+	CHECK(trie.size() == 3);
+
+	CHECK(trie.at("apple") == "green");
+	CHECK(trie.find("durian") == nullptr);
+	CHECK(trie.contains("cherry"));
+
+	/** const lookups leave the Trie's count alone, and report their own */
+	counted = trie.cost();
+	CHECK(constTrie.find("banana", cost) != nullptr && cost > 0);
+	CHECK(constTrie.find("banana") != nullptr);
+	CHECK(trie.cost() == counted);
+
+	for (auto entry : trie)
+		keys.emplace_back(entry.key);
+	std::sort(keys.begin(), keys.end());
+	CHECK(keys.size() == 3 && keys[0] == "apple" && keys[2] == "cherry");
+
+	CHECK(trie.erase("banana"));
+	CHECK( ! trie.erase("banana"));
+	CHECK( ! trie.contains("banana"));
+	CHECK(trie.size() == 2);
+	CHECK(trie.cost() > counted);
+
+	trie.clear();
+	CHECK(trie.empty() && trie.begin() == trie.end());
+}
+
+static void
+checkMap()
+{
+	aa::Map<int, double> map;
+	std::vector<int> keys;
+
+	map[3] = 0.3;
+	map[-7] = -0.7;
+	map[0] = 0.0;
+	CHECK(map.size() == 3);
+	CHECK(map.find(-7) != nullptr && *map.find(-7) == -0.7);
+	CHECK(map.find(7) == nullptr);
+
+	/** every key, negative ones too, comes back as it went in */
+	for (auto entry : map)
+		keys.push_back(entry.key);
+	std::sort(keys.begin(), keys.end());
+	CHECK(keys.size() == 3 && keys[0] == -7 && keys[1] == 0 && keys[2] == 3);
+
+	CHECK(map.erase(0));
+	CHECK( ! map.contains(0));
+	CHECK(map.size() == 2);
+}
+
+int
+main()
+{
+	checkDenseTrie();
+	checkTrie();
+	checkMap();
+
+	printf("%d of %d checks passed\n", nChecks - nFailed, nChecks);
+	return (nFailed == 0) ? 0 : 1;
+}
@@ -102,6 +102,27 @@ readPlainLine(
 }
 
 
+/**
+ * Open a file of keys, or hand back stdin if the name is "-" so that
+ * keys can be piped in from another program
+ */
+FILE *
+openInputFile(const char *filename)
+{
+	if (strcmp(filename, "-") == 0)
+		return stdin;
+	return fopen(filename, "r");
+}
+
+/** close a file from openInputFile(), leaving stdin open */
+void
+closeInputFile(FILE *fp)
+{
+	if (fp != stdin)
+		fclose(fp);
+}
+
+
 /**
  * Return true (i.e.; nonzero) for characters we want to keep,
  * determined by isprint() and checks for tab and space.
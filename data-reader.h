@@ -8,5 +8,9 @@ int readDataLine(FILE *dataFP,
 int readPlainLine(FILE *dataFP,
 		char *linebuffer, int maxlinelen,
 		char **value);
+
+/** open a file to read, taking "-" to mean stdin */
+FILE *openInputFile(const char *filename);
+void closeInputFile(FILE *fp);
 	
 #endif
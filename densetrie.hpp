@@ -0,0 +1,214 @@
+#ifndef	__DENSE_TRIE_HEADER__
+#define	__DENSE_TRIE_HEADER__
+
+#include <cstddef>
+#include <cstring>
+
+/**
+ * Header only C++ counterpart of the dense alphabet mode of the C
+ * trie (see trieSetAlphabet()).  Here the alphabet size N is a
+ * template parameter, so every node holds a fixed array of exactly
+ * N children and a step down the trie is one indexed load with no
+ * allocation or bounds bookkeeping at run time.
+ *
+ * The letters themselves are only known when the trie is built, so
+ * DenseAlphabet<N> keeps the byte to code table.  The N == 256 case
+ * is specialized to the identity and needs no table at all.
+ */
+namespace aa {
+
+template <unsigned N>
+class DenseAlphabet {
+public:
+	/** letters after the first N are ignored */
+	explicit DenseAlphabet(const char *letters)
+	{
+		unsigned n = 0;
+
+		for (unsigned i = 0; i < 256; i++)
+			codes_[i] = N;
+		for (; letters != nullptr && *letters != '\0' && n < N; letters++) {
+			unsigned char c = (unsigned char) *letters;
+			if (codes_[c] == N) {
+				codes_[c] = (unsigned short) n;
+				letters_[n++] = c;
+			}
+		}
+		size_ = n;
+	}
+
+	/** the code for a byte, or N if it is not in the alphabet */
+	unsigned code(unsigned char c) const { return codes_[c]; }
+	unsigned char letter(unsigned code) const { return letters_[code]; }
+	unsigned size() const { return size_; }
+
+private:
+	unsigned short codes_[256];
+	unsigned char letters_[N];
+	unsigned size_;
+};
+
+/** every byte is its own code */
+template <>
+class DenseAlphabet<256> {
+public:
+	explicit DenseAlphabet(const char * = nullptr) {}
+
+	unsigned code(unsigned char c) const { return c; }
+	unsigned char letter(unsigned code) const { return (unsigned char) code; }
+	unsigned size() const { return 256; }
+};
+
+
+template <typename V, unsigned N>
+class DenseTrie {
+public:
+	explicit DenseTrie(const char *letters = nullptr)
+		: alphabet_(letters), root_(new Node()), nEntries_(0), maxKeyLength_(0) {}
+	~DenseTrie() { deleteNode(root_); }
+
+	/** owns raw nodes, so copying is not allowed */
+	DenseTrie(const DenseTrie &) = delete;
+	DenseTrie &operator=(const DenseTrie &) = delete;
+
+	/**
+	 * Add or replace the value for a key.  Returns false if the key
+	 * holds a letter outside the alphabet.
+	 */
+	bool insert(const unsigned char *key, size_t keylength, const V &value)
+	{
+		Node *node = root_;
+		size_t i;
+
+		/** check the whole key first so that nothing is half added */
+		for (i = 0; i < keylength; i++) {
+			if (alphabet_.code(key[i]) >= N)
+				return false;
+		}
+
+		for (i = 0; i < keylength; i++) {
+			Node *&child = node->children[alphabet_.code(key[i])];
+			if (child == nullptr)
+				child = new Node();
+			node = child;
+		}
+
+		if ( ! node->isKeySoHasValue) {
+			node->isKeySoHasValue = true;
+			nEntries_++;
+		}
+		node->value = value;
+		if (keylength > maxKeyLength_)
+			maxKeyLength_ = keylength;
+		return true;
+	}
+
+	/** the value for the key, or nullptr if it is not present */
+	V *lookup(const unsigned char *key, size_t keylength) const
+	{
+		Node *node = find(key, keylength);
+
+		if (node == nullptr || ! node->isKeySoHasValue)
+			return nullptr;
+		return &node->value;
+	}
+
+	/** remove the key (nodes are kept, as in the C trie) */
+	bool remove(const unsigned char *key, size_t keylength)
+	{
+		Node *node = find(key, keylength);
+
+		if (node == nullptr || ! node->isKeySoHasValue)
+			return false;
+		node->isKeySoHasValue = false;
+		node->value = V();
+		nEntries_--;
+		return true;
+	}
+
+	/**
+	 * Call f(key, keylength, value) on every key, in the order of the
+	 * alphabet.  Stops early (returning -1) if f returns a negative
+	 * value; otherwise returns the number of keys visited.
+	 */
+	template <typename F>
+	long iterate(F f) const
+	{
+		unsigned char *buffer = new unsigned char[maxKeyLength_ + 1];
+		long nKeys = iterateNode(root_, buffer, 0, f);
+
+		delete [] buffer;
+		return nKeys;
+	}
+
+	size_t size() const { return nEntries_; }
+	const DenseAlphabet<N> &alphabet() const { return alphabet_; }
+
+private:
+	struct Node {
+		Node *children[N];
+		V value;
+		bool isKeySoHasValue;
+
+		Node() : value(), isKeySoHasValue(false)
+		{
+			memset(children, 0, sizeof(children));
+		}
+	};
+
+	Node *find(const unsigned char *key, size_t keylength) const
+	{
+		Node *node = root_;
+		unsigned code;
+
+		for (size_t i = 0; node != nullptr && i < keylength; i++) {
+			code = alphabet_.code(key[i]);
+			if (code >= N)
+				return nullptr;
+			node = node->children[code];
+		}
+		return node;
+	}
+
+	template <typename F>
+	long iterateNode(Node *node, unsigned char *buffer, size_t depth, F &f) const
+	{
+		long nKeys = 0, nBelow;
+
+		if (node->isKeySoHasValue) {
+			buffer[depth] = '\0';
+			if (f((const unsigned char *) buffer, depth, node->value) < 0)
+				return -1;
+			nKeys++;
+		}
+
+		for (unsigned i = 0; i < N; i++) {
+			if (node->children[i] == nullptr)
+				continue;
+			buffer[depth] = alphabet_.letter(i);
+			nBelow = iterateNode(node->children[i], buffer, depth + 1, f);
+			if (nBelow < 0)
+				return -1;
+			nKeys += nBelow;
+		}
+		return nKeys;
+	}
+
+	static void deleteNode(Node *node)
+	{
+		for (unsigned i = 0; i < N; i++) {
+			if (node->children[i] != nullptr)
+				deleteNode(node->children[i]);
+		}
+		delete node;
+	}
+
+	DenseAlphabet<N> alphabet_;
+	Node *root_;
+	size_t nEntries_;
+	size_t maxKeyLength_;
+};
+
+} // namespace aa
+
+#endif /* __DENSE_TRIE_HEADER__ */
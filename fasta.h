@@ -5,21 +5,47 @@
  * Macros to define lengths for parsing
  */
 #define	FASTA_MAX_ID_LEN 15
+#define	FASTA_MAX_ENTRY_NAME_LEN 23
 #define	FASTA_MAX_SEQUENCE_LINES 1024
 #define	FASTA_RECOMMENDED_LINE_LENGTH 80
 #define	FASTA_MAX_DESCRIPTION_LINE_LENGTH 1024
 
 /**
- * Define our record type with a char based ID field
+ * Define our record type with a char based ID field.
+ *
+ * The UniProt fields of the description are parsed out into typed
+ * columns by fastaParseFields(), for readers that want them; any that
+ * are missing (or not parsed) are left NULL or 0.
+ *
+ * Records kept in a deduplicating store (see fasta_store.h) have the
+ * protein name, organism and trailing fields of the description split
+ * out into shared strings, and share their sequence with identical
+ * records; inStore marks them so they are not freed one by one.
  */
 typedef struct FASTArecord {
 	char id[FASTA_MAX_ID_LEN+1];
+	char entryName[FASTA_MAX_ENTRY_NAME_LEN+1];	/* "001R_FRG3G", if any */
 	char *description;
+	char *descName;		/* " Protein name", if split out */
+	char *descOrganism;	/* " OS=... OX=...", if split out */
+	char *descFields;	/* " GN=... PE=... SV=...", if split out */
 	char *sequence;
+
+	/** parsed from the description */
+	char *organism;		/* OS= */
+	unsigned long taxon;	/* OX= */
+	char *gene;			/* GN= */
+	int existence;		/* PE=, 1 to 5 */
+	int version;		/* SV= */
+
+	int inStore;
+	int refCount;		/* map keys naming this record */
+	int fieldSlot[3];	/* place in each field index set holding it */
 } FASTArecord;
 
 /** prototypes */
 int  fastaReadRecord(FILE *ifp, FASTArecord *fRecord);
+int  fastaParseFields(FASTArecord *fRecord);
 void fastaInitializeRecord(FASTArecord *fRecord);
 FASTArecord * fastaAllocateRecord();
 int  fastaPrintRecord(FILE *ofp, FASTArecord *fRecord);
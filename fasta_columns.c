@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#ifdef	__SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fasta_columns.h"
+
+#define	COLUMN_MIN_RECORDS	1024
+#define	COLUMN_MIN_BYTES	(64 * 1024)
+
+/**
+ * The SSE2 class scan counts matches in byte lanes, so it must fold the
+ * lanes into the totals before any lane can pass 255
+ */
+#define	COLUMN_MAX_LANE_CHUNKS	255
+
+
+/** create an empty set of columns */
+FASTAcolumns *
+fastaColumnsCreate()
+{
+	FASTAcolumns *columns;
+
+	columns = (FASTAcolumns *) malloc(sizeof(FASTAcolumns));
+	if (columns == NULL)
+		return NULL;
+	memset(columns, 0, sizeof(FASTAcolumns));
+	return columns;
+}
+
+void
+fastaColumnsDelete(FASTAcolumns *columns)
+{
+	if (columns == NULL)	return;
+	free(columns->ids);
+	free(columns->descriptions.offsets);
+	free(columns->descriptions.bytes);
+	free(columns->sequences.offsets);
+	free(columns->sequences.bytes);
+	free(columns);
+}
+
+/** make room for one more record in every column */
+static int
+columnsGrowRecords(FASTAcolumns *columns)
+{
+	size_t *descOffsets, *seqOffsets;
+	char (*ids)[FASTA_MAX_ID_LEN+1];
+	int size;
+
+	size = (columns->maxRecords == 0) ? COLUMN_MIN_RECORDS : columns->maxRecords * 2;
+
+	/** the offset columns hold one more entry, the end of the last record */
+	ids = realloc(columns->ids, size * sizeof(*ids));
+	if (ids == NULL)
+		return -1;
+	columns->ids = ids;
+	descOffsets = (size_t *) realloc(columns->descriptions.offsets,
+			(size + 1) * sizeof(size_t));
+	if (descOffsets == NULL)
+		return -1;
+	columns->descriptions.offsets = descOffsets;
+	seqOffsets = (size_t *) realloc(columns->sequences.offsets,
+			(size + 1) * sizeof(size_t));
+	if (seqOffsets == NULL)
+		return -1;
+	columns->sequences.offsets = seqOffsets;
+
+	if (columns->maxRecords == 0) {
+		columns->descriptions.offsets[0] = 0;
+		columns->sequences.offsets[0] = 0;
+	}
+	columns->maxRecords = size;
+	return 0;
+}
+
+/** add the string (which may be NULL) to the end of the column */
+static int
+columnAppendBytes(FASTAbyteColumn *column, const char *string)
+{
+	size_t length, size;
+	char *grown;
+
+	if (string == NULL)
+		return 0;
+	length = strlen(string);
+
+	if (column->nBytes + length + 1 > column->maxBytes) {
+		size = (column->maxBytes == 0) ? COLUMN_MIN_BYTES : column->maxBytes;
+		while (column->nBytes + length + 1 > size)
+			size *= 2;
+		grown = (char *) realloc(column->bytes, size);
+		if (grown == NULL)
+			return -1;
+		column->bytes = grown;
+		column->maxBytes = size;
+	}
+
+	/** the '\0' is overwritten if another part is added after this one */
+	memcpy(&column->bytes[column->nBytes], string, length + 1);
+	column->nBytes += length;
+	return 0;
+}
+
+/** end the current record's bytes, keeping their '\0' */
+static int
+columnEndRecord(FASTAbyteColumn *column, int record)
+{
+	if (columnAppendBytes(column, "") < 0)
+		return -1;
+	column->nBytes++;
+	column->offsets[record + 1] = column->nBytes;
+	return 0;
+}
+
+/**
+ * Copy the record onto the end of the columns.  A description split
+ * up by a record store is joined back together.
+ */
+int
+fastaColumnsAppend(FASTAcolumns *columns, const FASTArecord *fRecord)
+{
+	int record = columns->nRecords;
+
+	if (record == columns->maxRecords && columnsGrowRecords(columns) < 0)
+		return -1;
+
+	strcpy(columns->ids[record], fRecord->id);
+
+	if (columnAppendBytes(&columns->descriptions, fRecord->description) < 0
+			|| columnAppendBytes(&columns->descriptions, fRecord->descName) < 0
+			|| columnAppendBytes(&columns->descriptions, fRecord->descOrganism) < 0
+			|| columnAppendBytes(&columns->descriptions, fRecord->descFields) < 0
+			|| columnEndRecord(&columns->descriptions, record) < 0)
+		return -1;
+
+	if (columnAppendBytes(&columns->sequences, fRecord->sequence) < 0
+			|| columnEndRecord(&columns->sequences, record) < 0)
+		return -1;
+
+	columns->nResidues += columns->sequences.offsets[record + 1]
+			- columns->sequences.offsets[record] - 1;
+	columns->nRecords++;
+	return 0;
+}
+
+/**
+ * Read every record in the file onto the end of the columns.  A
+ * single record is reused for the reading, so each sequence is only
+ * ever held here.  Returns the number of records read, or -1.
+ */
+int
+fastaColumnsLoad(FASTAcolumns *columns, char *filename)
+{
+	FASTArecord fRecord;
+	int nEntries = 0, status;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Failed to open input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	fastaInitializeRecord(&fRecord);
+	while ((status = fastaReadRecord(fp, &fRecord)) > 0) {
+		if (fastaColumnsAppend(columns, &fRecord) < 0) {
+			fprintf(stderr, "Error: cannot copy records into columns\n");
+			status = -1;
+		}
+		fastaClearRecord(&fRecord);
+		if (status < 0)
+			break;
+		nEntries++;
+	}
+	fclose(fp);
+
+	if (status < 0)
+		return -1;
+	return nEntries;
+}
+
+/** the sequence of the given record, and its length */
+const char *
+fastaColumnsSequence(FASTAcolumns *columns, int record, size_t *length)
+{
+	if (length != NULL) {
+		*length = columns->sequences.offsets[record + 1]
+				- columns->sequences.offsets[record] - 1;
+	}
+	return &columns->sequences.bytes[columns->sequences.offsets[record]];
+}
+
+const char *
+fastaColumnsDescription(FASTAcolumns *columns, int record)
+{
+	return &columns->descriptions.bytes[columns->descriptions.offsets[record]];
+}
+
+/**
+ * Minimum, maximum, total, mean and standard deviation of the
+ * sequence lengths, all taken from the offset column alone
+ */
+void
+fastaColumnsLengthStats(FASTAcolumns *columns, FASTAlengthStats *stats)
+{
+	const size_t *offsets = columns->sequences.offsets;
+	size_t length, minimum = (size_t) -1, maximum = 0;
+	double sumSquares = 0, mean, variance;
+	int i;
+
+	memset(stats, 0, sizeof(FASTAlengthStats));
+	if (columns->nRecords == 0)
+		return;
+
+	for (i = 0; i < columns->nRecords; i++) {
+		length = offsets[i + 1] - offsets[i] - 1;
+		minimum = (length < minimum) ? length : minimum;
+		maximum = (length > maximum) ? length : maximum;
+		sumSquares += (double) length * (double) length;
+	}
+
+	mean = (double) columns->nResidues / columns->nRecords;
+	variance = sumSquares / columns->nRecords - mean * mean;
+
+	stats->minimum = minimum;
+	stats->maximum = maximum;
+	stats->total = columns->nResidues;
+	stats->mean = mean;
+	stats->stddev = (variance > 0) ? sqrt(variance) : 0;
+}
+
+#ifdef	__SSE2__
+/** add up the sixteen byte lanes */
+static uint32_t
+columnLaneSum(__m128i lanes)
+{
+	__m128i sums = _mm_sad_epu8(lanes, _mm_setzero_si128());
+
+	return (uint32_t) (_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+}
+#endif
+
+/**
+ * Residue composition of every record: counts must hold
+ * FASTA_RESIDUES entries per record, and record i's count of
+ * letter 'A' + j is left in counts[i * FASTA_RESIDUES + j].
+ *
+ * A byte histogram does not map onto SSE2 well (comparing every lane
+ * against all 26 letters measured well under half the speed of this),
+ * so instead four tables are filled in turn, which keeps successive
+ * increments of the same letter from waiting on one another.  Only
+ * the 'A' to 'Z' entries are read, and cleared for the next record;
+ * anything else piles up harmlessly.
+ */
+void
+fastaColumnsComposition(FASTAcolumns *columns, uint32_t *counts)
+{
+	uint32_t tables[4][256], *recordCounts;
+	const unsigned char *sequence;
+	size_t length, j;
+	int i, letter;
+
+	memset(tables, 0, sizeof(tables));
+	for (i = 0; i < columns->nRecords; i++) {
+		sequence = (const unsigned char *) fastaColumnsSequence(columns, i, &length);
+
+		for (j = 0; j + 4 <= length; j += 4) {
+			tables[0][sequence[j]]++;
+			tables[1][sequence[j + 1]]++;
+			tables[2][sequence[j + 2]]++;
+			tables[3][sequence[j + 3]]++;
+		}
+		for ( ; j < length; j++)
+			tables[0][sequence[j]]++;
+
+		recordCounts = &counts[i * FASTA_RESIDUES];
+		for (letter = 'A'; letter <= 'Z'; letter++) {
+			recordCounts[letter - 'A'] = tables[0][letter] + tables[1][letter]
+					+ tables[2][letter] + tables[3][letter];
+			tables[0][letter] = tables[1][letter] = 0;
+			tables[2][letter] = tables[3][letter] = 0;
+		}
+	}
+}
+
+/**
+ * Count, for every record, the residues belonging to the character
+ * class made up of the given letters (e.g. "AVILMFWY" for the
+ * hydrophobic residues), leaving record i's count in counts[i].
+ * With SSE2, sixteen residues are compared against each letter at
+ * once, and the matches (all ones, so -1) are subtracted into byte
+ * counters.
+ */
+void
+fastaColumnsClassCount(FASTAcolumns *columns, const char *letters,
+		uint32_t *counts)
+{
+	unsigned char inClass[256];
+	const unsigned char *sequence;
+	size_t length, j;
+	int i, k, nLetters = 0;
+
+#ifdef	__SSE2__
+	__m128i block, matches, lanes, members[256];
+	int chunk;
+#endif
+
+	memset(inClass, 0, sizeof(inClass));
+	for (k = 0; letters[k] != '\0'; k++) {
+		if ( ! inClass[(unsigned char) letters[k]]) {
+			inClass[(unsigned char) letters[k]] = 1;
+#ifdef	__SSE2__
+			members[nLetters] = _mm_set1_epi8(letters[k]);
+#endif
+			nLetters++;
+		}
+	}
+
+	for (i = 0; i < columns->nRecords; i++) {
+		sequence = (const unsigned char *) fastaColumnsSequence(columns, i, &length);
+		counts[i] = 0;
+		j = 0;
+
+#ifdef	__SSE2__
+		while (j + 16 <= length) {
+			lanes = _mm_setzero_si128();
+			for (chunk = 0; chunk < COLUMN_MAX_LANE_CHUNKS && j + 16 <= length;
+					chunk++, j += 16) {
+				block = _mm_loadu_si128((const __m128i *) &sequence[j]);
+				matches = _mm_setzero_si128();
+				for (k = 0; k < nLetters; k++) {
+					matches = _mm_or_si128(matches,
+							_mm_cmpeq_epi8(block, members[k]));
+				}
+				lanes = _mm_sub_epi8(lanes, matches);
+			}
+			counts[i] += columnLaneSum(lanes);
+		}
+#endif
+
+		for ( ; j < length; j++)
+			counts[i] += inClass[sequence[j]];
+	}
+}
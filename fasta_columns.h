@@ -0,0 +1,61 @@
+#ifndef	__FASTA_COLUMN_STORE_HEADER__
+#define	__FASTA_COLUMN_STORE_HEADER__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fasta.h"
+
+/**
+ * Columnar (struct of arrays) store of a set of records: one
+ * contiguous ID column, and the descriptions and sequences each
+ * packed end to end into a single byte column with an offset per
+ * record.  Every string is still '\0' terminated in place, so the
+ * columns can be handed to code expecting C strings.
+ *
+ * Passes over every sequence then stream through one buffer instead
+ * of chasing a pointer per record.  The character class scan uses
+ * SSE2 where the compiler offers it.
+ */
+#define	FASTA_RESIDUES	26	/* composition counts 'A' to 'Z' */
+
+typedef struct FASTAbyteColumn {
+	size_t *offsets;	/* start of each record's bytes */
+	char *bytes;
+	size_t nBytes;
+	size_t maxBytes;
+} FASTAbyteColumn;
+
+typedef struct FASTAcolumns {
+	int nRecords;
+	int maxRecords;
+	char (*ids)[FASTA_MAX_ID_LEN+1];
+	FASTAbyteColumn descriptions;
+	FASTAbyteColumn sequences;
+	size_t nResidues;	/* over all sequences, not counting the '\0's */
+} FASTAcolumns;
+
+typedef struct FASTAlengthStats {
+	size_t minimum;
+	size_t maximum;
+	size_t total;
+	double mean;
+	double stddev;
+} FASTAlengthStats;
+
+/** prototypes */
+FASTAcolumns *fastaColumnsCreate();
+void fastaColumnsDelete(FASTAcolumns *columns);
+
+int  fastaColumnsAppend(FASTAcolumns *columns, const FASTArecord *fRecord);
+int  fastaColumnsLoad(FASTAcolumns *columns, char *filename);
+
+const char *fastaColumnsSequence(FASTAcolumns *columns, int record, size_t *length);
+const char *fastaColumnsDescription(FASTAcolumns *columns, int record);
+
+void fastaColumnsLengthStats(FASTAcolumns *columns, FASTAlengthStats *stats);
+void fastaColumnsComposition(FASTAcolumns *columns, uint32_t *counts);
+void fastaColumnsClassCount(FASTAcolumns *columns, const char *letters,
+		uint32_t *counts);
+
+#endif /* __FASTA_COLUMN_STORE_HEADER__ */
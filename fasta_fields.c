@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fasta_fields.h"
+
+#define	FIELD_SET_MIN_SIZE	4
+
+/** which of a record's fieldSlot[] entries each index uses */
+#define	FIELD_SLOT_ORGANISM	0
+#define	FIELD_SLOT_TAXON	1
+#define	FIELD_SLOT_GENE		2
+
+
+/** create an empty index */
+FASTAfieldIndex *
+fastaFieldIndexCreate()
+{
+	FASTAfieldIndex *index;
+
+	index = (FASTAfieldIndex *) malloc(sizeof(FASTAfieldIndex));
+	if (index == NULL)
+		return NULL;
+
+	/** the hashing arguments are ignored by the trie */
+	index->byOrganism = aaCreateAssociativeArray(0, "lin", "sum", "len");
+	index->byTaxon = aaCreateAssociativeArray(0, "lin", "sum", "len");
+	index->byGene = aaCreateAssociativeArray(0, "lin", "sum", "len");
+	if (index->byOrganism == NULL || index->byTaxon == NULL
+			|| index->byGene == NULL) {
+		fastaFieldIndexDelete(index);
+		return NULL;
+	}
+	return index;
+}
+
+static int
+deleteRecordSet(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	FASTArecordSet *set = (FASTArecordSet *) value;
+
+	if (set != NULL) {
+		free(set->records);
+		free(set);
+	}
+	return 0;
+}
+
+static void
+deleteFieldArray(AssociativeArray *array)
+{
+	if (array == NULL)	return;
+	aaIterateAction(array, deleteRecordSet, NULL);
+	aaDeleteAssociativeArray(array);
+}
+
+/** free the index, but not the records it points at */
+void
+fastaFieldIndexDelete(FASTAfieldIndex *index)
+{
+	if (index == NULL)	return;
+	deleteFieldArray(index->byOrganism);
+	deleteFieldArray(index->byTaxon);
+	deleteFieldArray(index->byGene);
+	free(index);
+}
+
+/**
+ * Close up the holes left by removed records, keeping the others in
+ * order and updating the place each one records for this field
+ */
+static void
+compactSet(FASTArecordSet *set, int field)
+{
+	int i, n = 0;
+
+	for (i = 0; i < set->nRecords; i++) {
+		if (set->records[i] != NULL) {
+			set->records[n] = set->records[i];
+			set->records[n]->fieldSlot[field] = n;
+			n++;
+		}
+	}
+	set->nRecords = n;
+	set->nRemoved = 0;
+}
+
+/** add the record to the set, creating the set if there is none yet */
+static FASTArecordSet *
+addToSet(FASTArecordSet *set, FASTArecord *record, int field)
+{
+	FASTArecord **grown;
+	int size;
+
+	if (set == NULL) {
+		set = (FASTArecordSet *) malloc(sizeof(FASTArecordSet));
+		if (set == NULL)
+			return NULL;
+		memset(set, 0, sizeof(FASTArecordSet));
+	}
+
+	if (set->nRecords == set->maxRecords && set->nRemoved > 0)
+		compactSet(set, field);
+	if (set->nRecords == set->maxRecords) {
+		size = (set->maxRecords == 0) ? FIELD_SET_MIN_SIZE : set->maxRecords * 2;
+		grown = (FASTArecord **) realloc(set->records,
+				size * sizeof(FASTArecord *));
+		if (grown == NULL)
+			return NULL;
+		set->records = grown;
+		set->maxRecords = size;
+	}
+	record->fieldSlot[field] = set->nRecords;
+	set->records[set->nRecords++] = record;
+	return set;
+}
+
+/**
+ * Take the record out of the set.  It is found through the place it
+ * recorded when added, and leaves a hole that is closed up once holes
+ * make up half the set, or before the set is next handed out.
+ */
+static void
+removeFromSet(FASTArecordSet *set, FASTArecord *record, int field)
+{
+	int i = record->fieldSlot[field];
+
+	if (set == NULL || i >= set->nRecords || set->records[i] != record)
+		return;
+	set->records[i] = NULL;
+	set->nRemoved++;
+	if (set->nRemoved * 2 > set->nRecords)
+		compactSet(set, field);
+}
+
+static int
+addByString(AssociativeArray *array, const char *value, FASTArecord *record,
+		int field)
+{
+	FASTArecordSet *set, *updated;
+
+	set = (FASTArecordSet *) aaLookup(array, (AAKeyType) value, strlen(value));
+	updated = addToSet(set, record, field);
+	if (updated == NULL)
+		return -1;
+	if (set == NULL && aaInsert(array, (AAKeyType) value, strlen(value), updated) < 0) {
+		deleteRecordSet(NULL, 0, updated, NULL);
+		return -1;
+	}
+	return 0;
+}
+
+/** index the record under each of the fields it has */
+int
+fastaFieldIndexAdd(FASTAfieldIndex *index, FASTArecord *record)
+{
+	FASTArecordSet *set, *updated;
+
+	if (record->organism != NULL
+			&& addByString(index->byOrganism, record->organism, record,
+					FIELD_SLOT_ORGANISM) < 0)
+		return -1;
+
+	if (record->gene != NULL
+			&& addByString(index->byGene, record->gene, record,
+					FIELD_SLOT_GENE) < 0)
+		return -1;
+
+	if (record->taxon != 0) {
+		set = (FASTArecordSet *) aaLookupU64(index->byTaxon, record->taxon);
+		updated = addToSet(set, record, FIELD_SLOT_TAXON);
+		if (updated == NULL)
+			return -1;
+		if (set == NULL && aaInsertU64(index->byTaxon, record->taxon, updated) < 0) {
+			deleteRecordSet(NULL, 0, updated, NULL);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/** drop the record from the index, before it is freed */
+void
+fastaFieldIndexRemove(FASTAfieldIndex *index, FASTArecord *record)
+{
+	if (record->organism != NULL)
+		removeFromSet((FASTArecordSet *) aaLookup(index->byOrganism,
+					(AAKeyType) record->organism, strlen(record->organism)),
+				record, FIELD_SLOT_ORGANISM);
+	if (record->gene != NULL)
+		removeFromSet((FASTArecordSet *) aaLookup(index->byGene,
+					(AAKeyType) record->gene, strlen(record->gene)),
+				record, FIELD_SLOT_GENE);
+	if (record->taxon != 0)
+		removeFromSet((FASTArecordSet *) aaLookupU64(index->byTaxon, record->taxon),
+				record, FIELD_SLOT_TAXON);
+}
+
+/** hand out a set with no holes in it */
+static FASTArecordSet *
+compactedSet(FASTArecordSet *set, int field)
+{
+	if (set != NULL && set->nRemoved > 0)
+		compactSet(set, field);
+	return set;
+}
+
+/**
+ * Find the records with the given field value, in the order they
+ * were added, or NULL if there have never been any
+ */
+FASTArecordSet *
+fastaFieldIndexByOrganism(FASTAfieldIndex *index, const char *organism)
+{
+	return compactedSet((FASTArecordSet *) aaLookup(index->byOrganism,
+			(AAKeyType) organism, strlen(organism)), FIELD_SLOT_ORGANISM);
+}
+
+FASTArecordSet *
+fastaFieldIndexByTaxon(FASTAfieldIndex *index, unsigned long taxon)
+{
+	return compactedSet((FASTArecordSet *) aaLookupU64(index->byTaxon, taxon),
+			FIELD_SLOT_TAXON);
+}
+
+FASTArecordSet *
+fastaFieldIndexByGene(FASTAfieldIndex *index, const char *gene)
+{
+	return compactedSet((FASTArecordSet *) aaLookup(index->byGene,
+			(AAKeyType) gene, strlen(gene)), FIELD_SLOT_GENE);
+}
@@ -0,0 +1,41 @@
+#ifndef	__FASTA_FIELD_INDEX_HEADER__
+#define	__FASTA_FIELD_INDEX_HEADER__
+
+#include "aarray.h"
+#include "fasta.h"
+
+/**
+ * Secondary indexes over the parsed description fields of a set of
+ * records: organism name (OS=), taxon (OX=) and gene (GN=), each an
+ * associative array from the field value to the records carrying it.
+ *
+ * The index only points at the records; they must be removed from
+ * it before they are freed.  Each record remembers its place in the
+ * sets holding it, so removal does not search them; the holes it
+ * leaves are closed up before a set is handed out.
+ */
+typedef struct FASTArecordSet {
+	FASTArecord **records;
+	int nRecords;
+	int maxRecords;
+	int nRemoved;		/* holes (NULL entries) among the records */
+} FASTArecordSet;
+
+typedef struct FASTAfieldIndex {
+	AssociativeArray *byOrganism;
+	AssociativeArray *byTaxon;	/* integer keys */
+	AssociativeArray *byGene;
+} FASTAfieldIndex;
+
+/** prototypes */
+FASTAfieldIndex *fastaFieldIndexCreate();
+void fastaFieldIndexDelete(FASTAfieldIndex *index);
+
+int  fastaFieldIndexAdd(FASTAfieldIndex *index, FASTArecord *record);
+void fastaFieldIndexRemove(FASTAfieldIndex *index, FASTArecord *record);
+
+FASTArecordSet *fastaFieldIndexByOrganism(FASTAfieldIndex *index, const char *organism);
+FASTArecordSet *fastaFieldIndexByTaxon(FASTAfieldIndex *index, unsigned long taxon);
+FASTArecordSet *fastaFieldIndexByGene(FASTAfieldIndex *index, const char *gene);
+
+#endif /* __FASTA_FIELD_INDEX_HEADER__ */
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "fasta.h"
+#include "hashmix.h"
+#include "fasta_index.h"
+
+#define	FASTA_INDEX_MAGIC	"AASUFAR1"
+#define	FASTA_INDEX_NBUCKETS	(256 * 256)
+
+/**
+ * The text being sorted.  qsort(3) gives the comparator no user
+ * data, so the text is parked here for the duration of a build;
+ * this means only one build may run at a time.
+ */
+static const unsigned char *sSortText = NULL;
+
+/** the work shared between the sorting threads */
+typedef struct FASTAindexBuild {
+	FASTAsuffixIndex *index;
+	size_t *bucketStart;
+	int nextBucket;
+	pthread_mutex_t lock;
+} FASTAindexBuild;
+
+
+/** FNV-1a, used to recognize a saved index built from the same text */
+static uint64_t
+fastaIndexChecksum(const unsigned char *text, size_t length)
+{
+	return hashFnv1a(text, length);
+}
+
+/**
+ * Compare two suffixes.  A separator ends a suffix, and sorts
+ * before any residue; two suffixes that are equal up to their
+ * separators are ordered by position so the sort is total.
+ */
+static int
+fastaIndexSuffixComparator(const void *a, const void *b)
+{
+	uint32_t posA = *(const uint32_t *) a;
+	uint32_t posB = *(const uint32_t *) b;
+	const unsigned char *sA = &sSortText[posA];
+	const unsigned char *sB = &sSortText[posB];
+
+	while (*sA == *sB && *sA != FASTA_INDEX_SEPARATOR) {
+		sA++;
+		sB++;
+	}
+	if (*sA == FASTA_INDEX_SEPARATOR && *sB == FASTA_INDEX_SEPARATOR)
+		return (posA < posB) ? -1 : (posA > posB);
+	return (int) *sA - (int) *sB;
+}
+
+/**
+ * Join the sequences of the given records into one text and
+ * prepare an (unsorted) index over it
+ */
+FASTAsuffixIndex *
+fastaIndexCreate(FASTArecord **records, int nRecords)
+{
+	FASTAsuffixIndex *index;
+	size_t length = 0, seqLength, pos;
+	int i;
+
+	for (i = 0; i < nRecords; i++) {
+		if (records[i]->sequence != NULL)
+			length += strlen(records[i]->sequence);
+		length++;
+	}
+	if (length > UINT32_MAX) {
+		fprintf(stderr, "Error: %lu residues are too many to index\n",
+				(unsigned long) length);
+		return NULL;
+	}
+
+	index = (FASTAsuffixIndex *) malloc(sizeof(FASTAsuffixIndex));
+	if (index == NULL)
+		return NULL;
+	memset(index, 0, sizeof(FASTAsuffixIndex));
+
+	index->records = records;
+	index->nRecords = nRecords;
+	index->textLength = length;
+	index->text = (unsigned char *) malloc(length + 1);
+	index->recordStart = (size_t *) malloc((nRecords + 1) * sizeof(size_t));
+	index->suffixes = (uint32_t *) malloc((length + 1) * sizeof(uint32_t));
+	if (index->text == NULL || index->recordStart == NULL
+			|| index->suffixes == NULL) {
+		fastaIndexDelete(index);
+		return NULL;
+	}
+
+	pos = 0;
+	for (i = 0; i < nRecords; i++) {
+		index->recordStart[i] = pos;
+		if (records[i]->sequence != NULL) {
+			seqLength = strlen(records[i]->sequence);
+			memcpy(&index->text[pos], records[i]->sequence, seqLength);
+			pos += seqLength;
+		}
+		index->text[pos++] = FASTA_INDEX_SEPARATOR;
+	}
+	index->recordStart[nRecords] = pos;
+	index->text[pos] = '\0';
+
+	/** only residues start suffixes */
+	index->nSuffixes = length - nRecords;
+	index->checksum = fastaIndexChecksum(index->text, length);
+
+	return index;
+}
+
+/** sorting thread: keep taking buckets until none remain */
+static void *
+fastaIndexSortWorker(void *userdata)
+{
+	FASTAindexBuild *build = (FASTAindexBuild *) userdata;
+	size_t start, count;
+	int bucket;
+
+	for (;;) {
+		pthread_mutex_lock(&build->lock);
+		bucket = build->nextBucket++;
+		pthread_mutex_unlock(&build->lock);
+
+		if (bucket >= FASTA_INDEX_NBUCKETS)
+			break;
+
+		start = build->bucketStart[bucket];
+		count = build->bucketStart[bucket + 1] - start;
+		if (count > 1) {
+			qsort(&build->index->suffixes[start], count,
+					sizeof(uint32_t), fastaIndexSuffixComparator);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Sort the suffixes.  A counting sort on the first two bytes splits
+ * the suffixes into buckets which are then sorted independently by
+ * the given number of threads.
+ */
+int
+fastaIndexBuild(FASTAsuffixIndex *index, int nThreads)
+{
+	FASTAindexBuild build;
+	pthread_t *threads;
+	size_t *fill, pos;
+	unsigned int bucket;
+	int i, nStarted;
+
+	if (nThreads < 1)
+		nThreads = 1;
+
+	build.index = index;
+	build.nextBucket = 0;
+	build.bucketStart = (size_t *) calloc(FASTA_INDEX_NBUCKETS + 1, sizeof(size_t));
+	fill = (size_t *) calloc(FASTA_INDEX_NBUCKETS, sizeof(size_t));
+	threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+	if (build.bucketStart == NULL || fill == NULL || threads == NULL) {
+		free(build.bucketStart);
+		free(fill);
+		free(threads);
+		return -1;
+	}
+
+	for (pos = 0; pos < index->textLength; pos++) {
+		if (index->text[pos] == FASTA_INDEX_SEPARATOR)
+			continue;
+		bucket = (index->text[pos] << 8) | index->text[pos + 1];
+		build.bucketStart[bucket + 1]++;
+	}
+	for (i = 0; i < FASTA_INDEX_NBUCKETS; i++)
+		build.bucketStart[i + 1] += build.bucketStart[i];
+	for (pos = 0; pos < index->textLength; pos++) {
+		if (index->text[pos] == FASTA_INDEX_SEPARATOR)
+			continue;
+		bucket = (index->text[pos] << 8) | index->text[pos + 1];
+		index->suffixes[build.bucketStart[bucket] + fill[bucket]++] = (uint32_t) pos;
+	}
+	free(fill);
+
+	sSortText = index->text;
+	pthread_mutex_init(&build.lock, NULL);
+	for (nStarted = 0; nStarted < nThreads; nStarted++) {
+		if (pthread_create(&threads[nStarted], NULL,
+					fastaIndexSortWorker, &build) != 0)
+			break;
+	}
+
+	/** if no threads could be started, do the work here */
+	if (nStarted == 0)
+		fastaIndexSortWorker(&build);
+
+	for (i = 0; i < nStarted; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&build.lock);
+	sSortText = NULL;
+
+	free(build.bucketStart);
+	free(threads);
+	return 0;
+}
+
+/**
+ * Read a previously saved suffix array.  The saved array is only
+ * used if it was built from exactly the same text; returns 1 if it
+ * was loaded, 0 if there is no usable saved index and -1 on error.
+ */
+int
+fastaIndexLoad(FASTAsuffixIndex *index, char *filename)
+{
+	char magic[sizeof(FASTA_INDEX_MAGIC)];
+	uint64_t header[4];
+	FILE *fp;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return 0;
+
+	if (fread(magic, 1, strlen(FASTA_INDEX_MAGIC), fp) != strlen(FASTA_INDEX_MAGIC)
+			|| memcmp(magic, FASTA_INDEX_MAGIC, strlen(FASTA_INDEX_MAGIC)) != 0
+			|| fread(header, sizeof(uint64_t), 4, fp) != 4
+			|| header[0] != index->textLength
+			|| header[1] != index->nSuffixes
+			|| header[2] != (uint64_t) index->nRecords
+			|| header[3] != index->checksum) {
+		fclose(fp);
+		return 0;
+	}
+
+	if (fread(index->suffixes, sizeof(uint32_t), index->nSuffixes, fp)
+			!= index->nSuffixes) {
+		fprintf(stderr, "Error: suffix array '%s' is truncated\n", filename);
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+	return 1;
+}
+
+/** write the suffix array so that the next run can skip the sort */
+int
+fastaIndexSave(FASTAsuffixIndex *index, char *filename)
+{
+	uint64_t header[4];
+	FILE *fp;
+
+	fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Warning: cannot save suffix array to '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	header[0] = index->textLength;
+	header[1] = index->nSuffixes;
+	header[2] = index->nRecords;
+	header[3] = index->checksum;
+
+	if (fwrite(FASTA_INDEX_MAGIC, 1, strlen(FASTA_INDEX_MAGIC), fp)
+				!= strlen(FASTA_INDEX_MAGIC)
+			|| fwrite(header, sizeof(uint64_t), 4, fp) != 4
+			|| fwrite(index->suffixes, sizeof(uint32_t), index->nSuffixes, fp)
+				!= index->nSuffixes) {
+		fprintf(stderr, "Warning: failed writing suffix array '%s'\n", filename);
+		fclose(fp);
+		remove(filename);
+		return -1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/** release the index; the records themselves belong to the caller */
+void
+fastaIndexDelete(FASTAsuffixIndex *index)
+{
+	if (index == NULL)	return;
+	free(index->text);
+	free(index->recordStart);
+	free(index->suffixes);
+	free(index);
+}
+
+/**
+ * Compare the pattern against the suffix at pos, knowing that the
+ * first *matched letters already agree.  Returns <0, 0 or >0 as the
+ * pattern is less than, a prefix of, or greater than the suffix,
+ * and leaves the number of agreeing letters in *matched.
+ */
+static int
+fastaIndexPrefixCompare(FASTAsuffixIndex *index,
+		const unsigned char *pattern, size_t patternLength,
+		size_t pos, size_t *matched)
+{
+	const unsigned char *suffix = &index->text[pos];
+	size_t k = *matched;
+
+	while (k < patternLength && suffix[k] == pattern[k]
+			&& suffix[k] != FASTA_INDEX_SEPARATOR)
+		k++;
+	*matched = k;
+
+	if (k == patternLength)
+		return 0;
+	if (suffix[k] == FASTA_INDEX_SEPARATOR)
+		return 1;
+	return (int) pattern[k] - (int) suffix[k];
+}
+
+/**
+ * Binary search for the first suffix that is not below the pattern
+ * (or, if upper is set, the first one the pattern is not a prefix
+ * of).  Letters known to agree with both ends of the range are
+ * skipped, so the pattern is rarely rescanned from the start.
+ */
+static size_t
+fastaIndexBound(FASTAsuffixIndex *index,
+		const unsigned char *pattern, size_t patternLength, int upper)
+{
+	size_t lo = 0, hi = index->nSuffixes, mid;
+	size_t lcpLo = 0, lcpHi = 0, matched;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		matched = (lcpLo < lcpHi) ? lcpLo : lcpHi;
+		cmp = fastaIndexPrefixCompare(index, pattern, patternLength,
+				index->suffixes[mid], &matched);
+		if (cmp < 0 || (cmp == 0 && ! upper)) {
+			hi = mid;
+			lcpHi = matched;
+		} else {
+			lo = mid + 1;
+			lcpLo = matched;
+		}
+	}
+	return lo;
+}
+
+/** find which record the text position belongs to */
+static int
+fastaIndexRecordAt(FASTAsuffixIndex *index, size_t pos)
+{
+	int lo = 0, hi = index->nRecords - 1, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (index->recordStart[mid] <= pos)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+static int
+fastaIndexIntComparator(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Call the user function once for each record containing the
+ * pattern, in record order.  Returns the number of records, or -1
+ * on error; the total number of occurrences is left in *nOccurrences.
+ */
+long
+fastaIndexSearch(FASTAsuffixIndex *index,
+		const char *pattern, long *nOccurrences,
+		int (*userfunction)(FASTArecord *record, void *userdata),
+		void *userdata)
+{
+	size_t patternLength = strlen(pattern);
+	size_t first, last, i;
+	long nRecords = 0;
+	int *hits;
+
+	*nOccurrences = 0;
+	if (patternLength == 0)
+		return 0;
+
+	first = fastaIndexBound(index, (const unsigned char *) pattern,
+			patternLength, 0);
+	last = fastaIndexBound(index, (const unsigned char *) pattern,
+			patternLength, 1);
+	if (first >= last)
+		return 0;
+
+	*nOccurrences = last - first;
+	hits = (int *) malloc((last - first) * sizeof(int));
+	if (hits == NULL)
+		return -1;
+	for (i = first; i < last; i++)
+		hits[i - first] = fastaIndexRecordAt(index, index->suffixes[i]);
+	qsort(hits, last - first, sizeof(int), fastaIndexIntComparator);
+
+	for (i = 0; i < last - first; i++) {
+		if (i > 0 && hits[i] == hits[i - 1])
+			continue;
+		nRecords++;
+		if ((*userfunction)(index->records[hits[i]], userdata) < 0) {
+			free(hits);
+			return -1;
+		}
+	}
+
+	free(hits);
+	return nRecords;
+}
+
@@ -0,0 +1,42 @@
+#ifndef	__FASTA_SUFFIX_INDEX_HEADER__
+#define	__FASTA_SUFFIX_INDEX_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "fasta.h"
+
+/**
+ * Suffix array over the concatenated sequences of a set of records.
+ *
+ * The sequences are joined with FASTA_INDEX_SEPARATOR between them,
+ * and every residue position is a suffix.  recordStart[i] is the
+ * offset of the first residue of records[i] within the text.
+ */
+#define	FASTA_INDEX_SEPARATOR	0x01
+#define	FASTA_INDEX_SUFFIX	".sa"
+
+typedef struct FASTAsuffixIndex {
+	FASTArecord **records;
+	int nRecords;
+	unsigned char *text;
+	size_t textLength;
+	size_t *recordStart;
+	uint32_t *suffixes;
+	size_t nSuffixes;
+	uint64_t checksum;
+} FASTAsuffixIndex;
+
+/** prototypes */
+FASTAsuffixIndex *fastaIndexCreate(FASTArecord **records, int nRecords);
+int  fastaIndexBuild(FASTAsuffixIndex *index, int nThreads);
+int  fastaIndexLoad(FASTAsuffixIndex *index, char *filename);
+int  fastaIndexSave(FASTAsuffixIndex *index, char *filename);
+void fastaIndexDelete(FASTAsuffixIndex *index);
+
+long fastaIndexSearch(FASTAsuffixIndex *index,
+		const char *pattern, long *nOccurrences,
+		int (*userfunction)(FASTArecord *record, void *userdata),
+		void *userdata);
+
+#endif /* __FASTA_SUFFIX_INDEX_HEADER__ */
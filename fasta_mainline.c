@@ -3,25 +3,119 @@
 #include <stdlib.h> /* for free() */
 #include <unistd.h> /* for getopt() */
 #include <ctype.h>  /* for isdigit() */
-#include <time.h>   /* for clock() */
 #include <errno.h>
 
 #include "aarray.h"
+#include "trie.h"
 #include "fasta.h"
+#include "fasta_index.h"
+#include "fasta_store.h"
+#include "fasta_fields.h"
+#include "accession.h"
 #include "data-reader.h"
+#include "latency.h"
+#include "perfcounters.h"
+#include "resultwriter.h"
+#include "querypipeline.h"
 
 #define	LINE_MAX	128
 
+/** the key is the record's ID, rather than its entry name */
+static int
+isRecordID(AAKeyType key, size_t keylen, FASTArecord *record)
+{
+	return keylen == strlen(record->id)
+			&& memcmp(key, record->id, keylen) == 0;
+}
+
+/**
+ * Drop one key's hold on the record, freeing it (and taking it out
+ * of the field index) once no key names it any more
+ */
+static void
+releaseRecord(FASTArecord *record, FASTAfieldIndex *fieldIndex)
+{
+	if (--record->refCount > 0)
+		return;
+	if (fieldIndex != NULL)
+		fastaFieldIndexRemove(fieldIndex, record);
+	fastaDeallocateRecord(record);
+}
+
+static void
+writeString(ResultWriter *results, const char *string)
+{
+	resultWriterString(results, string, strlen(string));
+}
+
+/**
+ * Report the record a key produced: in full, as fastaPrintRecord()
+ * prints it, or as one tab separated line of the key, ID, description
+ * (joined back up, without its newline) and sequence
+ */
+static void
+writeRecordResult(ResultWriter *results, const char *operation,
+		const char *key, FASTArecord *record)
+{
+	const char *parts[4];
+	size_t lengths[4];
+	int i, last = 0;
+
+	parts[0] = record->description;
+	parts[1] = record->descName;
+	parts[2] = record->descOrganism;
+	parts[3] = record->descFields;
+	for (i = 0; i < 4; i++) {
+		lengths[i] = (parts[i] == NULL) ? 0 : strlen(parts[i]);
+		if (lengths[i] > 0)
+			last = i;
+	}
+
+	if (results->format == RESULT_TSV) {
+		if (lengths[last] > 0 && parts[last][lengths[last] - 1] == '\n')
+			lengths[last]--;
+		writeString(results, operation);
+		writeString(results, "\t");
+		writeString(results, key);
+		writeString(results, "\t");
+		writeString(results, record->id);
+		writeString(results, "\t");
+		for (i = 0; i < 4; i++)
+			resultWriterString(results, parts[i], lengths[i]);
+		writeString(results, "\t");
+		writeString(results, record->sequence);
+		writeString(results, "\n");
+		return;
+	}
+
+	resultWriterPrintf(results, "%s: key '%s' produced record:\n", operation, key);
+	writeString(results, "FASTA Record:\nID   [");
+	writeString(results, record->id);
+	writeString(results, "]\nDESC [");
+	for (i = 0; i < 4; i++)
+		resultWriterString(results, parts[i], lengths[i]);
+	writeString(results, "]\nSEQ  [");
+	writeString(results, record->sequence);
+	writeString(results, "]\n");
+}
+
 /**
- * Load the associative array of attribute value entries
+ * Load the associative array of attribute value entries.  With a
+ * store, each record read is copied into it and the shared copy is
+ * what gets inserted, so the one parse record is reused throughout.
+ * With a field index, each record is also indexed by its fields.
+ * With useEntryNames, each record is keyed by its entry name as well
+ * as its ID; the record counts the keys naming it.
  */
 static int
-loadAssociativeArray(AssociativeArray *assocArray, char *filename)
+loadRecordMap(AccessionMap *recordMap, char *filename,
+		FASTAstore *store, FASTAfieldIndex *fieldIndex, int useEntryNames,
+		LatencyHistogram *latency, PerfCounters *perf)
 {
-	FASTArecord *fRecord = NULL;
-	clock_t startTime, endTime;
+	FASTArecord *fRecord = NULL, *value, *displaced;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int nEntries = 0;
+	int nEntries = 0, status;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -33,22 +127,72 @@ loadAssociativeArray(AssociativeArray *assocArray, char *filename)
 
 	fRecord = fastaAllocateRecord();
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (fastaReadRecord(fp, fRecord) > 0) {
-		if (aaInsert(assocArray,
-						(AAKeyType) fRecord->id, strlen(fRecord->id),
-						fRecord) < 0) {
+		/** only the field index looks at the parsed fields */
+		if (fieldIndex != NULL && fastaParseFields(fRecord) < 0) {
+			fprintf(stderr, "Failed to parse the fields of FASTA record '%s'\n",
+					fRecord->id);
+			return -1;
+		}
+		value = fRecord;
+		if (store != NULL) {
+			value = fastaStoreAdd(store, fRecord);
+			if (value == NULL) {
+				fprintf(stderr, "Failed to store FASTA record with key '%s'\n",
+						fRecord->id);
+				return -1;
+			}
+			fastaClearRecord(fRecord);
+		}
+		/** the ID replaces whatever the key named, which loses its hold */
+		displaced = (FASTArecord *) accessionMapLookup(recordMap, value->id);
+		opStart = latencyStart(latency);
+		status = accessionMapInsert(recordMap, value->id, value);
+		latencyStop(latency, opStart);
+		if (status < 0) {
 			fprintf(stderr,
 				"Failed to add FASTA record with key '%s' to associative array\n",
-				fRecord->id);
+				value->id);
+			return -1;
+		}
+		value->refCount++;
+		if (displaced != NULL) {
+			fprintf(stderr,
+				"Warning: ID '%s' is already a key of record '%s', which it replaces\n",
+				value->id, displaced->id);
+			releaseRecord(displaced, fieldIndex);
+		}
+
+		if (useEntryNames && value->entryName[0] != '\0') {
+			if (accessionMapLookup(recordMap, value->entryName) != NULL) {
+				fprintf(stderr,
+					"Warning: entry name '%s' of record '%s' is already a key\n",
+					value->entryName, value->id);
+			} else if (accessionMapInsert(recordMap, value->entryName, value) < 0) {
+				fprintf(stderr,
+					"Failed to add FASTA record with key '%s' to associative array\n",
+					value->entryName);
+				return -1;
+			} else {
+				value->refCount++;
+			}
+		}
+
+		if (fieldIndex != NULL && fastaFieldIndexAdd(fieldIndex, value) < 0) {
+			fprintf(stderr, "Failed to index the fields of FASTA record '%s'\n",
+					value->id);
 			return -1;
 		}
 		nEntries++;
-		fRecord = fastaAllocateRecord();
+		if (store == NULL)
+			fRecord = fastaAllocateRecord();
 	}
-	endTime = clock();
+	perfCountersStop(perf, nEntries);
+	endTime = latencyNow();
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Inserts took %lf seconds\n", timeTaken);
 
 	/** the last record didn't get used */
@@ -62,16 +206,18 @@ loadAssociativeArray(AssociativeArray *assocArray, char *filename)
  * Query the associative array with all the values in the given file
  */
 static int
-queryAssociativeArray(AssociativeArray *assocArray, char *filename)
+queryRecordMap(AccessionMap *recordMap, char *filename,
+		ResultWriter *results, LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
-	clock_t startTime, endTime;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
+	int nQueries = 0;
 	char *strkey = NULL;
 	FASTArecord *value = NULL;
 	FILE *fp = NULL;
 
-	fp = fopen(filename, "r");
+	fp = openInputFile(filename);
 	if (fp == NULL) {
 		fprintf(stderr,
 				"Error: Failed to open query input file '%s' : %s\n",
@@ -79,22 +225,437 @@ queryAssociativeArray(AssociativeArray *assocArray, char *filename)
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
-		value = (FASTArecord *) aaLookup(assocArray,
-				(AAKeyType) strkey, strlen(strkey));
+		nQueries++;
+		opStart = latencyStart(latency);
+		value = (FASTArecord *) accessionMapLookup(recordMap, strkey);
+		latencyStop(latency, opStart);
 		if (value == NULL) {
-			printf("LOOKUP: key '%s' produced no value\n", strkey);
+			resultWriterValue(results, "LOOKUP", strkey, NULL, 0);
 		} else {
-			printf("LOOKUP: key '%s' produced record:\n", strkey);
-			fastaPrintRecord(stdout, value);
+			writeRecordResult(results, "LOOKUP", strkey, value);
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Queries took %lf seconds\n", timeTaken);
 
+	closeInputFile(fp);
+	return 1;
+}
+
+/** look up one ID on a pipeline worker, as queryRecordMap() does */
+static int
+pipelineLookup(void *userdata, const char *strkey, QueryResult *result)
+{
+	result->value = accessionMapLookup((AccessionMap *) userdata, strkey);
+	result->length = 0;
+	return 0;
+}
+
+/** write out the record found for one ID, in the order of the query file */
+static void
+pipelineReport(void *userdata, ResultWriter *results,
+		const char *strkey, QueryResult *result)
+{
+	if (result->value == NULL) {
+		resultWriterValue(results, "LOOKUP", strkey, NULL, 0);
+	} else {
+		writeRecordResult(results, "LOOKUP", strkey,
+				(FASTArecord *) result->value);
+	}
+}
+
+/**
+ * Query the records with all the IDs in the given file, looking them
+ * up on nWorkers threads at once
+ */
+static int
+pipelineQueryRecordMap(AccessionMap *recordMap, char *filename, int nWorkers,
+		ResultWriter *results, LatencyHistogram *latency, PerfCounters *perf)
+{
+	QueryPipelineStats stats;
+	uint64_t startTime, endTime;
+	double timeTaken;
+	int status;
+	FILE *fp = NULL;
+
+	fp = openInputFile(filename);
+	if (fp == NULL) {
+		fprintf(stderr,
+				"Error: Failed to open query input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	startTime = latencyNow();
+	perfCountersStart(perf);
+	status = queryPipelineRun(fp, nWorkers, pipelineLookup, pipelineReport,
+			recordMap, results, latency, &stats);
+	perfCountersStop(perf, stats.nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
+	closeInputFile(fp);
+
+	if (status < 0) {
+		fprintf(stderr, "Error: cannot start %d query threads\n", nWorkers);
+		return -1;
+	}
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Queries took %lf seconds on %d threads\n", timeTaken, nWorkers);
+	return 1;
+}
+
+/** the description fields that can be looked up in the field index */
+typedef enum FieldKind {
+	FIELD_ORGANISM,
+	FIELD_TAXON,
+	FIELD_GENE
+} FieldKind;
+
+static const char *fieldLabel[] = { "ORGANISM", "TAXON", "GENE" };
+
+/**
+ * Look up each organism name, taxon or gene listed in the given file
+ * in the field index, reporting the records carrying it
+ */
+static int
+fieldQueryRecordMap(FASTAfieldIndex *fieldIndex, char *filename, FieldKind field)
+{
+	char linebuffer[LINE_MAX];
+	uint64_t startTime, endTime;
+	double timeTaken;
+	char *value = NULL, *end;
+	unsigned long taxon;
+	FASTArecordSet *set;
+	int i, nRecords;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr,
+				"Error: Failed to open %s query input file '%s' : %s\n",
+				fieldLabel[field], filename, strerror(errno));
+		return -1;
+	}
+
+	startTime = latencyNow();
+	while (readPlainLine(fp, linebuffer, LINE_MAX, &value)) {
+		if (value[0] == '\0')
+			continue;
+
+		if (field == FIELD_ORGANISM) {
+			set = fastaFieldIndexByOrganism(fieldIndex, value);
+		} else if (field == FIELD_GENE) {
+			set = fastaFieldIndexByGene(fieldIndex, value);
+		} else {
+			taxon = strtoul(value, &end, 10);
+			if (*end != '\0') {
+				fprintf(stderr, "Error: cannot parse taxon from '%s'\n", value);
+				continue;
+			}
+			set = fastaFieldIndexByTaxon(fieldIndex, taxon);
+		}
+
+		nRecords = (set == NULL) ? 0 : set->nRecords;
+		for (i = 0; i < nRecords; i++) {
+			printf("%s: '%s' found in record '%s'\n",
+					fieldLabel[field], value, set->records[i]->id);
+		}
+		printf("%s: '%s' has %d records\n", fieldLabel[field], value, nRecords);
+	}
+	endTime = latencyNow();
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("%s queries took %lf seconds\n", fieldLabel[field], timeTaken);
+
+	fclose(fp);
+	return 1;
+}
+
+/** report one record whose ID matches the current pattern */
+static int
+printPatternMatch(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	printf("PATTERN: '%s' matched record:\n", (char *) userdata);
+	fastaPrintRecord(stdout, (FASTArecord *) value);
+	return 0;
+}
+
+/**
+ * Run each of the glob patterns in the given file against the
+ * record IDs held in the associative array
+ */
+static int
+patternQueryRecordMap(AccessionMap *recordMap, char *filename)
+{
+	char linebuffer[LINE_MAX];
+	uint64_t startTime, endTime;
+	double timeTaken;
+	char *pattern = NULL;
+	int nMatches;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr,
+				"Error: Failed to open pattern input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	startTime = latencyNow();
+	while (readPlainLine(fp, linebuffer, LINE_MAX, &pattern)) {
+		nMatches = accessionMapPatternSearch(recordMap, pattern,
+				printPatternMatch, pattern);
+		if (nMatches < 0) {
+			fprintf(stderr, "Error: cannot parse pattern '%s'\n", pattern);
+		} else {
+			printf("PATTERN: '%s' matched %d records\n", pattern, nMatches);
+		}
+	}
+	endTime = latencyNow();
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Pattern queries took %lf seconds\n", timeTaken);
+
+	fclose(fp);
+	return 1;
+}
+
+/** state shared while scanning all records for motifs */
+typedef struct MotifScan {
+	TrieMatcher *matcher;
+	FASTArecord *record;
+	int nRecords;
+	int nRecordsWithHits;
+	long nHits;
+} MotifScan;
+
+/** report one motif occurrence within the current record */
+static int
+printMotifHit(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	MotifScan *scan = (MotifScan *) userdata;
+
+	printf("MOTIF: record '%s' contains '%.*s' at position %ld\n",
+			scan->record->id, (int) keylen, (char *) key,
+			(long) ((char *) key - scan->record->sequence));
+	return 0;
+}
+
+/** stream one record's sequence through the motif automaton */
+static int
+scanRecordForMotifs(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	MotifScan *scan = (MotifScan *) userdata;
+	long nHits;
+
+	/** scan each record once, under its ID */
+	scan->record = (FASTArecord *) value;
+	if ( ! isRecordID(key, keylen, scan->record))
+		return 0;
+	scan->nRecords++;
+	if (scan->record->sequence == NULL)
+		return 0;
+
+	nHits = trieMatcherScan(scan->matcher,
+			(unsigned char *) scan->record->sequence,
+			strlen(scan->record->sequence),
+			printMotifHit, scan);
+	if (nHits < 0)
+		return -1;
+	if (nHits > 0) {
+		printf("MOTIF: record '%s' has %ld motif hits\n",
+				scan->record->id, nHits);
+		scan->nRecordsWithHits++;
+		scan->nHits += nHits;
+	}
+	return 0;
+}
+
+/**
+ * Load the motifs listed in the given file into a trie, turn it into
+ * an Aho-Corasick automaton and report every motif occurring in every
+ * record in a single pass over each sequence
+ */
+static int
+motifScanRecordMap(AccessionMap *recordMap, char *filename)
+{
+	char linebuffer[LINE_MAX];
+	uint64_t startTime, endTime;
+	double timeTaken;
+	char *motif = NULL;
+	int nMotifs = 0;
+	KeyValueTrie *motifs;
+	MotifScan scan;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr,
+				"Error: Failed to open motif input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	motifs = trieCreateTrie();
+	if (motifs == NULL) {
+		fprintf(stderr, "Error: cannot allocate motif trie\n");
+		fclose(fp);
+		return -1;
+	}
+	while (readPlainLine(fp, linebuffer, LINE_MAX, &motif)) {
+		if (motif[0] == '\0')
+			continue;
+		if (trieInsertKey(motifs, (AAKeyType) motif, strlen(motif),
+					NULL, NULL) < 0) {
+			fprintf(stderr, "Failed to add motif '%s' to trie\n", motif);
+			trieDeleteTrie(motifs);
+			fclose(fp);
+			return -1;
+		}
+		nMotifs++;
+	}
+	fclose(fp);
+
+	startTime = latencyNow();
+	memset(&scan, 0, sizeof(scan));
+	scan.matcher = trieCreateMatcher(motifs);
+	if (scan.matcher == NULL) {
+		fprintf(stderr, "Error: cannot build motif automaton\n");
+		trieDeleteTrie(motifs);
+		return -1;
+	}
+	accessionMapIterateAction(recordMap, scanRecordForMotifs, &scan);
+	endTime = latencyNow();
+
+	printf("MOTIF: %d motifs found %ld times in %d of %d records\n",
+			nMotifs, scan.nHits, scan.nRecordsWithHits, scan.nRecords);
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Motif scan took %lf seconds\n", timeTaken);
+
+	trieDeleteMatcher(scan.matcher);
+	trieDeleteTrie(motifs);
+	return 1;
+}
+
+/** growable list of the records held in the associative array */
+typedef struct RecordList {
+	FASTArecord **records;
+	int nRecords;
+	int maxRecords;
+} RecordList;
+
+static int
+collectRecord(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	RecordList *list = (RecordList *) userdata;
+	FASTArecord **grown;
+
+	if ( ! isRecordID(key, keylen, (FASTArecord *) value))
+		return 0;
+
+	if (list->nRecords == list->maxRecords) {
+		list->maxRecords = (list->maxRecords == 0) ? 1024 : list->maxRecords * 2;
+		grown = (FASTArecord **) realloc(list->records,
+				list->maxRecords * sizeof(FASTArecord *));
+		if (grown == NULL)
+			return -1;
+		list->records = grown;
+	}
+	list->records[list->nRecords++] = (FASTArecord *) value;
+	return 0;
+}
+
+/** report one record containing the current peptide */
+static int
+printSubstringMatch(FASTArecord *record, void *userdata)
+{
+	printf("SUBSTRING: '%s' found in record '%s'\n",
+			(char *) userdata, record->id);
+	return 0;
+}
+
+/**
+ * Build (or reload) a suffix array over the sequences of all the
+ * records, then report which records contain each peptide listed
+ * in the given file
+ */
+static int
+substringQueryRecordMap(AccessionMap *recordMap,
+		char *filename, char *indexfile, int nThreads)
+{
+	char linebuffer[LINE_MAX];
+	uint64_t startTime, endTime;
+	double timeTaken;
+	char *peptide = NULL;
+	long nRecords, nOccurrences;
+	FASTAsuffixIndex *index;
+	RecordList list;
+	int loaded;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr,
+				"Error: Failed to open substring input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	memset(&list, 0, sizeof(list));
+	if (accessionMapIterateAction(recordMap, collectRecord, &list) < 0) {
+		fprintf(stderr, "Error: cannot collect records for indexing\n");
+		free(list.records);
+		fclose(fp);
+		return -1;
+	}
+
+	startTime = latencyNow();
+	index = fastaIndexCreate(list.records, list.nRecords);
+	if (index == NULL) {
+		fprintf(stderr, "Error: cannot allocate suffix array\n");
+		free(list.records);
+		fclose(fp);
+		return -1;
+	}
+	loaded = fastaIndexLoad(index, indexfile);
+	if (loaded <= 0) {
+		fastaIndexBuild(index, nThreads);
+		fastaIndexSave(index, indexfile);
+	}
+	endTime = latencyNow();
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Suffix array of %lu residues %s '%s' took %lf seconds\n",
+			(unsigned long) index->nSuffixes,
+			(loaded > 0) ? "loaded from" : "built and saved to",
+			indexfile, timeTaken);
+
+	startTime = latencyNow();
+	while (readPlainLine(fp, linebuffer, LINE_MAX, &peptide)) {
+		nRecords = fastaIndexSearch(index, peptide, &nOccurrences,
+				printSubstringMatch, peptide);
+		printf("SUBSTRING: '%s' occurs %ld times in %ld records\n",
+				peptide, nOccurrences, nRecords);
+	}
+	endTime = latencyNow();
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Substring queries took %lf seconds\n", timeTaken);
+
+	fastaIndexDelete(index);
+	free(list.records);
 	fclose(fp);
 	return 1;
 }
@@ -102,16 +663,21 @@ queryAssociativeArray(AssociativeArray *assocArray, char *filename)
 /**
  * Delete the selected values from the associative array.  Note that we free the values
  * as otherwise they are memory leaks as we are managing the memory for
- * these values outside of the library
+ * these values outside of the library.  Deleting a record by either of
+ * its keys removes the other key too.
  */
 static int
-deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename)
+deleteFromRecordMap(AccessionMap *recordMap, char *filename,
+		FASTAfieldIndex *fieldIndex, ResultWriter *results,
+		LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL;
 	FASTArecord *value = NULL;
-	clock_t startTime, endTime;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
+	int nDeletions = 0;
+	char *otherkey;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -121,21 +687,39 @@ deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename)
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
-		value = (FASTArecord *) aaDelete(assocArray,
-				(AAKeyType) strkey, strlen(strkey));
+		nDeletions++;
+		opStart = latencyStart(latency);
+		value = (FASTArecord *) accessionMapRemove(recordMap, strkey);
+		latencyStop(latency, opStart);
 		if (value == NULL) {
-			printf("DELETE: key '%s' produced no value\n", strkey);
+			resultWriterValue(results, "DELETE", strkey, NULL, 0);
 		} else {
-			printf("DELETE: successfully deleted record with key '%s' \n",
-					strkey);
-			fastaDeallocateRecord(value);
+			if (results->format == RESULT_TSV) {
+				resultWriterValue(results, "DELETE", strkey,
+						value->id, strlen(value->id));
+			} else {
+				resultWriterPrintf(results,
+						"DELETE: successfully deleted record with key '%s' \n",
+						strkey);
+			}
+			otherkey = (strcmp(strkey, value->id) == 0) ? value->entryName : value->id;
+			if (value->refCount > 1 && otherkey[0] != '\0'
+					&& accessionMapLookup(recordMap, otherkey) == value) {
+				accessionMapRemove(recordMap, otherkey);
+				releaseRecord(value, fieldIndex);
+			}
+			releaseRecord(value, fieldIndex);
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nDeletions);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Deletions took %lf seconds\n", timeTaken);
 
 	fclose(fp);
@@ -146,7 +730,7 @@ deleteFromAssociativeArray(AssociativeArray *assocArray, char *filename)
 static int
 deleteValue(AAKeyType key, size_t keylen, void *value, void *userdata)
 {
-	if (value != NULL)	fastaDeallocateRecord(value);
+	if (value != NULL)	releaseRecord((FASTArecord *) value, NULL);
 	return 0;
 }
 
@@ -163,8 +747,45 @@ void usage(char *progname)
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options: \n");
 	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
+	fprintf(stderr, "%-*s: Index trie children by letter, learning the alphabet\n",
+			OPTIONLEN, "-a");
+	fprintf(stderr, "%-*s: from the IDs as they are loaded.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -a, but with the letters of the alphabet given.\n",
+			OPTIONLEN, "-A <LETTERS>");
+	fprintf(stderr, "%-*s: Keep IDs that are valid UniProt accessions as integer\n",
+			OPTIONLEN, "-u");
+	fprintf(stderr, "%-*s: codes in a hash table instead of in the trie.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Key each record by its entry name (e.g. 001R_FRG3G) as well\n",
+			OPTIONLEN, "-e");
+	fprintf(stderr, "%-*s: as its ID, so either can be queried or deleted.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Store each distinct sequence, organism and set of\n",
+			OPTIONLEN, "-D");
+	fprintf(stderr, "%-*s: description fields once, shared between records.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Scan each trie node's children most used first, reordering\n",
+			OPTIONLEN, "-r");
+	fprintf(stderr, "%-*s: them as lookups go.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Cache up to <N> recently found keys in front of the trie.\n",
+			OPTIONLEN, "-c <N>");
+	fprintf(stderr, "%-*s: Write query and delete results as tab separated lines:\n",
+			OPTIONLEN, "-T");
+	fprintf(stderr, "%-*s: \"LOOKUP KEY ID DESCRIPTION SEQUENCE\" and \"DELETE KEY ID\",\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: or just \"OPERATION KEY\" for keys not found.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
 			OPTIONLEN, "-o <FILE>");
+	fprintf(stderr, "%-*s: Time each insert, lookup and delete, and report\n",
+			OPTIONLEN, "-l");
+	fprintf(stderr, "%-*s: percentiles of their latencies.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -l, also writing every latency (in ns) to <FILE>.\n",
+			OPTIONLEN, "-L <FILE>");
+	fprintf(stderr, "%-*s: Count cycles, instructions, LLC, branch and dTLB misses\n",
+			OPTIONLEN, "-C");
+	fprintf(stderr, "%-*s: over the insert, delete and query phases, per operation.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Size of table used internally, default %d.\n",
 			OPTIONLEN, "-n <SIZE>", DEFAULT_ARRAY_SIZE);
 	fprintf(stderr, "%-*s: Hash using the given algorithm.  Choices are \"sum\", \"length\",\n",
@@ -175,11 +796,46 @@ void usage(char *progname)
 	fprintf(stderr, "%-*s: or \"doublehash\".\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Perform queries on all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-q <FILE>");
+	fprintf(stderr, "%-*s: or, if <FILE> is \"-\", read from stdin.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Answer queries on <N> lookup threads, with a reader\n",
+			OPTIONLEN, "-Q <N>");
+	fprintf(stderr, "%-*s: thread feeding them and results in query file order.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Cannot be combined with -c or -r.\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Delete all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-d <FILE>");
+	fprintf(stderr, "%-*s: Report the records of each organism name (OS=) listed\n",
+			OPTIONLEN, "-O <FILE>");
+	fprintf(stderr, "%-*s: in <FILE> (one per line)\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report the records of each taxon (OX=) listed in <FILE>\n",
+			OPTIONLEN, "-x <FILE>");
+	fprintf(stderr, "%-*s: (one per line)\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report the records of each gene (GN=) listed in <FILE>\n",
+			OPTIONLEN, "-G <FILE>");
+	fprintf(stderr, "%-*s: (one per line)\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report records whose ID matches each glob pattern listed\n",
+			OPTIONLEN, "-g <FILE>");
+	fprintf(stderr, "%-*s: in <FILE> (one per line); patterns may use '?', '*' and \"[...]\"\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report every occurrence of each motif listed in <FILE>\n",
+			OPTIONLEN, "-m <FILE>");
+	fprintf(stderr, "%-*s: (one per line) within the sequence of every record\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report the records whose sequence contains each peptide\n",
+			OPTIONLEN, "-s <FILE>");
+	fprintf(stderr, "%-*s: listed in <FILE> (one per line), using a suffix array that\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: is saved next to the first data file as <datafile>%s\n",
+			OPTIONLEN, "", FASTA_INDEX_SUFFIX);
+	fprintf(stderr, "%-*s: Number of threads used to build the suffix array,\n",
+			OPTIONLEN, "-t <NUM>");
+	fprintf(stderr, "%-*s: default is one per online processor.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "\n");
-	fprintf(stderr, "The order of the operations controlled by -d, -q and -p are: deletion first,\n");
-	fprintf(stderr, "followed by any queries, and then finally printing (if indicated)\n");
+	fprintf(stderr, "The order of the operations controlled by -d, -q, -O, -x, -G, -g, -m, -s\n");
+	fprintf(stderr, "and -p are: deletion first, followed by any queries, field queries,\n");
+	fprintf(stderr, "pattern queries, motif scans and substring queries, and then finally\n");
+	fprintf(stderr, "printing (if indicated)\n");
 	fprintf(stderr, "\n");
 	exit (1);
 }
@@ -194,21 +850,75 @@ main(int argc, char **argv)
 	char *programname = NULL;
 	FILE *ofp = stdout;
 	int arraySize = DEFAULT_ARRAY_SIZE;
+	int cacheSize = 0;
+	int adaptiveOrder = 0;
+	int nQueryThreads = 0;
 	int printContents = 0;
-	char *queryfile = NULL, *deletefile = NULL;
+	int measureLatency = 0;
+	FILE *latencyfp = NULL;
+	LatencyHistogram *insertLatency = NULL, *lookupLatency = NULL;
+	LatencyHistogram *deleteLatency = NULL;
+	int countEvents = 0;
+	PerfCounters *insertPerf = NULL, *lookupPerf = NULL, *deletePerf = NULL;
+	char *queryfile = NULL, *deletefile = NULL, *patternfile = NULL;
+	char *motiffile = NULL, *substringfile = NULL;
+	char *fieldfile[3] = { NULL, NULL, NULL };
+	char indexfile[FILENAME_MAX];
+	int nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	ResultFormat resultFormat = RESULT_TEXT;
+	ResultWriter *results;
 	int i, c;
 
 	AssociativeArray *assocArray;
+	AccessionMap *recordMap;
+	FASTAstore *store = NULL;
+	FASTAfieldIndex *fieldIndex = NULL;
+	int useAccessionCodes = 0;
+	int useStore = 0;
+	int useEntryNames = 0;
+	int useDenseAlphabet = 0;
+	char *alphabet = NULL;
 	char *hash1 = "sum", *hash2 = "len", *probe = "lin";
 
 	/* save program name before calling getopt() */
 	programname = argv[0];
 
 	/** use getopt(3) to parse command line */
-	while ((c = getopt(argc, argv, "hpn:H:2:P:o:q:d:")) != -1) {
+	while ((c = getopt(argc, argv, "hpuDearlCTA:c:n:H:2:P:o:q:d:O:x:G:g:m:s:t:L:Q:")) != -1) {
 		if (c == 'p') {
 			printContents = 1;
 
+		} else if (c == 'T') {
+			resultFormat = RESULT_TSV;
+
+		} else if (c == 'u') {
+			useAccessionCodes = 1;
+
+		} else if (c == 'D') {
+			useStore = 1;
+
+		} else if (c == 'e') {
+			useEntryNames = 1;
+
+		} else if (c == 'a') {
+			useDenseAlphabet = 1;
+
+		} else if (c == 'A') {
+			useDenseAlphabet = 1;
+			alphabet = optarg;
+
+		} else if (c == 'r') {
+			adaptiveOrder = 1;
+
+		} else if (c == 'c') {
+			if (sscanf(optarg, "%d", &cacheSize) != 1 || cacheSize < 0) {
+				fprintf(stderr,
+						"Error: cannot parse cache"
+						" size requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
 		} else if (c == 'n') {
 			if (sscanf(optarg, "%d", &arraySize) != 1) {
 				fprintf(stderr,
@@ -231,9 +941,61 @@ main(int argc, char **argv)
 		} else if (c == 'q') {
 			queryfile = optarg;
 
+		} else if (c == 'Q') {
+			if (sscanf(optarg, "%d", &nQueryThreads) != 1 || nQueryThreads < 1) {
+				fprintf(stderr,
+						"Error: cannot parse number of query"
+						" threads requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
 		} else if (c == 'd') {
 			deletefile = optarg;
 
+		} else if (c == 'O') {
+			fieldfile[FIELD_ORGANISM] = optarg;
+
+		} else if (c == 'x') {
+			fieldfile[FIELD_TAXON] = optarg;
+
+		} else if (c == 'G') {
+			fieldfile[FIELD_GENE] = optarg;
+
+		} else if (c == 'g') {
+			patternfile = optarg;
+
+		} else if (c == 'm') {
+			motiffile = optarg;
+
+		} else if (c == 's') {
+			substringfile = optarg;
+
+		} else if (c == 't') {
+			if (sscanf(optarg, "%d", &nThreads) != 1 || nThreads < 1) {
+				fprintf(stderr,
+						"Error: cannot parse thread"
+						" count requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
+		} else if (c == 'C') {
+			countEvents = 1;
+
+		} else if (c == 'l') {
+			measureLatency = 1;
+
+		} else if (c == 'L') {
+			measureLatency = 1;
+			latencyfp = fopen(optarg, "w");
+			if (latencyfp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested latency file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
 		} else if (c == 'o') {
 			ofp = fopen(optarg, "w");
 			if (ofp == NULL) {
@@ -257,6 +1019,12 @@ main(int argc, char **argv)
 		usage(programname);
 	}
 
+	/** the cache and adaptive ordering update the trie as it is read */
+	if (nQueryThreads > 0 && (cacheSize > 0 || adaptiveOrder)) {
+		fprintf(stderr, "Error: -Q cannot be used with -c or -r\n");
+		usage(programname);
+	}
+
 	/** allocate the associative array and fail out if we cannot */
 	assocArray = aaCreateAssociativeArray(arraySize, probe, hash1, hash2);
 	if (assocArray == NULL) {
@@ -264,35 +1032,143 @@ main(int argc, char **argv)
 		return -1;
 	}
 
+	if (useDenseAlphabet && aaSetAlphabet(assocArray, alphabet) < 0) {
+		fprintf(stderr, "Error: cannot set up trie alphabet - exitting\n");
+		return -1;
+	}
+
+	if (cacheSize > 0 && aaSetCache(assocArray, (size_t) cacheSize) < 0) {
+		fprintf(stderr, "Error: cannot set up key cache - exitting\n");
+		return -1;
+	}
+
+	if (adaptiveOrder && aaSetAdaptiveOrder(assocArray, 1) < 0) {
+		fprintf(stderr, "Error: cannot set up adaptive ordering - exitting\n");
+		return -1;
+	}
+
+	/** valid accessions may be kept as integer codes instead */
+	recordMap = accessionMapCreate(assocArray, useAccessionCodes);
+	if (recordMap == NULL) {
+		fprintf(stderr, "Error: cannot allocate record map - exitting\n");
+		return -1;
+	}
+
+	if (useStore) {
+		store = fastaStoreCreate();
+		if (store == NULL) {
+			fprintf(stderr, "Error: cannot allocate record store - exitting\n");
+			return -1;
+		}
+	}
+
+	/** only index the description fields if they will be queried */
+	if (fieldfile[FIELD_ORGANISM] != NULL || fieldfile[FIELD_TAXON] != NULL
+			|| fieldfile[FIELD_GENE] != NULL) {
+		fieldIndex = fastaFieldIndexCreate();
+		if (fieldIndex == NULL) {
+			fprintf(stderr, "Error: cannot allocate field index - exitting\n");
+			return -1;
+		}
+	}
+
+	if (measureLatency) {
+		insertLatency = latencyCreate("insert", latencyfp != NULL);
+		lookupLatency = latencyCreate("lookup", latencyfp != NULL);
+		deleteLatency = latencyCreate("delete", latencyfp != NULL);
+		if (insertLatency == NULL || lookupLatency == NULL || deleteLatency == NULL) {
+			fprintf(stderr, "Error: cannot allocate latency histograms - exitting\n");
+			return -1;
+		}
+	}
+
+	if (countEvents) {
+		insertPerf = perfCountersCreate("insert");
+		lookupPerf = perfCountersCreate("lookup");
+		deletePerf = perfCountersCreate("delete");
+		if (insertPerf == NULL || lookupPerf == NULL || deletePerf == NULL) {
+			fprintf(stderr, "Error: cannot allocate performance counters - exitting\n");
+			return -1;
+		}
+	}
+
+	results = resultWriterCreate(stdout, resultFormat);
+	if (results == NULL) {
+		fprintf(stderr, "Error: cannot allocate result writer - exitting\n");
+		return -1;
+	}
 
 	/** getopt leaves us only "file" arguments left in argv */
 	for (i = 0; i < argc; i++) {
-		if (loadAssociativeArray(assocArray, argv[i]) < 0) {
+		if (loadRecordMap(recordMap, argv[i], store, fieldIndex,
+					useEntryNames, insertLatency, insertPerf) < 0) {
 			fprintf(stderr, "Error: failed loading from file '%s'\n", argv[i]);
 			return -1;
 		}
 	}
 	printf("Associative array loaded\n");
+	if (store != NULL)
+		fastaStorePrintSummary(stdout, store);
 
 
 	/** delete anything that we were asked to */
 	if (deletefile != NULL) {
-		deleteFromAssociativeArray(assocArray, deletefile);
+		deleteFromRecordMap(recordMap, deletefile, fieldIndex,
+				results, deleteLatency, deletePerf);
 	}
 
 	/** perform any queries we were asked to */
-	if (queryfile != NULL) {
-		queryAssociativeArray(assocArray, queryfile);
+	if (queryfile != NULL && nQueryThreads > 0) {
+		pipelineQueryRecordMap(recordMap, queryfile, nQueryThreads,
+				results, lookupLatency, lookupPerf);
+	} else if (queryfile != NULL) {
+		queryRecordMap(recordMap, queryfile, results, lookupLatency, lookupPerf);
+	}
+	resultWriterDelete(results);
+
+	latencyFinish(stdout, latencyfp, insertLatency);
+	latencyFinish(stdout, latencyfp, deleteLatency);
+	latencyFinish(stdout, latencyfp, lookupLatency);
+	perfCountersFinish(stdout, insertPerf);
+	perfCountersFinish(stdout, deletePerf);
+	perfCountersFinish(stdout, lookupPerf);
+	if (latencyfp != NULL)
+		fclose(latencyfp);
+
+	/** look up records by their description fields */
+	for (i = FIELD_ORGANISM; i <= FIELD_GENE; i++) {
+		if (fieldfile[i] != NULL)
+			fieldQueryRecordMap(fieldIndex, fieldfile[i], (FieldKind) i);
+	}
+
+	/** run any pattern queries we were asked to */
+	if (patternfile != NULL) {
+		patternQueryRecordMap(recordMap, patternfile);
+	}
+
+	/** scan every sequence for the motifs we were given */
+	if (motiffile != NULL) {
+		motifScanRecordMap(recordMap, motiffile);
+	}
+
+	/** answer peptide queries from a suffix array over all sequences */
+	if (substringfile != NULL) {
+		snprintf(indexfile, FILENAME_MAX, "%s%s", argv[0], FASTA_INDEX_SUFFIX);
+		substringQueryRecordMap(recordMap,
+				substringfile, indexfile, nThreads);
 	}
 
 	/* print out what we loaded */
+	aaPrintSummary(ofp, assocArray);
 	if (printContents) {
-		aaPrintContents(ofp, assocArray, "    ");
+		accessionMapPrint(ofp, recordMap, "    ");
 	}
 
 	/* clean up before exit */
-	aaIterateAction(assocArray, deleteValue, NULL);
-	aaDeleteAssociativeArray(assocArray);
+	accessionMapIterateAction(recordMap, deleteValue, NULL);
+	accessionMapDelete(recordMap);
+	fastaFieldIndexDelete(fieldIndex);
+	fastaStoreDelete(store);
 
 	/* exit with success if we get here */
 	return 0;
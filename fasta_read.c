@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#include <ctype.h>
 
 #include "fasta.h"
 
@@ -42,6 +43,99 @@ fastaExtractIDfromDescription(
 	return extractedLength;
 }
 
+/**
+ * Extract the entry name, which follows the ID up to the first space
+ * (">sp|Q6GZX4|001R_FRG3G ..."); records without one get an empty name
+ */
+static int
+fastaExtractEntryName(char *namebuffer, int maxNameLen, const char *fastaIDline)
+{
+	const char *start, *end;
+	int extractedLength;
+
+	namebuffer[0] = '\0';
+	if ((start = index(fastaIDline, '|')) == NULL)	return 0;
+	if ((start = index(start + 1, '|')) == NULL)	return 0;
+	start++;
+
+	for (end = start; *end != '\0' && ! isspace((unsigned char) *end); end++)
+		;
+	extractedLength = end - start;
+	if (extractedLength > maxNameLen)
+		extractedLength = maxNameLen;
+
+	memcpy(namebuffer, start, extractedLength);
+	namebuffer[extractedLength] = '\0';
+	return extractedLength;
+}
+
+/**
+ * Find the value of the given " XX=" field within the description,
+ * returning NULL if it is not there.  The value runs up to the start
+ * of the next field or the end of the line.
+ */
+static const char *
+fastaFindField(const char *description, const char *marker, int *length)
+{
+	const char *value, *end;
+
+	value = strstr(description, marker);
+	if (value == NULL)
+		return NULL;
+	value += strlen(marker);
+
+	for (end = value; *end != '\0' && *end != '\n'; end++) {
+		if (end[0] == ' ' && isupper((unsigned char) end[1])
+				&& isupper((unsigned char) end[2]) && end[3] == '=')
+			break;
+	}
+	*length = end - value;
+	return value;
+}
+
+/**
+ * Pull the UniProt OS=, OX=, GN=, PE= and SV= fields out of the
+ * description into the typed columns of the record.  This is left
+ * to the readers that want the fields, as most never look at them.
+ */
+int
+fastaParseFields(FASTArecord *fRecord)
+{
+	const char *value;
+	int length;
+
+	if (fRecord->description == NULL)
+		return 0;
+
+	value = fastaFindField(fRecord->description, " OS=", &length);
+	if (value != NULL && length > 0) {
+		fRecord->organism = strndup(value, length);
+		if (fRecord->organism == NULL)
+			return -1;
+	}
+
+	value = fastaFindField(fRecord->description, " GN=", &length);
+	if (value != NULL && length > 0) {
+		fRecord->gene = strndup(value, length);
+		if (fRecord->gene == NULL)
+			return -1;
+	}
+
+	value = fastaFindField(fRecord->description, " OX=", &length);
+	if (value != NULL)
+		fRecord->taxon = strtoul(value, NULL, 10);
+
+	value = fastaFindField(fRecord->description, " PE=", &length);
+	if (value != NULL)
+		fRecord->existence = atoi(value);
+
+	value = fastaFindField(fRecord->description, " SV=", &length);
+	if (value != NULL)
+		fRecord->version = atoi(value);
+
+	return 0;
+}
+
 /**
  * Read in a FASTA record, allocating memory for the fields.
  */
@@ -117,6 +211,8 @@ fastaReadRecord(FILE *ifp, FASTArecord *fRecord)
 		fprintf(stderr, "	 : '%s'\n", linebuffer);
 		return -1;
 	}
+	fastaExtractEntryName(fRecord->entryName,
+			FASTA_MAX_ENTRY_NAME_LEN, linebuffer);
 
 	/** handle the sequence */
 	curLoadIndex = 0;
@@ -133,7 +229,8 @@ fastaReadRecord(FILE *ifp, FASTArecord *fRecord)
 
 	/** collate all of the portions of the sequence */
 	while (linebuffer[curLoadIndex] > 0 && linebuffer[curLoadIndex] != '>') {
-		fgetstatus = fgets(&linebuffer[curLoadIndex], bytesRemain, ifp);
+		/* the first letter of the line is already in place */
+		fgetstatus = fgets(&linebuffer[curLoadIndex + 1], bytesRemain - 1, ifp);
 		if (fgetstatus == NULL) {
 			fprintf(stderr, "Error: FASTA parser encountered"
 					" unexpected end of file\n");
@@ -170,6 +267,9 @@ fastaReadRecord(FILE *ifp, FASTArecord *fRecord)
 		}
 	}
 
+	/* do not keep the EOF marker as part of the last sequence */
+	linebuffer[curLoadIndex] = 0;
+
 	/** save the sequence */
 	fRecord->sequence = strdup(linebuffer);
 
@@ -184,7 +284,10 @@ fastaPrintRecord(FILE *ofp, FASTArecord *fRecord)
 {
 	fprintf(ofp, "FASTA Record:\n");
 	fprintf(ofp, "ID   [%s]\n", fRecord->id);
-	fprintf(ofp, "DESC [%s]\n", fRecord->description);
+	fprintf(ofp, "DESC [%s%s%s%s]\n", fRecord->description,
+			(fRecord->descName == NULL) ? "" : fRecord->descName,
+			(fRecord->descOrganism == NULL) ? "" : fRecord->descOrganism,
+			(fRecord->descFields == NULL) ? "" : fRecord->descFields);
 	fprintf(ofp, "SEQ  [%s]\n", fRecord->sequence);
 
 	return 0;
@@ -198,8 +301,20 @@ void
 fastaInitializeRecord(FASTArecord *fRecord)
 {
 	fRecord->description = NULL;
+	fRecord->descName = NULL;
+	fRecord->descOrganism = NULL;
+	fRecord->descFields = NULL;
 	fRecord->sequence = NULL;
+	fRecord->organism = NULL;
+	fRecord->taxon = 0;
+	fRecord->gene = NULL;
+	fRecord->existence = 0;
+	fRecord->version = 0;
+	fRecord->inStore = 0;
+	fRecord->refCount = 0;
+	memset(fRecord->fieldSlot, 0, sizeof(fRecord->fieldSlot));
 	fRecord->id[0] = '\0';
+	fRecord->entryName[0] = '\0';
 }
 
 /**
@@ -219,11 +334,14 @@ fastaAllocateRecord()
 
 /**
  * Clear the record but do not free the fRecord pointer.
- * Useful when working with tables of records.
+ * Useful when working with tables of records.  Records owned by
+ * a store are left alone; they are freed with the store.
  */
 void
 fastaClearRecord(FASTArecord *fRecord)
 {
+	if (fRecord->inStore)
+		return;
 	if (fRecord->description != NULL) {
 		free(fRecord->description);
 		fRecord->description = NULL;
@@ -232,7 +350,19 @@ fastaClearRecord(FASTArecord *fRecord)
 		free(fRecord->sequence);
 		fRecord->sequence = NULL;
 	}
+	if (fRecord->organism != NULL) {
+		free(fRecord->organism);
+		fRecord->organism = NULL;
+	}
+	if (fRecord->gene != NULL) {
+		free(fRecord->gene);
+		fRecord->gene = NULL;
+	}
+	fRecord->taxon = 0;
+	fRecord->existence = 0;
+	fRecord->version = 0;
 	fRecord->id[0] = '\0';
+	fRecord->entryName[0] = '\0';
 }
 
 /**
@@ -241,6 +371,8 @@ fastaClearRecord(FASTArecord *fRecord)
 void
 fastaDeallocateRecord(FASTArecord *fRecord)
 {
+	if (fRecord->inStore)
+		return;
 	fastaClearRecord(fRecord);
 	free(fRecord);
 }
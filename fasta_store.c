@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "hashmix.h"
+#include "fasta_store.h"
+
+/** grow the sequence table once more than this percentage is in use */
+#define	STORE_MAX_LOAD		70
+#define	STORE_MIN_CAPACITY	1024
+
+/** where the UniProt fields following the protein name begin */
+#define	STORE_ORGANISM_MARK	" OS="
+static const char *storeFieldMarks[] = { " GN=", " PE=", " SV=", NULL };
+
+
+/**
+ * 128-bit hash of the bytes, eight at a time, as two independently
+ * seeded lanes.  Both halves must match before the bytes are compared.
+ */
+static void
+storeHash(const char *data, size_t length, uint64_t hash[2])
+{
+	uint64_t a = HASH_SPLITMIX_GAMMA ^ length;
+	uint64_t b = 0xc2b2ae3d27d4eb4fULL + length;
+	uint64_t word;
+	size_t i;
+
+	for (i = 0; i + 8 <= length; i += 8) {
+		memcpy(&word, &data[i], 8);
+		a = hashMix64(a ^ word);
+		b = (b ^ word) * 0x87c37b91114253d5ULL;
+		b = (b << 31) | (b >> 33);
+	}
+	if (i < length) {
+		word = 0;
+		memcpy(&word, &data[i], length - i);
+		a = hashMix64(a ^ word);
+		b = (b ^ word) * 0x87c37b91114253d5ULL;
+		b = (b << 31) | (b >> 33);
+	}
+
+	hash[0] = hashMix64(a + b);
+	hash[1] = hashMix64(b ^ (a >> 17));
+}
+
+/** create an empty store */
+FASTAstore *
+fastaStoreCreate()
+{
+	FASTAstore *store;
+
+	store = (FASTAstore *) malloc(sizeof(FASTAstore));
+	if (store == NULL)
+		return NULL;
+	memset(store, 0, sizeof(FASTAstore));
+
+	store->arena = arenaCreate(0);
+	store->fields = arenaCreate(1);
+	if (store->arena == NULL || store->fields == NULL) {
+		fastaStoreDelete(store);
+		return NULL;
+	}
+	return store;
+}
+
+/** free every record handed out by the store, and the store itself */
+void
+fastaStoreDelete(FASTAstore *store)
+{
+	if (store == NULL)	return;
+	arenaDelete(store->arena);
+	arenaDelete(store->fields);
+	free(store->slots);
+	free(store);
+}
+
+/** double the sequence table, re-placing every sequence */
+static int
+storeGrowTable(FASTAstore *store)
+{
+	FASTAsequenceSlot *slots;
+	size_t capacity, i, slot;
+
+	capacity = (store->capacity == 0) ? STORE_MIN_CAPACITY : store->capacity * 2;
+	slots = (FASTAsequenceSlot *) calloc(capacity, sizeof(FASTAsequenceSlot));
+	if (slots == NULL)
+		return -1;
+
+	for (i = 0; i < store->capacity; i++) {
+		if (store->slots[i].sequence == NULL)
+			continue;
+		slot = store->slots[i].hash[0] & (capacity - 1);
+		while (slots[slot].sequence != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		slots[slot] = store->slots[i];
+	}
+
+	free(store->slots);
+	store->slots = slots;
+	store->capacity = capacity;
+	return 0;
+}
+
+/** find the stored copy of the sequence, storing it if it is new */
+static char *
+storeSequence(FASTAstore *store, const char *sequence)
+{
+	size_t length = strlen(sequence), slot;
+	uint64_t hash[2];
+	char *copy;
+
+	store->nSequenceBytes += length + 1;
+
+	if ((store->nSequences + 1) * 100 > store->capacity * STORE_MAX_LOAD) {
+		if (storeGrowTable(store) < 0)
+			return NULL;
+	}
+
+	storeHash(sequence, length, hash);
+	slot = hash[0] & (store->capacity - 1);
+	while (store->slots[slot].sequence != NULL) {
+		if (store->slots[slot].hash[0] == hash[0]
+				&& store->slots[slot].hash[1] == hash[1]
+				&& strcmp(store->slots[slot].sequence, sequence) == 0)
+			return store->slots[slot].sequence;
+		slot = (slot + 1) & (store->capacity - 1);
+	}
+
+	copy = arenaStrndup(store->arena, sequence, length);
+	if (copy == NULL)
+		return NULL;
+	store->slots[slot].hash[0] = hash[0];
+	store->slots[slot].hash[1] = hash[1];
+	store->slots[slot].sequence = copy;
+	store->nSequences++;
+	store->nSequenceBytesStored += length + 1;
+	return copy;
+}
+
+/** store the bytes in the interned arena, unless there are none */
+static int
+storeField(FASTAstore *store, char **field, const char *start, const char *end)
+{
+	if (start == end)
+		return 0;
+	*field = arenaStrndup(store->fields, start, end - start);
+	return (*field == NULL) ? -1 : 0;
+}
+
+/**
+ * Split the description into the per-record head (">db|ID|NAME"),
+ * the protein name, the organism and the remaining fields, storing
+ * all but the head in the interned arena
+ */
+static int
+storeDescription(FASTAstore *store, FASTArecord *shared, const char *description)
+{
+	const char *end, *name, *organism, *fields, *mark;
+	size_t before;
+	int i;
+
+	end = description + strlen(description);
+	store->nDescriptionBytes += (end - description) + 1;
+
+	name = strchr(description, ' ');
+	if (name == NULL)
+		name = end;
+	organism = strstr(name, STORE_ORGANISM_MARK);
+	if (organism == NULL)
+		organism = end;
+
+	/** the fields start at whichever known mark comes first */
+	fields = end;
+	for (i = 0; storeFieldMarks[i] != NULL; i++) {
+		mark = strstr(organism, storeFieldMarks[i]);
+		if (mark != NULL && mark < fields)
+			fields = mark;
+	}
+
+	/** interned fields already seen add nothing to either arena */
+	before = store->arena->nBytesStored + store->fields->nBytesStored;
+	shared->description = arenaStrndup(store->arena,
+			description, name - description);
+	if (shared->description == NULL
+			|| storeField(store, &shared->descName, name, organism) < 0
+			|| storeField(store, &shared->descOrganism, organism, fields) < 0
+			|| storeField(store, &shared->descFields, fields, end) < 0)
+		return -1;
+	store->nDescriptionBytesStored += store->arena->nBytesStored
+			+ store->fields->nBytesStored - before;
+	return 0;
+}
+
+/**
+ * Copy the record into the store, sharing its sequence and the
+ * common parts of its description with the records already there.
+ * The given record is untouched, and may be cleared and reused.
+ */
+FASTArecord *
+fastaStoreAdd(FASTAstore *store, const FASTArecord *fRecord)
+{
+	FASTArecord *shared;
+
+	shared = (FASTArecord *) arenaAlloc(store->arena, sizeof(FASTArecord));
+	if (shared == NULL)
+		return NULL;
+	fastaInitializeRecord(shared);
+	strcpy(shared->id, fRecord->id);
+	strcpy(shared->entryName, fRecord->entryName);
+	shared->inStore = 1;
+
+	if (fRecord->description != NULL
+			&& storeDescription(store, shared, fRecord->description) < 0)
+		return NULL;
+
+	/** the parsed columns; organisms repeat, so they are interned too */
+	shared->taxon = fRecord->taxon;
+	shared->existence = fRecord->existence;
+	shared->version = fRecord->version;
+	if (fRecord->organism != NULL) {
+		shared->organism = arenaStrdup(store->fields, fRecord->organism);
+		if (shared->organism == NULL)
+			return NULL;
+	}
+	if (fRecord->gene != NULL) {
+		shared->gene = arenaStrdup(store->arena, fRecord->gene);
+		if (shared->gene == NULL)
+			return NULL;
+	}
+
+	if (fRecord->sequence != NULL) {
+		shared->sequence = storeSequence(store, fRecord->sequence);
+		if (shared->sequence == NULL)
+			return NULL;
+	}
+
+	store->nRecords++;
+	return shared;
+}
+
+/** report how much sharing the sequences and descriptions saved */
+void
+fastaStorePrintSummary(FILE *fp, FASTAstore *store)
+{
+	size_t parsed, stored;
+
+	parsed = store->nRecords * sizeof(FASTArecord)
+			+ store->nSequenceBytes + store->nDescriptionBytes;
+	stored = store->arena->nBytesStored + store->fields->nBytesStored
+			+ store->nRecords * sizeof(FASTArecord)
+			+ store->capacity * sizeof(FASTAsequenceSlot);
+
+	fprintf(fp, "Record store holds %lu records\n", (unsigned long) store->nRecords);
+	fprintf(fp, "  Distinct sequences : %lu\n", (unsigned long) store->nSequences);
+	fprintf(fp, "  Sequence bytes     : %lu stored of %lu\n",
+			(unsigned long) store->nSequenceBytesStored,
+			(unsigned long) store->nSequenceBytes);
+	fprintf(fp, "  Distinct fields    : %lu\n", (unsigned long) store->fields->nInterned);
+	fprintf(fp, "  Description bytes  : %lu stored of %lu\n",
+			(unsigned long) store->nDescriptionBytesStored,
+			(unsigned long) store->nDescriptionBytes);
+	if (store->nRecords > 0) {
+		fprintf(fp, "  Bytes per record   : %lu (%lu without sharing)\n",
+				(unsigned long) (stored / store->nRecords),
+				(unsigned long) (parsed / store->nRecords));
+	}
+}
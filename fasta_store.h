@@ -0,0 +1,57 @@
+#ifndef	__FASTA_RECORD_STORE_HEADER__
+#define	__FASTA_RECORD_STORE_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fasta.h"
+#include "strarena.h"
+
+/**
+ * Deduplicating store for loaded FASTA records.
+ *
+ * Each sequence is stored once, keyed by a 128-bit hash of its
+ * residues; records with identical sequences share the one copy.
+ * Descriptions are split into their UniProt parts: the ">db|ID|NAME"
+ * head is kept per record, while the protein name, the organism
+ * (" OS=... OX=...") and the remaining fields (" GN=... PE=... SV=...")
+ * are interned, so each distinct string is stored once.
+ *
+ * Records handed back by the store live until fastaStoreDelete(),
+ * and are marked so that fastaClearRecord() and
+ * fastaDeallocateRecord() leave them alone.
+ *
+ * The store is not thread safe.
+ */
+typedef struct FASTAsequenceSlot {
+	uint64_t hash[2];
+	char *sequence;		/* NULL if the slot is empty */
+} FASTAsequenceSlot;
+
+typedef struct FASTAstore {
+	StringArena *arena;		/* records, description heads and sequences */
+	StringArena *fields;	/* interned description fields */
+
+	/** open addressing table of distinct sequences */
+	FASTAsequenceSlot *slots;
+	size_t capacity;
+	size_t nSequences;
+
+	/** statistics */
+	size_t nRecords;
+	size_t nSequenceBytes;		/* sequence bytes offered to the store */
+	size_t nSequenceBytesStored;
+	size_t nDescriptionBytes;	/* description bytes offered to the store */
+	size_t nDescriptionBytesStored;
+} FASTAstore;
+
+/** prototypes */
+FASTAstore *fastaStoreCreate();
+void fastaStoreDelete(FASTAstore *store);
+
+FASTArecord *fastaStoreAdd(FASTAstore *store, const FASTArecord *fRecord);
+
+void fastaStorePrintSummary(FILE *fp, FASTAstore *store);
+
+#endif /* __FASTA_RECORD_STORE_HEADER__ */
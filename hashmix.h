@@ -0,0 +1,57 @@
+#ifndef	__HASH_MIX_HEADER__
+#define	__HASH_MIX_HEADER__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * The hashing shared by the trie's filter and cache, the string arena,
+ * the record store, the integer table, the suffix index and the
+ * generators of the benchmarks: FNV-1a over bytes, and the splitmix64
+ * finalizer and generator over 64-bit words.
+ *
+ * FNV-1a alone leaves its low bits poorly mixed, so anything that
+ * masks or splits a string's hash should pass it through
+ * hashMix64() first.  The saved suffix index records the plain
+ * FNV-1a of its text, so that must not change.
+ */
+#define	HASH_FNV_OFFSET		0xcbf29ce484222325ULL
+#define	HASH_FNV_PRIME		0x100000001b3ULL
+#define	HASH_SPLITMIX_GAMMA	0x9e3779b97f4a7c15ULL
+
+/** FNV-1a over the bytes */
+static inline uint64_t
+hashFnv1a(const void *bytes, size_t length)
+{
+	const unsigned char *p = (const unsigned char *) bytes;
+	uint64_t hash = HASH_FNV_OFFSET;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		hash ^= p[i];
+		hash *= HASH_FNV_PRIME;
+	}
+	return hash;
+}
+
+/** the splitmix64 finalizer; a bijection spreading every bit over the word */
+static inline uint64_t
+hashMix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/** the next value of a splitmix64 generator with the given state */
+static inline uint64_t
+hashSplitmixNext(uint64_t *state)
+{
+	*state += HASH_SPLITMIX_GAMMA;
+	return hashMix64(*state);
+}
+
+#endif /* __HASH_MIX_HEADER__ */
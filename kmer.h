@@ -0,0 +1,58 @@
+#ifndef	__KMER_COUNTING_HEADER__
+#define	__KMER_COUNTING_HEADER__
+
+#include <stdint.h>
+
+#include "fasta_columns.h"
+#include "u64table.h"
+
+/**
+ * K-mers are packed into a 64-bit key, most significant letter
+ * first, using the number of bits given by the alphabet.  Because
+ * the letter codes follow alphabetical order, numeric order of the
+ * keys is also the alphabetical order of the k-mers.
+ *
+ * DNA uses A=0, C=1, G=2, T(U)=3; protein uses letter - 'A' for A-Z.
+ */
+typedef enum KmerAlphabet {
+	KMER_DNA = 2,
+	KMER_PROTEIN = 5
+} KmerAlphabet;
+
+#define	KMER_MAX_LENGTH(alphabet)	(64 / (int) (alphabet))
+
+/**
+ * The counts, split into shards by hash so that the per-thread
+ * tables can be merged in parallel, one shard per merging thread
+ */
+typedef struct KmerCounter {
+	KmerAlphabet alphabet;
+	int k;
+	uint64_t mask;
+	int nShards;
+	U64Table **shards;
+	uint64_t nKmers;
+} KmerCounter;
+
+/** a single k-mer and the number of times it was seen */
+typedef struct KmerCount {
+	uint64_t key;
+	uint64_t count;
+} KmerCount;
+
+/** prototypes */
+KmerCounter *kmerCreateCounter(KmerAlphabet alphabet, int k, int nShards);
+void kmerDeleteCounter(KmerCounter *counter);
+
+int  kmerEncodeLetter(KmerAlphabet alphabet, char letter);
+void kmerDecode(KmerCounter *counter, uint64_t key, char *buffer);
+
+int  kmerCountColumns(KmerCounter *counter,
+		FASTAcolumns *columns, int nThreads);
+
+uint64_t kmerDistinct(KmerCounter *counter);
+int  kmerTopCounts(KmerCounter *counter, KmerCount *top, int nTop);
+KmerCount *kmerAllCounts(KmerCounter *counter, uint64_t *nCounts);
+KmerCount *kmerSpectrum(KmerCounter *counter, uint64_t *nCounts);
+
+#endif /* __KMER_COUNTING_HEADER__ */
@@ -0,0 +1,539 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "kmer.h"
+
+/** records handed to a counting thread at a time */
+#define	KMER_RECORD_CHUNK	64
+
+/** the state shared by all the threads in one counting pass */
+typedef struct KmerWork {
+	KmerCounter *counter;
+	FASTAcolumns *columns;
+	int nRecords;
+	int nextRecord;
+	int nextShard;
+	U64Table ***local;
+	uint64_t *localKmers;
+	int nThreads;
+	int failed;
+	pthread_mutex_t lock;
+} KmerWork;
+
+/** what each thread needs to know about itself */
+typedef struct KmerThread {
+	KmerWork *work;
+	int threadId;
+} KmerThread;
+
+
+/** which shard a key belongs to; uses different hash bits from the table */
+static int
+kmerShard(KmerCounter *counter, uint64_t key)
+{
+	return (int) ((u64tableHash(key) >> 48) & (counter->nShards - 1));
+}
+
+/**
+ * Create a counter for k-mers of the given length.  The number of
+ * shards is rounded up to a power of two.
+ */
+KmerCounter *
+kmerCreateCounter(KmerAlphabet alphabet, int k, int nShards)
+{
+	KmerCounter *counter;
+	int i, shards = 1;
+
+	if (k < 1 || k > KMER_MAX_LENGTH(alphabet))
+		return NULL;
+	while (shards < nShards && shards < 65536)
+		shards *= 2;
+
+	counter = (KmerCounter *) malloc(sizeof(KmerCounter));
+	if (counter == NULL)
+		return NULL;
+	memset(counter, 0, sizeof(KmerCounter));
+
+	counter->alphabet = alphabet;
+	counter->k = k;
+	counter->mask = (k * (int) alphabet == 64)
+			? ~0ULL : ((1ULL << (k * (int) alphabet)) - 1);
+	counter->nShards = shards;
+	counter->shards = (U64Table **) calloc(shards, sizeof(U64Table *));
+	if (counter->shards == NULL) {
+		free(counter);
+		return NULL;
+	}
+	for (i = 0; i < shards; i++) {
+		counter->shards[i] = u64tableCreate(0);
+		if (counter->shards[i] == NULL) {
+			kmerDeleteCounter(counter);
+			return NULL;
+		}
+	}
+	return counter;
+}
+
+void
+kmerDeleteCounter(KmerCounter *counter)
+{
+	int i;
+
+	if (counter == NULL)	return;
+	for (i = 0; i < counter->nShards; i++)
+		u64tableDelete(counter->shards[i]);
+	free(counter->shards);
+	free(counter);
+}
+
+/** the code for a letter, or -1 if it is not part of the alphabet */
+int
+kmerEncodeLetter(KmerAlphabet alphabet, char letter)
+{
+	letter = toupper((unsigned char) letter);
+
+	if (alphabet == KMER_DNA) {
+		switch (letter) {
+		case 'A':	return 0;
+		case 'C':	return 1;
+		case 'G':	return 2;
+		case 'T':
+		case 'U':	return 3;
+		}
+		return -1;
+	}
+
+	if (letter >= 'A' && letter <= 'Z')
+		return letter - 'A';
+	return -1;
+}
+
+/** unpack a key into a NUL terminated string of k letters */
+void
+kmerDecode(KmerCounter *counter, uint64_t key, char *buffer)
+{
+	static const char dnaLetters[] = "ACGT";
+	int bits = (int) counter->alphabet;
+	int i, code;
+
+	for (i = 0; i < counter->k; i++) {
+		code = (int) ((key >> (bits * (counter->k - 1 - i)))
+				& ((1 << bits) - 1));
+		buffer[i] = (counter->alphabet == KMER_DNA)
+				? dnaLetters[code] : (char) ('A' + code);
+	}
+	buffer[counter->k] = '\0';
+}
+
+/**
+ * Count the k-mers of one sequence into the thread's own tables.
+ * Letters outside the alphabet break the sequence; no k-mer spans
+ * them.
+ */
+static int
+kmerCountSequence(KmerCounter *counter, U64Table **tables,
+		const char *sequence, uint64_t *nKmers)
+{
+	uint64_t key = 0, *slot;
+	int bits = (int) counter->alphabet;
+	int code, run = 0;
+
+	for ( ; *sequence != '\0'; sequence++) {
+		code = kmerEncodeLetter(counter->alphabet, *sequence);
+		if (code < 0) {
+			run = 0;
+			key = 0;
+			continue;
+		}
+		key = ((key << bits) | (uint64_t) code) & counter->mask;
+		if (++run < counter->k)
+			continue;
+
+		slot = u64tableSlot(tables[kmerShard(counter, key)], key);
+		if (slot == NULL)
+			return -1;
+		(*slot)++;
+		(*nKmers)++;
+	}
+	return 0;
+}
+
+/** counting phase: take chunks of records until there are none left */
+static void *
+kmerCountWorker(void *userdata)
+{
+	KmerThread *self = (KmerThread *) userdata;
+	KmerWork *work = self->work;
+	U64Table **tables = work->local[self->threadId];
+	int first, last, i;
+
+	for (;;) {
+		pthread_mutex_lock(&work->lock);
+		first = work->nextRecord;
+		work->nextRecord += KMER_RECORD_CHUNK;
+		pthread_mutex_unlock(&work->lock);
+
+		if (first >= work->nRecords)
+			break;
+		last = first + KMER_RECORD_CHUNK;
+		if (last > work->nRecords)
+			last = work->nRecords;
+
+		for (i = first; i < last; i++) {
+			if (kmerCountSequence(work->counter, tables,
+						fastaColumnsSequence(work->columns, i, NULL),
+						&work->localKmers[self->threadId]) < 0) {
+				work->failed = 1;
+				return NULL;
+			}
+		}
+	}
+	return NULL;
+}
+
+/** fold one table into another, summing the counts */
+static int
+kmerMergeTable(U64Table *into, U64Table *from)
+{
+	uint64_t *slot;
+	size_t i;
+
+	for (i = 0; i < from->capacity; i++) {
+		if ( ! from->used[i])
+			continue;
+		slot = u64tableSlot(into, from->keys[i]);
+		if (slot == NULL)
+			return -1;
+		*slot += from->values[i];
+	}
+	return 0;
+}
+
+/**
+ * Merge phase: each shard is owned by exactly one thread, which
+ * folds that shard of every thread's tables into the result
+ */
+static void *
+kmerMergeWorker(void *userdata)
+{
+	KmerThread *self = (KmerThread *) userdata;
+	KmerWork *work = self->work;
+	KmerCounter *counter = work->counter;
+	U64Table *largest;
+	int shard, t, biggest;
+
+	for (;;) {
+		pthread_mutex_lock(&work->lock);
+		shard = work->nextShard++;
+		pthread_mutex_unlock(&work->lock);
+
+		if (shard >= counter->nShards)
+			break;
+
+		/** start from the biggest table rather than copying it */
+		biggest = 0;
+		for (t = 1; t < work->nThreads; t++) {
+			if (work->local[t][shard]->nEntries
+					> work->local[biggest][shard]->nEntries)
+				biggest = t;
+		}
+		largest = work->local[biggest][shard];
+		work->local[biggest][shard] = NULL;
+
+		if (kmerMergeTable(largest, counter->shards[shard]) < 0)
+			work->failed = 1;
+		for (t = 0; t < work->nThreads; t++) {
+			if (work->local[t][shard] == NULL)
+				continue;
+			if (kmerMergeTable(largest, work->local[t][shard]) < 0)
+				work->failed = 1;
+			u64tableDelete(work->local[t][shard]);
+			work->local[t][shard] = NULL;
+		}
+		u64tableDelete(counter->shards[shard]);
+		counter->shards[shard] = largest;
+	}
+	return NULL;
+}
+
+/** run the given phase on nThreads threads, or here if none start */
+static void
+kmerRunPhase(KmerWork *work, KmerThread *selves, pthread_t *threads,
+		void *(*phase)(void *))
+{
+	int i, nStarted;
+
+	for (nStarted = 0; nStarted < work->nThreads; nStarted++) {
+		if (pthread_create(&threads[nStarted], NULL,
+					phase, &selves[nStarted]) != 0)
+			break;
+	}
+	if (nStarted == 0) {
+		for (i = 0; i < work->nThreads; i++)
+			(*phase)(&selves[i]);
+	}
+	for (i = 0; i < nStarted; i++)
+		pthread_join(threads[i], NULL);
+}
+
+/**
+ * Count every k-mer in the sequence column of the records.  May be
+ * called repeatedly; counts accumulate.  Returns -1 on allocation
+ * failure.
+ */
+int
+kmerCountColumns(KmerCounter *counter,
+		FASTAcolumns *columns, int nThreads)
+{
+	KmerWork work;
+	KmerThread *selves;
+	pthread_t *threads;
+	int t, s, status = 0;
+
+	if (nThreads < 1)
+		nThreads = 1;
+
+	memset(&work, 0, sizeof(work));
+	work.counter = counter;
+	work.columns = columns;
+	work.nRecords = columns->nRecords;
+	work.nThreads = nThreads;
+	work.local = (U64Table ***) calloc(nThreads, sizeof(U64Table **));
+	work.localKmers = (uint64_t *) calloc(nThreads, sizeof(uint64_t));
+	selves = (KmerThread *) calloc(nThreads, sizeof(KmerThread));
+	threads = (pthread_t *) calloc(nThreads, sizeof(pthread_t));
+	if (work.local == NULL || work.localKmers == NULL
+			|| selves == NULL || threads == NULL) {
+		status = -1;
+		goto cleanup;
+	}
+
+	for (t = 0; t < nThreads; t++) {
+		selves[t].work = &work;
+		selves[t].threadId = t;
+		work.local[t] = (U64Table **) calloc(counter->nShards, sizeof(U64Table *));
+		if (work.local[t] == NULL) {
+			status = -1;
+			goto cleanup;
+		}
+		for (s = 0; s < counter->nShards; s++) {
+			work.local[t][s] = u64tableCreate(0);
+			if (work.local[t][s] == NULL) {
+				status = -1;
+				goto cleanup;
+			}
+		}
+	}
+
+	pthread_mutex_init(&work.lock, NULL);
+	kmerRunPhase(&work, selves, threads, kmerCountWorker);
+	if ( ! work.failed)
+		kmerRunPhase(&work, selves, threads, kmerMergeWorker);
+	pthread_mutex_destroy(&work.lock);
+
+	for (t = 0; t < nThreads; t++)
+		counter->nKmers += work.localKmers[t];
+	if (work.failed)
+		status = -1;
+
+cleanup:
+	if (work.local != NULL) {
+		for (t = 0; t < nThreads; t++) {
+			if (work.local[t] == NULL)
+				continue;
+			for (s = 0; s < counter->nShards; s++)
+				u64tableDelete(work.local[t][s]);
+			free(work.local[t]);
+		}
+	}
+	free(work.local);
+	free(work.localKmers);
+	free(selves);
+	free(threads);
+	return status;
+}
+
+/** number of different k-mers seen */
+uint64_t
+kmerDistinct(KmerCounter *counter)
+{
+	uint64_t nDistinct = 0;
+	int s;
+
+	for (s = 0; s < counter->nShards; s++)
+		nDistinct += counter->shards[s]->nEntries;
+	return nDistinct;
+}
+
+/** heap order: smaller counts first, and larger keys before smaller */
+static int
+kmerLess(const KmerCount *a, const KmerCount *b)
+{
+	if (a->count != b->count)
+		return a->count < b->count;
+	return a->key > b->key;
+}
+
+static void
+kmerSiftDown(KmerCount *heap, int n, int i)
+{
+	KmerCount tmp;
+	int child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && kmerLess(&heap[child + 1], &heap[child]))
+			child++;
+		if ( ! kmerLess(&heap[child], &heap[i]))
+			break;
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+static int
+kmerCountDescending(const void *a, const void *b)
+{
+	const KmerCount *kA = (const KmerCount *) a, *kB = (const KmerCount *) b;
+
+	if (kmerLess(kB, kA))	return -1;
+	if (kmerLess(kA, kB))	return 1;
+	return 0;
+}
+
+/**
+ * Fill top with the nTop most frequent k-mers, most frequent first
+ * (ties broken alphabetically).  Returns how many were filled.
+ */
+int
+kmerTopCounts(KmerCounter *counter, KmerCount *top, int nTop)
+{
+	U64Table *table;
+	KmerCount candidate;
+	size_t i;
+	int s, j, n = 0;
+
+	if (nTop <= 0)
+		return 0;
+
+	/** keep a min-heap of the best nTop seen so far */
+	for (s = 0; s < counter->nShards; s++) {
+		table = counter->shards[s];
+		for (i = 0; i < table->capacity; i++) {
+			if ( ! table->used[i])
+				continue;
+			candidate.key = table->keys[i];
+			candidate.count = table->values[i];
+			if (n < nTop) {
+				top[n++] = candidate;
+				if (n == nTop) {
+					for (j = n / 2 - 1; j >= 0; j--)
+						kmerSiftDown(top, n, j);
+				}
+			} else if (kmerLess(&top[0], &candidate)) {
+				top[0] = candidate;
+				kmerSiftDown(top, n, 0);
+			}
+		}
+	}
+
+	qsort(top, n, sizeof(KmerCount), kmerCountDescending);
+	return n;
+}
+
+static int
+kmerKeyAscending(const void *a, const void *b)
+{
+	const KmerCount *kA = (const KmerCount *) a, *kB = (const KmerCount *) b;
+
+	if (kA->key < kB->key)	return -1;
+	return kA->key > kB->key;
+}
+
+/**
+ * Every k-mer with its count, in alphabetical order.  The caller
+ * frees the returned array.
+ */
+KmerCount *
+kmerAllCounts(KmerCounter *counter, uint64_t *nCounts)
+{
+	KmerCount *all;
+	U64Table *table;
+	uint64_t n = 0;
+	size_t i;
+	int s;
+
+	all = (KmerCount *) malloc((kmerDistinct(counter) + 1) * sizeof(KmerCount));
+	if (all == NULL)
+		return NULL;
+
+	for (s = 0; s < counter->nShards; s++) {
+		table = counter->shards[s];
+		for (i = 0; i < table->capacity; i++) {
+			if (table->used[i]) {
+				all[n].key = table->keys[i];
+				all[n].count = table->values[i];
+				n++;
+			}
+		}
+	}
+
+	qsort(all, n, sizeof(KmerCount), kmerKeyAscending);
+	*nCounts = n;
+	return all;
+}
+
+/**
+ * The k-mer spectrum: for each multiplicity, how many different
+ * k-mers were seen that many times.  The key field of each entry
+ * holds the multiplicity; the array is in increasing multiplicity
+ * and is freed by the caller.
+ */
+KmerCount *
+kmerSpectrum(KmerCounter *counter, uint64_t *nCounts)
+{
+	U64Table *histogram, *table;
+	KmerCount *spectrum;
+	uint64_t *slot, n = 0;
+	size_t i;
+	int s;
+
+	histogram = u64tableCreate(0);
+	if (histogram == NULL)
+		return NULL;
+
+	for (s = 0; s < counter->nShards; s++) {
+		table = counter->shards[s];
+		for (i = 0; i < table->capacity; i++) {
+			if ( ! table->used[i])
+				continue;
+			slot = u64tableSlot(histogram, table->values[i]);
+			if (slot == NULL) {
+				u64tableDelete(histogram);
+				return NULL;
+			}
+			(*slot)++;
+		}
+	}
+
+	spectrum = (KmerCount *) malloc((histogram->nEntries + 1) * sizeof(KmerCount));
+	if (spectrum != NULL) {
+		for (i = 0; i < histogram->capacity; i++) {
+			if (histogram->used[i]) {
+				spectrum[n].key = histogram->keys[i];
+				spectrum[n].count = histogram->values[i];
+				n++;
+			}
+		}
+		qsort(spectrum, n, sizeof(KmerCount), kmerKeyAscending);
+		*nCounts = n;
+	}
+
+	u64tableDelete(histogram);
+	return spectrum;
+}
+
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <string.h> /* for strlen(), strcmp() */
+#include <stdlib.h> /* for free() */
+#include <unistd.h> /* for getopt(), sysconf() */
+#include <time.h>   /* for clock_gettime() */
+#include <errno.h>
+
+#include "fasta.h"
+#include "kmer.h"
+#include "fasta_columns.h"
+
+#define	DEFAULT_KMER_LENGTH	5
+#define	DEFAULT_TOP_COUNT	20
+#define	DEFAULT_CLASS_PERCENT	50.0
+#define OPTIONLEN	12
+
+/**
+ * Wall clock seconds.  The counting is done on several threads, so
+ * clock() (which sums CPU time over all of them) would hide any
+ * speedup.
+ */
+static double
+wallSeconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Run the column scans over the records: length statistics and
+ * overall residue composition, and (given a class of letters) the
+ * records made up of at least minPercent of that class
+ */
+static int
+columnReport(FILE *ofp, FASTAcolumns *columns, char *classLetters, double minPercent)
+{
+	FASTAlengthStats stats;
+	uint32_t *composition, *classCounts = NULL;
+	uint64_t totals[FASTA_RESIDUES];
+	double startTime, endTime, percent;
+	size_t length;
+	int i, j, nPassing = 0;
+
+	composition = (uint32_t *) malloc(
+			(columns->nRecords + 1) * FASTA_RESIDUES * sizeof(uint32_t));
+	if (classLetters != NULL)
+		classCounts = (uint32_t *) malloc((columns->nRecords + 1) * sizeof(uint32_t));
+	if (composition == NULL || (classLetters != NULL && classCounts == NULL)) {
+		fprintf(stderr, "Error: cannot allocate column scan results\n");
+		free(composition);
+		free(classCounts);
+		return -1;
+	}
+
+	startTime = wallSeconds();
+	fastaColumnsLengthStats(columns, &stats);
+	fastaColumnsComposition(columns, composition);
+	if (classLetters != NULL)
+		fastaColumnsClassCount(columns, classLetters, classCounts);
+	endTime = wallSeconds();
+	printf("Column scans over %lu residues took %lf seconds\n",
+			(unsigned long) columns->nResidues, endTime - startTime);
+
+	fprintf(ofp, "LENGTH: min %lu max %lu mean %.1lf stddev %.1lf total %lu\n",
+			(unsigned long) stats.minimum, (unsigned long) stats.maximum,
+			stats.mean, stats.stddev, (unsigned long) stats.total);
+
+	memset(totals, 0, sizeof(totals));
+	for (i = 0; i < columns->nRecords; i++) {
+		for (j = 0; j < FASTA_RESIDUES; j++)
+			totals[j] += composition[i * FASTA_RESIDUES + j];
+	}
+	for (j = 0; j < FASTA_RESIDUES; j++) {
+		if (totals[j] == 0)
+			continue;
+		fprintf(ofp, "COMPOSITION: %c %llu (%.2lf%%)\n", 'A' + j,
+				(unsigned long long) totals[j],
+				(stats.total == 0) ? 0 : 100.0 * totals[j] / stats.total);
+	}
+
+	if (classLetters != NULL) {
+		for (i = 0; i < columns->nRecords; i++) {
+			fastaColumnsSequence(columns, i, &length);
+			percent = (length == 0) ? 0 : 100.0 * classCounts[i] / length;
+			if (length == 0 || percent < minPercent)
+				continue;
+			fprintf(ofp, "CLASS: record '%s' is %.1lf%% [%s]\n",
+					columns->ids[i], percent, classLetters);
+			nPassing++;
+		}
+		fprintf(ofp, "CLASS: %d of %d records are at least %.1lf%% [%s]\n",
+				nPassing, columns->nRecords, minPercent, classLetters);
+	}
+
+	free(composition);
+	free(classCounts);
+	return 0;
+}
+
+/** print out the help */
+void usage(char *progname)
+{
+	fprintf(stderr, "%s [<OPTIONS>] <datafile> [ <datafile> ... ]\n", progname);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Counts the k-mers in the sequences of the FASTA records\n");
+	fprintf(stderr, "in the data files given.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options: \n");
+	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
+	fprintf(stderr, "%-*s: Length of the k-mers, default %d.\n",
+			OPTIONLEN, "-k <LEN>", DEFAULT_KMER_LENGTH);
+	fprintf(stderr, "%-*s: Sequence alphabet, \"protein\" (default, 5 bits per\n",
+			OPTIONLEN, "-a <ALPHA>");
+	fprintf(stderr, "%-*s: letter, k up to %d) or \"dna\" (2 bits, k up to %d).\n",
+			OPTIONLEN, "", KMER_MAX_LENGTH(KMER_PROTEIN), KMER_MAX_LENGTH(KMER_DNA));
+	fprintf(stderr, "%-*s: Number of counting threads, default is one per\n",
+			OPTIONLEN, "-t <NUM>");
+	fprintf(stderr, "%-*s: online processor.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report the <NUM> most frequent k-mers, default %d.\n",
+			OPTIONLEN, "-n <NUM>", DEFAULT_TOP_COUNT);
+	fprintf(stderr, "%-*s: Report the k-mer spectrum (how many k-mers occur\n",
+			OPTIONLEN, "-s");
+	fprintf(stderr, "%-*s: once, twice, ...).\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Report the count of every k-mer, in alphabetical order.\n",
+			OPTIONLEN, "-f");
+	fprintf(stderr, "%-*s: Report sequence length statistics and residue\n",
+			OPTIONLEN, "-c");
+	fprintf(stderr, "%-*s: composition, scanning the record columns.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -c, and also report the records with at least\n",
+			OPTIONLEN, "-F <LET>[:<PCT>]");
+	fprintf(stderr, "%-*s: <PCT> percent (default %.0lf) of their residues\n",
+			OPTIONLEN, "", DEFAULT_CLASS_PERCENT);
+	fprintf(stderr, "%-*s: among the letters <LET>, e.g. \"AVILMFWY\".\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
+			OPTIONLEN, "-o <FILE>");
+	fprintf(stderr, "\n");
+	exit (1);
+}
+
+/**
+ * Program mainline -- loads all records from the files listed and
+ * counts their k-mers.  Uses getopt(3) to parse arguments.
+ */
+int
+main(int argc, char **argv)
+{
+	char *programname = NULL;
+	FILE *ofp = stdout;
+	KmerAlphabet alphabet = KMER_PROTEIN;
+	int k = DEFAULT_KMER_LENGTH;
+	int nTop = DEFAULT_TOP_COUNT;
+	int nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	int printSpectrum = 0, printAll = 0;
+	int printColumns = 0;
+	char *classLetters = NULL, *percentText;
+	double classPercent = DEFAULT_CLASS_PERCENT;
+	KmerCounter *counter;
+	KmerCount *counts;
+	uint64_t nCounts, j;
+	FASTAcolumns *columns;
+	double startTime, endTime;
+	char *kmer;
+	int i, c, n;
+
+	/* save program name before calling getopt() */
+	programname = argv[0];
+
+	/** use getopt(3) to parse command line */
+	while ((c = getopt(argc, argv, "hsfck:a:t:n:o:F:")) != -1) {
+		if (c == 'k') {
+			if (sscanf(optarg, "%d", &k) != 1) {
+				fprintf(stderr,
+						"Error: cannot parse k-mer"
+						" length requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
+		} else if (c == 'a') {
+			if (strcmp(optarg, "dna") == 0) {
+				alphabet = KMER_DNA;
+			} else if (strcmp(optarg, "protein") == 0) {
+				alphabet = KMER_PROTEIN;
+			} else {
+				fprintf(stderr, "Error: unknown alphabet '%s'\n", optarg);
+				usage(programname);
+			}
+
+		} else if (c == 't') {
+			if (sscanf(optarg, "%d", &nThreads) != 1 || nThreads < 1) {
+				fprintf(stderr,
+						"Error: cannot parse thread"
+						" count requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
+		} else if (c == 'n') {
+			if (sscanf(optarg, "%d", &nTop) != 1) {
+				fprintf(stderr,
+						"Error: cannot parse top"
+						" count requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
+		} else if (c == 's') {
+			printSpectrum = 1;
+
+		} else if (c == 'f') {
+			printAll = 1;
+
+		} else if (c == 'c') {
+			printColumns = 1;
+
+		} else if (c == 'F') {
+			printColumns = 1;
+			classLetters = optarg;
+			percentText = strchr(optarg, ':');
+			if (percentText != NULL) {
+				*percentText++ = '\0';
+				if (sscanf(percentText, "%lf", &classPercent) != 1) {
+					fprintf(stderr,
+							"Error: cannot parse class"
+							" percentage from '%s'\n",
+							percentText);
+					usage(programname);
+				}
+			}
+
+		} else if (c == 'o') {
+			ofp = fopen(optarg, "w");
+			if (ofp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested output file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
+		} else if (c == 'h') {
+			usage(programname);
+		}
+	}
+
+	/** update argc + argv to skip past flags */
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1) {
+		fprintf(stderr, "Error: No data files listed to load!\n");
+		usage(programname);
+	}
+
+	if (k < 1 || k > KMER_MAX_LENGTH(alphabet)) {
+		fprintf(stderr, "Error: k-mer length must be between 1 and %d\n",
+				KMER_MAX_LENGTH(alphabet));
+		usage(programname);
+	}
+
+	/** one shard per thread lets every thread take part in the merge */
+	counter = kmerCreateCounter(alphabet, k, nThreads);
+	if (counter == NULL) {
+		fprintf(stderr, "Error: cannot allocate k-mer counter - exitting\n");
+		return -1;
+	}
+
+	/** every record goes straight into the columns */
+	columns = fastaColumnsCreate();
+	if (columns == NULL) {
+		fprintf(stderr, "Error: cannot allocate record columns - exitting\n");
+		return -1;
+	}
+
+	/** getopt leaves us only "file" arguments left in argv */
+	startTime = wallSeconds();
+	for (i = 0; i < argc; i++) {
+		if (fastaColumnsLoad(columns, argv[i]) < 0) {
+			fprintf(stderr, "Error: failed loading from file '%s'\n", argv[i]);
+			return -1;
+		}
+	}
+	endTime = wallSeconds();
+	printf("Reading %d records took %lf seconds\n",
+			columns->nRecords, endTime - startTime);
+
+	startTime = wallSeconds();
+	if (kmerCountColumns(counter, columns, nThreads) < 0) {
+		fprintf(stderr, "Error: failed counting k-mers\n");
+		return -1;
+	}
+	endTime = wallSeconds();
+	printf("Counting on %d threads took %lf seconds\n",
+			nThreads, endTime - startTime);
+
+	fprintf(ofp, "Counted %llu %d-mers, %llu distinct\n",
+			(unsigned long long) counter->nKmers, k,
+			(unsigned long long) kmerDistinct(counter));
+
+	kmer = (char *) malloc(k + 1);
+
+	/** the most frequent k-mers */
+	if (nTop > 0) {
+		counts = (KmerCount *) malloc(nTop * sizeof(KmerCount));
+		n = kmerTopCounts(counter, counts, nTop);
+		for (i = 0; i < n; i++) {
+			kmerDecode(counter, counts[i].key, kmer);
+			fprintf(ofp, "TOP: %s %llu\n", kmer,
+					(unsigned long long) counts[i].count);
+		}
+		free(counts);
+	}
+
+	/** how many k-mers were seen each number of times */
+	if (printSpectrum) {
+		counts = kmerSpectrum(counter, &nCounts);
+		for (j = 0; counts != NULL && j < nCounts; j++) {
+			fprintf(ofp, "SPECTRUM: %llu %llu\n",
+					(unsigned long long) counts[j].key,
+					(unsigned long long) counts[j].count);
+		}
+		free(counts);
+	}
+
+	/** every k-mer */
+	if (printAll) {
+		counts = kmerAllCounts(counter, &nCounts);
+		for (j = 0; counts != NULL && j < nCounts; j++) {
+			kmerDecode(counter, counts[j].key, kmer);
+			fprintf(ofp, "KMER: %s %llu\n", kmer,
+					(unsigned long long) counts[j].count);
+		}
+		free(counts);
+	}
+
+	/** scans over the sequences held as columns */
+	if (printColumns && columnReport(ofp, columns, classLetters, classPercent) < 0) {
+		fprintf(stderr, "Error: failed scanning record columns\n");
+		return -1;
+	}
+
+	/* clean up before exit */
+	free(kmer);
+	fastaColumnsDelete(columns);
+	kmerDeleteCounter(counter);
+
+	/* exit with success if we get here */
+	return 0;
+}
+
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "latency.h"
+
+#define	LATENCY_MIN_SAMPLES	1024
+
+
+/** nanoseconds on the monotonic clock, which (unlike clock()) is wall time */
+uint64_t
+latencyNow()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/** create an empty histogram, keeping the raw samples if asked to */
+LatencyHistogram *
+latencyCreate(const char *name, int keepSamples)
+{
+	LatencyHistogram *histogram;
+
+	histogram = (LatencyHistogram *) malloc(sizeof(LatencyHistogram));
+	if (histogram == NULL)
+		return NULL;
+	memset(histogram, 0, sizeof(LatencyHistogram));
+	histogram->name = name;
+	histogram->minimum = UINT64_MAX;
+	histogram->keepSamples = keepSamples;
+	return histogram;
+}
+
+void
+latencyDelete(LatencyHistogram *histogram)
+{
+	if (histogram == NULL)	return;
+	free(histogram->samples);
+	free(histogram);
+}
+
+/**
+ * The bucket of a value: itself below LATENCY_LINEAR, and otherwise
+ * its top LATENCY_SUB_BITS bits (the leading one and those after it)
+ * along with how far they had to be shifted down
+ */
+static int
+latencyBucket(uint64_t value)
+{
+	int shift = 0;
+
+	if (value < LATENCY_LINEAR)
+		return (int) value;
+	while ((value >> shift) >= LATENCY_LINEAR)
+		shift++;
+	return shift * (LATENCY_LINEAR / 2) + (int) (value >> shift);
+}
+
+/** the largest value falling in the bucket */
+static uint64_t
+latencyBucketTop(int bucket)
+{
+	int shift;
+
+	if (bucket < LATENCY_LINEAR)
+		return (uint64_t) bucket;
+	shift = bucket / (LATENCY_LINEAR / 2) - 1;
+	return (((uint64_t) (bucket - shift * (LATENCY_LINEAR / 2)) + 1) << shift) - 1;
+}
+
+void
+latencyRecord(LatencyHistogram *histogram, uint64_t nanoseconds)
+{
+	uint64_t *grown;
+	size_t size;
+
+	histogram->counts[latencyBucket(nanoseconds)]++;
+	histogram->nSamples++;
+	histogram->total += nanoseconds;
+	if (nanoseconds < histogram->minimum)
+		histogram->minimum = nanoseconds;
+	if (nanoseconds > histogram->maximum)
+		histogram->maximum = nanoseconds;
+
+	if ( ! histogram->keepSamples)
+		return;
+	if (histogram->nKept == histogram->maxSamples) {
+		size = (histogram->maxSamples == 0)
+				? LATENCY_MIN_SAMPLES : histogram->maxSamples * 2;
+		grown = (uint64_t *) realloc(histogram->samples, size * sizeof(uint64_t));
+		if (grown == NULL) {
+			/** carry on with the histogram alone */
+			histogram->keepSamples = 0;
+			return;
+		}
+		histogram->samples = grown;
+		histogram->maxSamples = size;
+	}
+	histogram->samples[histogram->nKept++] = nanoseconds;
+}
+
+/**
+ * Add the samples of one histogram into another, as when each thread
+ * has kept its own
+ */
+void
+latencyMerge(LatencyHistogram *into, LatencyHistogram *from)
+{
+	uint64_t *grown;
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		into->counts[i] += from->counts[i];
+	into->nSamples += from->nSamples;
+	into->total += from->total;
+	if (from->minimum < into->minimum)
+		into->minimum = from->minimum;
+	if (from->maximum > into->maximum)
+		into->maximum = from->maximum;
+
+	if ( ! into->keepSamples || from->nKept == 0)
+		return;
+	if (into->nKept + from->nKept > into->maxSamples) {
+		grown = (uint64_t *) realloc(into->samples,
+				(into->nKept + from->nKept) * sizeof(uint64_t));
+		if (grown == NULL) {
+			into->keepSamples = 0;
+			return;
+		}
+		into->samples = grown;
+		into->maxSamples = into->nKept + from->nKept;
+	}
+	memcpy(&into->samples[into->nKept], from->samples,
+			from->nKept * sizeof(uint64_t));
+	into->nKept += from->nKept;
+}
+
+/**
+ * The latency that the given percentage of samples came in at or
+ * under, reported as the top of its bucket (but never past the
+ * largest sample seen)
+ */
+uint64_t
+latencyPercentile(LatencyHistogram *histogram, double percent)
+{
+	uint64_t rank, seen = 0, top;
+	int i;
+
+	if (histogram->nSamples == 0)
+		return 0;
+
+	rank = (uint64_t) (percent / 100.0 * histogram->nSamples + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += histogram->counts[i];
+		if (seen >= rank) {
+			top = latencyBucketTop(i);
+			return (top < histogram->maximum) ? top : histogram->maximum;
+		}
+	}
+	return histogram->maximum;
+}
+
+/** print one line of percentiles, if there were any samples */
+void
+latencyPrint(FILE *fp, LatencyHistogram *histogram)
+{
+	if (histogram == NULL || histogram->nSamples == 0)
+		return;
+
+	fprintf(fp, "LATENCY: %s of %llu operations (ns): mean %.0f,"
+			" p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n",
+			histogram->name,
+			(unsigned long long) histogram->nSamples,
+			(double) histogram->total / histogram->nSamples,
+			(unsigned long long) latencyPercentile(histogram, 50.0),
+			(unsigned long long) latencyPercentile(histogram, 90.0),
+			(unsigned long long) latencyPercentile(histogram, 99.0),
+			(unsigned long long) latencyPercentile(histogram, 99.9),
+			(unsigned long long) histogram->maximum);
+}
+
+/** write the raw samples, in the order taken, one "<name> <ns>" per line */
+void
+latencyDumpSamples(FILE *fp, LatencyHistogram *histogram)
+{
+	size_t i;
+
+	if (histogram == NULL)
+		return;
+	for (i = 0; i < histogram->nKept; i++) {
+		fprintf(fp, "%s %llu\n", histogram->name,
+				(unsigned long long) histogram->samples[i]);
+	}
+}
+
+/**
+ * Report the histogram (which may be NULL), write its samples if
+ * there is a file for them, and free it
+ */
+void
+latencyFinish(FILE *reportfp, FILE *samplefp, LatencyHistogram *histogram)
+{
+	if (histogram == NULL)
+		return;
+	latencyPrint(reportfp, histogram);
+	if (samplefp != NULL)
+		latencyDumpSamples(samplefp, histogram);
+	latencyDelete(histogram);
+}
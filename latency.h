@@ -0,0 +1,63 @@
+#ifndef	__LATENCY_HISTOGRAM_HEADER__
+#define	__LATENCY_HISTOGRAM_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Per operation latencies, in nanoseconds of the monotonic clock,
+ * kept in an HDR style histogram: values below LATENCY_LINEAR get a
+ * bucket each, and above that every power of two is split into
+ * LATENCY_LINEAR / 2 buckets, so a value is known to within about 3%
+ * however large it is, in a fixed 15kB.
+ *
+ * If asked to, the histogram also keeps every sample so that they can
+ * be written out raw afterwards.
+ */
+#define	LATENCY_SUB_BITS	6
+#define	LATENCY_LINEAR		(1 << LATENCY_SUB_BITS)
+#define	LATENCY_BUCKETS		((64 - LATENCY_SUB_BITS + 2) * (LATENCY_LINEAR / 2))
+
+typedef struct LatencyHistogram {
+	const char *name;
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t nSamples;
+	uint64_t minimum;
+	uint64_t maximum;
+	uint64_t total;
+
+	/** raw samples, if kept */
+	int keepSamples;
+	uint64_t *samples;
+	size_t nKept;
+	size_t maxSamples;
+} LatencyHistogram;
+
+/** prototypes */
+uint64_t latencyNow();
+
+LatencyHistogram *latencyCreate(const char *name, int keepSamples);
+void latencyDelete(LatencyHistogram *histogram);
+
+void latencyRecord(LatencyHistogram *histogram, uint64_t nanoseconds);
+void latencyMerge(LatencyHistogram *into, LatencyHistogram *from);
+uint64_t latencyPercentile(LatencyHistogram *histogram, double percent);
+
+void latencyPrint(FILE *fp, LatencyHistogram *histogram);
+void latencyDumpSamples(FILE *fp, LatencyHistogram *histogram);
+void latencyFinish(FILE *reportfp, FILE *samplefp, LatencyHistogram *histogram);
+
+/**
+ * Time a single operation into a histogram that may be NULL, in
+ * which case the clock is never read:
+ *
+ *     start = latencyStart(histogram);
+ *     ... the operation ...
+ *     latencyStop(histogram, start);
+ */
+#define	latencyStart(h)		(((h) != NULL) ? latencyNow() : 0)
+#define	latencyStop(h, start) \
+		do { if ((h) != NULL) latencyRecord((h), latencyNow() - (start)); } while (0)
+
+#endif /* __LATENCY_HISTOGRAM_HEADER__ */
@@ -0,0 +1,718 @@
+#include <stdio.h>
+#include <string.h> /* for strlen(), strcmp() */
+#include <stdlib.h> /* for free() */
+#include <unistd.h> /* for getopt(), dup2() */
+#include <fcntl.h>  /* for open() */
+#include <math.h>   /* for exp(), log() */
+#include <stdint.h>
+#include <time.h>   /* for clock_gettime() */
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "fasta.h"
+#include "fasta_columns.h"
+#include "hashmix.h"
+
+#define	DEFAULT_RECORD_COUNT	100000
+#define	DEFAULT_LINE_WIDTH	60
+#define	DEFAULT_MEAN_LENGTH	360
+#define	LOGNORMAL_SIGMA		0.6
+#define	READ_BLOCK_SIZE		(64 * 1024)
+#define OPTIONLEN	12
+
+/**
+ * Parsing throughput of the FASTA readers, timed apart from anything
+ * done with the records afterwards.  The corpus is either a file
+ * given on the command line or one synthesized from the seed, with
+ * the record count, line width and sequence length distribution
+ * asked for.
+ */
+
+/** the ways of reading the corpus that can be timed */
+typedef enum ReaderKind {
+	READER_READ = 0,	/* fread(3) in blocks: the I/O ceiling */
+	READER_LINES,		/* fgets(3) each line: the floor for a line parser */
+	READER_RECORD,		/* fastaReadRecord() into one reused record */
+	READER_ARRAY,		/* loadFastaArray() into an array of records */
+	READER_COLUMNS,		/* fastaReadRecord() appended to a column store */
+	N_READERS
+} ReaderKind;
+
+static const char *readerNames[N_READERS] = {
+		"read", "lines", "record", "array", "columns"
+	};
+
+/** sequence length distributions for the synthesized corpus */
+typedef enum LengthDistribution {
+	LENGTHS_FIXED = 0,
+	LENGTHS_UNIFORM,
+	LENGTHS_LOGNORMAL,
+	N_DISTRIBUTIONS
+} LengthDistribution;
+
+static const char *distributionNames[N_DISTRIBUTIONS] = {
+		"fixed", "uniform", "lognormal"
+	};
+
+typedef struct CorpusSpec {
+	long nRecords;
+	int lineWidth;
+	int meanLength;
+	LengthDistribution lengths;
+	uint64_t seed;
+} CorpusSpec;
+
+typedef struct ParseResult {
+	ReaderKind reader;
+	int rep;
+	long nRecords;
+	double seconds;
+} ParseResult;
+
+
+/** Wall clock seconds */
+static double
+wallSeconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** splitmix64, so a corpus can be made again from its seed */
+static uint64_t
+nextRandom(uint64_t *state)
+{
+	return hashSplitmixNext(state);
+}
+
+/** uniform in [0, 1) */
+static double
+uniformRandom(uint64_t *state)
+{
+	return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * A sequence length from the distribution, between 1 and maxLength.
+ * Protein lengths are roughly lognormal; the mean given is kept as
+ * the mean by taking mu = log(mean) - sigma^2 / 2.
+ */
+static int
+sequenceLength(uint64_t *state, const CorpusSpec *spec, int maxLength)
+{
+	double u1, u2, normal, length;
+
+	if (spec->lengths == LENGTHS_FIXED) {
+		length = spec->meanLength;
+	} else if (spec->lengths == LENGTHS_UNIFORM) {
+		length = 1 + (int) (uniformRandom(state) * (2 * spec->meanLength - 1));
+	} else {
+		/* Box-Muller */
+		u1 = 1.0 - uniformRandom(state);
+		u2 = uniformRandom(state);
+		normal = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+		length = exp(log(spec->meanLength)
+				- LOGNORMAL_SIGMA * LOGNORMAL_SIGMA / 2
+				+ LOGNORMAL_SIGMA * normal);
+	}
+	if (length < 1)
+		return 1;
+	if (length > maxLength)
+		return maxLength;
+	return (int) length;
+}
+
+/** an accession unique to the record number, six letters while that lasts */
+static void
+makeAccession(char *buffer, long recordNumber)
+{
+	static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	int i, length = (recordNumber < 36L * 36 * 36 * 36 * 36) ? 5 : 9;
+
+	buffer[0] = "OPQ"[recordNumber % 3];
+	for (i = length; i > 0; i--) {
+		buffer[i] = digits[recordNumber % 36];
+		recordNumber /= 36;
+	}
+	buffer[length + 1] = '\0';
+}
+
+/**
+ * Write a corpus of UniProt style records: a description line with
+ * the OS=, OX=, GN=, PE= and SV= fields the reader parses out, and
+ * the sequence wrapped at the line width.  Sequences are capped so
+ * the lines fit the reader's buffer.
+ */
+static int
+writeCorpus(FILE *fp, const CorpusSpec *spec)
+{
+	static const char residues[] = "ACDEFGHIKLMNPQRSTVWY";
+	static const char *proteinWords[] = {
+			"Putative", "Uncharacterized", "protein", "kinase", "transporter",
+			"subunit", "alpha", "beta", "ribosomal", "binding", "domain",
+			"containing", "dehydrogenase", "synthase", "receptor", "factor"
+		};
+	static const struct { const char *mnemonic, *name; unsigned long taxon; }
+		organisms[] = {
+			{ "HUMAN", "Homo sapiens", 9606 },
+			{ "MOUSE", "Mus musculus", 10090 },
+			{ "YEAST", "Saccharomyces cerevisiae (strain ATCC 204508 / S288c)", 559292 },
+			{ "ECOLI", "Escherichia coli (strain K12)", 83333 },
+			{ "ARATH", "Arabidopsis thaliana", 3702 },
+			{ "FRG3G", "Frog virus 3 (isolate Goorha)", 654924 }
+		};
+	int nWords = sizeof(proteinWords) / sizeof(proteinWords[0]);
+	int nOrganisms = sizeof(organisms) / sizeof(organisms[0]);
+	int maxLength = FASTA_MAX_SEQUENCE_LINES * spec->lineWidth;
+	char accession[16], entryName[8], gene[8];
+	char *line;
+	uint64_t state = spec->seed;
+	long i;
+	int j, length, organism, nNameWords, column;
+
+	line = (char *) malloc(spec->lineWidth + 2);
+	if (line == NULL)
+		return -1;
+
+	for (i = 0; i < spec->nRecords; i++) {
+		makeAccession(accession, i);
+		for (j = 0; j < 5; j++)
+			entryName[j] = 'A' + nextRandom(&state) % 26;
+		entryName[5] = '\0';
+		for (j = 0; j < 4; j++)
+			gene[j] = 'a' + nextRandom(&state) % 26;
+		gene[4] = '0' + nextRandom(&state) % 10;
+		gene[5] = '\0';
+		organism = nextRandom(&state) % nOrganisms;
+
+		fprintf(fp, ">sp|%s|%s_%s", accession, entryName,
+				organisms[organism].mnemonic);
+		nNameWords = 1 + nextRandom(&state) % 4;
+		for (j = 0; j < nNameWords; j++)
+			fprintf(fp, " %s", proteinWords[nextRandom(&state) % nWords]);
+		fprintf(fp, " OS=%s OX=%lu GN=%s PE=%d SV=%d\n",
+				organisms[organism].name, organisms[organism].taxon, gene,
+				1 + (int) (nextRandom(&state) % 5),
+				1 + (int) (nextRandom(&state) % 3));
+
+		length = sequenceLength(&state, spec, maxLength);
+		for (column = 0; length > 0; length--) {
+			line[column++] = residues[nextRandom(&state) % 20];
+			if (column == spec->lineWidth || length == 1) {
+				line[column++] = '\n';
+				fwrite(line, 1, column, fp);
+				column = 0;
+			}
+		}
+	}
+	free(line);
+
+	if (ferror(fp))
+		return -1;
+	return 0;
+}
+
+/** the raw bytes, counting the '>' that start lines (and so records) */
+static long
+readBlocks(char *filename)
+{
+	char *block;
+	const char *mark, *end;
+	char previous = '\n';
+	size_t nRead;
+	long nRecords = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	block = (char *) malloc(READ_BLOCK_SIZE);
+	while ((nRead = fread(block, 1, READ_BLOCK_SIZE, fp)) > 0) {
+		end = block + nRead;
+		for (mark = block; (mark = memchr(mark, '>', end - mark)) != NULL; mark++) {
+			if (((mark == block) ? previous : mark[-1]) == '\n')
+				nRecords++;
+		}
+		previous = end[-1];
+	}
+	free(block);
+	fclose(fp);
+	return nRecords;
+}
+
+static long
+readLines(char *filename)
+{
+	char linebuffer[FASTA_MAX_DESCRIPTION_LINE_LENGTH + 2];
+	long nRecords = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(linebuffer, sizeof(linebuffer), fp) != NULL) {
+		if (linebuffer[0] == '>')
+			nRecords++;
+	}
+	fclose(fp);
+	return nRecords;
+}
+
+static long
+readRecords(char *filename)
+{
+	FASTArecord fRecord;
+	long nRecords = 0;
+	int status;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -1;
+	fastaInitializeRecord(&fRecord);
+	while ((status = fastaReadRecord(fp, &fRecord)) > 0) {
+		nRecords++;
+		fastaClearRecord(&fRecord);
+	}
+	fclose(fp);
+	return (status < 0) ? -1 : nRecords;
+}
+
+/**
+ * loadFastaArray() as it stands, progress dots and all; they are sent
+ * to /dev/null so they cannot end up among the results.  Clearing the
+ * records afterwards is not timed.
+ */
+static long
+readArray(char *filename, long maxRecords, double *seconds)
+{
+	FASTArecord *list;
+	double startTime;
+	int savedStdout, nullFd;
+	long i, nRecords;
+
+	list = (FASTArecord *) malloc((maxRecords + 1) * sizeof(FASTArecord));
+	if (list == NULL)
+		return -1;
+	for (i = 0; i <= maxRecords; i++)
+		fastaInitializeRecord(&list[i]);
+
+	fflush(stdout);
+	savedStdout = dup(STDOUT_FILENO);
+	nullFd = open("/dev/null", O_WRONLY);
+	if (savedStdout >= 0 && nullFd >= 0)
+		dup2(nullFd, STDOUT_FILENO);
+	if (nullFd >= 0)
+		close(nullFd);
+
+	startTime = wallSeconds();
+	nRecords = loadFastaArray(list, (int) maxRecords + 1, filename);
+	*seconds = wallSeconds() - startTime;
+
+	fflush(stdout);
+	if (savedStdout >= 0) {
+		dup2(savedStdout, STDOUT_FILENO);
+		close(savedStdout);
+	}
+
+	clearFastaArray(list, (int) maxRecords + 1);
+	free(list);
+	return nRecords;
+}
+
+/** freeing the column store afterwards is not timed */
+static long
+readColumns(char *filename, double *seconds)
+{
+	FASTAcolumns *columns;
+	FASTArecord fRecord;
+	double startTime;
+	long nRecords = 0;
+	int status;
+	FILE *fp;
+
+	columns = fastaColumnsCreate();
+	if (columns == NULL)
+		return -1;
+
+	startTime = wallSeconds();
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fastaColumnsDelete(columns);
+		return -1;
+	}
+	fastaInitializeRecord(&fRecord);
+	while ((status = fastaReadRecord(fp, &fRecord)) > 0) {
+		if (fastaColumnsAppend(columns, &fRecord) < 0)
+			status = -1;
+		fastaClearRecord(&fRecord);
+		if (status < 0)
+			break;
+		nRecords++;
+	}
+	fclose(fp);
+	*seconds = wallSeconds() - startTime;
+
+	fastaColumnsDelete(columns);
+	return (status < 0) ? -1 : nRecords;
+}
+
+/** time one pass of the reader over the file, returning the records read */
+static long
+timeReader(ReaderKind reader, char *filename, long expectedRecords,
+		double *seconds)
+{
+	double startTime;
+	long nRecords;
+
+	if (reader == READER_ARRAY)
+		return readArray(filename, expectedRecords, seconds);
+	if (reader == READER_COLUMNS)
+		return readColumns(filename, seconds);
+
+	startTime = wallSeconds();
+	if (reader == READER_READ) {
+		nRecords = readBlocks(filename);
+	} else if (reader == READER_LINES) {
+		nRecords = readLines(filename);
+	} else {
+		nRecords = readRecords(filename);
+	}
+	*seconds = wallSeconds() - startTime;
+	return nRecords;
+}
+
+
+static void
+printCSV(FILE *fp, const char *corpus, long nBytes,
+		ParseResult *results, int nResults)
+{
+	int i;
+
+	fprintf(fp, "corpus,bytes,reader,rep,records,seconds,mb_per_s,records_per_s\n");
+	for (i = 0; i < nResults; i++) {
+		fprintf(fp, "%s,%ld,%s,%d,%ld,%.6f,%.1f,%.0f\n",
+				corpus, nBytes, readerNames[results[i].reader],
+				results[i].rep, results[i].nRecords, results[i].seconds,
+				nBytes / 1e6 / results[i].seconds,
+				results[i].nRecords / results[i].seconds);
+	}
+}
+
+static void
+printJSON(FILE *fp, const char *corpus, long nBytes, const CorpusSpec *spec,
+		ParseResult *results, int nResults)
+{
+	int i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"corpus\": \"%s\",\n", corpus);
+	fprintf(fp, "  \"bytes\": %ld,\n", nBytes);
+	if (spec != NULL) {
+		fprintf(fp, "  \"generated\": {\"records\": %ld, \"lineWidth\": %d, "
+				"\"meanLength\": %d, \"lengths\": \"%s\", \"seed\": %llu},\n",
+				spec->nRecords, spec->lineWidth, spec->meanLength,
+				distributionNames[spec->lengths],
+				(unsigned long long) spec->seed);
+	}
+#ifdef	__OPTIMIZE__
+	fprintf(fp, "  \"optimized\": true,\n");
+#else
+	fprintf(fp, "  \"optimized\": false,\n");
+#endif
+	fprintf(fp, "  \"results\": [\n");
+	for (i = 0; i < nResults; i++) {
+		fprintf(fp, "    {\"reader\": \"%s\", \"rep\": %d, \"records\": %ld, "
+				"\"seconds\": %.6f, \"mbPerSecond\": %.1f, "
+				"\"recordsPerSecond\": %.0f}%s\n",
+				readerNames[results[i].reader], results[i].rep,
+				results[i].nRecords, results[i].seconds,
+				nBytes / 1e6 / results[i].seconds,
+				results[i].nRecords / results[i].seconds,
+				(i < nResults - 1) ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+}
+
+
+/** set flags[i] for each comma separated name found in names[] */
+static int
+parseNameList(char *list, const char **names, int nNames, int *flags)
+{
+	char *name, *save = NULL;
+	int i;
+
+	for (name = strtok_r(list, ",", &save); name != NULL;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "all") == 0) {
+			for (i = 0; i < nNames; i++)
+				flags[i] = 1;
+			continue;
+		}
+		for (i = 0; i < nNames; i++) {
+			if (strcmp(name, names[i]) == 0)
+				break;
+		}
+		if (i == nNames) {
+			fprintf(stderr, "Error: unknown name '%s'\n", name);
+			return -1;
+		}
+		flags[i] = 1;
+	}
+	return 0;
+}
+
+/** print out the help */
+void usage(char *progname)
+{
+	fprintf(stderr, "%s [<OPTIONS>] [ <datafile> ]\n", progname);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Times the FASTA readers over the data file given, or over a\n");
+	fprintf(stderr, "corpus synthesized to the options below, reporting MB/s and\n");
+	fprintf(stderr, "records/s for each as CSV, one line per pass.  Nothing is done\n");
+	fprintf(stderr, "with the records read, so this is the parsing cost alone.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options: \n");
+	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
+	fprintf(stderr, "%-*s: Comma separated readers, default all of: read (raw\n",
+			OPTIONLEN, "-R <LIST>");
+	fprintf(stderr, "%-*s: blocks), lines (fgets), record (fastaReadRecord),\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: array (loadFastaArray) and columns (fastaReadRecord\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: into a column store).\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Repeat each reader <N> times, default 1.\n",
+			OPTIONLEN, "-r <N>");
+	fprintf(stderr, "%-*s: Records to synthesize, default %d; may be written\n",
+			OPTIONLEN, "-n <N>", DEFAULT_RECORD_COUNT);
+	fprintf(stderr, "%-*s: as 1e6.  The array reader holds every record.\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Residues per sequence line, 1 to 78, default %d.\n",
+			OPTIONLEN, "-w <WIDTH>", DEFAULT_LINE_WIDTH);
+	fprintf(stderr, "%-*s: Mean sequence length, default %d.\n",
+			OPTIONLEN, "-l <MEAN>", DEFAULT_MEAN_LENGTH);
+	fprintf(stderr, "%-*s: Sequence length distribution: fixed, uniform (1 to\n",
+			OPTIONLEN, "-d <DIST>");
+	fprintf(stderr, "%-*s: twice the mean) or lognormal (default, sigma %.1f).\n",
+			OPTIONLEN, "", LOGNORMAL_SIGMA);
+	fprintf(stderr, "%-*s: Seed for the synthesized corpus, default 1.\n",
+			OPTIONLEN, "-s <SEED>");
+	fprintf(stderr, "%-*s: Keep the synthesized corpus in <FILE>.\n",
+			OPTIONLEN, "-g <FILE>");
+	fprintf(stderr, "%-*s: Write the results as JSON rather than CSV.\n",
+			OPTIONLEN, "-j");
+	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
+			OPTIONLEN, "-o <FILE>");
+	fprintf(stderr, "\n");
+	exit (1);
+}
+
+/**
+ * Program mainline -- synthesizes the corpus if none was given, then
+ * times each reader over it.  Uses getopt(3) to parse arguments.
+ */
+int
+main(int argc, char **argv)
+{
+	char *programname = NULL;
+	FILE *ofp = stdout, *corpusfp;
+	CorpusSpec spec;
+	int readers[N_READERS] = { 0 };
+	int anyReader = 0, nReps = 1, printJSONResults = 0;
+	char *corpusName = NULL, *keepName = NULL;
+	char temporaryName[1024];
+	const char *tmpdir;
+	ParseResult *results = NULL;
+	int nResults = 0, generated = 0, status = -1;
+	long nBytes, nRecords, expectedRecords;
+	double value, seconds;
+	struct stat corpusStat;
+	int fd, i, rep, c;
+
+	spec.nRecords = DEFAULT_RECORD_COUNT;
+	spec.lineWidth = DEFAULT_LINE_WIDTH;
+	spec.meanLength = DEFAULT_MEAN_LENGTH;
+	spec.lengths = LENGTHS_LOGNORMAL;
+	spec.seed = 1;
+
+	/* save program name before calling getopt() */
+	programname = argv[0];
+
+	/** use getopt(3) to parse command line */
+	while ((c = getopt(argc, argv, "hjR:r:n:w:l:d:s:g:o:")) != -1) {
+		if (c == 'R') {
+			if (parseNameList(optarg, readerNames, N_READERS, readers) < 0)
+				usage(programname);
+			anyReader = 1;
+
+		} else if (c == 'r') {
+			nReps = atoi(optarg);
+			if (nReps < 1) {
+				fprintf(stderr, "Error: need at least one repetition\n");
+				usage(programname);
+			}
+
+		} else if (c == 'n') {
+			value = strtod(optarg, NULL);
+			if ( ! (value >= 1 && value <= 1e9)) {
+				fprintf(stderr, "Error: bad record count '%s'\n", optarg);
+				usage(programname);
+			}
+			spec.nRecords = (long) value;
+
+		} else if (c == 'w') {
+			spec.lineWidth = atoi(optarg);
+			if (spec.lineWidth < 1 || spec.lineWidth > FASTA_RECOMMENDED_LINE_LENGTH - 2) {
+				fprintf(stderr, "Error: line width must be between 1 and %d\n",
+						FASTA_RECOMMENDED_LINE_LENGTH - 2);
+				usage(programname);
+			}
+
+		} else if (c == 'l') {
+			spec.meanLength = atoi(optarg);
+			if (spec.meanLength < 1) {
+				fprintf(stderr, "Error: mean length must be positive\n");
+				usage(programname);
+			}
+
+		} else if (c == 'd') {
+			for (i = 0; i < N_DISTRIBUTIONS; i++) {
+				if (strcmp(optarg, distributionNames[i]) == 0)
+					break;
+			}
+			if (i == N_DISTRIBUTIONS) {
+				fprintf(stderr, "Error: unknown length distribution '%s'\n", optarg);
+				usage(programname);
+			}
+			spec.lengths = (LengthDistribution) i;
+
+		} else if (c == 's') {
+			spec.seed = strtoull(optarg, NULL, 0);
+
+		} else if (c == 'g') {
+			keepName = optarg;
+
+		} else if (c == 'j') {
+			printJSONResults = 1;
+
+		} else if (c == 'o') {
+			ofp = fopen(optarg, "w");
+			if (ofp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested output file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
+		} else if (c == 'h') {
+			usage(programname);
+		}
+	}
+
+	/** update argc + argv to skip past flags */
+	argc -= optind;
+	argv += optind;
+
+	if (argc > 1 || (argc == 1 && keepName != NULL)) {
+		fprintf(stderr, "Error: give one data file, or -g to synthesize one\n");
+		usage(programname);
+	}
+
+	for (i = 0; i < N_READERS; i++)
+		readers[i] |= ! anyReader;
+
+	/** synthesize the corpus if no file was given */
+	if (argc == 1) {
+		corpusName = argv[0];
+	} else {
+		if (keepName != NULL) {
+			corpusName = keepName;
+			corpusfp = fopen(corpusName, "w");
+		} else {
+			tmpdir = getenv("TMPDIR");
+			snprintf(temporaryName, sizeof(temporaryName), "%s/a4parse-XXXXXX",
+					(tmpdir != NULL) ? tmpdir : "/tmp");
+			corpusName = temporaryName;
+			fd = mkstemp(temporaryName);
+			corpusfp = (fd < 0) ? NULL : fdopen(fd, "w");
+		}
+		if (corpusfp == NULL) {
+			fprintf(stderr, "Error: cannot create corpus file '%s' : %s\n",
+					corpusName, strerror(errno));
+			return -1;
+		}
+		generated = 1;
+		if (writeCorpus(corpusfp, &spec) < 0 || fclose(corpusfp) != 0) {
+			fprintf(stderr, "Error: failed writing corpus file '%s'\n", corpusName);
+			if (keepName == NULL)
+				unlink(corpusName);
+			return -1;
+		}
+	}
+
+	/** from here on, a synthesized corpus is removed however we leave */
+	if (stat(corpusName, &corpusStat) < 0) {
+		fprintf(stderr, "Error: cannot stat data file '%s' : %s\n",
+				corpusName, strerror(errno));
+		goto cleanup;
+	}
+	nBytes = (long) corpusStat.st_size;
+
+	/** an untimed pass to bring the file into the page cache */
+	expectedRecords = readBlocks(corpusName);
+	if (expectedRecords < 0) {
+		fprintf(stderr, "Error: cannot read data file '%s' : %s\n",
+				corpusName, strerror(errno));
+		goto cleanup;
+	}
+
+	results = (ParseResult *) malloc(N_READERS * nReps * sizeof(ParseResult));
+	if (results == NULL) {
+		fprintf(stderr, "Error: cannot allocate results - exitting\n");
+		goto cleanup;
+	}
+	for (rep = 0; rep < nReps; rep++) {
+		for (i = 0; i < N_READERS; i++) {
+			if ( ! readers[i])
+				continue;
+			nRecords = timeReader((ReaderKind) i, corpusName,
+					expectedRecords, &seconds);
+			if (nRecords < 0) {
+				fprintf(stderr, "Error: reader '%s' failed on '%s'\n",
+						readerNames[i], corpusName);
+				goto cleanup;
+			}
+			if (generated && nRecords != spec.nRecords) {
+				fprintf(stderr, "Error: reader '%s' found %ld records of %ld\n",
+						readerNames[i], nRecords, spec.nRecords);
+				goto cleanup;
+			}
+			results[nResults].reader = (ReaderKind) i;
+			results[nResults].rep = rep;
+			results[nResults].nRecords = nRecords;
+			results[nResults].seconds = seconds;
+			nResults++;
+		}
+	}
+
+	if (printJSONResults) {
+		printJSON(ofp, (keepName == NULL && generated) ? "synthetic" : corpusName,
+				nBytes, generated ? &spec : NULL, results, nResults);
+	} else {
+		printCSV(ofp, (keepName == NULL && generated) ? "synthetic" : corpusName,
+				nBytes, results, nResults);
+	}
+	if (ofp != stdout)
+		fclose(ofp);
+
+	/* exit with success if we get here */
+	status = 0;
+
+cleanup:
+	if (generated && keepName == NULL)
+		unlink(corpusName);
+	free(results);
+	return status;
+}
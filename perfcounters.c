@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef	__linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfcounters.h"
+
+static const char *perfEventNames[PERF_N_EVENTS] = {
+		"cycles", "instructions", "LLC misses", "branch misses", "dTLB misses"
+	};
+
+const char *
+perfEventName(PerfEvent event)
+{
+	if (event < 0 || event >= PERF_N_EVENTS)
+		return "unknown";
+	return perfEventNames[event];
+}
+
+#ifdef	__linux__
+
+/** the type and config perf_event_open(2) wants for each event */
+static void
+perfEventAttr(PerfEvent event, struct perf_event_attr *attr)
+{
+	memset(attr, 0, sizeof(struct perf_event_attr));
+	attr->size = sizeof(struct perf_event_attr);
+	attr->type = PERF_TYPE_HARDWARE;
+	attr->disabled = 1;
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+	/** threads started later are counted too, once they have been joined */
+	attr->inherit = 1;
+	attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	if (event == PERF_CYCLES) {
+		attr->config = PERF_COUNT_HW_CPU_CYCLES;
+	} else if (event == PERF_INSTRUCTIONS) {
+		attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+	} else if (event == PERF_LLC_MISSES) {
+		attr->config = PERF_COUNT_HW_CACHE_MISSES;
+	} else if (event == PERF_BRANCH_MISSES) {
+		attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+	} else {
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = PERF_COUNT_HW_CACHE_DTLB
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+				| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+}
+
+/**
+ * Open a counter for each event on this process, any CPU.  The events
+ * are opened separately rather than as a group so that one the
+ * machine lacks does not lose the others; if the kernel has to take
+ * turns with them, the counts are scaled up by the time each ran.
+ */
+PerfCounters *
+perfCountersCreate(const char *name)
+{
+	PerfCounters *counters;
+	struct perf_event_attr attr;
+	int i;
+
+	counters = (PerfCounters *) malloc(sizeof(PerfCounters));
+	if (counters == NULL)
+		return NULL;
+	memset(counters, 0, sizeof(PerfCounters));
+	counters->name = name;
+
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		perfEventAttr((PerfEvent) i, &attr);
+		counters->fd[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (counters->fd[i] < 0)
+			counters->openErrno = errno;
+	}
+	return counters;
+}
+
+void
+perfCountersStart(PerfCounters *counters)
+{
+	int i;
+
+	if (counters == NULL)
+		return;
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void
+perfCountersStop(PerfCounters *counters, uint64_t nOperations)
+{
+	uint64_t reading[3];	/* value, time enabled, time running */
+	int i;
+
+	if (counters == NULL)
+		return;
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] >= 0)
+			ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] < 0
+				|| read(counters->fd[i], reading, sizeof(reading)) != sizeof(reading))
+			continue;
+		if (reading[2] > 0 && reading[2] < reading[1])
+			reading[0] = (uint64_t) ((double) reading[0] * reading[1] / reading[2]);
+		counters->counts[i] += reading[0];
+	}
+	counters->nOperations += nOperations;
+}
+
+void
+perfCountersDelete(PerfCounters *counters)
+{
+	int i;
+
+	if (counters == NULL)	return;
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] >= 0)
+			close(counters->fd[i]);
+	}
+	free(counters);
+}
+
+#else	/* __linux__ */
+
+/** there is no perf_event_open(2) here, so nothing is ever counted */
+PerfCounters *
+perfCountersCreate(const char *name)
+{
+	PerfCounters *counters;
+	int i;
+
+	counters = (PerfCounters *) malloc(sizeof(PerfCounters));
+	if (counters == NULL)
+		return NULL;
+	memset(counters, 0, sizeof(PerfCounters));
+	counters->name = name;
+	counters->openErrno = ENOSYS;
+	for (i = 0; i < PERF_N_EVENTS; i++)
+		counters->fd[i] = -1;
+	return counters;
+}
+
+void
+perfCountersStart(PerfCounters *counters)
+{
+}
+
+void
+perfCountersStop(PerfCounters *counters, uint64_t nOperations)
+{
+	if (counters != NULL)
+		counters->nOperations += nOperations;
+}
+
+void
+perfCountersDelete(PerfCounters *counters)
+{
+	free(counters);
+}
+
+#endif	/* __linux__ */
+
+/**
+ * Print the counts per operation on one line, along with the
+ * instructions per cycle if both were counted
+ */
+void
+perfCountersPrint(FILE *fp, PerfCounters *counters)
+{
+	double perOperation;
+	int i, nOpen = 0;
+
+	if (counters == NULL || counters->nOperations == 0)
+		return;
+
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] >= 0)
+			nOpen++;
+	}
+	if (nOpen == 0) {
+		fprintf(fp, "PERF: %s counters unavailable: %s\n",
+				counters->name, strerror(counters->openErrno));
+		return;
+	}
+
+	fprintf(fp, "PERF: %s of %llu operations, per operation:",
+			counters->name, (unsigned long long) counters->nOperations);
+	for (i = 0; i < PERF_N_EVENTS; i++) {
+		if (counters->fd[i] < 0) {
+			fprintf(fp, "%s %s n/a", (i == 0) ? "" : ",", perfEventNames[i]);
+			continue;
+		}
+		perOperation = (double) counters->counts[i] / counters->nOperations;
+		fprintf(fp, "%s %s %.1f", (i == 0) ? "" : ",",
+				perfEventNames[i], perOperation);
+	}
+	if (counters->fd[PERF_CYCLES] >= 0 && counters->fd[PERF_INSTRUCTIONS] >= 0
+			&& counters->counts[PERF_CYCLES] > 0) {
+		fprintf(fp, ", IPC %.2f", (double) counters->counts[PERF_INSTRUCTIONS]
+				/ counters->counts[PERF_CYCLES]);
+	}
+	fprintf(fp, "\n");
+}
+
+/** report the counters (which may be NULL) and free them */
+void
+perfCountersFinish(FILE *fp, PerfCounters *counters)
+{
+	if (counters == NULL)
+		return;
+	perfCountersPrint(fp, counters);
+	perfCountersDelete(counters);
+}
@@ -0,0 +1,49 @@
+#ifndef	__PERF_COUNTERS_HEADER__
+#define	__PERF_COUNTERS_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Hardware event counts for a phase of work (all the inserts, say),
+ * read from the kernel's performance counters through perf_event_open(2)
+ * and reported per operation.  Only user space is counted, so the
+ * system calls reading the input do not show up, but the library
+ * calls and the parsing and printing around them all do.
+ *
+ * Events the machine (or the kernel's perf_event_paranoid setting)
+ * does not allow are reported as unavailable; elsewhere than Linux
+ * they all are.
+ */
+typedef enum PerfEvent {
+	PERF_CYCLES = 0,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_N_EVENTS
+} PerfEvent;
+
+typedef struct PerfCounters {
+	const char *name;
+	int fd[PERF_N_EVENTS];
+	int openErrno;
+
+	/** totals over all the runs so far, scaled up if multiplexed */
+	uint64_t counts[PERF_N_EVENTS];
+	uint64_t nOperations;
+} PerfCounters;
+
+/** prototypes */
+PerfCounters *perfCountersCreate(const char *name);
+void perfCountersDelete(PerfCounters *counters);
+
+/** both may be given NULL, and then do nothing */
+void perfCountersStart(PerfCounters *counters);
+void perfCountersStop(PerfCounters *counters, uint64_t nOperations);
+
+const char *perfEventName(PerfEvent event);
+void perfCountersPrint(FILE *fp, PerfCounters *counters);
+void perfCountersFinish(FILE *fp, PerfCounters *counters);
+
+#endif /* __PERF_COUNTERS_HEADER__ */
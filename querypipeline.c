@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "querypipeline.h"
+#include "data-reader.h"
+
+/** yield this many times while waiting on a ring, then sleep briefly */
+#define	QUERY_WAIT_YIELDS	64
+#define	QUERY_WAIT_SLEEP_NS	50000
+
+/**
+ * Bounded queue of pointers that any number of threads may push to
+ * and pop from without a lock (Vyukov's design): each cell carries a
+ * sequence number saying whether it is ready to be filled or emptied
+ * on the current lap, and a thread claims a cell by advancing the
+ * position with a compare and swap.  The two positions are kept on
+ * separate cache lines so pushers and poppers do not contend.
+ */
+typedef struct QueryRingCell {
+	uint64_t sequence;
+	void *data;
+} QueryRingCell;
+
+typedef struct QueryRing {
+	QueryRingCell *cells;
+	uint64_t mask;
+	uint64_t pushPosition __attribute__ ((aligned (64)));
+	uint64_t popPosition __attribute__ ((aligned (64)));
+} QueryRing;
+
+/** the keys of a chunk, packed end to end, and what each produced */
+typedef struct QueryChunk {
+	uint64_t sequence;
+	int nKeys;
+	size_t nBytes;
+	size_t offsets[QUERY_CHUNK_KEYS];
+	QueryResult results[QUERY_CHUNK_KEYS];
+	char keys[QUERY_CHUNK_KEYS * QUERY_LINE_MAX];
+} QueryChunk;
+
+typedef struct QueryPipeline {
+	FILE *fp;
+	QueryLookupFunction lookup;
+	void *context;
+	int nWorkers;
+
+	QueryChunk *chunks;
+	int nChunks;
+	QueryRing empty;	/* chunks ready for the reader */
+	QueryRing work;		/* chunks of keys to be looked up */
+	QueryRing done;		/* chunks of results to be reported */
+	QueryChunk **waiting;	/* done chunks held for their turn */
+
+	/** set by the reader once it has seen the end of the input */
+	uint64_t nChunksRead;
+	int readerDone;
+} QueryPipeline;
+
+typedef struct QueryWorker {
+	QueryPipeline *pipeline;
+	pthread_t thread;
+	LatencyHistogram *latency;
+	uint64_t nQueries;
+	uint64_t cost;
+} QueryWorker;
+
+/** pushed once per worker after the last chunk, to send them home */
+static char queryEndOfInput;
+
+
+static int
+query_ring_init(QueryRing *ring, int minimumSize)
+{
+	uint64_t size = 1, i;
+
+	while (size < (uint64_t) minimumSize)
+		size <<= 1;
+	ring->cells = (QueryRingCell *) malloc(size * sizeof(QueryRingCell));
+	if (ring->cells == NULL)
+		return -1;
+	for (i = 0; i < size; i++)
+		ring->cells[i].sequence = i;
+	ring->mask = size - 1;
+	ring->pushPosition = 0;
+	ring->popPosition = 0;
+	return 0;
+}
+
+/** add to the ring, returning 0 if it is full */
+static int
+query_ring_push(QueryRing *ring, void *data)
+{
+	QueryRingCell *cell;
+	uint64_t position, sequence;
+	int64_t difference;
+
+	position = __atomic_load_n(&ring->pushPosition, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &ring->cells[position & ring->mask];
+		sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		difference = (int64_t) (sequence - position);
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&ring->pushPosition, &position,
+					position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (difference < 0) {
+			return 0;
+		} else {
+			position = __atomic_load_n(&ring->pushPosition, __ATOMIC_RELAXED);
+		}
+	}
+	cell->data = data;
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/** take from the ring, returning NULL if it is empty */
+static void *
+query_ring_pop(QueryRing *ring)
+{
+	QueryRingCell *cell;
+	uint64_t position, sequence;
+	int64_t difference;
+	void *data;
+
+	position = __atomic_load_n(&ring->popPosition, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &ring->cells[position & ring->mask];
+		sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		difference = (int64_t) (sequence - (position + 1));
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&ring->popPosition, &position,
+					position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (difference < 0) {
+			return NULL;
+		} else {
+			position = __atomic_load_n(&ring->popPosition, __ATOMIC_RELAXED);
+		}
+	}
+	data = cell->data;
+	__atomic_store_n(&cell->sequence, position + ring->mask + 1, __ATOMIC_RELEASE);
+	return data;
+}
+
+/** wait a little for another stage, yielding at first and then sleeping */
+static void
+query_wait(int *nWaits)
+{
+	struct timespec pause = { 0, QUERY_WAIT_SLEEP_NS };
+
+	if (++(*nWaits) < QUERY_WAIT_YIELDS) {
+		sched_yield();
+	} else {
+		nanosleep(&pause, NULL);
+	}
+}
+
+static void
+query_ring_push_wait(QueryRing *ring, void *data)
+{
+	int nWaits = 0;
+
+	while ( ! query_ring_push(ring, data))
+		query_wait(&nWaits);
+}
+
+static void *
+query_ring_pop_wait(QueryRing *ring)
+{
+	void *data;
+	int nWaits = 0;
+
+	while ((data = query_ring_pop(ring)) == NULL)
+		query_wait(&nWaits);
+	return data;
+}
+
+/** the reader: pack the keys of the input into chunks, in order */
+static void *
+query_reader_main(void *arg)
+{
+	QueryPipeline *pipeline = (QueryPipeline *) arg;
+	char linebuffer[QUERY_LINE_MAX];
+	char *key = NULL;
+	QueryChunk *chunk;
+	uint64_t sequence = 0;
+	size_t length;
+	int i, more = 1;
+
+	while (more) {
+		chunk = (QueryChunk *) query_ring_pop_wait(&pipeline->empty);
+		chunk->nKeys = 0;
+		chunk->nBytes = 0;
+		while (chunk->nKeys < QUERY_CHUNK_KEYS) {
+			if ( ! readPlainLine(pipeline->fp, linebuffer, QUERY_LINE_MAX, &key)) {
+				more = 0;
+				break;
+			}
+			length = strlen(key) + 1;
+			chunk->offsets[chunk->nKeys++] = chunk->nBytes;
+			memcpy(&chunk->keys[chunk->nBytes], key, length);
+			chunk->nBytes += length;
+		}
+		if (chunk->nKeys == 0) {
+			query_ring_push_wait(&pipeline->empty, chunk);
+			break;
+		}
+		chunk->sequence = sequence++;
+		query_ring_push_wait(&pipeline->work, chunk);
+	}
+
+	__atomic_store_n(&pipeline->nChunksRead, sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&pipeline->readerDone, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < pipeline->nWorkers; i++)
+		query_ring_push_wait(&pipeline->work, &queryEndOfInput);
+	return NULL;
+}
+
+/** a lookup worker: answer every key of each chunk it takes */
+static void *
+query_worker_main(void *arg)
+{
+	QueryWorker *worker = (QueryWorker *) arg;
+	QueryPipeline *pipeline = worker->pipeline;
+	QueryChunk *chunk;
+	uint64_t opStart;
+	int i;
+
+	for (;;) {
+		chunk = (QueryChunk *) query_ring_pop_wait(&pipeline->work);
+		if (chunk == (QueryChunk *) &queryEndOfInput)
+			break;
+		for (i = 0; i < chunk->nKeys; i++) {
+			opStart = latencyStart(worker->latency);
+			worker->cost += pipeline->lookup(pipeline->context,
+					&chunk->keys[chunk->offsets[i]], &chunk->results[i]);
+			latencyStop(worker->latency, opStart);
+		}
+		worker->nQueries += chunk->nKeys;
+		query_ring_push_wait(&pipeline->done, chunk);
+	}
+	return NULL;
+}
+
+/**
+ * The reporting stage, run by the caller: chunks come back from the
+ * workers in any order, and are held until those before them have
+ * been reported.  Every chunk not waiting in the empty ring is one of
+ * the nChunks after the next to report, so its sequence number modulo
+ * nChunks gives it a slot of its own.
+ */
+static void
+query_report_in_order(QueryPipeline *pipeline, QueryReportFunction report,
+		void *context, ResultWriter *results)
+{
+	QueryChunk **waiting = pipeline->waiting, *chunk;
+	uint64_t next = 0;
+	int i, nWaits = 0;
+
+	for (;;) {
+		while ((chunk = waiting[next % pipeline->nChunks]) != NULL) {
+			for (i = 0; i < chunk->nKeys; i++) {
+				report(context, results,
+						&chunk->keys[chunk->offsets[i]], &chunk->results[i]);
+			}
+			waiting[next % pipeline->nChunks] = NULL;
+			next++;
+			query_ring_push_wait(&pipeline->empty, chunk);
+		}
+
+		if (__atomic_load_n(&pipeline->readerDone, __ATOMIC_ACQUIRE)
+				&& next == __atomic_load_n(&pipeline->nChunksRead, __ATOMIC_RELAXED))
+			break;
+
+		chunk = (QueryChunk *) query_ring_pop(&pipeline->done);
+		if (chunk == NULL) {
+			query_wait(&nWaits);
+			continue;
+		}
+		nWaits = 0;
+		waiting[chunk->sequence % pipeline->nChunks] = chunk;
+	}
+}
+
+static void
+query_pipeline_free(QueryPipeline *pipeline, QueryWorker *workers, int nWorkers)
+{
+	int i;
+
+	for (i = 0; workers != NULL && i < nWorkers; i++)
+		latencyDelete(workers[i].latency);
+	free(workers);
+	free(pipeline->empty.cells);
+	free(pipeline->work.cells);
+	free(pipeline->done.cells);
+	free(pipeline->chunks);
+	free(pipeline->waiting);
+}
+
+/**
+ * Look up every key in the file on nWorkers threads, reporting the
+ * results in the order of the file.  Latencies are kept per worker
+ * and added into the histogram given (if any) at the end.  Returns
+ * -1 if the threads or their chunks cannot be set up.
+ */
+int
+queryPipelineRun(FILE *fp, int nWorkers,
+		QueryLookupFunction lookup, QueryReportFunction report, void *context,
+		ResultWriter *results, LatencyHistogram *latency,
+		QueryPipelineStats *stats)
+{
+	QueryPipeline pipeline;
+	QueryWorker *workers;
+	pthread_t reader;
+	int i, nStarted;
+
+	memset(stats, 0, sizeof(QueryPipelineStats));
+	memset(&pipeline, 0, sizeof(QueryPipeline));
+	pipeline.fp = fp;
+	pipeline.lookup = lookup;
+	pipeline.context = context;
+	pipeline.nChunks = nWorkers * QUERY_CHUNKS_PER_WORKER + 2;
+
+	pipeline.chunks = (QueryChunk *) malloc(pipeline.nChunks * sizeof(QueryChunk));
+	pipeline.waiting = (QueryChunk **) calloc(pipeline.nChunks, sizeof(QueryChunk *));
+	workers = (QueryWorker *) calloc(nWorkers, sizeof(QueryWorker));
+	if (pipeline.chunks == NULL || pipeline.waiting == NULL || workers == NULL
+			|| query_ring_init(&pipeline.empty, pipeline.nChunks) < 0
+			|| query_ring_init(&pipeline.work, pipeline.nChunks + nWorkers) < 0
+			|| query_ring_init(&pipeline.done, pipeline.nChunks) < 0) {
+		query_pipeline_free(&pipeline, workers, 0);
+		return -1;
+	}
+	for (i = 0; i < pipeline.nChunks; i++)
+		query_ring_push(&pipeline.empty, &pipeline.chunks[i]);
+
+	for (nStarted = 0; nStarted < nWorkers; nStarted++) {
+		workers[nStarted].pipeline = &pipeline;
+		if (latency != NULL) {
+			workers[nStarted].latency = latencyCreate(latency->name,
+					latency->keepSamples);
+			if (workers[nStarted].latency == NULL)
+				break;
+		}
+		if (pthread_create(&workers[nStarted].thread, NULL,
+				query_worker_main, &workers[nStarted]) != 0)
+			break;
+	}
+	pipeline.nWorkers = nStarted;
+
+	if (nStarted < nWorkers
+			|| pthread_create(&reader, NULL, query_reader_main, &pipeline) != 0) {
+		for (i = 0; i < nStarted; i++)
+			query_ring_push_wait(&pipeline.work, &queryEndOfInput);
+		for (i = 0; i < nStarted; i++)
+			pthread_join(workers[i].thread, NULL);
+		query_pipeline_free(&pipeline, workers, nWorkers);
+		return -1;
+	}
+
+	query_report_in_order(&pipeline, report, context, results);
+
+	pthread_join(reader, NULL);
+	for (i = 0; i < nWorkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		stats->nQueries += workers[i].nQueries;
+		stats->cost += workers[i].cost;
+		if (latency != NULL)
+			latencyMerge(latency, workers[i].latency);
+	}
+
+	query_pipeline_free(&pipeline, workers, nWorkers);
+	return 0;
+}
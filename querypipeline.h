@@ -0,0 +1,53 @@
+#ifndef	__QUERY_PIPELINE_HEADER__
+#define	__QUERY_PIPELINE_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "latency.h"
+#include "resultwriter.h"
+
+/**
+ * Answer a file of queries on several threads at once.  A reader
+ * thread packs the keys into chunks, lookup workers answer the keys
+ * of a chunk each, and the calling thread reports the chunks in the
+ * order they were read, so the output is the same as a serial run.
+ * The stages hand chunks to each other through bounded lock-free
+ * rings; a fixed set of chunks circulates, so a slow stage holds the
+ * others back rather than letting the work pile up.
+ *
+ * The structure looked up must not change while the pipeline runs:
+ * no inserts or deletes, and none of the options (such as a front
+ * cache or adaptive ordering) that rearrange it on lookup.
+ */
+#define	QUERY_LINE_MAX			128
+#define	QUERY_CHUNK_KEYS		256
+#define	QUERY_CHUNKS_PER_WORKER	4
+
+/** what a lookup found; value is NULL if the key is not present */
+typedef struct QueryResult {
+	void *value;
+	size_t length;
+} QueryResult;
+
+/** look up one key, returning the cost (nodes visited) if known */
+typedef int (*QueryLookupFunction)(void *context, const char *key,
+		QueryResult *result);
+
+/** write out the result of one key; called in input order */
+typedef void (*QueryReportFunction)(void *context, ResultWriter *results,
+		const char *key, QueryResult *result);
+
+typedef struct QueryPipelineStats {
+	uint64_t nQueries;
+	uint64_t cost;
+} QueryPipelineStats;
+
+/** prototypes */
+int queryPipelineRun(FILE *fp, int nWorkers,
+		QueryLookupFunction lookup, QueryReportFunction report, void *context,
+		ResultWriter *results, LatencyHistogram *latency,
+		QueryPipelineStats *stats);
+
+#endif /* __QUERY_PIPELINE_HEADER__ */
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "resultwriter.h"
+
+
+/** serial numbers for writers, so a stale thread slot is never mistaken */
+static unsigned long rw_next_serial = 0;
+
+/** each thread's buffer for the writers it is using */
+static __thread struct {
+	ResultWriter *writer;
+	unsigned long serial;
+	ResultBuffer *buffer;
+} rw_thread_slots[RESULT_WRITER_THREAD_SLOTS];
+
+
+/** write one buffer out, noting the first failure */
+static void
+rw_write_buffer(ResultWriter *writer, ResultBuffer *buffer)
+{
+	if (buffer->length > 0
+			&& fwrite(buffer->data, 1, buffer->length, writer->fp) != buffer->length
+			&& writer->error == 0)
+		writer->error = (errno != 0) ? errno : EIO;
+	writer->nBytes += buffer->length;
+	buffer->length = 0;
+}
+
+/** the background thread: write out each buffer handed over, in order */
+static void *
+rw_thread_main(void *arg)
+{
+	ResultWriter *writer = (ResultWriter *) arg;
+	ResultBuffer *buffer;
+
+	pthread_mutex_lock(&writer->lock);
+	for (;;) {
+		while (writer->head == NULL && ! writer->stopping)
+			pthread_cond_wait(&writer->queued, &writer->lock);
+		if (writer->head == NULL)
+			break;
+
+		buffer = writer->head;
+		writer->head = buffer->next;
+		if (writer->head == NULL)
+			writer->tail = NULL;
+		writer->writing = 1;
+		pthread_mutex_unlock(&writer->lock);
+
+		rw_write_buffer(writer, buffer);
+
+		pthread_mutex_lock(&writer->lock);
+		writer->writing = 0;
+		buffer->next = writer->free;
+		writer->free = buffer;
+		pthread_cond_broadcast(&writer->written);
+	}
+	pthread_mutex_unlock(&writer->lock);
+	return NULL;
+}
+
+ResultWriter *
+resultWriterCreate(FILE *fp, ResultFormat format)
+{
+	ResultWriter *writer;
+
+	writer = (ResultWriter *) malloc(sizeof(ResultWriter));
+	if (writer == NULL)
+		return NULL;
+	memset(writer, 0, sizeof(ResultWriter));
+	writer->fp = fp;
+	writer->format = format;
+	writer->serial = __sync_add_and_fetch(&rw_next_serial, 1);
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->queued, NULL);
+	pthread_cond_init(&writer->written, NULL);
+
+	writer->threadRunning = (pthread_create(&writer->thread, NULL,
+			rw_thread_main, writer) == 0);
+	return writer;
+}
+
+/**
+ * An empty buffer: a written one if there is one, a new one if fewer
+ * than RESULT_WRITER_MAX_BUFFERS exist, and otherwise the next one the
+ * background thread finishes with, so a writer that cannot keep up
+ * holds back the work rather than using ever more memory
+ */
+static ResultBuffer *
+rw_empty_buffer(ResultWriter *writer)
+{
+	ResultBuffer *buffer = NULL;
+
+	pthread_mutex_lock(&writer->lock);
+	while (writer->free == NULL && writer->nBuffers >= RESULT_WRITER_MAX_BUFFERS
+			&& writer->threadRunning)
+		pthread_cond_wait(&writer->written, &writer->lock);
+	if (writer->free != NULL) {
+		buffer = writer->free;
+		writer->free = buffer->next;
+	} else {
+		buffer = (ResultBuffer *) malloc(sizeof(ResultBuffer));
+		if (buffer != NULL) {
+			buffer->data = (char *) malloc(RESULT_BUFFER_SIZE);
+			buffer->size = RESULT_BUFFER_SIZE;
+			if (buffer->data == NULL) {
+				free(buffer);
+				buffer = NULL;
+			} else {
+				writer->nBuffers++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&writer->lock);
+
+	if (buffer != NULL) {
+		buffer->length = 0;
+		buffer->next = NULL;
+	}
+	return buffer;
+}
+
+/** queue a buffer to be written, or write it here if there is no thread */
+static void
+rw_hand_off(ResultWriter *writer, ResultBuffer *buffer)
+{
+	pthread_mutex_lock(&writer->lock);
+	if ( ! writer->threadRunning) {
+		rw_write_buffer(writer, buffer);
+		buffer->next = writer->free;
+		writer->free = buffer;
+	} else {
+		buffer->next = NULL;
+		if (writer->tail == NULL) {
+			writer->head = buffer;
+		} else {
+			writer->tail->next = buffer;
+		}
+		writer->tail = buffer;
+		pthread_cond_signal(&writer->queued);
+	}
+	pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * This thread's slot for the writer.  If another writer holds the
+ * slot its buffer is handed over first, so nothing is lost.
+ */
+static int
+rw_thread_slot(ResultWriter *writer)
+{
+	int slot = (int) (writer->serial % RESULT_WRITER_THREAD_SLOTS);
+
+	if (rw_thread_slots[slot].writer == writer
+			&& rw_thread_slots[slot].serial == writer->serial)
+		return slot;
+
+	if (rw_thread_slots[slot].buffer != NULL)
+		rw_hand_off(rw_thread_slots[slot].writer, rw_thread_slots[slot].buffer);
+	rw_thread_slots[slot].writer = writer;
+	rw_thread_slots[slot].serial = writer->serial;
+	rw_thread_slots[slot].buffer = NULL;
+	return slot;
+}
+
+/**
+ * This thread's buffer, with room for at least the given number of
+ * bytes; the current one is handed over if it is too full, and one
+ * is grown for a single result larger than a buffer.  Returns NULL if
+ * no memory is left, in which case the result is dropped.
+ */
+static ResultBuffer *
+rw_space(ResultWriter *writer, size_t needed)
+{
+	ResultBuffer *buffer;
+	char *grown;
+	int slot;
+
+	slot = rw_thread_slot(writer);
+	buffer = rw_thread_slots[slot].buffer;
+	if (buffer != NULL && buffer->size - buffer->length >= needed)
+		return buffer;
+
+	if (buffer != NULL && buffer->length > 0) {
+		rw_hand_off(writer, buffer);
+		buffer = NULL;
+	}
+	if (buffer == NULL)
+		buffer = rw_empty_buffer(writer);
+	rw_thread_slots[slot].buffer = buffer;
+	if (buffer == NULL) {
+		writer->error = ENOMEM;
+		return NULL;
+	}
+
+	if (buffer->size < needed) {
+		grown = (char *) realloc(buffer->data, needed);
+		if (grown == NULL) {
+			writer->error = ENOMEM;
+			return NULL;
+		}
+		buffer->data = grown;
+		buffer->size = needed;
+	}
+	return buffer;
+}
+
+/** copy bytes onto the end of a buffer already known to have room */
+#define	rw_put(buffer, string, n) \
+		do { \
+			memcpy((buffer)->data + (buffer)->length, (string), (n)); \
+			(buffer)->length += (n); \
+		} while (0)
+
+void
+resultWriterString(ResultWriter *writer, const char *string, size_t length)
+{
+	ResultBuffer *buffer;
+
+	if (length > 0 && (buffer = rw_space(writer, length)) != NULL)
+		rw_put(buffer, string, length);
+}
+
+void
+resultWriterPrintf(ResultWriter *writer, const char *format, ...)
+{
+	ResultBuffer *buffer;
+	va_list args;
+	int length;
+
+	if ((buffer = rw_space(writer, 128)) == NULL)
+		return;
+
+	va_start(args, format);
+	length = vsnprintf(buffer->data + buffer->length,
+			buffer->size - buffer->length, format, args);
+	va_end(args);
+	if (length < 0)
+		return;
+
+	if ((size_t) length >= buffer->size - buffer->length) {
+		if ((buffer = rw_space(writer, length + 1)) == NULL)
+			return;
+		va_start(args, format);
+		vsnprintf(buffer->data + buffer->length,
+				buffer->size - buffer->length, format, args);
+		va_end(args);
+	}
+	buffer->length += length;
+}
+
+/**
+ * One result line, with the key already in text and the quotes that
+ * go around it in the text format
+ */
+static void
+rw_value(ResultWriter *writer, const char *operation,
+		const char *open, const char *key, const char *close,
+		const char *value, size_t valueLength)
+{
+	static const char produced[] = " produced ";
+	static const char noValue[] = "no value\n";
+	static const char hasValue[] = "value '";
+	size_t operationLength = strlen(operation), keyLength = strlen(key);
+	ResultBuffer *buffer;
+
+	if (writer->format == RESULT_TSV) {
+		buffer = rw_space(writer, operationLength + keyLength + valueLength + 3);
+		if (buffer == NULL)
+			return;
+		rw_put(buffer, operation, operationLength);
+		rw_put(buffer, "\t", 1);
+		rw_put(buffer, key, keyLength);
+		if (value != NULL) {
+			rw_put(buffer, "\t", 1);
+			rw_put(buffer, value, valueLength);
+		}
+		rw_put(buffer, "\n", 1);
+		return;
+	}
+
+	buffer = rw_space(writer, operationLength + keyLength + valueLength + 40);
+	if (buffer == NULL)
+		return;
+	rw_put(buffer, operation, operationLength);
+	rw_put(buffer, ": key ", 6);
+	rw_put(buffer, open, 1);
+	rw_put(buffer, key, keyLength);
+	rw_put(buffer, close, 1);
+	rw_put(buffer, produced, sizeof(produced) - 1);
+	if (value == NULL) {
+		rw_put(buffer, noValue, sizeof(noValue) - 1);
+	} else {
+		rw_put(buffer, hasValue, sizeof(hasValue) - 1);
+		rw_put(buffer, value, valueLength);
+		rw_put(buffer, "'\n", 2);
+	}
+}
+
+void
+resultWriterValue(ResultWriter *writer, const char *operation,
+		const char *key, const char *value, size_t valueLength)
+{
+	rw_value(writer, operation, "'", key, "'", value, valueLength);
+}
+
+void
+resultWriterIntegerValue(ResultWriter *writer, const char *operation,
+		long long key, const char *value, size_t valueLength)
+{
+	char keybuffer[32];
+
+	snprintf(keybuffer, sizeof(keybuffer), "%lld", key);
+	rw_value(writer, operation, "(", keybuffer, ")", value, valueLength);
+}
+
+/**
+ * Hand over this thread's results and wait until everything handed
+ * over has been written out and flushed to the file.  Returns -1 if
+ * any write has failed.
+ */
+int
+resultWriterFlush(ResultWriter *writer)
+{
+	int slot = (int) (writer->serial % RESULT_WRITER_THREAD_SLOTS);
+
+	if (rw_thread_slots[slot].writer == writer
+			&& rw_thread_slots[slot].serial == writer->serial) {
+		if (rw_thread_slots[slot].buffer != NULL)
+			rw_hand_off(writer, rw_thread_slots[slot].buffer);
+		rw_thread_slots[slot].writer = NULL;
+		rw_thread_slots[slot].buffer = NULL;
+	}
+
+	pthread_mutex_lock(&writer->lock);
+	while (writer->head != NULL || writer->writing)
+		pthread_cond_wait(&writer->written, &writer->lock);
+	pthread_mutex_unlock(&writer->lock);
+
+	if (fflush(writer->fp) != 0 && writer->error == 0)
+		writer->error = errno;
+	return (writer->error == 0) ? 0 : -1;
+}
+
+/** flush, stop the background thread and free everything */
+void
+resultWriterDelete(ResultWriter *writer)
+{
+	ResultBuffer *buffer, *next;
+
+	if (writer == NULL)
+		return;
+	resultWriterFlush(writer);
+
+	if (writer->threadRunning) {
+		pthread_mutex_lock(&writer->lock);
+		writer->stopping = 1;
+		pthread_cond_signal(&writer->queued);
+		pthread_mutex_unlock(&writer->lock);
+		pthread_join(writer->thread, NULL);
+	}
+
+	for (buffer = writer->free; buffer != NULL; buffer = next) {
+		next = buffer->next;
+		free(buffer->data);
+		free(buffer);
+	}
+	pthread_cond_destroy(&writer->written);
+	pthread_cond_destroy(&writer->queued);
+	pthread_mutex_destroy(&writer->lock);
+	free(writer);
+}
@@ -0,0 +1,81 @@
+#ifndef	__RESULT_WRITER_HEADER__
+#define	__RESULT_WRITER_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Buffered output of query and delete results.  Results are formatted
+ * into large buffers belonging to the thread writing them, and full
+ * buffers are handed to a background thread that does the fwrite(3),
+ * so a timed loop pays for copying its results into memory but not
+ * for stdio.  Each thread's results come out in the order it wrote
+ * them; results of different threads are interleaved a buffer at a
+ * time.
+ *
+ * Nothing reaches the file until a buffer fills or resultWriterFlush()
+ * is called, so flush before writing to the same file any other way.
+ * A thread that has written results must flush before it finishes,
+ * and all of them before the writer is deleted.  The drivers flush
+ * once their clocks have stopped, so the times they report leave out
+ * the writing of the results.
+ *
+ * Values are written as they are, so in the tab separated format a
+ * value runs to the end of its line, tabs and all.
+ */
+#define	RESULT_BUFFER_SIZE			(1024 * 1024)
+#define	RESULT_WRITER_MAX_BUFFERS	8
+#define	RESULT_WRITER_THREAD_SLOTS	4
+
+typedef enum ResultFormat {
+	RESULT_TEXT = 0,	/* "LOOKUP: key 'K' produced value 'V'" */
+	RESULT_TSV			/* "LOOKUP\tK\tV", or "LOOKUP\tK" if not found */
+} ResultFormat;
+
+typedef struct ResultBuffer {
+	char *data;
+	size_t length;
+	size_t size;
+	struct ResultBuffer *next;
+} ResultBuffer;
+
+typedef struct ResultWriter {
+	FILE *fp;
+	ResultFormat format;
+	unsigned long serial;
+
+	pthread_mutex_t lock;
+	pthread_cond_t queued;		/* a buffer is waiting, or we are stopping */
+	pthread_cond_t written;		/* a buffer has been written out */
+	ResultBuffer *head, *tail;	/* full buffers, in the order handed over */
+	ResultBuffer *free;			/* written buffers, ready for reuse */
+	int nBuffers;
+	int writing;
+	int stopping;
+
+	/** if the thread cannot be started, buffers are written in place */
+	int threadRunning;
+	pthread_t thread;
+
+	int error;					/* errno of the first failed write */
+	uint64_t nBytes;
+} ResultWriter;
+
+/** prototypes */
+ResultWriter *resultWriterCreate(FILE *fp, ResultFormat format);
+void resultWriterDelete(ResultWriter *writer);
+int  resultWriterFlush(ResultWriter *writer);
+
+void resultWriterString(ResultWriter *writer, const char *string, size_t length);
+void resultWriterPrintf(ResultWriter *writer, const char *format, ...)
+		__attribute__ ((format (printf, 2, 3)));
+
+/** a key and the value it produced, which is NULL if there was none */
+void resultWriterValue(ResultWriter *writer, const char *operation,
+		const char *key, const char *value, size_t valueLength);
+void resultWriterIntegerValue(ResultWriter *writer, const char *operation,
+		long long key, const char *value, size_t valueLength);
+
+#endif /* __RESULT_WRITER_HEADER__ */
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "hashmix.h"
+#include "strarena.h"
+
+/** most blocks are this size; bigger requests get a block to themselves */
+#define	ARENA_BLOCK_SIZE	(64 * 1024)
+#define	ARENA_ALIGN		(sizeof(void *))
+
+/** grow the intern table once more than this percentage is in use */
+#define	ARENA_MAX_LOAD		70
+#define	ARENA_MIN_CAPACITY	256
+
+
+/** create an empty arena, interning strings if asked to */
+StringArena *
+arenaCreate(int intern)
+{
+	StringArena *arena;
+
+	arena = (StringArena *) malloc(sizeof(StringArena));
+	if (arena == NULL)
+		return NULL;
+	memset(arena, 0, sizeof(StringArena));
+	arena->intern = intern;
+	return arena;
+}
+
+/** free every string copied into the arena, and the arena itself */
+void
+arenaDelete(StringArena *arena)
+{
+	StringArenaBlock *block, *next;
+
+	if (arena == NULL)	return;
+
+	for (block = arena->blocks; block != NULL; block = next) {
+		next = block->next;
+		free(block);
+	}
+	free(arena->strings);
+	free(arena->hashes);
+	free(arena);
+}
+
+/**
+ * Carve size bytes (aligned for any pointer) out of the current
+ * block, starting a new block if they do not fit
+ */
+void *
+arenaAlloc(StringArena *arena, size_t size)
+{
+	StringArenaBlock *block = arena->blocks;
+	size_t blocksize;
+	void *place;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if (block == NULL || block->size - block->used < size) {
+		blocksize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+		block = (StringArenaBlock *) malloc(sizeof(StringArenaBlock) + blocksize);
+		if (block == NULL)
+			return NULL;
+		block->used = 0;
+		block->size = blocksize;
+
+		/** an outsized block is not worth bumping into, so keep the current one on top */
+		if (size > ARENA_BLOCK_SIZE && arena->blocks != NULL) {
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+		} else {
+			block->next = arena->blocks;
+			arena->blocks = block;
+		}
+		arena->nBlocks++;
+	}
+
+	place = &block->data[block->used];
+	block->used += size;
+	return place;
+}
+
+/** copy the bytes into the arena, adding the '\0' */
+static char *
+arenaCopy(StringArena *arena, const char *string, size_t length)
+{
+	char *copy;
+
+	copy = (char *) arenaAlloc(arena, length + 1);
+	if (copy == NULL)
+		return NULL;
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	arena->nBytesStored += length + 1;
+	return copy;
+}
+
+/** double the intern table, re-placing every string */
+static int
+arenaGrowTable(StringArena *arena)
+{
+	size_t capacity, i, slot;
+	char **strings;
+	uint64_t *hashes;
+
+	capacity = (arena->capacity == 0) ? ARENA_MIN_CAPACITY : arena->capacity * 2;
+	strings = (char **) calloc(capacity, sizeof(char *));
+	hashes = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+	if (strings == NULL || hashes == NULL) {
+		free(strings);
+		free(hashes);
+		return -1;
+	}
+
+	for (i = 0; i < arena->capacity; i++) {
+		if (arena->strings[i] == NULL)
+			continue;
+		slot = arena->hashes[i] & (capacity - 1);
+		while (strings[slot] != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		strings[slot] = arena->strings[i];
+		hashes[slot] = arena->hashes[i];
+	}
+
+	free(arena->strings);
+	free(arena->hashes);
+	arena->strings = strings;
+	arena->hashes = hashes;
+	arena->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Copy length bytes of the string into the arena.  When interning,
+ * an equal string already in the arena is returned instead.
+ */
+char *
+arenaStrndup(StringArena *arena, const char *string, size_t length)
+{
+	uint64_t hash;
+	size_t slot;
+	char *copy;
+
+	arena->nCopies++;
+	arena->nBytesRequested += length + 1;
+
+	if ( ! arena->intern)
+		return arenaCopy(arena, string, length);
+
+	if ((arena->nInterned + 1) * 100 > arena->capacity * ARENA_MAX_LOAD) {
+		if (arenaGrowTable(arena) < 0)
+			return NULL;
+	}
+
+	hash = hashFnv1a(string, length);
+	slot = hash & (arena->capacity - 1);
+	while (arena->strings[slot] != NULL) {
+		if (arena->hashes[slot] == hash
+				&& strncmp(arena->strings[slot], string, length) == 0
+				&& arena->strings[slot][length] == '\0')
+			return arena->strings[slot];
+		slot = (slot + 1) & (arena->capacity - 1);
+	}
+
+	copy = arenaCopy(arena, string, length);
+	if (copy == NULL)
+		return NULL;
+	arena->strings[slot] = copy;
+	arena->hashes[slot] = hash;
+	arena->nInterned++;
+	return copy;
+}
+
+char *
+arenaStrdup(StringArena *arena, const char *string)
+{
+	return arenaStrndup(arena, string, strlen(string));
+}
+
+/** report how much was stored, and how much interning saved */
+void
+arenaPrintSummary(FILE *fp, StringArena *arena)
+{
+	fprintf(fp, "String arena copied %lu strings into %lu blocks\n",
+			(unsigned long) arena->nCopies, (unsigned long) arena->nBlocks);
+	fprintf(fp, "  Bytes requested : %lu\n", (unsigned long) arena->nBytesRequested);
+	fprintf(fp, "  Bytes stored    : %lu\n", (unsigned long) arena->nBytesStored);
+	if (arena->intern) {
+		fprintf(fp, "  Distinct strings: %lu\n", (unsigned long) arena->nInterned);
+	}
+}
+
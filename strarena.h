@@ -0,0 +1,55 @@
+#ifndef	__STRING_ARENA_HEADER__
+#define	__STRING_ARENA_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Bump allocator for strings that all live until the same moment,
+ * such as the values loaded from a data file.  Strings are packed
+ * into large blocks and the whole arena is freed at once, so there
+ * is no per-string malloc() or free().
+ *
+ * With interning turned on, copying a string equal to one already
+ * in the arena hands back the earlier copy instead, so repeated
+ * values are only stored once.  Strings from an interning arena are
+ * shared and must not be modified.
+ *
+ * The arena is not thread safe.
+ */
+typedef struct StringArenaBlock {
+	struct StringArenaBlock *next;
+	size_t used;
+	size_t size;
+	char data[];
+} StringArenaBlock;
+
+typedef struct StringArena {
+	StringArenaBlock *blocks;	/* most recent first */
+	int intern;
+
+	/** open addressing table of interned strings */
+	char **strings;
+	uint64_t *hashes;
+	size_t capacity;
+	size_t nInterned;
+
+	/** statistics */
+	size_t nCopies;			/* calls to copy a string */
+	size_t nBytesRequested;
+	size_t nBytesStored;
+	size_t nBlocks;
+} StringArena;
+
+/** prototypes */
+StringArena *arenaCreate(int intern);
+void arenaDelete(StringArena *arena);
+
+char *arenaStrdup(StringArena *arena, const char *string);
+char *arenaStrndup(StringArena *arena, const char *string, size_t length);
+void *arenaAlloc(StringArena *arena, size_t size);
+
+void arenaPrintSummary(FILE *fp, StringArena *arena);
+
+#endif /* __STRING_ARENA_HEADER__ */
@@ -2,10 +2,21 @@
 #define	__KEY_VALUE_TRIE_HEADER__
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include <aarray.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct KeyValueTrie KeyValueTrie;
+typedef struct U64Trie U64Trie;
+typedef struct TrieMatcher TrieMatcher;
+typedef struct TrieCursor TrieCursor;
+typedef struct TrieFilter TrieFilter;
+typedef struct TrieCache TrieCache;
+typedef struct TriePattern TriePattern;
 
 /**
  ** PROTOTYPES
@@ -15,6 +26,31 @@ typedef struct KeyValueTrie KeyValueTrie;
 KeyValueTrie *trieCreateTrie();
 void trieDeleteTrie(KeyValueTrie *trie);
 
+/**
+ * Switch the trie over to dense child indexing.  The letters given
+ * get the first codes; any other letter is coded as it is first seen,
+ * so letters may be NULL to learn the whole alphabet from the keys.
+ */
+int trieSetAlphabet(KeyValueTrie *trie, const unsigned char *letters, size_t nLetters);
+
+/**
+ * Have lookups scan each node's subtries most used first, reordering
+ * them as the lookups go (see trie_defs.h).  Iteration order is not
+ * affected.  Tries with a dense alphabet index their children instead,
+ * so this has no effect on them.
+ */
+int trieSetAdaptiveOrder(KeyValueTrie *trie, int enable);
+
+/** the average number of letters compared per subtrie scan by lookups */
+double trieAverageScanLength(KeyValueTrie *trie);
+
+/**
+ * Add the shape of the trie to the statistics: its nodes, the depths
+ * its keys end at, the fanout of each node, and the bytes allocated
+ */
+void trieGetStats(KeyValueTrie *trie, AAStats *stats);
+void trieU64GetStats(U64Trie *trie, AAStats *stats);
+
 /** iteration and printing */
 void triePrint(FILE *fp, KeyValueTrie *);
 int trieIterateAction(
@@ -31,5 +67,93 @@ int trieInsertKey(KeyValueTrie *root,
 void *trieLookupKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost);
 void *trieDeleteKey(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost);
 
+/** access to the stored value itself, so NULL values can be told apart */
+void **trieLookupSlot(KeyValueTrie *root, AAKeyType key, size_t keylength, int *cost);
+void **trieInsertSlot(KeyValueTrie *root, AAKeyType key, size_t keylength,
+		int *isNew, int *cost);
+
+/**
+ * Tries that own their values: values are copied in, small ones
+ * into the node itself, and freed when their key is deleted.
+ */
+int trieSetValueBytes(KeyValueTrie *trie, size_t maxInline);
+int trieInsertValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		const void *value, size_t valuelength, int *cost);
+const void *trieLookupValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		size_t *valuelength, int *cost);
+int trieDeleteValue(KeyValueTrie *trie, AAKeyType key, size_t keylength,
+		void **value, size_t *valuelength, int *cost);
+
+/**
+ * Step through the keys one at a time.  Adding keys invalidates a
+ * cursor; deleting them (which never removes nodes) does not.
+ */
+TrieCursor *trieCreateCursor(KeyValueTrie *trie);
+void trieDeleteCursor(TrieCursor *cursor);
+void trieCursorRewind(TrieCursor *cursor);
+int trieCursorNext(TrieCursor *cursor, AAKeyType *key, size_t *keylength, void ***slot);
+
+/**
+ * Approximate membership filter over the keys of a trie, with the
+ * given false positive rate.  A key the filter rules out is certainly
+ * absent; trieFilterCheck() returning 1 means only "maybe".
+ */
+TrieFilter *trieCreateFilter(size_t expectedKeys, double falsePositiveRate);
+void trieDeleteFilter(TrieFilter *filter);
+void trieFilterAdd(TrieFilter *filter, AAKeyType key, size_t keylength);
+int  trieFilterCheck(TrieFilter *filter, AAKeyType key, size_t keylength);
+int  trieFilterCheckBatch(TrieFilter *filter, AAKeyType *keys, size_t *keylengths,
+		int nKeys, unsigned char *maybe);
+void trieFilterNoteDelete(TrieFilter *filter);
+int  trieFilterNeedsRebuild(TrieFilter *filter);
+int  trieFilterRebuild(TrieFilter *filter, KeyValueTrie *trie);
+
+/**
+ * Fixed size front cache of key to value mappings.  The cache knows
+ * nothing of the trie: whoever changes or deletes a key must
+ * invalidate it here.  trieCacheLookup() returns 1 on a hit.
+ */
+TrieCache *trieCreateCache(size_t nEntries);
+void trieDeleteCache(TrieCache *cache);
+int  trieCacheLookup(TrieCache *cache, AAKeyType key, size_t keylength,
+		void **value, size_t *valuelength);
+void trieCacheAdmit(TrieCache *cache, AAKeyType key, size_t keylength,
+		void *value, size_t valuelength);
+void trieCacheInvalidate(TrieCache *cache, AAKeyType key, size_t keylength);
+
+/** glob style matching ('?', '*' and "[...]") over the stored keys */
+int triePatternSearch(KeyValueTrie *trie, const char *pattern,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata, int *cost);
+TriePattern *trieCompilePattern(const char *pattern);
+void trieDeletePattern(TriePattern *pattern);
+int triePatternMatch(TriePattern *pattern, AAKeyType key, size_t keylength);
+size_t triePatternPrefix(TriePattern *pattern, AAKeyType buffer, size_t maxLength);
+
+/** multi-pattern (Aho-Corasick) scanning of text for all stored keys */
+TrieMatcher *trieCreateMatcher(KeyValueTrie *trie);
+void trieDeleteMatcher(TrieMatcher *matcher);
+long trieMatcherScan(TrieMatcher *matcher,
+		const unsigned char *text, size_t textlength,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata);
+
+/** fixed width integer keys, iterated in numeric order */
+U64Trie *trieCreateU64Trie();
+void trieDeleteU64Trie(U64Trie *trie);
+void trieU64Print(FILE *fp, U64Trie *trie);
+int trieInsertU64(U64Trie *trie, uint64_t key, void *value, int *cost);
+void *trieLookupU64(U64Trie *trie, uint64_t key, int *cost);
+void *trieDeleteU64(U64Trie *trie, uint64_t key, int *cost);
+int trieIterateU64Action(
+		U64Trie *trie,
+		int (*userfunction)(AAKeyType key, size_t keylen, void *datavalue, void *userdata),
+		void *userdata
+	);
+
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
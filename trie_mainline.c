@@ -3,27 +3,42 @@
 #include <stdlib.h> /* for free() */
 #include <unistd.h> /* for getopt() */
 #include <ctype.h>  /* for isdigit() */
-#include <time.h>   /* for clock() */
 #include <errno.h>
 
 #include "trie.h"
 #include "data-reader.h"
 #include "keyprint.h"
+#include "strarena.h"
+#include "latency.h"
+#include "perfcounters.h"
+#include "resultwriter.h"
+#include "querypipeline.h"
 
 #define	LINE_MAX	128
 
+/** copy a value, into the arena if there is one */
+static char *
+copyValue(StringArena *arena, const char *value)
+{
+	if (arena != NULL)
+		return arenaStrdup(arena, value);
+	return strdup(value);
+}
+
 /**
  * Load the trie of attribute value entries
  */
 static int
-loadKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
+loadKeyValueTrie(KeyValueTrie *trie, U64Trie *intTrie, char *filename,
+		StringArena *arena, LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	clock_t startTime, endTime;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int nEntries = 0;
-	int intkey, cost = 0;
+	int nEntries = 0, status;
+	long long intkey;
+	int cost = 0;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -33,33 +48,39 @@ loadKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readDataLine(fp, linebuffer, LINE_MAX, &strkey, &value) > 0) {
-		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+		if (intTrie != NULL && isdigit(strkey[0])) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
-			if (trieInsertKey(trie,
-						(AAKeyType) &intkey, sizeof(int),
-						strdup(value), &cost) < 0) {
-				fprintf(stderr, "Failed to add key '%d' to trie\n", intkey);
+			value = copyValue(arena, value);
+			opStart = latencyStart(latency);
+			status = trieInsertU64(intTrie, AA_I64_KEY(intkey), value, &cost);
+			latencyStop(latency, opStart);
+			if (status < 0) {
+				fprintf(stderr, "Failed to add key '%lld' to trie\n", intkey);
 				return -1;
 			}
 		} else {
-
-			if (trieInsertKey(trie,
-						(AAKeyType) strkey, strlen(strkey),
-						strdup(value), &cost) < 0) {
+			value = copyValue(arena, value);
+			opStart = latencyStart(latency);
+			status = trieInsertKey(trie,
+					(AAKeyType) strkey, strlen(strkey), value, &cost);
+			latencyStop(latency, opStart);
+			if (status < 0) {
 				fprintf(stderr, "Failed to add key '%s' to trie\n", strkey);
 				return -1;
 			}
 		}
 		nEntries++;
 	}
-	endTime = clock();
+	perfCountersStop(perf, nEntries);
+	endTime = latencyNow();
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Inserts took %lf seconds with reported cost %d\n",
 			timeTaken, cost);
 
@@ -73,54 +94,206 @@ loadKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
  * Query the trie with all the values in the given file
  */
 static int
-queryKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
+queryKeyValueTrie(KeyValueTrie *trie, U64Trie *intTrie, char *filename,
+		ResultWriter *results, LatencyHistogram *latency, PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	clock_t startTime, endTime;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int intkey, cost = 0;
+	long long intkey;
+	int cost = 0, nQueries = 0;
 	FILE *fp = NULL;
 
-	fp = fopen(filename, "r");
+	fp = openInputFile(filename);
 	if (fp == NULL) {
 		fprintf(stderr, "Error: Failed to open query input file '%s' : %s\n",
 				filename, strerror(errno));
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
-		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+		nQueries++;
+		if (intTrie != NULL && isdigit(strkey[0])) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
 
-			value = trieLookupKey(trie,
-					(AAKeyType) &intkey, sizeof(int), &cost);
+			opStart = latencyStart(latency);
+			value = trieLookupU64(intTrie, AA_I64_KEY(intkey), &cost);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("LOOKUP: key (%d) produced no value\n", intkey);
+				resultWriterIntegerValue(results, "LOOKUP", intkey, NULL, 0);
 			} else {
-				printf("LOOKUP: key (%d) produced value '%s'\n", intkey, value);
+				resultWriterIntegerValue(results, "LOOKUP", intkey,
+						value, strlen(value));
 			}
 
 		} else {
+			opStart = latencyStart(latency);
 			value = trieLookupKey(trie,
 					(AAKeyType) strkey, strlen(strkey), &cost);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("LOOKUP: key '%s' produced no value\n", strkey);
+				resultWriterValue(results, "LOOKUP", strkey, NULL, 0);
 			} else {
-				printf("LOOKUP: key '%s' produced value '%s'\n", strkey, value);
+				resultWriterValue(results, "LOOKUP", strkey, value, strlen(value));
 			}
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nQueries);
+	endTime = latencyNow();
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	resultWriterFlush(results);
+
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Queries took %lf seconds with reported cost %d\n",
 			timeTaken, cost);
 
+	closeInputFile(fp);
+	return 1;
+}
+
+/** the tries the lookup workers of a pipelined query search */
+typedef struct TrieQueryContext {
+	KeyValueTrie *trie;
+	U64Trie *intTrie;
+} TrieQueryContext;
+
+/** look up one key on a pipeline worker, as queryKeyValueTrie() does */
+static int
+pipelineLookup(void *userdata, const char *strkey, QueryResult *result)
+{
+	TrieQueryContext *context = (TrieQueryContext *) userdata;
+	long long intkey;
+	int cost = 0;
+
+	result->value = NULL;
+	if (context->intTrie != NULL && isdigit(strkey[0])) {
+		if (sscanf(strkey, "%lld", &intkey) == 1)
+			result->value = trieLookupU64(context->intTrie,
+					AA_I64_KEY(intkey), &cost);
+	} else {
+		result->value = trieLookupKey(context->trie,
+				(AAKeyType) strkey, strlen(strkey), &cost);
+	}
+	result->length = (result->value == NULL) ? 0 : strlen((char *) result->value);
+	return cost;
+}
+
+/** write out the result of one key, in the order of the query file */
+static void
+pipelineReport(void *userdata, ResultWriter *results,
+		const char *strkey, QueryResult *result)
+{
+	TrieQueryContext *context = (TrieQueryContext *) userdata;
+	long long intkey;
+
+	if (context->intTrie != NULL && isdigit(strkey[0])
+			&& sscanf(strkey, "%lld", &intkey) == 1) {
+		resultWriterIntegerValue(results, "LOOKUP", intkey,
+				(const char *) result->value, result->length);
+	} else {
+		resultWriterValue(results, "LOOKUP", strkey,
+				(const char *) result->value, result->length);
+	}
+}
+
+/**
+ * Query the trie with all the keys in the given file, looking them
+ * up on nWorkers threads at once
+ */
+static int
+pipelineQueryKeyValueTrie(KeyValueTrie *trie, U64Trie *intTrie, char *filename,
+		int nWorkers, ResultWriter *results,
+		LatencyHistogram *latency, PerfCounters *perf)
+{
+	TrieQueryContext context;
+	QueryPipelineStats stats;
+	uint64_t startTime, endTime;
+	double timeTaken;
+	int status;
+	FILE *fp = NULL;
+
+	fp = openInputFile(filename);
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Failed to open query input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	context.trie = trie;
+	context.intTrie = intTrie;
+
+	startTime = latencyNow();
+	perfCountersStart(perf);
+	status = queryPipelineRun(fp, nWorkers, pipelineLookup, pipelineReport,
+			&context, results, latency, &stats);
+	perfCountersStop(perf, stats.nQueries);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
+	closeInputFile(fp);
+
+	if (status < 0) {
+		fprintf(stderr, "Error: cannot start %d query threads\n", nWorkers);
+		return -1;
+	}
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Queries took %lf seconds on %d threads with reported cost %d\n",
+			timeTaken, nWorkers, (int) stats.cost);
+	return 1;
+}
+
+/** report one key matching the current pattern */
+static int
+printPatternMatch(AAKeyType key, size_t keylen, void *value, void *userdata)
+{
+	printf("PATTERN: '%s' matched key '%s' with value '%s'\n",
+			(char *) userdata, (char *) key, (char *) value);
+	return 0;
+}
+
+/**
+ * Run each of the glob patterns in the given file against the trie
+ */
+static int
+patternQueryKeyValueTrie(KeyValueTrie *trie, char *filename)
+{
+	char linebuffer[LINE_MAX];
+	char *pattern = NULL;
+	uint64_t startTime, endTime;
+	double timeTaken;
+	int nMatches, cost = 0;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: Failed to open pattern input file '%s' : %s\n",
+				filename, strerror(errno));
+		return -1;
+	}
+
+	startTime = latencyNow();
+	while (readPlainLine(fp, linebuffer, LINE_MAX, &pattern)) {
+		nMatches = triePatternSearch(trie, pattern,
+				printPatternMatch, pattern, &cost);
+		if (nMatches < 0) {
+			fprintf(stderr, "Error: cannot parse pattern '%s'\n", pattern);
+		} else {
+			printf("PATTERN: '%s' matched %d keys\n", pattern, nMatches);
+		}
+	}
+	endTime = latencyNow();
+
+	timeTaken = (endTime - startTime) / 1e9;
+	printf("Pattern queries took %lf seconds with reported cost %d\n",
+			timeTaken, cost);
+
 	fclose(fp);
 	return 1;
 }
@@ -131,13 +304,16 @@ queryKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
  * these values outside of the library
  */
 static int
-deleteFromKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
+deleteFromKeyValueTrie(KeyValueTrie *trie, U64Trie *intTrie, char *filename,
+		StringArena *arena, ResultWriter *results, LatencyHistogram *latency,
+		PerfCounters *perf)
 {
 	char linebuffer[LINE_MAX];
 	char *strkey = NULL, *value = NULL;
-	clock_t startTime, endTime;
+	uint64_t startTime, endTime, opStart;
 	double timeTaken;
-	int intkey, cost = 0;
+	long long intkey;
+	int cost = 0, nDeletions = 0;
 	FILE *fp = NULL;
 
 	fp = fopen(filename, "r");
@@ -147,37 +323,48 @@ deleteFromKeyValueTrie(KeyValueTrie *trie, char *filename, int useIntKey)
 		return -1;
 	}
 
-	startTime = clock();
+	startTime = latencyNow();
+	perfCountersStart(perf);
 	while (readPlainLine(fp, linebuffer, LINE_MAX, &strkey)) {
-		if (useIntKey && isdigit(strkey[0])) {
-			if (sscanf(strkey, "%d", &intkey) != 1) {
+		nDeletions++;
+		if (intTrie != NULL && isdigit(strkey[0])) {
+			if (sscanf(strkey, "%lld", &intkey) != 1) {
 				fprintf(stderr, "Error: Failed extracting integer from '%s'\n", strkey);
 				return -1;
 			}
 
-			value = trieDeleteKey(trie,
-					(AAKeyType) &intkey, sizeof(int), &cost);
+			opStart = latencyStart(latency);
+			value = trieDeleteU64(intTrie, AA_I64_KEY(intkey), &cost);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("DELETE: key (%d) produced no value\n", intkey);
+				resultWriterIntegerValue(results, "DELETE", intkey, NULL, 0);
 			} else {
-				printf("DELETE: key (%d) produced value '%s'\n", intkey, value);
-				free(value);
+				resultWriterIntegerValue(results, "DELETE", intkey,
+						value, strlen(value));
+				if (arena == NULL)
+					free(value);
 			}
 
 		} else {
+			opStart = latencyStart(latency);
 			value = trieDeleteKey(trie,
 					(AAKeyType) strkey, strlen(strkey), &cost);
+			latencyStop(latency, opStart);
 			if (value == NULL) {
-				printf("DELETE: key '%s' produced no value\n", strkey);
+				resultWriterValue(results, "DELETE", strkey, NULL, 0);
 			} else {
-				printf("DELETE: key '%s' produced value '%s'\n", strkey, value);
-				free(value);
+				resultWriterValue(results, "DELETE", strkey, value, strlen(value));
+				if (arena == NULL)
+					free(value);
 			}
 		}
 	}
-	endTime = clock();
+	perfCountersStop(perf, nDeletions);
+	endTime = latencyNow();
+
+	resultWriterFlush(results);
 
-	timeTaken = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+	timeTaken = (endTime - startTime) / 1e9;
 	printf("Deletions took %lf seconds with reported cost %d\n",
 			timeTaken, cost);
 
@@ -224,18 +411,54 @@ void usage(char *progname)
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options: \n");
 	fprintf(stderr, "%-*s: Print this help.\n", OPTIONLEN, "-h");
-	fprintf(stderr, "%-*s: If a key is made of digits, store it as an int.\n", OPTIONLEN, "-i");
+	fprintf(stderr, "%-*s: If a key is made of digits, store it as a 64-bit integer key\n", OPTIONLEN, "-i");
+	fprintf(stderr, "%-*s: in a fixed depth trie; these are iterated in numeric order.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Demonstrate the iterator by printing each key in turn\n", OPTIONLEN, "-I");
+	fprintf(stderr, "%-*s: Index trie children by letter, learning the alphabet\n",
+			OPTIONLEN, "-a");
+	fprintf(stderr, "%-*s: from the keys as they are loaded.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -a, but with the letters of the alphabet given.\n",
+			OPTIONLEN, "-A <LETTERS>");
+	fprintf(stderr, "%-*s: Copy values into a string arena that is freed in one go\n",
+			OPTIONLEN, "-s");
+	fprintf(stderr, "%-*s: at exit, rather than with strdup(3).\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -s, also storing repeated values only once.\n",
+			OPTIONLEN, "-S");
+	fprintf(stderr, "%-*s: Write query and delete results as tab separated\n",
+			OPTIONLEN, "-T");
+	fprintf(stderr, "%-*s: \"OPERATION KEY VALUE\" lines, leaving out the value\n",
+			OPTIONLEN, "");
+	fprintf(stderr, "%-*s: (and its tab) for keys not found.\n", OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Output file to write to, default stdout.\n",
 			OPTIONLEN, "-o <FILE>");
 	fprintf(stderr, "%-*s: Print out the trie after processing.\n", OPTIONLEN, "-p");
+	fprintf(stderr, "%-*s: Time each insert, lookup and delete, and report\n",
+			OPTIONLEN, "-l");
+	fprintf(stderr, "%-*s: percentiles of their latencies.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: As -l, also writing every latency (in ns) to <FILE>.\n",
+			OPTIONLEN, "-L <FILE>");
+	fprintf(stderr, "%-*s: Count cycles, instructions, LLC, branch and dTLB misses\n",
+			OPTIONLEN, "-C");
+	fprintf(stderr, "%-*s: over the insert, delete and query phases, per operation.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Perform queries on all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-q <FILE>");
+	fprintf(stderr, "%-*s: or, if <FILE> is \"-\", read from stdin.\n", OPTIONLEN, "");
+	fprintf(stderr, "%-*s: Answer queries on <N> lookup threads, with a reader\n",
+			OPTIONLEN, "-Q <N>");
+	fprintf(stderr, "%-*s: thread feeding them and results in query file order.\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "%-*s: Delete all of the keys listed in <FILE> (one per line)\n",
 			OPTIONLEN, "-d <FILE>");
+	fprintf(stderr, "%-*s: Report keys matching each glob pattern listed in <FILE>\n",
+			OPTIONLEN, "-g <FILE>");
+	fprintf(stderr, "%-*s: (one per line); patterns may use '?', '*' and \"[...]\"\n",
+			OPTIONLEN, "");
 	fprintf(stderr, "\n");
-	fprintf(stderr, "The order of the operations controlled by -d, -q and -p are: deletion first,\n");
-	fprintf(stderr, "followed by any queries, and then finally printing (if indicated)\n");
+	fprintf(stderr, "The order of the operations controlled by -d, -q, -g and -p are: deletion\n");
+	fprintf(stderr, "first, followed by any queries and pattern queries, and then finally\n");
+	fprintf(stderr, "printing (if indicated)\n");
 	fprintf(stderr, "\n");
 	exit (1);
 }
@@ -248,12 +471,26 @@ int
 main(int argc, char **argv)
 {
 	KeyValueTrie *trie;
+	U64Trie *intTrie = NULL;
 	char *programname = NULL;
 	FILE *ofp = stdout;
 	int useIntKey = 0;
+	int useDenseAlphabet = 0;
+	int useArena = 0, internValues = 0;
+	StringArena *arena = NULL;
+	char *alphabet = NULL;
 	int iterateContents = 0;
 	int printContents = 0;
-	char *queryfile = NULL, *deletefile = NULL;
+	int nQueryThreads = 0;
+	int measureLatency = 0;
+	FILE *latencyfp = NULL;
+	LatencyHistogram *insertLatency = NULL, *lookupLatency = NULL;
+	LatencyHistogram *deleteLatency = NULL;
+	int countEvents = 0;
+	PerfCounters *insertPerf = NULL, *lookupPerf = NULL, *deletePerf = NULL;
+	char *queryfile = NULL, *deletefile = NULL, *patternfile = NULL;
+	ResultFormat resultFormat = RESULT_TEXT;
+	ResultWriter *results;
 	int i, c;
 
 
@@ -261,20 +498,64 @@ main(int argc, char **argv)
 	programname = argv[0];
 
 	/** use getopt(3) to parse command line */
-	while ((c = getopt(argc, argv, "hpiIo:q:d:")) != -1) {
+	while ((c = getopt(argc, argv, "hplCiIsSaTA:o:q:d:g:L:Q:")) != -1) {
 		if (c == 'i') {
 			useIntKey = 1;
+		} else if (c == 'T') {
+			resultFormat = RESULT_TSV;
 		} else if (c == 'I') {
 			iterateContents = 1;
 		} else if (c == 'p') {
 			printContents = 1;
 
+		} else if (c == 's') {
+			useArena = 1;
+
+		} else if (c == 'S') {
+			useArena = 1;
+			internValues = 1;
+
+		} else if (c == 'a') {
+			useDenseAlphabet = 1;
+
+		} else if (c == 'A') {
+			useDenseAlphabet = 1;
+			alphabet = optarg;
+
 		} else if (c == 'q') {
 			queryfile = optarg;
 
+		} else if (c == 'Q') {
+			if (sscanf(optarg, "%d", &nQueryThreads) != 1 || nQueryThreads < 1) {
+				fprintf(stderr,
+						"Error: cannot parse number of query"
+						" threads requested from '%s'\n",
+						optarg);
+				usage(programname);
+			}
+
 		} else if (c == 'd') {
 			deletefile = optarg;
 
+		} else if (c == 'g') {
+			patternfile = optarg;
+
+		} else if (c == 'C') {
+			countEvents = 1;
+
+		} else if (c == 'l') {
+			measureLatency = 1;
+
+		} else if (c == 'L') {
+			measureLatency = 1;
+			latencyfp = fopen(optarg, "w");
+			if (latencyfp == NULL) {
+				fprintf(stderr,
+						"Error: cannot open requested latency file '%s' : %s\n",
+						optarg, strerror(errno));
+				usage(programname);
+			}
+
 		} else if (c == 'o') {
 			ofp = fopen(optarg, "w");
 			if (ofp == NULL) {
@@ -310,10 +591,60 @@ main(int argc, char **argv)
 		return -1;
 	}
 
+	if (useDenseAlphabet && trieSetAlphabet(trie, (unsigned char *) alphabet,
+				(alphabet == NULL) ? 0 : strlen(alphabet)) < 0) {
+		fprintf(stderr, "Error: cannot set up trie alphabet - exitting\n");
+		return -1;
+	}
+
+	/** integer keys go into their own fixed depth trie */
+	if (useIntKey) {
+		intTrie = trieCreateU64Trie();
+		if (intTrie == NULL) {
+			fprintf(stderr, "Error: cannot allocate integer trie - exitting\n");
+			return -1;
+		}
+	}
+
+
+	if (useArena) {
+		arena = arenaCreate(internValues);
+		if (arena == NULL) {
+			fprintf(stderr, "Error: cannot allocate string arena - exitting\n");
+			return -1;
+		}
+	}
+
+	if (measureLatency) {
+		insertLatency = latencyCreate("insert", latencyfp != NULL);
+		lookupLatency = latencyCreate("lookup", latencyfp != NULL);
+		deleteLatency = latencyCreate("delete", latencyfp != NULL);
+		if (insertLatency == NULL || lookupLatency == NULL || deleteLatency == NULL) {
+			fprintf(stderr, "Error: cannot allocate latency histograms - exitting\n");
+			return -1;
+		}
+	}
+
+	if (countEvents) {
+		insertPerf = perfCountersCreate("insert");
+		lookupPerf = perfCountersCreate("lookup");
+		deletePerf = perfCountersCreate("delete");
+		if (insertPerf == NULL || lookupPerf == NULL || deletePerf == NULL) {
+			fprintf(stderr, "Error: cannot allocate performance counters - exitting\n");
+			return -1;
+		}
+	}
+
+	results = resultWriterCreate(stdout, resultFormat);
+	if (results == NULL) {
+		fprintf(stderr, "Error: cannot allocate result writer - exitting\n");
+		return -1;
+	}
 
 	/** getopt leaves us only "file" arguments left in argv */
 	for (i = 0; i < argc; i++) {
-		if (loadKeyValueTrie(trie, argv[i], useIntKey) < 0) {
+		if (loadKeyValueTrie(trie, intTrie, argv[i], arena,
+					insertLatency, insertPerf) < 0) {
 			fprintf(stderr, "Error: failed loading from file '%s'\n",
 					argv[i]);
 			return -1;
@@ -325,22 +656,44 @@ main(int argc, char **argv)
 
 	/** delete anything that we were asked to */
 	if (deletefile != NULL) {
-		deleteFromKeyValueTrie(trie, deletefile, useIntKey);
+		deleteFromKeyValueTrie(trie, intTrie, deletefile, arena,
+				results, deleteLatency, deletePerf);
 	}
 	
 	
 
 
 	/** perform any queries we were asked to */
-	if (queryfile != NULL) {
-		queryKeyValueTrie(trie, queryfile, useIntKey);
+	if (queryfile != NULL && nQueryThreads > 0) {
+		pipelineQueryKeyValueTrie(trie, intTrie, queryfile, nQueryThreads,
+				results, lookupLatency, lookupPerf);
+	} else if (queryfile != NULL) {
+		queryKeyValueTrie(trie, intTrie, queryfile, results,
+				lookupLatency, lookupPerf);
+	}
+
+	/** run any pattern queries we were asked to */
+	if (patternfile != NULL) {
+		patternQueryKeyValueTrie(trie, patternfile);
 	}
+	resultWriterDelete(results);
 	
 	
 
+	latencyFinish(stdout, latencyfp, insertLatency);
+	latencyFinish(stdout, latencyfp, deleteLatency);
+	latencyFinish(stdout, latencyfp, lookupLatency);
+	perfCountersFinish(stdout, insertPerf);
+	perfCountersFinish(stdout, deletePerf);
+	perfCountersFinish(stdout, lookupPerf);
+	if (latencyfp != NULL)
+		fclose(latencyfp);
+
 	/** iterate (printing each key) */
 	if (iterateContents) {
 		trieIterateAction(trie, printIteratorValue, stdout);
+		if (intTrie != NULL)
+			trieIterateU64Action(intTrie, printIteratorValue, stdout);
 	}
 	
 	
@@ -348,13 +701,25 @@ main(int argc, char **argv)
 	/* print out what we loaded */
 	if (printContents) {
 		triePrint(ofp, trie);
+		if (intTrie != NULL)
+			trieU64Print(ofp, intTrie);
 	}
 	
 	
 
-	/* clean up before exit */
-	trieIterateAction(trie, deleteValue, NULL);
+	if (arena != NULL)
+		arenaPrintSummary(ofp, arena);
+
+	/* clean up before exit; the arena, if any, takes all the values with it */
+	if (arena == NULL)
+		trieIterateAction(trie, deleteValue, NULL);
 	trieDeleteTrie(trie);
+	if (intTrie != NULL) {
+		if (arena == NULL)
+			trieIterateU64Action(intTrie, deleteValue, NULL);
+		trieDeleteU64Trie(intTrie);
+	}
+	arenaDelete(arena);
 	
 
 	/* exit with success if we get here */
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "hashmix.h"
+#include "u64table.h"
+
+/** grow once more than this fraction (in percent) is in use */
+#define	U64TABLE_MAX_LOAD	70
+#define	U64TABLE_MIN_CAPACITY	16
+
+
+/** splitmix64 finalizer; spreads dense keys over the whole table */
+uint64_t
+u64tableHash(uint64_t key)
+{
+	return hashMix64(key);
+}
+
+/** allocate the arrays for a table of the given (power of 2) size */
+static int
+u64tableAllocate(U64Table *table, size_t capacity)
+{
+	table->keys = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+	table->values = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+	table->used = (unsigned char *) calloc(capacity, 1);
+	if (table->keys == NULL || table->values == NULL || table->used == NULL) {
+		free(table->keys);
+		free(table->values);
+		free(table->used);
+		return -1;
+	}
+	table->capacity = capacity;
+	table->nEntries = 0;
+	return 0;
+}
+
+/**
+ * Create a table sized so that the expected number of entries
+ * fits without growing
+ */
+U64Table *
+u64tableCreate(size_t expectedEntries)
+{
+	U64Table *table;
+	size_t capacity = U64TABLE_MIN_CAPACITY;
+
+	while (capacity * U64TABLE_MAX_LOAD / 100 < expectedEntries)
+		capacity *= 2;
+
+	table = (U64Table *) malloc(sizeof(U64Table));
+	if (table == NULL)
+		return NULL;
+	if (u64tableAllocate(table, capacity) < 0) {
+		free(table);
+		return NULL;
+	}
+	return table;
+}
+
+void
+u64tableDelete(U64Table *table)
+{
+	if (table == NULL)	return;
+	free(table->keys);
+	free(table->values);
+	free(table->used);
+	free(table);
+}
+
+/** double the table, re-placing every entry */
+static int
+u64tableGrow(U64Table *table)
+{
+	U64Table old = *table;
+	uint64_t *value;
+	size_t i;
+
+	if (u64tableAllocate(table, old.capacity * 2) < 0) {
+		*table = old;
+		return -1;
+	}
+	for (i = 0; i < old.capacity; i++) {
+		if (old.used[i]) {
+			value = u64tableSlot(table, old.keys[i]);
+			*value = old.values[i];
+		}
+	}
+	free(old.keys);
+	free(old.values);
+	free(old.used);
+	return 0;
+}
+
+/**
+ * Return the value slot for the key, adding the key with a zero
+ * value if it is not present.  Returns NULL only if the table needed
+ * to grow and could not.
+ */
+uint64_t *
+u64tableSlot(U64Table *table, uint64_t key)
+{
+	size_t mask, i;
+
+	if ((table->nEntries + 1) * 100 > table->capacity * U64TABLE_MAX_LOAD) {
+		if (u64tableGrow(table) < 0)
+			return NULL;
+	}
+
+	mask = table->capacity - 1;
+	for (i = u64tableHash(key) & mask; table->used[i]; i = (i + 1) & mask) {
+		if (table->keys[i] == key)
+			return &table->values[i];
+	}
+
+	table->used[i] = 1;
+	table->keys[i] = key;
+	table->values[i] = 0;
+	table->nEntries++;
+	return &table->values[i];
+}
+
+/** return the value slot for the key, or NULL if it is not present */
+uint64_t *
+u64tableFind(U64Table *table, uint64_t key)
+{
+	size_t mask = table->capacity - 1, i;
+
+	for (i = u64tableHash(key) & mask; table->used[i]; i = (i + 1) & mask) {
+		if (table->keys[i] == key)
+			return &table->values[i];
+	}
+	return NULL;
+}
+
+/**
+ * Remove the key, shifting later members of its probe run back so
+ * that no tombstones are needed.  Returns 1 if the key was present.
+ */
+int
+u64tableRemove(U64Table *table, uint64_t key)
+{
+	size_t mask = table->capacity - 1, i, j, home;
+
+	for (i = u64tableHash(key) & mask; table->used[i]; i = (i + 1) & mask) {
+		if (table->keys[i] == key)
+			break;
+	}
+	if ( ! table->used[i])
+		return 0;
+
+	for (j = (i + 1) & mask; table->used[j]; j = (j + 1) & mask) {
+		home = u64tableHash(table->keys[j]) & mask;
+		/** move j into the hole at i unless its home lies in (i, j] */
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			table->keys[i] = table->keys[j];
+			table->values[i] = table->values[j];
+			i = j;
+		}
+	}
+	table->used[i] = 0;
+	table->nEntries--;
+	return 1;
+}
+
+/**
+ * Call the user function on every entry, in table order.  Returns
+ * the number of entries visited, or -1 if the user function asked
+ * us to stop.
+ */
+int
+u64tableIterate(U64Table *table,
+		int (*userfunction)(uint64_t key, uint64_t value, void *userdata),
+		void *userdata)
+{
+	size_t i;
+	int nVisited = 0;
+
+	for (i = 0; i < table->capacity; i++) {
+		if (table->used[i]) {
+			if ((*userfunction)(table->keys[i], table->values[i], userdata) < 0)
+				return -1;
+			nVisited++;
+		}
+	}
+	return nVisited;
+}
+
@@ -0,0 +1,36 @@
+#ifndef	__U64_HASH_TABLE_HEADER__
+#define	__U64_HASH_TABLE_HEADER__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Open addressing (linear probing) hash table from 64-bit integer
+ * keys to 64-bit values.  Used where the keys are already dense
+ * integers, so there is nothing for a trie to share between them.
+ *
+ * The table is not thread safe; give each thread its own.
+ */
+typedef struct U64Table {
+	uint64_t *keys;
+	uint64_t *values;
+	unsigned char *used;
+	size_t capacity;
+	size_t nEntries;
+} U64Table;
+
+/** prototypes */
+U64Table *u64tableCreate(size_t expectedEntries);
+void u64tableDelete(U64Table *table);
+
+uint64_t *u64tableSlot(U64Table *table, uint64_t key);
+uint64_t *u64tableFind(U64Table *table, uint64_t key);
+int u64tableRemove(U64Table *table, uint64_t key);
+
+int u64tableIterate(U64Table *table,
+		int (*userfunction)(uint64_t key, uint64_t value, void *userdata),
+		void *userdata);
+
+uint64_t u64tableHash(uint64_t key);
+
+#endif /* __U64_HASH_TABLE_HEADER__ */